@@ -62,6 +62,19 @@ render_states = {
 		cull_mode = "cw"
 	}
 
+	particle = {
+		rgb_write_enable = true
+		alpha_write_enable = true
+		depth_write_enable = false
+		depth_enable = true
+		depth_func = "lequal"
+		blend_enable = true
+		blend_src = "src_alpha"
+		blend_dst = "inv_src_alpha"
+		blend_equation = "add"
+		cull_mode = "none"
+	}
+
 	mesh = {
 		rgb_write_enable = true
 		alpha_write_enable = true
@@ -100,18 +113,35 @@ bgfx_shaders = {
 
 			vec3 a_position : POSITION;
 			vec4 a_color0   : COLOR0;
+			vec4 i_data0    : TEXCOORD7;
+			vec4 i_data1    : TEXCOORD6;
+			vec4 i_data2    : TEXCOORD5;
+			vec4 i_data3    : TEXCOORD4;
+			vec4 i_data4    : TEXCOORD3;
 		"""
 
 		vs_input_output = """
+		#if defined(INSTANCED)
+			$input a_position, a_color0, i_data0, i_data1, i_data2, i_data3, i_data4
+		#else
 			$input a_position, a_color0
+		#endif
 			$output v_color0
 		"""
 
 		vs_code = """
 			void main()
 			{
+		#if defined(INSTANCED)
+				// Instance data is the world matrix of a unit primitive,
+				// then its color.
+				mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+				gl_Position = mul(u_viewProj, mul(model, vec4(a_position, 1.0)));
+				v_color0 = toLinearAccurate(i_data4);
+		#else
 				gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
 				v_color0 = toLinearAccurate(a_color0);
+		#endif
 			}
 		"""
 
@@ -191,18 +221,37 @@ bgfx_shaders = {
 
 			vec3 a_position  : POSITION;
 			vec2 a_texcoord0 : TEXCOORD0;
+			vec4 i_data0     : TEXCOORD7;
+			vec4 i_data1     : TEXCOORD6;
+			vec4 i_data2     : TEXCOORD5;
+			vec4 i_data3     : TEXCOORD4;
+			vec4 i_data4     : TEXCOORD3;
 		"""
 
 		vs_input_output = """
+		#if defined(INSTANCED)
+			$input a_position, a_texcoord0, i_data0, i_data1, i_data2, i_data3, i_data4
+		#else
 			$input a_position, a_texcoord0
+		#endif
 			$output v_texcoord0
 		"""
 
 		vs_code = """
 			void main()
 			{
+		#if defined(INSTANCED)
+				// Instance data is the world translation, the world x and z
+				// axes, the frame rectangle and its UV rectangle. The vertex
+				// buffer is a unit quad whose texcoords select the corner.
+				vec2 pos = mix(i_data3.xy, i_data3.zw, a_texcoord0);
+				vec3 world_pos = i_data0.xyz + i_data1.xyz*pos.x + i_data2.xyz*pos.y;
+				gl_Position = mul(u_viewProj, vec4(world_pos, 1.0));
+				v_texcoord0 = mix(i_data4.xy, i_data4.zw, a_texcoord0);
+		#else
 				gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
 				v_texcoord0 = a_texcoord0;
+		#endif
 			}
 		"""
 
@@ -221,6 +270,63 @@ bgfx_shaders = {
 		"""
 	}
 
+	particle = {
+		includes = "common"
+
+		samplers = {
+			u_albedo = { sampler_state = "clamp_anisotropic" }
+		}
+
+		varying = """
+			vec2 v_texcoord0 : TEXCOORD0 = vec2(0.0, 0.0);
+			vec4 v_color0    : COLOR0 = vec4(0.0, 0.0, 0.0, 0.0);
+
+			vec3 a_position  : POSITION;
+			vec2 a_texcoord0 : TEXCOORD0;
+			vec4 i_data0     : TEXCOORD7;
+			vec4 i_data1     : TEXCOORD6;
+		"""
+
+		vs_input_output = """
+			$input a_position, a_texcoord0, i_data0, i_data1
+			$output v_texcoord0, v_color0
+		"""
+
+		vs_code = """
+			void main()
+			{
+				// Instance data is the world position and size of the
+				// particle, then its color. The vertex buffer is a unit quad
+				// whose texcoords select the corner, expanded in view-space
+				// to face the camera.
+				vec4 view_pos = mul(u_view, vec4(i_data0.xyz, 1.0));
+				view_pos.xy += (a_texcoord0 - vec2(0.5, 0.5)) * i_data0.w;
+				gl_Position = mul(u_proj, view_pos);
+				v_texcoord0 = a_texcoord0;
+				v_color0 = toLinearAccurate(i_data1);
+			}
+		"""
+
+		fs_input_output = """
+			$input v_texcoord0, v_color0
+		"""
+
+		fs_code = """
+		#ifdef DIFFUSE_MAP
+			SAMPLER2D(u_albedo, 0);
+		#endif // DIFFUSE_MAP
+
+			void main()
+			{
+		#ifdef DIFFUSE_MAP
+				gl_FragColor = texture2D(u_albedo, v_texcoord0) * v_color0;
+		#else
+				gl_FragColor = v_color0;
+		#endif // DIFFUSE_MAP
+			}
+		"""
+	}
+
 	mesh = {
 		includes = "common"
 
@@ -236,19 +342,36 @@ bgfx_shaders = {
 			vec3 a_position  : POSITION;
 			vec3 a_normal    : NORMAL;
 			vec2 a_texcoord0 : TEXCOORD0;
+			vec4 i_data0     : TEXCOORD7;
+			vec4 i_data1     : TEXCOORD6;
+			vec4 i_data2     : TEXCOORD5;
+			vec4 i_data3     : TEXCOORD4;
 		"""
 
 		vs_input_output = """
+		#if defined(INSTANCED)
+			$input a_position, a_normal, a_texcoord0, i_data0, i_data1, i_data2, i_data3
+		#else
 			$input a_position, a_normal, a_texcoord0
+		#endif
 			$output v_normal, v_view, v_texcoord0
 		"""
 
 		vs_code = """
 			void main()
 			{
+		#if defined(INSTANCED)
+				// World matrix comes from the instance data buffer.
+				mat4 model = mtxFromCols(i_data0, i_data1, i_data2, i_data3);
+				vec4 world_pos = mul(model, vec4(a_position, 1.0));
+				gl_Position = mul(u_viewProj, world_pos);
+				v_view = mul(u_view, world_pos);
+				v_normal = normalize(mul(u_view, mul(model, vec4(a_normal, 0.0))).xyz);
+		#else
 				gl_Position = mul(u_modelViewProj, vec4(a_position, 1.0));
 				v_view = mul(u_modelView, vec4(a_position, 1.0));
 				v_normal = normalize(mul(u_modelView, vec4(a_normal, 0.0)).xyz);
+		#endif
 
 				v_texcoord0 = a_texcoord0;
 			}
@@ -260,11 +383,17 @@ bgfx_shaders = {
 
 		fs_code = """
 		#if !defined(NO_LIGHT)
-			uniform vec4 u_light_position;  // In world-space
-			uniform vec4 u_light_direction; // In view-space
-			uniform vec4 u_light_color;
-			uniform vec4 u_light_range;
-			uniform vec4 u_light_intensity;
+			#define MAX_LIGHTS 8 // Must match CROWN_MAX_LIGHTS_PER_MESH.
+			#define LIGHT_DIRECTIONAL 0.0
+			#define LIGHT_SPOT 2.0
+
+			// In view-space, 4 vec4 per light:
+			// 0: position, type
+			// 1: direction, range
+			// 2: color, intensity
+			// 3: cosine of spot angle
+			uniform vec4 u_lights[MAX_LIGHTS*4];
+			uniform vec4 u_light_count;
 
 			uniform vec4 u_ambient;
 			uniform vec4 u_diffuse;
@@ -281,10 +410,33 @@ bgfx_shaders = {
 				// normalize both input vectors
 				vec3 n = normalize(v_normal);
 				vec3 e = normalize(v_view.xyz);
-				vec3 l = u_light_direction.xyz;
-
-				float nl = max(0.0, dot(n, l));
-				vec3 light_diffuse = nl * toLinearAccurate(u_light_color.rgb) * u_light_intensity.x;
+				vec3 light_diffuse = vec3(0.0, 0.0, 0.0);
+
+				for (int i = 0; i < MAX_LIGHTS; ++i) {
+					if (float(i) >= u_light_count.x)
+						break;
+
+					vec4 pos_type = u_lights[i*4 + 0];
+					vec4 dir_range = u_lights[i*4 + 1];
+					vec4 color_intensity = u_lights[i*4 + 2];
+					vec4 spot = u_lights[i*4 + 3];
+
+					vec3 l = dir_range.xyz;
+					float att = 1.0;
+					if (pos_type.w != LIGHT_DIRECTIONAL) {
+						vec3 d = pos_type.xyz - v_view.xyz;
+						float dist = length(d);
+						l = d / dist;
+						att = max(0.0, 1.0 - dist / dir_range.w);
+						att *= att;
+
+						if (pos_type.w == LIGHT_SPOT)
+							att *= step(spot.x, dot(l, dir_range.xyz));
+					}
+
+					float nl = max(0.0, dot(n, l));
+					light_diffuse += nl * att * toLinearAccurate(color_intensity.rgb) * color_intensity.w;
+				}
 
 				vec3 color = max(u_diffuse.rgb * light_diffuse, u_ambient.rgb);
 		#else
@@ -542,6 +694,11 @@ shaders = {
 		render_state = "sprite"
 	}
 
+	particle = {
+		bgfx_shader = "particle"
+		render_state = "particle"
+	}
+
 	mesh = {
 		bgfx_shader = "mesh"
 		render_state = "mesh"
@@ -577,12 +734,20 @@ shaders = {
 static_compile = [
 	{ shader = "debug_line" defines = [] }
 	{ shader = "debug_line_noz" defines = [] }
+	{ shader = "debug_line" defines = ["INSTANCED"] }
+	{ shader = "debug_line_noz" defines = ["INSTANCED"] }
 	{ shader = "gui" defines = [] }
 	{ shader = "gui" defines = ["DIFFUSE_MAP"]}
 	{ shader = "sprite" defines = [] }
+	{ shader = "sprite" defines = ["INSTANCED"] }
+	{ shader = "particle" defines = [] }
+	{ shader = "particle" defines = ["DIFFUSE_MAP"] }
 	{ shader = "mesh" defines = [] }
 	{ shader = "mesh" defines = ["DIFFUSE_MAP"] }
 	{ shader = "mesh" defines = ["DIFFUSE_MAP" "NO_LIGHT"] }
+	{ shader = "mesh" defines = ["INSTANCED"] }
+	{ shader = "mesh" defines = ["DIFFUSE_MAP" "INSTANCED"] }
+	{ shader = "mesh" defines = ["DIFFUSE_MAP" "NO_LIGHT" "INSTANCED"] }
 	{ shader = "selection" defines = [] }
 	{ shader = "outline" defines = [] }
 	{ shader = "blit" defines = [] }
@@ -31,6 +31,10 @@
 	#define CROWN_BUILD_UNIT_TESTS 1
 #endif
 
+#ifndef CROWN_BUILD_BENCHMARKS
+	#define CROWN_BUILD_BENCHMARKS 1
+#endif
+
 #if !defined(CROWN_PHYSICS_BULLET) \
 	&& !defined(CROWN_PHYSICS_NOOP)
 
@@ -131,6 +135,26 @@
 	#define CROWN_MAX_OS_EVENTS 128
 #endif
 
+#ifndef CROWN_MAX_LIGHTS_PER_MESH
+	#define CROWN_MAX_LIGHTS_PER_MESH 8 // Must match MAX_LIGHTS in core/shaders/default.shader.
+#endif
+
+#ifndef CROWN_MESH_LOD_HYSTERESIS
+	#define CROWN_MESH_LOD_HYSTERESIS 0.1f // Fraction of the LOD screen size.
+#endif
+
+#ifndef CROWN_GUI_MAX_CACHED_GLYPHS
+	#define CROWN_GUI_MAX_CACHED_GLYPHS 16384 // Bytes of text across all the layouts cached by a world.
+#endif
+
+#ifndef CROWN_RESOURCE_LOADER_UNPACK_THREADS
+	#define CROWN_RESOURCE_LOADER_UNPACK_THREADS 3 // Threads helping the loader decompress resources.
+#endif
+
+#ifndef CROWN_TILEMAP_CHUNK_SIZE
+	#define CROWN_TILEMAP_CHUNK_SIZE 16 // In tiles.
+#endif
+
 #ifndef CROWN_USE_LUAJIT
 	#define CROWN_USE_LUAJIT 1
 #endif
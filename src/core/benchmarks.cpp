@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#if CROWN_BUILD_BENCHMARKS
+#include "core/containers/array.inl"
+#include "core/math/aabb_tree.h"
+#include "core/math/math.h"
+#include "core/math/random.h"
+#include "core/math/vector3.inl"
+#include "core/memory/globals.h"
+#include "core/memory/memory.inl"
+#include "core/os.h"
+#include "core/strings/string_id.inl"
+#include "core/thread/job_system.h"
+#include "core/time.h"
+#include "resource/package_resource.h"
+#include <algorithm>
+#include <stdlib.h> // EXIT_SUCCESS
+#include <stdio.h>  // printf
+
+namespace crown
+{
+static void bench_job_system_overhead()
+{
+	const u32 num_jobs = 100000;
+
+	memory_globals::init();
+	for (u32 nw = 0; nw < os::num_cpus(); ++nw) {
+		job_system_globals::init(nw);
+
+		const s64 t0 = time::now();
+		for (u32 ii = 0; ii < num_jobs; ii += 1000) {
+			Job *root = job_system::create([](void *) {});
+			for (u32 jj = 0; jj < 1000; ++jj)
+				job_system::run(job_system::create([](void *) {}, NULL, root));
+			job_system::run(root);
+			job_system::wait(root);
+		}
+		const f64 dt = time::seconds(time::now() - t0);
+
+		printf("  %2u threads: %8.1f ns/job\n", job_system::num_threads(), dt * 1e9 / num_jobs);
+		job_system_globals::shutdown();
+	}
+	memory_globals::shutdown();
+}
+
+static void bench_job_system_scaling()
+{
+	const u32 num_items = 1u << 20;
+
+	memory_globals::init();
+	f32 *items = (f32 *)default_allocator().allocate(sizeof(f32) * num_items);
+
+	f64 dt_1 = 0.0;
+	for (u32 nw = 0; nw < os::num_cpus(); ++nw) {
+		job_system_globals::init(nw);
+
+		const s64 t0 = time::now();
+		job_system::parallel_for(num_items, 4096, [](u32 begin, u32 end, void *data) {
+				f32 *out = (f32 *)data;
+				for (u32 ii = begin; ii < end; ++ii) {
+					f32 x = (f32)ii;
+					for (u32 jj = 0; jj < 32; ++jj)
+						x = fsin(x) * 0.5f + fcos(x) * 0.5f;
+					out[ii] = x;
+				}
+			}
+			, items
+			);
+		const f64 dt = time::seconds(time::now() - t0);
+		if (nw == 0)
+			dt_1 = dt;
+
+		printf("  %2u threads: %8.3f ms (%.2fx)\n", job_system::num_threads(), dt * 1e3, dt_1 / dt);
+		job_system_globals::shutdown();
+	}
+
+	default_allocator().deallocate(items);
+	memory_globals::shutdown();
+}
+
+static void bench_aabb_tree()
+{
+	// Side of the world grows with the cube root of the number of objects to
+	// keep the density constant.
+	const struct
+	{
+		u32 num;
+		f32 extent;
+	} sizes[] =
+	{
+		{  100000,  464.0f },
+		{ 1000000, 1000.0f }
+	};
+
+	memory_globals::init();
+	Allocator &a = default_allocator();
+
+	for (u32 ss = 0; ss < countof(sizes); ++ss) {
+		const u32 num = sizes[ss].num;
+		const f32 extent = sizes[ss].extent;
+
+		Random rnd(1);
+		Array<AABB> boxes(a);
+		Array<u32> proxies(a);
+		array::resize(boxes, num);
+		array::resize(proxies, num);
+		for (u32 ii = 0; ii < num; ++ii) {
+			const Vector3 c = vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float()) * extent;
+			const Vector3 e = vector3(0.5f, 0.5f, 0.5f) + vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float());
+			boxes[ii].min = c - e;
+			boxes[ii].max = c + e;
+		}
+
+		AabbTree t(a);
+
+		// Insert.
+		s64 t0 = time::now();
+		for (u32 ii = 0; ii < num; ++ii)
+			proxies[ii] = aabb_tree::create(t, boxes[ii], ii);
+		const f64 dt_insert = time::seconds(time::now() - t0);
+
+		// Move 10% of the objects, mostly by small amounts.
+		const u32 num_moved = num / 10;
+		u32 num_reinserted = 0;
+		t0 = time::now();
+		for (u32 ii = 0; ii < num_moved; ++ii) {
+			const u32 id = (ii * 7919u) % num;
+			const f32 d = (ii % 8) == 0 ? 5.0f : 0.05f;
+			const Vector3 delta = vector3(rnd.unit_float() - 0.5f, rnd.unit_float() - 0.5f, rnd.unit_float() - 0.5f) * d;
+			boxes[id].min += delta;
+			boxes[id].max += delta;
+			num_reinserted += aabb_tree::move(t, proxies[id], boxes[id]);
+		}
+		const f64 dt_move = time::seconds(time::now() - t0);
+
+		// Query boxes of 20 units.
+		const u32 num_queries = 10000;
+		Array<u32> result(a);
+		u32 num_results = 0;
+		t0 = time::now();
+		for (u32 ii = 0; ii < num_queries; ++ii) {
+			const Vector3 c = vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float()) * extent;
+			AABB q;
+			q.min = c - vector3(10.0f, 10.0f, 10.0f);
+			q.max = c + vector3(10.0f, 10.0f, 10.0f);
+			array::clear(result);
+			aabb_tree::query_box(t, result, q);
+			num_results += array::size(result);
+		}
+		const f64 dt_query = time::seconds(time::now() - t0);
+
+		printf("  %7u objects: insert %6.1f ns/object, move %6.1f ns/object (%u reinserted), query %6.2f us/query (%.1f results), height %u\n"
+			, num
+			, dt_insert * 1e9 / num
+			, dt_move * 1e9 / num_moved
+			, num_reinserted
+			, dt_query * 1e6 / num_queries
+			, f64(num_results) / num_queries
+			, aabb_tree::height(t)
+			);
+	}
+
+	memory_globals::shutdown();
+}
+
+static void bench_package_resource_find()
+{
+	const u32 num = 50000;
+	const u32 num_types = 12;
+
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		// Synthetic package: the offsets are sorted like the compiler does.
+		const u32 size = sizeof(PackageResource) + num*sizeof(ResourceOffset);
+		PackageResource *pr = (PackageResource *)a.allocate(size);
+		pr->version = 0;
+		pr->num_resources = num;
+
+		ResourceOffset *offsets = (ResourceOffset *)&pr[1];
+		for (u32 ii = 0; ii < num; ++ii) {
+			offsets[ii].type = StringId64(u64(ii % num_types));
+			offsets[ii].name = StringId64(u64(ii) * UINT64_C(0x9e3779b97f4a7c15));
+			offsets[ii].offset = ii;
+			offsets[ii].size = 0;
+		}
+		std::sort(offsets, offsets + num, [](const ResourceOffset &ra, const ResourceOffset &rb) {
+				return ra.type < rb.type || (ra.type == rb.type && ra.name < rb.name);
+			});
+
+		// Look every resource up in a different order than it is stored.
+		Array<ResourceOffset> queries(a);
+		array::resize(queries, num);
+		for (u32 ii = 0; ii < num; ++ii)
+			queries[ii] = offsets[(ii * 7919u) % num];
+
+		u32 num_found = 0;
+		s64 t0 = time::now();
+		for (u32 ii = 0; ii < num; ++ii)
+			num_found += package_resource::find(pr, queries[ii].type, queries[ii].name) != NULL;
+		const f64 dt_find = time::seconds(time::now() - t0);
+
+		// Linear scan, on a subset of the queries.
+		const u32 num_scans = 1000;
+		u32 num_scanned = 0;
+		t0 = time::now();
+		for (u32 ii = 0; ii < num_scans; ++ii) {
+			for (u32 jj = 0; jj < num; ++jj) {
+				if (offsets[jj].type == queries[ii].type && offsets[jj].name == queries[ii].name) {
+					++num_scanned;
+					break;
+				}
+			}
+		}
+		const f64 dt_scan = time::seconds(time::now() - t0);
+
+		printf("  %u resources: find %6.1f ns/lookup (%u found), linear scan %8.1f ns/lookup (%u found)\n"
+			, num
+			, dt_find * 1e9 / num
+			, num_found
+			, dt_scan * 1e9 / num_scans
+			, num_scanned
+			);
+
+		a.deallocate(pr);
+	}
+	memory_globals::shutdown();
+}
+
+#define RUN_BENCHMARK(name) \
+	do {                    \
+		printf(#name "\n"); \
+		name();             \
+	} while (0)
+
+int main_benchmarks()
+{
+	RUN_BENCHMARK(bench_job_system_overhead);
+	RUN_BENCHMARK(bench_job_system_scaling);
+	RUN_BENCHMARK(bench_aabb_tree);
+	RUN_BENCHMARK(bench_package_resource_find);
+
+	return EXIT_SUCCESS;
+}
+
+} // namespace crown
+
+#endif // if CROWN_BUILD_BENCHMARKS
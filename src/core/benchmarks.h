@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+namespace crown
+{
+/// Runs all the benchmarks.
+int main_benchmarks();
+
+} // namespace crown
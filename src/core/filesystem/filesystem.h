@@ -40,6 +40,13 @@ struct Filesystem
 	/// Closes the given @a file.
 	virtual void close(File &file) = 0;
 
+	/// Maps the file at the given @a path in memory. Changes to the memory
+	/// are private and never written back to the file. The memory stays
+	/// valid until the returned file is closed with close().
+	/// Returns NULL if the file cannot be mapped, e.g. if it is empty or
+	/// 4 GiB or larger.
+	virtual FileMemory *map(const char *path) = 0;
+
 	/// Returns information about @a path.
 	virtual Stat stat(const char *path) = 0;
 
@@ -133,6 +133,13 @@ void FilesystemApk::close(File &file)
 	CE_DELETE(*_allocator, &file);
 }
 
+FileMemory *FilesystemApk::map(const char *path)
+{
+	// Assets are accessed through AAssetManager only.
+	CE_UNUSED(path);
+	return NULL;
+}
+
 Stat FilesystemApk::stat(const char *path)
 {
 	CE_UNUSED(path);
@@ -31,6 +31,9 @@ struct FilesystemApk : public Filesystem
 	/// @copydoc Filesystem::close()
 	void close(File &file) override;
 
+	/// @copydoc Filesystem::map()
+	FileMemory *map(const char *path) override;
+
 	/// @copydoc Filesystem::stat()
 	Stat stat(const char *path) override;
 
@@ -5,6 +5,7 @@
 
 #include "core/containers/vector.inl"
 #include "core/filesystem/file.h"
+#include "core/filesystem/file_memory.inl"
 #include "core/filesystem/filesystem_disk.h"
 #include "core/filesystem/path.h"
 #include "core/memory/temp_allocator.inl"
@@ -20,6 +21,10 @@
 #else
 	#include <stdio.h>
 	#include <errno.h>
+	#include <fcntl.h>    // open
+	#include <sys/mman.h> // mmap, posix_madvise
+	#include <sys/stat.h> // fstat
+	#include <unistd.h>   // close
 #endif
 
 namespace crown
@@ -227,6 +232,104 @@ struct FileDisk : public File
 	}
 };
 
+/// File mapped in memory copy-on-write. Changes to its memory are private
+/// and never written back to the file.
+struct FileMapped : public FileMemory
+{
+#if CROWN_PLATFORM_WINDOWS
+	HANDLE _file;
+	HANDLE _mapping;
+#endif
+
+	FileMapped()
+		: FileMemory(NULL, 0)
+#if CROWN_PLATFORM_WINDOWS
+		, _file(INVALID_HANDLE_VALUE)
+		, _mapping(NULL)
+#endif
+	{
+	}
+
+	virtual ~FileMapped()
+	{
+		close();
+	}
+
+	void open(const char *path, FileOpenMode::Enum mode) override
+	{
+		CE_ASSERT(mode == FileOpenMode::READ, "Mapped files cannot be written");
+		CE_UNUSED(mode);
+#if CROWN_PLATFORM_WINDOWS
+		_file = CreateFile(path
+			, GENERIC_READ
+			, FILE_SHARE_READ
+			, NULL
+			, OPEN_EXISTING
+			, FILE_FLAG_SEQUENTIAL_SCAN
+			, NULL
+			);
+		if (_file == INVALID_HANDLE_VALUE)
+			return;
+
+		// Files of 4 GiB or more do not fit in _size: let the caller read them.
+		DWORD size_high;
+		const DWORD size = GetFileSize(_file, &size_high);
+		if (size != 0 && size_high == 0)
+			_mapping = CreateFileMapping(_file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (_mapping != NULL)
+			_memory = (const u8 *)MapViewOfFile(_mapping, FILE_MAP_COPY, 0, 0, 0);
+
+		if (_memory == NULL) {
+			if (_mapping != NULL)
+				CloseHandle(_mapping);
+			CloseHandle(_file);
+			_mapping = NULL;
+			_file = INVALID_HANDLE_VALUE;
+			return;
+		}
+		_size = size;
+#else
+		int fd = ::open(path, O_RDONLY);
+		if (fd == -1)
+			return;
+
+		// Files of 4 GiB or more do not fit in _size: let the caller read them.
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0 && u64(info.st_size) <= UINT32_MAX) {
+			void *mem = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (mem != MAP_FAILED) {
+				// Data is mostly read front to back: read ahead aggressively
+				// and let the pages already read be reclaimed.
+				posix_madvise(mem, (size_t)info.st_size, POSIX_MADV_SEQUENTIAL);
+				_memory = (const u8 *)mem;
+				_size = (u32)info.st_size;
+			}
+		}
+
+		// The mapping keeps its own reference to the file.
+		::close(fd);
+#endif
+		_position = 0;
+	}
+
+	void close() override
+	{
+		if (!is_open())
+			return;
+
+#if CROWN_PLATFORM_WINDOWS
+		UnmapViewOfFile(_memory);
+		CloseHandle(_mapping);
+		CloseHandle(_file);
+		_mapping = NULL;
+		_file = INVALID_HANDLE_VALUE;
+#else
+		munmap((void *)_memory, _size);
+#endif
+		FileMemory::close();
+	}
+};
+
 FilesystemDisk::FilesystemDisk(Allocator &a)
 	: _allocator(&a)
 	, _prefix(a)
@@ -256,6 +359,24 @@ void FilesystemDisk::close(File &file)
 	CE_DELETE(*_allocator, &file);
 }
 
+FileMemory *FilesystemDisk::map(const char *path)
+{
+	CE_ENSURE(NULL != path);
+
+	TempAllocator256 ta;
+	DynamicString abs_path(ta);
+	absolute_path(abs_path, path);
+
+	FileMapped *file = CE_NEW(*_allocator, FileMapped)();
+	file->open(abs_path.c_str(), FileOpenMode::READ);
+	if (!file->is_open()) {
+		CE_DELETE(*_allocator, file);
+		return NULL;
+	}
+
+	return file;
+}
+
 Stat FilesystemDisk::stat(const char *path)
 {
 	CE_ENSURE(NULL != path);
@@ -37,6 +37,9 @@ struct FilesystemDisk : public Filesystem
 	/// @copydoc Filesystem::close()
 	void close(File &file) override;
 
+	/// @copydoc Filesystem::map()
+	FileMemory *map(const char *path) override;
+
 	/// @copydoc Filesystem::stat()
 	Stat stat(const char *path) override;
 
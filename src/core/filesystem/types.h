@@ -10,6 +10,7 @@
 namespace crown
 {
 struct File;
+struct FileMemory;
 struct FileMonitor;
 struct Filesystem;
 
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/lz4.h"
+#include <string.h> // memcpy, memset
+
+namespace crown
+{
+namespace lz4
+{
+	// A sequence is a token, the literals and a match:
+	//   token:    4 bits literal length, 4 bits match length - MIN_MATCH
+	//   literals: [extra length bytes] literal bytes
+	//   match:    2 bytes little-endian offset, [extra length bytes]
+	// The last sequence has literals only.
+	static const u32 MIN_MATCH     = 4;
+	static const u32 LAST_LITERALS = 5;  // The last bytes are always literals.
+	static const u32 MF_LIMIT      = 12; // The last match starts before this many bytes from the end.
+	static const u32 MAX_OFFSET    = 65535;
+	static const u32 HASH_BITS     = 12;
+
+	static inline u32 read32(const u8 *p)
+	{
+		u32 val;
+		memcpy(&val, p, sizeof(val));
+		return val;
+	}
+
+	static inline u32 hash(u32 val)
+	{
+		return (val * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	static inline u8 *write_length(u8 *out, u32 len)
+	{
+		for (; len >= 255; len -= 255)
+			*out++ = 255;
+		*out++ = u8(len);
+		return out;
+	}
+
+	static u8 *write_sequence(u8 *out, u8 *out_end, const u8 *literals, u32 num_literals, u32 offset, u32 match_len)
+	{
+		const u32 max_size = 1 + num_literals/255 + 1 + num_literals + 2 + match_len/255 + 1;
+		if (max_size > u32(out_end - out))
+			return NULL;
+
+		u8 *token = out++;
+		*token = u8((num_literals < 15 ? num_literals : 15) << 4);
+		if (num_literals >= 15)
+			out = write_length(out, num_literals - 15);
+		memcpy(out, literals, num_literals);
+		out += num_literals;
+
+		if (match_len == 0)
+			return out;
+
+		*out++ = u8(offset);
+		*out++ = u8(offset >> 8);
+
+		const u32 len = match_len - MIN_MATCH;
+		*token |= u8(len < 15 ? len : 15);
+		if (len >= 15)
+			out = write_length(out, len - 15);
+
+		return out;
+	}
+
+	u32 compress_bound(u32 size)
+	{
+		return size + size/255 + 16;
+	}
+
+	u32 compress(void *dst, u32 dst_size, const void *src, u32 src_size)
+	{
+		const u8 *in = (const u8 *)src;
+		const u8 *in_end = in + src_size;
+		const u8 *anchor = in;
+		u8 *out = (u8 *)dst;
+		u8 *out_end = out + dst_size;
+
+		if (src_size > MF_LIMIT) {
+			u32 table[1 << HASH_BITS];
+			memset(table, 0, sizeof(table));
+
+			const u8 *match_limit = in_end - MF_LIMIT;
+			const u8 *ip = in + 1;
+			while (ip < match_limit) {
+				const u32 h = hash(read32(ip));
+				const u8 *ref = in + table[h];
+				table[h] = u32(ip - in);
+
+				if (ip - ref > MAX_OFFSET || read32(ref) != read32(ip)) {
+					// Skip faster through data that does not compress.
+					ip += 1 + ((ip - anchor) >> 6);
+					continue;
+				}
+
+				// Extend the match backwards, then forwards.
+				while (ip > anchor && ref > in && ip[-1] == ref[-1]) {
+					--ip;
+					--ref;
+				}
+
+				const u8 *limit = in_end - LAST_LITERALS;
+				u32 len = MIN_MATCH;
+				while (ip + len < limit && ip[len] == ref[len])
+					++len;
+
+				out = write_sequence(out, out_end, anchor, u32(ip - anchor), u32(ip - ref), len);
+				if (out == NULL)
+					return 0;
+
+				ip += len;
+				anchor = ip;
+
+				if (ip < match_limit)
+					table[hash(read32(ip - 2))] = u32(ip - 2 - in);
+			}
+		}
+
+		out = write_sequence(out, out_end, anchor, u32(in_end - anchor), 0, 0);
+		if (out == NULL)
+			return 0;
+
+		return u32(out - (u8 *)dst);
+	}
+
+	bool decompress(void *dst, u32 dst_size, const void *src, u32 src_size)
+	{
+		const u8 *ip = (const u8 *)src;
+		const u8 *ip_end = ip + src_size;
+		u8 *op = (u8 *)dst;
+		u8 *op_end = op + dst_size;
+
+		while (ip < ip_end) {
+			const u32 token = *ip++;
+
+			u32 num_literals = token >> 4;
+			if (num_literals == 15) {
+				u32 b;
+				do {
+					if (ip == ip_end)
+						return false;
+					b = *ip++;
+					num_literals += b;
+				} while (b == 255);
+			}
+
+			if (num_literals > u32(ip_end - ip) || num_literals > u32(op_end - op))
+				return false;
+
+			memcpy(op, ip, num_literals);
+			ip += num_literals;
+			op += num_literals;
+
+			// The last sequence has no match.
+			if (ip == ip_end)
+				break;
+
+			if (ip_end - ip < 2)
+				return false;
+
+			const u32 offset = ip[0] | (u32(ip[1]) << 8);
+			ip += 2;
+			if (offset == 0 || offset > u32(op - (u8 *)dst))
+				return false;
+
+			u32 len = token & 15;
+			if (len == 15) {
+				u32 b;
+				do {
+					if (ip == ip_end)
+						return false;
+					b = *ip++;
+					len += b;
+				} while (b == 255);
+			}
+			len += MIN_MATCH;
+
+			if (len > u32(op_end - op))
+				return false;
+
+			const u8 *ref = op - offset;
+			if (offset >= len) {
+				memcpy(op, ref, len);
+			} else {
+				// Overlapping match: repeats the last offset bytes.
+				for (u32 i = 0; i < len; ++i)
+					op[i] = ref[i];
+			}
+			op += len;
+		}
+
+		return op == op_end;
+	}
+
+} // namespace lz4
+
+} // namespace crown
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/types.h"
+
+namespace crown
+{
+/// Functions to compress data in the LZ4 block format.
+///
+/// @ingroup Core
+namespace lz4
+{
+	/// Returns the maximum size of @a size bytes once compressed.
+	u32 compress_bound(u32 size);
+
+	/// Compresses @a src_size bytes from @a src into @a dst, which can hold at
+	/// most @a dst_size bytes. Returns the size of the compressed data or 0 if
+	/// it does not fit in @a dst.
+	u32 compress(void *dst, u32 dst_size, const void *src, u32 src_size);
+
+	/// Decompresses @a src_size bytes from @a src into @a dst. Returns true if
+	/// @a src is valid and decompresses to exactly @a dst_size bytes.
+	bool decompress(void *dst, u32 dst_size, const void *src, u32 src_size);
+
+} // namespace lz4
+
+} // namespace crown
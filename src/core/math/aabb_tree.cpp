@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/containers/array.inl"
+#include "core/error/error.inl"
+#include "core/math/aabb_tree.h"
+#include "core/math/intersection.h"
+#include "core/math/vector3.inl"
+#include <float.h>  // FLT_MAX
+#include <stdint.h> // UINT32_MAX
+
+#define AABB_TREE_NULL       UINT32_MAX
+#define AABB_TREE_MARGIN     0.1f
+#define AABB_TREE_STACK_SIZE 256
+
+namespace crown
+{
+AabbTree::AabbTree(Allocator &a)
+	: _nodes(a)
+	, _root(AABB_TREE_NULL)
+	, _free_list(AABB_TREE_NULL)
+	, _num_proxies(0)
+{
+}
+
+namespace aabb_tree
+{
+	static AABB merge(const AABB &a, const AABB &b)
+	{
+		AABB r;
+		r.min = min(a.min, b.min);
+		r.max = max(a.max, b.max);
+		return r;
+	}
+
+	/// Returns half the surface area of the box @a b.
+	static f32 area(const AABB &b)
+	{
+		const Vector3 d = b.max - b.min;
+		return d.x*d.y + d.y*d.z + d.z*d.x;
+	}
+
+	static bool contains(const AABB &a, const AABB &b)
+	{
+		return a.min.x <= b.min.x && a.min.y <= b.min.y && a.min.z <= b.min.z
+			&& a.max.x >= b.max.x && a.max.y >= b.max.y && a.max.z >= b.max.z
+			;
+	}
+
+	static bool is_leaf(const AabbTree::Node &n)
+	{
+		return n.left == AABB_TREE_NULL;
+	}
+
+	static bool is_proxy(const AabbTree &t, u32 id)
+	{
+		return id < array::size(t._nodes) && is_leaf(t._nodes[id]) && t._nodes[id].height == 0;
+	}
+
+	static u32 allocate_node(AabbTree &t)
+	{
+		AabbTree::Node n;
+		n.parent = AABB_TREE_NULL;
+		n.left = AABB_TREE_NULL;
+		n.right = AABB_TREE_NULL;
+		n.user_data = 0;
+		n.height = 0;
+
+		const u32 id = t._free_list;
+		if (id == AABB_TREE_NULL)
+			return array::push_back(t._nodes, n);
+
+		t._free_list = t._nodes[id].parent;
+		t._nodes[id] = n;
+		return id;
+	}
+
+	static void free_node(AabbTree &t, u32 id)
+	{
+		t._nodes[id].parent = t._free_list;
+		t._nodes[id].height = -1;
+		t._free_list = id;
+	}
+
+	static void replace_child(AabbTree &t, u32 parent, u32 old_child, u32 new_child)
+	{
+		if (parent == AABB_TREE_NULL)
+			t._root = new_child;
+		else if (t._nodes[parent].left == old_child)
+			t._nodes[parent].left = new_child;
+		else
+			t._nodes[parent].right = new_child;
+	}
+
+	static void refit(AabbTree &t, u32 id)
+	{
+		AabbTree::Node &n = t._nodes[id];
+		const AabbTree::Node &l = t._nodes[n.left];
+		const AabbTree::Node &r = t._nodes[n.right];
+		n.aabb = merge(l.aabb, r.aabb);
+		n.height = 1 + max(l.height, r.height);
+	}
+
+	/// Rotates the subtree rooted at @a a if it is imbalanced and returns
+	/// the index of its new root.
+	static u32 balance(AabbTree &t, u32 a)
+	{
+		AabbTree::Node *nodes = array::begin(t._nodes);
+
+		if (is_leaf(nodes[a]) || nodes[a].height < 2)
+			return a;
+
+		const u32 b = nodes[a].left;
+		const u32 c = nodes[a].right;
+		const s32 bal = nodes[c].height - nodes[b].height;
+
+		if (bal > 1) {
+			// Rotate c up.
+			const u32 f = nodes[c].left;
+			const u32 g = nodes[c].right;
+
+			nodes[c].left = a;
+			nodes[c].parent = nodes[a].parent;
+			nodes[a].parent = c;
+			replace_child(t, nodes[c].parent, a, c);
+
+			if (nodes[f].height > nodes[g].height) {
+				nodes[c].right = f;
+				nodes[a].right = g;
+				nodes[g].parent = a;
+			} else {
+				nodes[c].right = g;
+				nodes[a].right = f;
+				nodes[f].parent = a;
+			}
+
+			refit(t, a);
+			refit(t, c);
+			return c;
+		}
+
+		if (bal < -1) {
+			// Rotate b up.
+			const u32 d = nodes[b].left;
+			const u32 e = nodes[b].right;
+
+			nodes[b].left = a;
+			nodes[b].parent = nodes[a].parent;
+			nodes[a].parent = b;
+			replace_child(t, nodes[b].parent, a, b);
+
+			if (nodes[d].height > nodes[e].height) {
+				nodes[b].right = d;
+				nodes[a].left = e;
+				nodes[e].parent = a;
+			} else {
+				nodes[b].right = e;
+				nodes[a].left = d;
+				nodes[d].parent = a;
+			}
+
+			refit(t, a);
+			refit(t, b);
+			return b;
+		}
+
+		return a;
+	}
+
+	/// Refits and balances the ancestors of @a id up to the root.
+	static void fix_upwards(AabbTree &t, u32 id)
+	{
+		while (id != AABB_TREE_NULL) {
+			id = balance(t, id);
+			refit(t, id);
+			id = t._nodes[id].parent;
+		}
+	}
+
+	static void insert_leaf(AabbTree &t, u32 leaf)
+	{
+		if (t._root == AABB_TREE_NULL) {
+			t._root = leaf;
+			t._nodes[leaf].parent = AABB_TREE_NULL;
+			return;
+		}
+
+		// Find the best sibling by descending towards the child whose
+		// area grows the least.
+		const AABB leaf_aabb = t._nodes[leaf].aabb;
+		u32 id = t._root;
+		while (!is_leaf(t._nodes[id])) {
+			const AabbTree::Node &n = t._nodes[id];
+			const f32 node_area = area(n.aabb);
+			const f32 combined_area = area(merge(n.aabb, leaf_aabb));
+
+			// Cost of making a new parent for this node and the leaf.
+			const f32 cost = 2.0f * combined_area;
+
+			// Minimum cost of pushing the leaf further down the tree.
+			const f32 inheritance_cost = 2.0f * (combined_area - node_area);
+
+			f32 child_cost[2];
+			const u32 children[] = { n.left, n.right };
+			for (u32 ii = 0; ii < 2; ++ii) {
+				const AabbTree::Node &c = t._nodes[children[ii]];
+				child_cost[ii] = area(merge(c.aabb, leaf_aabb)) + inheritance_cost;
+				if (!is_leaf(c))
+					child_cost[ii] -= area(c.aabb);
+			}
+
+			if (cost < child_cost[0] && cost < child_cost[1])
+				break;
+
+			id = child_cost[0] < child_cost[1] ? n.left : n.right;
+		}
+
+		const u32 sibling = id;
+		const u32 old_parent = t._nodes[sibling].parent;
+		const u32 new_parent = allocate_node(t);
+
+		AabbTree::Node &p = t._nodes[new_parent];
+		p.parent = old_parent;
+		p.left = sibling;
+		p.right = leaf;
+		p.aabb = merge(leaf_aabb, t._nodes[sibling].aabb);
+		p.height = t._nodes[sibling].height + 1;
+		replace_child(t, old_parent, sibling, new_parent);
+
+		t._nodes[sibling].parent = new_parent;
+		t._nodes[leaf].parent = new_parent;
+
+		fix_upwards(t, new_parent);
+	}
+
+	static void remove_leaf(AabbTree &t, u32 leaf)
+	{
+		if (leaf == t._root) {
+			t._root = AABB_TREE_NULL;
+			return;
+		}
+
+		const u32 parent = t._nodes[leaf].parent;
+		const u32 grand_parent = t._nodes[parent].parent;
+		const u32 sibling = t._nodes[parent].left == leaf
+			? t._nodes[parent].right
+			: t._nodes[parent].left
+			;
+
+		replace_child(t, grand_parent, parent, sibling);
+		t._nodes[sibling].parent = grand_parent;
+		free_node(t, parent);
+
+		fix_upwards(t, grand_parent);
+	}
+
+	u32 create(AabbTree &t, const AABB &b, u32 user_data)
+	{
+		const u32 id = allocate_node(t);
+		const Vector3 margin = vector3(AABB_TREE_MARGIN, AABB_TREE_MARGIN, AABB_TREE_MARGIN);
+
+		AabbTree::Node &n = t._nodes[id];
+		n.aabb.min = b.min - margin;
+		n.aabb.max = b.max + margin;
+		n.user_data = user_data;
+
+		insert_leaf(t, id);
+		++t._num_proxies;
+		return id;
+	}
+
+	void destroy(AabbTree &t, u32 proxy)
+	{
+		CE_ASSERT(is_proxy(t, proxy), "Invalid proxy");
+
+		remove_leaf(t, proxy);
+		free_node(t, proxy);
+		--t._num_proxies;
+	}
+
+	bool move(AabbTree &t, u32 proxy, const AABB &b)
+	{
+		CE_ASSERT(is_proxy(t, proxy), "Invalid proxy");
+
+		const Vector3 margin = vector3(AABB_TREE_MARGIN, AABB_TREE_MARGIN, AABB_TREE_MARGIN);
+		const AABB &fat = t._nodes[proxy].aabb;
+
+		// Keep the current box unless the new one escapes it or it has become
+		// much larger than needed.
+		AABB huge;
+		huge.min = b.min - 4.0f*margin;
+		huge.max = b.max + 4.0f*margin;
+		if (contains(fat, b) && contains(huge, fat))
+			return false;
+
+		remove_leaf(t, proxy);
+		t._nodes[proxy].aabb.min = b.min - margin;
+		t._nodes[proxy].aabb.max = b.max + margin;
+		insert_leaf(t, proxy);
+		return true;
+	}
+
+	u32 user_data(const AabbTree &t, u32 proxy)
+	{
+		CE_ASSERT(is_proxy(t, proxy), "Invalid proxy");
+		return t._nodes[proxy].user_data;
+	}
+
+	void set_user_data(AabbTree &t, u32 proxy, u32 user_data)
+	{
+		CE_ASSERT(is_proxy(t, proxy), "Invalid proxy");
+		t._nodes[proxy].user_data = user_data;
+	}
+
+	const AABB &fat_aabb(const AabbTree &t, u32 proxy)
+	{
+		CE_ASSERT(is_proxy(t, proxy), "Invalid proxy");
+		return t._nodes[proxy].aabb;
+	}
+
+	u32 size(const AabbTree &t)
+	{
+		return t._num_proxies;
+	}
+
+	u32 height(const AabbTree &t)
+	{
+		return t._root == AABB_TREE_NULL ? 0 : t._nodes[t._root].height;
+	}
+
+	void clear(AabbTree &t)
+	{
+		array::clear(t._nodes);
+		t._root = AABB_TREE_NULL;
+		t._free_list = AABB_TREE_NULL;
+		t._num_proxies = 0;
+	}
+
+	/// Appends to @a result the user data of the leaves whose box passes
+	/// @a overlaps.
+	template<typename Overlaps>
+	static void query(const AabbTree &t, Array<u32> &result, Overlaps overlaps)
+	{
+		if (t._root == AABB_TREE_NULL)
+			return;
+
+		u32 stack[AABB_TREE_STACK_SIZE];
+		u32 top = 0;
+		stack[top++] = t._root;
+
+		while (top > 0) {
+			const AabbTree::Node &n = t._nodes[stack[--top]];
+			if (!overlaps(n.aabb))
+				continue;
+
+			if (is_leaf(n)) {
+				array::push_back(result, n.user_data);
+			} else {
+				CE_ENSURE(top + 2 <= countof(stack));
+				stack[top++] = n.right;
+				stack[top++] = n.left;
+			}
+		}
+	}
+
+	void query_box(const AabbTree &t, Array<u32> &result, const AABB &b)
+	{
+		query(t, result, [&b](const AABB &nb) { return aabb_intersects_aabb(nb, b); });
+	}
+
+	void query_sphere(const AabbTree &t, Array<u32> &result, const Sphere &s)
+	{
+		query(t, result, [&s](const AABB &nb) { return sphere_intersects_aabb(s, nb); });
+	}
+
+	void query_frustum(const AabbTree &t, Array<u32> &result, const Frustum &f)
+	{
+		query(t, result, [&f](const AABB &nb) { return aabb_intersects_frustum(nb, f); });
+	}
+
+	f32 cast_ray(const AabbTree &t
+		, const Vector3 &from
+		, const Vector3 &dir
+		, BvhRayFunction function
+		, void *user_data
+		, u32 *hit
+		)
+	{
+		const Vector3 inv_dir = vector3(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
+
+		if (t._root == AABB_TREE_NULL || ray_aabb_intersection(from, inv_dir, t._nodes[t._root].aabb) == -1.0f)
+			return -1.0f;
+
+		struct Item
+		{
+			u32 node;
+			f32 t;
+		};
+
+		Item stack[AABB_TREE_STACK_SIZE];
+		u32 top = 0;
+
+		f32 tmin = FLT_MAX;
+		u32 hit_data = 0;
+		bool any_hit = false;
+		u32 cur = t._root;
+
+		for (;;) {
+			const AabbTree::Node &n = t._nodes[cur];
+
+			if (is_leaf(n)) {
+				const f32 ti = function(n.user_data, from, dir, user_data);
+				if (ti >= 0.0f && ti < tmin) {
+					tmin = ti;
+					hit_data = n.user_data;
+					any_hit = true;
+				}
+			} else {
+				// Visit the nearest child first and postpone the farthest.
+				u32 nearest  = n.left;
+				u32 farthest = n.right;
+				f32 t_nearest  = ray_aabb_intersection(from, inv_dir, t._nodes[nearest].aabb);
+				f32 t_farthest = ray_aabb_intersection(from, inv_dir, t._nodes[farthest].aabb);
+				if (t_nearest == -1.0f)
+					t_nearest = FLT_MAX;
+				if (t_farthest == -1.0f)
+					t_farthest = FLT_MAX;
+				if (t_farthest < t_nearest) {
+					exchange(nearest, farthest);
+					exchange(t_nearest, t_farthest);
+				}
+
+				if (t_nearest < tmin) {
+					if (t_farthest < tmin) {
+						CE_ENSURE(top < countof(stack));
+						stack[top++] = { farthest, t_farthest };
+					}
+					cur = nearest;
+					continue;
+				}
+			}
+
+			// Skip postponed nodes farther than the nearest hit so far.
+			while (top > 0 && stack[top - 1].t >= tmin)
+				--top;
+			if (top == 0)
+				break;
+			cur = stack[--top].node;
+		}
+
+		if (!any_hit)
+			return -1.0f;
+
+		if (hit != NULL)
+			*hit = hit_data;
+
+		return tmin;
+	}
+
+} // namespace aabb_tree
+
+} // namespace crown
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/containers/types.h"
+#include "core/math/bvh.h"
+#include "core/math/types.h"
+
+namespace crown
+{
+/// Dynamic bounding volume hierarchy of axis-aligned boxes.
+///
+/// Each proxy stores a box slightly larger than the one it was created or
+/// moved with, so that small movements do not change the tree. Moving a
+/// proxy outside of its enlarged box removes and reinserts it, keeping the
+/// tree balanced with rotations.
+///
+/// @ingroup Math
+struct AabbTree
+{
+	struct Node
+	{
+		AABB aabb;
+		u32 parent;    ///< Parent node or next free node.
+		u32 left;      ///< UINT32_MAX if the node is a leaf.
+		u32 right;
+		u32 user_data;
+		s32 height;    ///< 0 for leaves, -1 for free nodes.
+	};
+
+	Array<Node> _nodes;
+	u32 _root;
+	u32 _free_list;
+	u32 _num_proxies;
+
+	///
+	explicit AabbTree(Allocator &a);
+};
+
+/// Functions to manipulate AabbTree.
+///
+/// @ingroup Math
+namespace aabb_tree
+{
+	/// Creates a new proxy enclosing the box @a b and returns its ID.
+	u32 create(AabbTree &t, const AABB &b, u32 user_data);
+
+	/// Destroys the @a proxy.
+	void destroy(AabbTree &t, u32 proxy);
+
+	/// Moves the @a proxy to enclose the box @a b. Returns whether the proxy
+	/// had to be reinserted in the tree.
+	bool move(AabbTree &t, u32 proxy, const AABB &b);
+
+	/// Returns the user data of the @a proxy.
+	u32 user_data(const AabbTree &t, u32 proxy);
+
+	/// Sets the user data of the @a proxy.
+	void set_user_data(AabbTree &t, u32 proxy, u32 user_data);
+
+	/// Returns the (enlarged) box of the @a proxy.
+	const AABB &fat_aabb(const AabbTree &t, u32 proxy);
+
+	/// Returns the number of proxies in the tree.
+	u32 size(const AabbTree &t);
+
+	/// Returns the height of the tree.
+	u32 height(const AabbTree &t);
+
+	/// Destroys all the proxies in the tree.
+	void clear(AabbTree &t);
+
+	/// Appends to @a result the user data of the proxies whose box intersects
+	/// the box @a b.
+	void query_box(const AabbTree &t, Array<u32> &result, const AABB &b);
+
+	/// Appends to @a result the user data of the proxies whose box intersects
+	/// the sphere @a s.
+	void query_sphere(const AabbTree &t, Array<u32> &result, const Sphere &s);
+
+	/// Appends to @a result the user data of the proxies whose box intersects
+	/// the frustum @a f.
+	void query_frustum(const AabbTree &t, Array<u32> &result, const Frustum &f);
+
+	/// Returns the distance along ray (from, dir) to the nearest intersection
+	/// point with the proxies in @a t or -1.0 if no intersection. Each proxy
+	/// whose box is crossed by the ray is tested by calling @a function with
+	/// its user data. If @a hit is not NULL it is set to the user data of the
+	/// nearest proxy hit.
+	f32 cast_ray(const AabbTree &t
+		, const Vector3 &from
+		, const Vector3 &dir
+		, BvhRayFunction function
+		, void *user_data
+		, u32 *hit = NULL
+		);
+
+} // namespace aabb_tree
+
+} // namespace crown
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/error/error.inl"
+#include "core/math/aabb.inl"
+#include "core/math/bvh.h"
+#include "core/math/intersection.h"
+#include "core/math/vector3.inl"
+#include <float.h>  // FLT_MAX
+#include <stdint.h> // UINT32_MAX
+
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_MAX_DEPTH     48
+
+namespace crown
+{
+namespace bvh
+{
+	/// Returns the distance along ray (from, 1/inv_dir) to the box @a b or
+	/// FLT_MAX if no intersection.
+	static f32 ray_aabb(const AABB &b, const Vector3 &from, const Vector3 &inv_dir)
+	{
+		const f32 t = ray_aabb_intersection(from, inv_dir, b);
+		return t == -1.0f ? FLT_MAX : t;
+	}
+
+	static f32 center(const AABB &b, u32 axis)
+	{
+		return (to_float_ptr(b.min)[axis] + to_float_ptr(b.max)[axis]) * 0.5f;
+	}
+
+	u32 max_nodes(u32 num)
+	{
+		return num > 0 ? 2*num - 1 : 0;
+	}
+
+	void build(Bvh &b, const AABB *aabbs, u32 num)
+	{
+		b.num_nodes = 0;
+		if (num == 0)
+			return;
+
+		for (u32 ii = 0; ii < num; ++ii)
+			b.primitives[ii] = ii;
+
+		struct Item
+		{
+			u32 node;
+			u32 depth;
+		};
+
+		Item stack[BVH_MAX_DEPTH + 2];
+		u32 top = 0;
+
+		b.nodes[0].first = 0;
+		b.nodes[0].num = num;
+		b.num_nodes = 1;
+		stack[top++] = { 0u, 0u };
+
+		while (top > 0) {
+			const Item item = stack[--top];
+			BvhNode &node = b.nodes[item.node];
+			const u32 first = node.first;
+			const u32 count = node.num;
+
+			// Compute the bounds of the primitives and of their centers.
+			AABB centers;
+			node.aabb = aabbs[b.primitives[first]];
+			centers.min = centers.max = aabb::center(node.aabb);
+			for (u32 ii = first + 1; ii < first + count; ++ii) {
+				const AABB &pb = aabbs[b.primitives[ii]];
+				const Vector3 pc = aabb::center(pb);
+				node.aabb.min = min(node.aabb.min, pb.min);
+				node.aabb.max = max(node.aabb.max, pb.max);
+				centers.min = min(centers.min, pc);
+				centers.max = max(centers.max, pc);
+			}
+
+			if (count <= BVH_MAX_LEAF_SIZE || item.depth == BVH_MAX_DEPTH)
+				continue;
+
+			// Split the primitives at the middle of the longest axis of their centers.
+			const Vector3 size = centers.max - centers.min;
+			u32 axis = 0;
+			if (size.y > size.x)
+				axis = 1;
+			if (size.z > to_float_ptr(size)[axis])
+				axis = 2;
+			const f32 mid = center(centers, axis);
+
+			u32 ii = first;
+			u32 jj = first + count;
+			while (ii < jj) {
+				if (center(aabbs[b.primitives[ii]], axis) < mid)
+					++ii;
+				else
+					exchange(b.primitives[ii], b.primitives[--jj]);
+			}
+
+			// All centers coincide: split the primitives in two halves.
+			u32 num_left = ii - first;
+			if (num_left == 0 || num_left == count)
+				num_left = count / 2;
+
+			const u32 left = b.num_nodes;
+			b.num_nodes += 2;
+			b.nodes[left + 0].first = first;
+			b.nodes[left + 0].num = num_left;
+			b.nodes[left + 1].first = first + num_left;
+			b.nodes[left + 1].num = count - num_left;
+			node.first = left;
+			node.num = 0;
+
+			CE_ENSURE(top + 2 <= countof(stack));
+			stack[top++] = { left + 1, item.depth + 1 };
+			stack[top++] = { left + 0, item.depth + 1 };
+		}
+	}
+
+	f32 cast_ray(const Bvh &b
+		, const Vector3 &from
+		, const Vector3 &dir
+		, BvhRayFunction function
+		, void *user_data
+		, u32 *primitive
+		)
+	{
+		const Vector3 inv_dir = vector3(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
+
+		if (b.num_nodes == 0 || ray_aabb(b.nodes[0].aabb, from, inv_dir) == FLT_MAX)
+			return -1.0f;
+
+		struct Item
+		{
+			u32 node;
+			f32 t;
+		};
+
+		Item stack[BVH_MAX_DEPTH + 2];
+		u32 top = 0;
+
+		f32 tmin = FLT_MAX;
+		u32 hit = UINT32_MAX;
+		u32 cur = 0;
+
+		for (;;) {
+			const BvhNode &node = b.nodes[cur];
+
+			if (node.num != 0) {
+				for (u32 ii = node.first; ii < node.first + node.num; ++ii) {
+					const u32 prim = b.primitives[ii];
+					const f32 t = function(prim, from, dir, user_data);
+					if (t >= 0.0f && t < tmin) {
+						tmin = t;
+						hit = prim;
+					}
+				}
+			} else {
+				// Visit the nearest child first and postpone the farthest.
+				u32 nearest  = node.first + 0;
+				u32 farthest = node.first + 1;
+				f32 t_nearest  = ray_aabb(b.nodes[nearest].aabb, from, inv_dir);
+				f32 t_farthest  = ray_aabb(b.nodes[farthest].aabb, from, inv_dir);
+				if (t_farthest < t_nearest) {
+					exchange(nearest, farthest);
+					exchange(t_nearest, t_farthest);
+				}
+
+				if (t_nearest < tmin) {
+					if (t_farthest < tmin) {
+						CE_ENSURE(top < countof(stack));
+						stack[top++] = { farthest, t_farthest };
+					}
+					cur = nearest;
+					continue;
+				}
+			}
+
+			// Skip postponed nodes farther than the nearest hit so far.
+			while (top > 0 && stack[top - 1].t >= tmin)
+				--top;
+			if (top == 0)
+				break;
+			cur = stack[--top].node;
+		}
+
+		if (hit == UINT32_MAX)
+			return -1.0f;
+
+		if (primitive != NULL)
+			*primitive = hit;
+
+		return tmin;
+	}
+
+} // namespace bvh
+
+} // namespace crown
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/math/types.h"
+
+namespace crown
+{
+/// Returns the distance along ray (from, dir) to intersection point with the
+/// primitive @a primitive or -1.0 if no intersection.
+typedef f32 (*BvhRayFunction)(u32 primitive, const Vector3 &from, const Vector3 &dir, void *user_data);
+
+/// Functions to manipulate Bvh.
+///
+/// @ingroup Math
+namespace bvh
+{
+	/// Returns the maximum number of nodes needed to build a Bvh over @a num primitives.
+	u32 max_nodes(u32 num);
+
+	/// Builds the Bvh @a b over the @a num primitives enclosed by @a aabbs.
+	/// @a b.nodes must have room for max_nodes(num) nodes and @a b.primitives
+	/// must have room for @a num indices.
+	void build(Bvh &b, const AABB *aabbs, u32 num);
+
+	/// Returns the distance along ray (from, dir) to the nearest intersection
+	/// point with the primitives in @a b or -1.0 if no intersection. Each
+	/// primitive whose box is crossed by the ray is tested with @a function.
+	/// If @a primitive is not NULL it is set to the nearest primitive hit.
+	f32 cast_ray(const Bvh &b
+		, const Vector3 &from
+		, const Vector3 &dir
+		, BvhRayFunction function
+		, void *user_data
+		, u32 *primitive = NULL
+		);
+
+} // namespace bvh
+
+} // namespace crown
@@ -7,6 +7,7 @@
 #include "core/math/constants.h"
 #include "core/math/frustum.inl"
 #include "core/math/intersection.h"
+#include "core/math/matrix4x4.inl"
 #include "core/math/plane3.inl"
 #include "core/math/sphere.inl"
 #include "core/math/vector3.inl"
@@ -138,67 +139,84 @@ f32 ray_obb_intersection(const Vector3 &from, const Vector3 &dir, const Matrix4x
 	return tmin;
 }
 
-f32 ray_triangle_intersection(const Vector3 &from, const Vector3 &dir, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2)
+f32 ray_aabb_intersection(const Vector3 &from, const Vector3 &inv_dir, const AABB &b)
 {
-	const Vector3 verts[] = { v0, v1, v2 };
-	const u16 inds[] = { 0, 1, 2 };
-	return ray_mesh_intersection(from, dir, MATRIX4X4_IDENTITY, verts, sizeof(Vector3), inds, 3);
+	const f32 tx1 = (b.min.x - from.x) * inv_dir.x;
+	const f32 tx2 = (b.max.x - from.x) * inv_dir.x;
+	const f32 ty1 = (b.min.y - from.y) * inv_dir.y;
+	const f32 ty2 = (b.max.y - from.y) * inv_dir.y;
+	const f32 tz1 = (b.min.z - from.z) * inv_dir.z;
+	const f32 tz2 = (b.max.z - from.z) * inv_dir.z;
+
+	const f32 tmin = max(max(min(tx1, tx2), min(ty1, ty2)), min(tz1, tz2));
+	const f32 tmax = min(min(max(tx1, tx2), max(ty1, ty2)), max(tz1, tz2));
+
+	if (tmax < 0.0f || tmin > tmax)
+		return -1.0f;
+
+	return max(tmin, 0.0f);
 }
 
-f32 ray_mesh_intersection(const Vector3 &from, const Vector3 &dir, const Matrix4x4 &tm, const void *vertices, u32 stride, const u16 *indices, u32 num)
+f32 ray_triangle_intersection(const Vector3 &from, const Vector3 &dir, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2)
 {
-	bool hit = false;
-	f32 tmin = FLT_MAX;
+	// https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
 
-	for (u32 i = 0; i < num; i += 3) {
-		const u32 i0 = indices[i + 0];
-		const u32 i1 = indices[i + 1];
-		const u32 i2 = indices[i + 2];
+	// Find vectors for two edges sharing v0
+	const Vector3 e1 = v1 - v0;
+	const Vector3 e2 = v2 - v0;
 
-		const Vector3 &v0 = *(const Vector3 *)((const char *)vertices + i0*stride) * tm;
-		const Vector3 &v1 = *(const Vector3 *)((const char *)vertices + i1*stride) * tm;
-		const Vector3 &v2 = *(const Vector3 *)((const char *)vertices + i2*stride) * tm;
+	// Begin calculating determinant - also used to calculate u parameter
+	const Vector3 P = cross(dir, e2);
 
-		// https://en.wikipedia.org/wiki/M%C3%B6ller%E2%80%93Trumbore_intersection_algorithm
+	// If determinant is near zero, ray lies in plane of triangle
+	const f32 det = dot(e1, P);
+	if (fequal(det, 0.0f))
+		return -1.0f;
 
-		// Find vectors for two edges sharing v0
-		const Vector3 e1 = v1 - v0;
-		const Vector3 e2 = v2 - v0;
+	const f32 inv_det = 1.0f / det;
 
-		// Begin calculating determinant - also used to calculate u parameter
-		const Vector3 P = cross(dir, e2);
+	// Distance from v0 to ray origin
+	const Vector3 T = from - v0;
 
-		// If determinant is near zero, ray lies in plane of triangle
-		const f32 det = dot(e1, P);
-		if (fequal(det, 0.0f))
-			continue;
+	// u parameter and test bound
+	const f32 u = dot(T, P) * inv_det;
 
-		const f32 inv_det = 1.0f / det;
+	// The intersection lies outside of the triangle
+	if (u < 0.0f || u > 1.0f)
+		return -1.0f;
 
-		// Distance from v0 to ray origin
-		const Vector3 T = from - v0;
+	// Prepare to test v parameter
+	const Vector3 Q = cross(T, e1);
 
-		// u parameter and test bound
-		const f32 u = dot(T, P) * inv_det;
+	// v parameter and test bound
+	const f32 v = dot(dir, Q) * inv_det;
 
-		// The intersection lies outside of the triangle
-		if (u < 0.0f || u > 1.0f)
-			continue;
+	// The intersection lies outside of the triangle
+	if (v < 0.0f || u + v > 1.0f)
+		return -1.0f;
 
-		// Prepare to test v parameter
-		const Vector3 Q = cross(T, e1);
+	const f32 t = dot(e2, Q) * inv_det;
 
-		// v parameter and test bound
-		const f32 v = dot(dir, Q) * inv_det;
+	// Ray intersection
+	return t > FLOAT_EPSILON ? t : -1.0f;
+}
+
+f32 ray_mesh_intersection(const Vector3 &from, const Vector3 &dir, const Matrix4x4 &tm, const void *vertices, u32 stride, const u16 *indices, u32 num)
+{
+	bool hit = false;
+	f32 tmin = FLT_MAX;
 
-		// The intersection lies outside of the triangle
-		if (v < 0.0f || u + v > 1.0f)
-			continue;
+	for (u32 i = 0; i < num; i += 3) {
+		const u32 i0 = indices[i + 0];
+		const u32 i1 = indices[i + 1];
+		const u32 i2 = indices[i + 2];
 
-		const f32 t = dot(e2, Q) * inv_det;
+		const Vector3 &v0 = *(const Vector3 *)((const char *)vertices + i0*stride) * tm;
+		const Vector3 &v1 = *(const Vector3 *)((const char *)vertices + i1*stride) * tm;
+		const Vector3 &v2 = *(const Vector3 *)((const char *)vertices + i2*stride) * tm;
 
-		// Ray intersection
-		if (t > FLOAT_EPSILON) {
+		const f32 t = ray_triangle_intersection(from, dir, v0, v1, v2);
+		if (t != -1.0f) {
 			hit = true;
 			tmin = min(t, tmin);
 		}
@@ -228,6 +246,25 @@ bool plane_3_intersection(Vector3 &ip, const Plane3 &a, const Plane3 &b, const P
 	return true;
 }
 
+bool aabb_intersects_aabb(const AABB &a, const AABB &b)
+{
+	return a.min.x <= b.max.x && a.max.x >= b.min.x
+		&& a.min.y <= b.max.y && a.max.y >= b.min.y
+		&& a.min.z <= b.max.z && a.max.z >= b.min.z
+		;
+}
+
+bool sphere_intersects_aabb(const Sphere &s, const AABB &b)
+{
+	// Closest point of the box to the center of the sphere.
+	const Vector3 p = vector3(clamp(s.c.x, b.min.x, b.max.x)
+		, clamp(s.c.y, b.min.y, b.max.y)
+		, clamp(s.c.z, b.min.z, b.max.z)
+		);
+
+	return distance_squared(p, s.c) <= s.r*s.r;
+}
+
 bool sphere_intersects_frustum(const Sphere &s, const Frustum &f)
 {
 	for (u32 ii = 0; ii < countof(f.planes); ++ii) {
@@ -238,6 +275,24 @@ bool sphere_intersects_frustum(const Sphere &s, const Frustum &f)
 	return true;
 }
 
+bool aabb_intersects_frustum(const AABB &b, const Frustum &f)
+{
+	for (u32 ii = 0; ii < countof(f.planes); ++ii) {
+		const Plane3 &p = f.planes[ii];
+
+		// Vertex of the box farthest along the plane normal.
+		const Vector3 v = vector3(p.n.x >= 0.0f ? b.max.x : b.min.x
+			, p.n.y >= 0.0f ? b.max.y : b.min.y
+			, p.n.z >= 0.0f ? b.max.z : b.min.z
+			);
+
+		if (plane3::distance_to_point(p, v) < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
 bool obb_intersects_frustum(const OBB &obb, const Frustum &f)
 {
 	const Vector3 obb_x = vector3(obb.tm.x.x, obb.tm.x.y, obb.tm.x.z);
@@ -322,4 +377,69 @@ bool obb_intersects_frustum(const OBB &obb, const Frustum &f)
 	return true;
 }
 
+u32 obb_intersects_frustum_batch(u32 *indices, u32 num, const OBB *obb, const Matrix4x4 *world, const Frustum &f)
+{
+	// Lay out the planes in two groups of four, repeating the last plane to
+	// fill the second group.
+	f32x4 pnx[2];
+	f32x4 pny[2];
+	f32x4 pnz[2];
+	f32x4 pd[2];
+	for (u32 jj = 0; jj < 2; ++jj) {
+		const Plane3 &p0 = f.planes[jj*4 + 0];
+		const Plane3 &p1 = f.planes[jj*4 + 1];
+		const Plane3 &p2 = f.planes[min(jj*4 + 2, 5u)];
+		const Plane3 &p3 = f.planes[min(jj*4 + 3, 5u)];
+		pnx[jj] = simd::set(p0.n.x, p1.n.x, p2.n.x, p3.n.x);
+		pny[jj] = simd::set(p0.n.y, p1.n.y, p2.n.y, p3.n.y);
+		pnz[jj] = simd::set(p0.n.z, p1.n.z, p2.n.z, p3.n.z);
+		pd[jj]  = simd::set(p0.d, p1.d, p2.d, p3.d);
+	}
+
+	const f32x4 zero = simd::splat(0.0f);
+	u32 num_visible = 0;
+
+	for (u32 nn = 0; nn < num; ++nn) {
+		const u32 ii = indices[nn];
+		const Matrix4x4 tm = obb[ii].tm * world[ii];
+		const Vector3 &he = obb[ii].half_extents;
+
+		const f32x4 cx = simd::splat(tm.t.x);
+		const f32x4 cy = simd::splat(tm.t.y);
+		const f32x4 cz = simd::splat(tm.t.z);
+
+		bool outside = false;
+		for (u32 jj = 0; jj < 2 && !outside; ++jj) {
+			// Distance from the box center to the planes.
+			f32x4 dist = simd::mul(pnx[jj], cx);
+			dist = simd::madd(pny[jj], cy, dist);
+			dist = simd::madd(pnz[jj], cz, dist);
+			dist = simd::sub(dist, pd[jj]);
+
+			// Extent of the box along the planes' normals.
+			f32x4 rx = simd::mul(pnx[jj], simd::splat(tm.x.x));
+			rx = simd::madd(pny[jj], simd::splat(tm.x.y), rx);
+			rx = simd::madd(pnz[jj], simd::splat(tm.x.z), rx);
+			f32x4 ry = simd::mul(pnx[jj], simd::splat(tm.y.x));
+			ry = simd::madd(pny[jj], simd::splat(tm.y.y), ry);
+			ry = simd::madd(pnz[jj], simd::splat(tm.y.z), ry);
+			f32x4 rz = simd::mul(pnx[jj], simd::splat(tm.z.x));
+			rz = simd::madd(pny[jj], simd::splat(tm.z.y), rz);
+			rz = simd::madd(pnz[jj], simd::splat(tm.z.z), rz);
+
+			f32x4 radius = simd::mul(simd::abs(rx), simd::splat(he.x));
+			radius = simd::madd(simd::abs(ry), simd::splat(he.y), radius);
+			radius = simd::madd(simd::abs(rz), simd::splat(he.z), radius);
+
+			// The box is outside if it lies entirely behind any plane.
+			outside = simd::any_lt(simd::add(dist, radius), zero);
+		}
+
+		if (!outside)
+			indices[num_visible++] = ii;
+	}
+
+	return num_visible;
+}
+
 } // namespace crown
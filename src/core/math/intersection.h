@@ -28,6 +28,10 @@ f32 ray_sphere_intersection(const Vector3 &from, const Vector3 &dir, const Spher
 /// bounding box (tm, half_extents) or -1.0 if no intersection.
 f32 ray_obb_intersection(const Vector3 &from, const Vector3 &dir, const Matrix4x4 &tm, const Vector3 &half_extents);
 
+/// Returns the distance along ray (from, dir) to intersection point with the box @a b
+/// or -1.0 if no intersection. @a inv_dir is the component-wise inverse of dir.
+f32 ray_aabb_intersection(const Vector3 &from, const Vector3 &inv_dir, const AABB &b);
+
 /// Returns the distance along ray (from, dir) to intersection point with the triangle
 /// (v0, v1, v2) or -1.0 if no intersection.
 f32 ray_triangle_intersection(const Vector3 &from, const Vector3 &dir, const Vector3 &v0, const Vector3 &v1, const Vector3 &v2);
@@ -39,12 +43,30 @@ f32 ray_mesh_intersection(const Vector3 &from, const Vector3 &dir, const Matrix4
 /// Returns whether the planes @a a, @a b and @a c intersects and if so fills @a ip with the intersection point.
 bool plane_3_intersection(Vector3 &ip, const Plane3 &a, const Plane3 &b, const Plane3 &c);
 
+/// Returns whether the boxes @a a and @a b intersects.
+bool aabb_intersects_aabb(const AABB &a, const AABB &b);
+
+/// Returns whether the sphere @a s and the box @a b intersects.
+bool sphere_intersects_aabb(const Sphere &s, const AABB &b);
+
 /// Returns whether the frustum @a f and the sphere @a s intersects.
 bool sphere_intersects_frustum(const Sphere &s, const Frustum &f);
 
+/// Returns whether the box @a b intersects the frustum @a f.
+/// @note This test is conservative: boxes near the frustum edges may be
+/// reported as intersecting when they are not.
+bool aabb_intersects_frustum(const AABB &b, const Frustum &f);
+
 /// Returns whether the OBB @a obb intersects the frustum @a f.
 bool obb_intersects_frustum(const OBB &obb, const Frustum &f);
 
+/// Keeps, in order, the first @a num indices i in @a indices whose oriented
+/// bounding box @a obb[i], transformed by @a world[i], intersects the
+/// frustum @a f. Returns the number of indices kept.
+/// @note Unlike obb_intersects_frustum(), this test is conservative: boxes
+/// near the frustum edges may be reported as intersecting when they are not.
+u32 obb_intersects_frustum_batch(u32 *indices, u32 num, const OBB *obb, const Matrix4x4 *world, const Frustum &f);
+
 /// @}
 
 } // namespace crown
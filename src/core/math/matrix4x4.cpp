@@ -213,4 +213,98 @@ Matrix4x4 &invert(Matrix4x4 &m)
 	return m;
 }
 
+void mul_batch(Matrix4x4 *out, const Matrix4x4 *a, const Matrix4x4 *b, u32 num)
+{
+	for (u32 i = 0; i < num; ++i)
+		out[i] = a[i] * b[i];
+}
+
+void transform_points(Vector3 *out, const Vector3 *in, u32 num, const Matrix4x4 &m)
+{
+	const f32x4 mx = simd::load(&m.x.x);
+	const f32x4 my = simd::load(&m.y.x);
+	const f32x4 mz = simd::load(&m.z.x);
+	const f32x4 mt = simd::load(&m.t.x);
+
+	for (u32 i = 0; i < num; ++i) {
+		f32x4 tmp = simd::madd(simd::splat(in[i].x), mx, mt);
+		tmp = simd::madd(simd::splat(in[i].y), my, tmp);
+		tmp = simd::madd(simd::splat(in[i].z), mz, tmp);
+
+		f32 r[4];
+		simd::store(r, tmp);
+		out[i].x = r[0];
+		out[i].y = r[1];
+		out[i].z = r[2];
+	}
+}
+
+void to_matrix_batch(Matrix4x4 *out, const Vector3 *pos, const Quaternion *rot, const Vector3 *scale, u32 num)
+{
+	const f32x4 zero = simd::splat(0.0f);
+	const f32x4 one = simd::splat(1.0f);
+	const f32x4 two = simd::splat(2.0f);
+
+	// Convert four quaternions at a time with their components laid out
+	// in separate registers.
+	u32 i = 0;
+	for (; i + 4 <= num; i += 4) {
+		f32x4 qx = simd::load(&rot[i + 0].x);
+		f32x4 qy = simd::load(&rot[i + 1].x);
+		f32x4 qz = simd::load(&rot[i + 2].x);
+		f32x4 qw = simd::load(&rot[i + 3].x);
+		simd::transpose(qx, qy, qz, qw);
+
+		const f32x4 x2 = simd::mul(qx, two);
+		const f32x4 y2 = simd::mul(qy, two);
+		const f32x4 z2 = simd::mul(qz, two);
+		const f32x4 xx = simd::mul(qx, x2);
+		const f32x4 yy = simd::mul(qy, y2);
+		const f32x4 zz = simd::mul(qz, z2);
+		const f32x4 xy = simd::mul(qx, y2);
+		const f32x4 xz = simd::mul(qx, z2);
+		const f32x4 yz = simd::mul(qy, z2);
+		const f32x4 wx = simd::mul(qw, x2);
+		const f32x4 wy = simd::mul(qw, y2);
+		const f32x4 wz = simd::mul(qw, z2);
+
+		f32x4 rx[4];
+		rx[0] = simd::sub(simd::sub(one, yy), zz);
+		rx[1] = simd::add(xy, wz);
+		rx[2] = simd::sub(xz, wy);
+		rx[3] = zero;
+		f32x4 ry[4];
+		ry[0] = simd::sub(xy, wz);
+		ry[1] = simd::sub(simd::sub(one, xx), zz);
+		ry[2] = simd::add(yz, wx);
+		ry[3] = zero;
+		f32x4 rz[4];
+		rz[0] = simd::add(xz, wy);
+		rz[1] = simd::sub(yz, wx);
+		rz[2] = simd::sub(simd::sub(one, xx), yy);
+		rz[3] = zero;
+		simd::transpose(rx[0], rx[1], rx[2], rx[3]);
+		simd::transpose(ry[0], ry[1], ry[2], ry[3]);
+		simd::transpose(rz[0], rz[1], rz[2], rz[3]);
+
+		for (u32 j = 0; j < 4; ++j) {
+			Matrix4x4 &m = out[i + j];
+			const Vector3 &s = scale[i + j];
+			const Vector3 &p = pos[i + j];
+			simd::store(&m.x.x, simd::mul(rx[j], simd::splat(s.x)));
+			simd::store(&m.y.x, simd::mul(ry[j], simd::splat(s.y)));
+			simd::store(&m.z.x, simd::mul(rz[j], simd::splat(s.z)));
+			simd::store(&m.t.x, simd::set(p.x, p.y, p.z, 1.0f));
+		}
+	}
+
+	for (; i < num; ++i) {
+		const Matrix3x3 r = from_quaternion(rot[i]);
+		out[i].x = vector4(r.x.x * scale[i].x, r.x.y * scale[i].x, r.x.z * scale[i].x, 0.0f);
+		out[i].y = vector4(r.y.x * scale[i].y, r.y.y * scale[i].y, r.y.z * scale[i].y, 0.0f);
+		out[i].z = vector4(r.z.x * scale[i].z, r.z.y * scale[i].z, r.z.z * scale[i].z, 0.0f);
+		out[i].t = vector4(pos[i].x, pos[i].y, pos[i].z, 1.0f);
+	}
+}
+
 } // namespace crown
@@ -9,6 +9,7 @@
 #include "core/math/math.h"
 #include "core/math/matrix3x3.inl"
 #include "core/math/quaternion.inl"
+#include "core/math/simd.inl"
 #include "core/math/types.h"
 #include "core/math/vector4.inl"
 
@@ -72,29 +73,21 @@ inline Matrix4x4 &operator*=(Matrix4x4 &a, f32 k)
 /// Multiplies the matrix @a a by @a b and returns the result. (i.e. transforms first by @a a then by @a b)
 inline Matrix4x4 &operator*=(Matrix4x4 &a, const Matrix4x4 &b)
 {
-	Matrix4x4 tmp;
+	const f32x4 bx = simd::load(&b.x.x);
+	const f32x4 by = simd::load(&b.y.x);
+	const f32x4 bz = simd::load(&b.z.x);
+	const f32x4 bt = simd::load(&b.t.x);
+
+	f32 *rows[] = { &a.x.x, &a.y.x, &a.z.x, &a.t.x };
+	for (u32 i = 0; i < countof(rows); ++i) {
+		const f32 *r = rows[i];
+		f32x4 tmp = simd::mul(simd::splat(r[0]), bx);
+		tmp = simd::madd(simd::splat(r[1]), by, tmp);
+		tmp = simd::madd(simd::splat(r[2]), bz, tmp);
+		tmp = simd::madd(simd::splat(r[3]), bt, tmp);
+		simd::store(rows[i], tmp);
+	}
 
-	tmp.x.x = a.x.x*b.x.x + a.x.y*b.y.x + a.x.z*b.z.x + a.x.w*b.t.x;
-	tmp.x.y = a.x.x*b.x.y + a.x.y*b.y.y + a.x.z*b.z.y + a.x.w*b.t.y;
-	tmp.x.z = a.x.x*b.x.z + a.x.y*b.y.z + a.x.z*b.z.z + a.x.w*b.t.z;
-	tmp.x.w = a.x.x*b.x.w + a.x.y*b.y.w + a.x.z*b.z.w + a.x.w*b.t.w;
-
-	tmp.y.x = a.y.x*b.x.x + a.y.y*b.y.x + a.y.z*b.z.x + a.y.w*b.t.x;
-	tmp.y.y = a.y.x*b.x.y + a.y.y*b.y.y + a.y.z*b.z.y + a.y.w*b.t.y;
-	tmp.y.z = a.y.x*b.x.z + a.y.y*b.y.z + a.y.z*b.z.z + a.y.w*b.t.z;
-	tmp.y.w = a.y.x*b.x.w + a.y.y*b.y.w + a.y.z*b.z.w + a.y.w*b.t.w;
-
-	tmp.z.x = a.z.x*b.x.x + a.z.y*b.y.x + a.z.z*b.z.x + a.z.w*b.t.x;
-	tmp.z.y = a.z.x*b.x.y + a.z.y*b.y.y + a.z.z*b.z.y + a.z.w*b.t.y;
-	tmp.z.z = a.z.x*b.x.z + a.z.y*b.y.z + a.z.z*b.z.z + a.z.w*b.t.z;
-	tmp.z.w = a.z.x*b.x.w + a.z.y*b.y.w + a.z.z*b.z.w + a.z.w*b.t.w;
-
-	tmp.t.x = a.t.x*b.x.x + a.t.y*b.y.x + a.t.z*b.z.x + a.t.w*b.t.x;
-	tmp.t.y = a.t.x*b.x.y + a.t.y*b.y.y + a.t.z*b.z.y + a.t.w*b.t.y;
-	tmp.t.z = a.t.x*b.x.z + a.t.y*b.y.z + a.t.z*b.z.z + a.t.w*b.t.z;
-	tmp.t.w = a.t.x*b.x.w + a.t.y*b.y.w + a.t.z*b.z.w + a.t.w*b.t.w;
-
-	a = tmp;
 	return a;
 }
 
@@ -139,11 +132,13 @@ inline Vector3 operator*(const Vector3 &v, const Matrix4x4 &a)
 /// Multiplies the matrix @a by the vector @a v and returns the result.
 inline Vector4 operator*(const Vector4 &v, const Matrix4x4 &a)
 {
+	f32x4 tmp = simd::mul(simd::splat(v.x), simd::load(&a.x.x));
+	tmp = simd::madd(simd::splat(v.y), simd::load(&a.y.x), tmp);
+	tmp = simd::madd(simd::splat(v.z), simd::load(&a.z.x), tmp);
+	tmp = simd::madd(simd::splat(v.w), simd::load(&a.t.x), tmp);
+
 	Vector4 r;
-	r.x = v.x*a.x.x + v.y*a.y.x + v.z*a.z.x + v.w*a.t.x;
-	r.y = v.x*a.x.y + v.y*a.y.y + v.z*a.z.y + v.w*a.t.y;
-	r.z = v.x*a.x.z + v.y*a.y.z + v.z*a.z.z + v.w*a.t.z;
-	r.w = v.x*a.x.w + v.y*a.y.w + v.z*a.z.w + v.w*a.t.w;
+	simd::store(&r.x, tmp);
 	return r;
 }
 
@@ -392,6 +387,19 @@ inline const f32 *to_float_ptr(const Matrix4x4 &m)
 /// output round-trip safe ASCII conversions. Do not use in production.
 const char *to_string(char *buf, u32 buf_len, const Matrix4x4 &m);
 
+/// Multiplies @a a[i] by @a b[i] and stores the result in @a out[i] for
+/// each i in [0; @a num). @a out can alias @a a or @a b.
+void mul_batch(Matrix4x4 *out, const Matrix4x4 *a, const Matrix4x4 *b, u32 num);
+
+/// Transforms the @a num points in @a in by the matrix @a m and stores the
+/// results in @a out. @a out can alias @a in.
+void transform_points(Vector3 *out, const Vector3 *in, u32 num, const Matrix4x4 &m);
+
+/// Sets @a out[i] to the matrix that scales by @a scale[i], rotates by @a rot[i]
+/// and translates by @a pos[i] for each i in [0; @a num).
+/// @note Quaternions in @a rot must be unit length.
+void to_matrix_batch(Matrix4x4 *out, const Vector3 *pos, const Quaternion *rot, const Vector3 *scale, u32 num);
+
 /// @}
 
 } // namespace crown
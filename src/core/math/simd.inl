@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/math/math.h"
+#include "core/platform.h"
+#include "core/types.h"
+
+#if CROWN_SIMD_AVX2 || CROWN_SIMD_FMA
+	#include <immintrin.h>
+#elif CROWN_SIMD_SSE
+	#include <xmmintrin.h>
+#elif CROWN_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace crown
+{
+#if CROWN_SIMD_SSE
+typedef __m128 f32x4;
+#elif CROWN_SIMD_NEON
+typedef float32x4_t f32x4;
+#else
+struct f32x4
+{
+	f32 x, y, z, w;
+};
+#endif
+
+/// Functions to operate on four f32 at a time.
+/// Loads and stores do not require any particular alignment.
+///
+/// @ingroup Math
+namespace simd
+{
+	/// Returns the four values at @a p.
+	inline f32x4 load(const f32 *p)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_loadu_ps(p);
+#elif CROWN_SIMD_NEON
+		return vld1q_f32(p);
+#else
+		f32x4 r = { p[0], p[1], p[2], p[3] };
+		return r;
+#endif
+	}
+
+	/// Stores the four values in @a a to @a p.
+	inline void store(f32 *p, f32x4 a)
+	{
+#if CROWN_SIMD_SSE
+		_mm_storeu_ps(p, a);
+#elif CROWN_SIMD_NEON
+		vst1q_f32(p, a);
+#else
+		p[0] = a.x;
+		p[1] = a.y;
+		p[2] = a.z;
+		p[3] = a.w;
+#endif
+	}
+
+	/// Returns a new value from @a x, @a y, @a z and @a w.
+	inline f32x4 set(f32 x, f32 y, f32 z, f32 w)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_setr_ps(x, y, z, w);
+#else
+		const f32 p[] = { x, y, z, w };
+		return load(p);
+#endif
+	}
+
+	/// Returns a new value with all four elements set to @a a.
+	inline f32x4 splat(f32 a)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_set1_ps(a);
+#elif CROWN_SIMD_NEON
+		return vdupq_n_f32(a);
+#else
+		f32x4 r = { a, a, a, a };
+		return r;
+#endif
+	}
+
+	/// Returns @a a + @a b.
+	inline f32x4 add(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_add_ps(a, b);
+#elif CROWN_SIMD_NEON
+		return vaddq_f32(a, b);
+#else
+		f32x4 r = { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w };
+		return r;
+#endif
+	}
+
+	/// Returns @a a - @a b.
+	inline f32x4 sub(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_sub_ps(a, b);
+#elif CROWN_SIMD_NEON
+		return vsubq_f32(a, b);
+#else
+		f32x4 r = { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w };
+		return r;
+#endif
+	}
+
+	/// Returns @a a * @a b.
+	inline f32x4 mul(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_mul_ps(a, b);
+#elif CROWN_SIMD_NEON
+		return vmulq_f32(a, b);
+#else
+		f32x4 r = { a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w };
+		return r;
+#endif
+	}
+
+	/// Returns @a a * @a b + @a c.
+	inline f32x4 madd(f32x4 a, f32x4 b, f32x4 c)
+	{
+#if CROWN_SIMD_FMA
+		return _mm_fmadd_ps(a, b, c);
+#elif CROWN_SIMD_NEON && defined(__aarch64__)
+		return vfmaq_f32(c, a, b);
+#else
+		return add(mul(a, b), c);
+#endif
+	}
+
+	/// Returns the absolute value of @a a.
+	inline f32x4 abs(f32x4 a)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+#elif CROWN_SIMD_NEON
+		return vabsq_f32(a);
+#else
+		f32x4 r = { fabs(a.x), fabs(a.y), fabs(a.z), fabs(a.w) };
+		return r;
+#endif
+	}
+
+	/// Returns the minimum of @a a and @a b.
+	inline f32x4 min(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_min_ps(a, b);
+#elif CROWN_SIMD_NEON
+		return vminq_f32(a, b);
+#else
+		f32x4 r =
+		{
+			a.x < b.x ? a.x : b.x,
+			a.y < b.y ? a.y : b.y,
+			a.z < b.z ? a.z : b.z,
+			a.w < b.w ? a.w : b.w
+		};
+		return r;
+#endif
+	}
+
+	/// Returns the maximum of @a a and @a b.
+	inline f32x4 max(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_max_ps(a, b);
+#elif CROWN_SIMD_NEON
+		return vmaxq_f32(a, b);
+#else
+		f32x4 r =
+		{
+			a.x > b.x ? a.x : b.x,
+			a.y > b.y ? a.y : b.y,
+			a.z > b.z ? a.z : b.z,
+			a.w > b.w ? a.w : b.w
+		};
+		return r;
+#endif
+	}
+
+	/// Returns, for each element, @a c if @a a is less than @a b or @a d otherwise.
+	inline f32x4 select_lt(f32x4 a, f32x4 b, f32x4 c, f32x4 d)
+	{
+#if CROWN_SIMD_SSE
+		const __m128 lt = _mm_cmplt_ps(a, b);
+		return _mm_or_ps(_mm_and_ps(lt, c), _mm_andnot_ps(lt, d));
+#elif CROWN_SIMD_NEON
+		return vbslq_f32(vcltq_f32(a, b), c, d);
+#else
+		f32x4 r =
+		{
+			a.x < b.x ? c.x : d.x,
+			a.y < b.y ? c.y : d.y,
+			a.z < b.z ? c.z : d.z,
+			a.w < b.w ? c.w : d.w
+		};
+		return r;
+#endif
+	}
+
+	/// Returns whether any element of @a a is less than the corresponding element of @a b.
+	inline bool any_lt(f32x4 a, f32x4 b)
+	{
+#if CROWN_SIMD_SSE
+		return _mm_movemask_ps(_mm_cmplt_ps(a, b)) != 0;
+#elif CROWN_SIMD_NEON
+		const uint32x4_t lt = vcltq_f32(a, b);
+		const uint32x2_t lt2 = vorr_u32(vget_low_u32(lt), vget_high_u32(lt));
+		return (vget_lane_u32(lt2, 0) | vget_lane_u32(lt2, 1)) != 0;
+#else
+		return a.x < b.x || a.y < b.y || a.z < b.z || a.w < b.w;
+#endif
+	}
+
+	/// Transposes the 4x4 matrix whose rows are @a a, @a b, @a c and @a d.
+	inline void transpose(f32x4 &a, f32x4 &b, f32x4 &c, f32x4 &d)
+	{
+#if CROWN_SIMD_SSE
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+#elif CROWN_SIMD_NEON
+		const float32x4x2_t ab = vtrnq_f32(a, b);
+		const float32x4x2_t cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+		b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+#else
+		const f32x4 ta = { a.x, b.x, c.x, d.x };
+		const f32x4 tb = { a.y, b.y, c.y, d.y };
+		const f32x4 tc = { a.z, b.z, c.z, d.z };
+		const f32x4 td = { a.w, b.w, c.w, d.w };
+		a = ta;
+		b = tb;
+		c = tc;
+		d = td;
+#endif
+	}
+
+} // namespace simd
+
+} // namespace crown
@@ -79,6 +79,23 @@ struct Sphere
 	f32 r;
 };
 
+struct BvhNode
+{
+	AABB aabb;
+	u32 first; ///< Index of the first child if num == 0, index of the first primitive otherwise.
+	u32 num;   ///< Number of primitives in the leaf or 0 if the node is not a leaf.
+};
+
+/// Bounding volume hierarchy.
+/// Children of a node are stored next to each other and leaves reference a
+/// contiguous range of @a primitives.
+struct Bvh
+{
+	BvhNode *nodes;
+	u32 *primitives;
+	u32 num_nodes;
+};
+
 /// @}
 
 } // namespace crown
@@ -29,7 +29,7 @@
 	#include <string.h>   // memset
 	#include <sys/wait.h> // wait
 	#include <time.h>     // clock_gettime
-	#include <unistd.h>   // unlink, rmdir, getcwd, access, chdir
+	#include <unistd.h>   // unlink, rmdir, getcwd, access, chdir, sysconf
 #endif // if CROWN_PLATFORM_WINDOWS
 #if CROWN_PLATFORM_ANDROID
 	#include <android/log.h>
@@ -48,6 +48,18 @@ namespace os
 #endif
 	}
 
+	u32 num_cpus()
+	{
+#if CROWN_PLATFORM_WINDOWS
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return max(1u, (u32)info.dwNumberOfProcessors);
+#else
+		const long n = sysconf(_SC_NPROCESSORS_ONLN);
+		return n > 0 ? (u32)n : 1u;
+#endif
+	}
+
 	void *library_open(const char *path)
 	{
 #if CROWN_PLATFORM_WINDOWS
@@ -30,6 +30,11 @@
 #define CROWN_CPU_ENDIAN_BIG 0
 #define CROWN_CPU_ENDIAN_LITTLE 0
 
+#define CROWN_SIMD_AVX2 0
+#define CROWN_SIMD_FMA  0
+#define CROWN_SIMD_NEON 0
+#define CROWN_SIMD_SSE  0
+
 // http://sourceforge.net/apps/mediawiki/predef/index.php?title=Compilers
 #if defined(_MSC_VER)
 	#undef CROWN_COMPILER_MSVC
@@ -119,6 +124,22 @@
 	#define CROWN_CPU_ENDIAN_LITTLE 1
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#undef CROWN_SIMD_SSE
+	#define CROWN_SIMD_SSE 1
+	#if defined(__AVX2__)
+		#undef CROWN_SIMD_AVX2
+		#define CROWN_SIMD_AVX2 1
+	#endif
+	#if defined(__FMA__)
+		#undef CROWN_SIMD_FMA
+		#define CROWN_SIMD_FMA 1
+	#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#undef CROWN_SIMD_NEON
+	#define CROWN_SIMD_NEON 1
+#endif
+
 #if CROWN_COMPILER_GCC
 	#define CROWN_COMPILER_NAME "GCC"
 #elif CROWN_COMPILER_MSVC
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/error/error.inl"
+#include "core/memory/globals.h"
+#include "core/memory/memory.inl"
+#include "core/os.h"
+#include "core/thread/job_system.h"
+#include "core/thread/semaphore.h"
+#include "core/thread/thread.h"
+#include <atomic>
+#include <stdint.h> // UINT32_MAX
+
+#define MAX_JOBS_PER_THREAD   4096
+#define MAX_JOB_CONTINUATIONS 4
+#define MAX_JOB_PAYLOAD       32
+
+namespace crown
+{
+struct Job
+{
+	JobFunction function;
+	void *data;
+	Job *parent;
+	std::atomic_int unfinished;
+	std::atomic_int num_continuations;
+	Job *continuations[MAX_JOB_CONTINUATIONS];
+	CE_ALIGN_DECL(16, char payload[MAX_JOB_PAYLOAD]);
+};
+
+/// Fixed-size work-stealing deque of jobs.
+/// The owner thread pushes and pops at the bottom, other threads steal from the top.
+/// https://fzn.fr/readings/ppopp13.pdf
+struct JobQueue
+{
+	CE_STATIC_ASSERT(is_power_of_2(MAX_JOBS_PER_THREAD));
+
+	CE_ALIGN_DECL(CROWN_CACHE_LINE_SIZE, std::atomic<s64> _top);
+	CE_ALIGN_DECL(CROWN_CACHE_LINE_SIZE, std::atomic<s64> _bottom);
+	CE_ALIGN_DECL(CROWN_CACHE_LINE_SIZE, std::atomic<Job *> _jobs[MAX_JOBS_PER_THREAD]);
+
+	JobQueue()
+		: _top(0)
+		, _bottom(0)
+	{
+	}
+
+	/// Must only be called by the owner thread.
+	void push(Job *job)
+	{
+		const s64 b = _bottom.load(std::memory_order_relaxed);
+		const s64 t = _top.load(std::memory_order_acquire);
+		CE_ASSERT(b - t < MAX_JOBS_PER_THREAD, "Job queue is full");
+		CE_UNUSED(t);
+
+		_jobs[b & (MAX_JOBS_PER_THREAD - 1)].store(job, std::memory_order_relaxed);
+		_bottom.store(b + 1, std::memory_order_release);
+	}
+
+	/// Must only be called by the owner thread.
+	Job *pop()
+	{
+		const s64 b = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		s64 t = _top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			// Queue was empty.
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+
+		Job *job = _jobs[b & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if (t == b) {
+			// Last job in the queue: race against thieves.
+			if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = NULL;
+
+			_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+
+		return job;
+	}
+
+	/// Can be called by any thread.
+	Job *steal()
+	{
+		s64 t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const s64 b = _bottom.load(std::memory_order_acquire);
+
+		if (t >= b)
+			return NULL;
+
+		Job *job = _jobs[t & (MAX_JOBS_PER_THREAD - 1)].load(std::memory_order_relaxed);
+		if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return NULL;
+
+		return job;
+	}
+};
+
+struct JobThreadData
+{
+	JobQueue queue;
+	Job *jobs;
+	u32 num_allocated;
+};
+
+namespace job_system_globals
+{
+	static u32 _num_threads = 0;
+	static JobThreadData *_threads = NULL;
+	static Thread *_workers = NULL;
+	static Semaphore _semaphore;
+	static std::atomic_int _num_sleeping;
+	static std::atomic_int _quit;
+	static CE_THREAD u32 _thread_index = UINT32_MAX;
+
+} // namespace job_system_globals
+
+namespace job_system
+{
+	using namespace job_system_globals;
+
+	static Job *get_job()
+	{
+		JobThreadData &td = _threads[_thread_index];
+
+		Job *job = td.queue.pop();
+		if (job != NULL)
+			return job;
+
+		for (u32 ii = 1; ii < _num_threads; ++ii) {
+			job = _threads[(_thread_index + ii) % _num_threads].queue.steal();
+			if (job != NULL)
+				return job;
+		}
+
+		return NULL;
+	}
+
+	static void finish(Job *job)
+	{
+		if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		const s32 num = job->num_continuations.load(std::memory_order_relaxed);
+		for (s32 ii = 0; ii < num; ++ii)
+			run(job->continuations[ii]);
+
+		if (job->parent != NULL)
+			finish(job->parent);
+	}
+
+	static void execute(Job *job)
+	{
+		job->function(job->data);
+		finish(job);
+	}
+
+	static void noop(void * /*data*/)
+	{
+	}
+
+	Job *create(JobFunction function, void *data, Job *parent)
+	{
+		CE_ASSERT(_thread_index < _num_threads, "Job system not running or calling thread not managed by it");
+		CE_ASSERT(function != NULL, "Function must be != NULL");
+
+		JobThreadData &td = _threads[_thread_index];
+		Job *job = &td.jobs[td.num_allocated++ & (MAX_JOBS_PER_THREAD - 1)];
+		CE_ASSERT(is_finished(job), "Too many jobs in flight");
+
+		if (parent != NULL)
+			parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+
+		job->function = function;
+		job->data = data;
+		job->parent = parent;
+		job->unfinished.store(1, std::memory_order_relaxed);
+		job->num_continuations.store(0, std::memory_order_relaxed);
+		return job;
+	}
+
+	void add_continuation(Job *job, Job *continuation)
+	{
+		const s32 ii = job->num_continuations.fetch_add(1, std::memory_order_relaxed);
+		CE_ASSERT(ii < MAX_JOB_CONTINUATIONS, "Too many continuations");
+		job->continuations[ii] = continuation;
+	}
+
+	void run(Job *job)
+	{
+		CE_ASSERT(_thread_index < _num_threads, "Job system not running or calling thread not managed by it");
+		_threads[_thread_index].queue.push(job);
+
+		// Pairs with the sleep announcement in worker_main().
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_num_sleeping.load(std::memory_order_seq_cst) > 0)
+			_semaphore.post();
+	}
+
+	void wait(const Job *job)
+	{
+		while (!is_finished(job)) {
+			Job *next = get_job();
+			if (next != NULL)
+				execute(next);
+		}
+	}
+
+	bool is_finished(const Job *job)
+	{
+		return job->unfinished.load(std::memory_order_acquire) == 0;
+	}
+
+	struct ParallelForData
+	{
+		ParallelForFunction function;
+		void *data;
+		u32 begin;
+		u32 end;
+	};
+	CE_STATIC_ASSERT(sizeof(ParallelForData) <= MAX_JOB_PAYLOAD);
+
+	static void parallel_for_job(void *data)
+	{
+		const ParallelForData *pfd = (ParallelForData *)data;
+		pfd->function(pfd->begin, pfd->end, pfd->data);
+	}
+
+	void parallel_for(u32 count, u32 grain_size, ParallelForFunction function, void *data)
+	{
+		if (count == 0)
+			return;
+
+		grain_size = max(grain_size, 1u);
+
+		if (_num_threads < 2 || _thread_index >= _num_threads || count <= grain_size) {
+			function(0, count, data);
+			return;
+		}
+
+		// Keep the number of chunks well below the per-thread job limit.
+		const u32 max_chunks = MAX_JOBS_PER_THREAD / 4;
+		if ((count + grain_size - 1) / grain_size > max_chunks)
+			grain_size = (count + max_chunks - 1) / max_chunks;
+
+		Job *root = create(noop);
+		for (u32 begin = 0; begin < count; begin += grain_size) {
+			Job *job = create(parallel_for_job, NULL, root);
+			ParallelForData *pfd = (ParallelForData *)job->payload;
+			pfd->function = function;
+			pfd->data = data;
+			pfd->begin = begin;
+			pfd->end = min(begin + grain_size, count);
+			job->data = pfd;
+			run(job);
+		}
+		run(root);
+		wait(root);
+	}
+
+	u32 num_threads()
+	{
+		return _num_threads;
+	}
+
+	u32 thread_index()
+	{
+		return _thread_index < _num_threads ? _thread_index : UINT32_MAX;
+	}
+
+} // namespace job_system
+
+namespace job_system_globals
+{
+	static s32 worker_main(void *user_data)
+	{
+		_thread_index = (u32)(uintptr_t)user_data;
+
+		while (_quit.load(std::memory_order_relaxed) == 0) {
+			Job *job = job_system::get_job();
+			if (job != NULL) {
+				job_system::execute(job);
+				continue;
+			}
+
+			// Announce that we are going to sleep and look for work one last
+			// time: either we see the job or job_system::run() sees us.
+			_num_sleeping.fetch_add(1, std::memory_order_seq_cst);
+			job = job_system::get_job();
+			if (job == NULL && _quit.load(std::memory_order_relaxed) == 0)
+				_semaphore.wait();
+			_num_sleeping.fetch_sub(1, std::memory_order_seq_cst);
+
+			if (job != NULL)
+				job_system::execute(job);
+		}
+
+		return 0;
+	}
+
+	void init(u32 num_workers)
+	{
+		CE_ASSERT(_num_threads == 0, "Job system already running");
+
+		if (num_workers == UINT32_MAX)
+			num_workers = os::num_cpus() - 1;
+
+		_num_threads = num_workers + 1;
+		_num_sleeping.store(0);
+		_quit.store(0);
+
+		Allocator &a = default_allocator();
+		_threads = (JobThreadData *)a.allocate(sizeof(JobThreadData) * _num_threads, alignof(JobThreadData));
+		for (u32 ii = 0; ii < _num_threads; ++ii) {
+			new (&_threads[ii]) JobThreadData();
+			_threads[ii].jobs = (Job *)a.allocate(sizeof(Job) * MAX_JOBS_PER_THREAD, alignof(Job));
+			_threads[ii].num_allocated = 0;
+
+			for (u32 jj = 0; jj < MAX_JOBS_PER_THREAD; ++jj)
+				new (&_threads[ii].jobs[jj]) Job();
+		}
+
+		// The calling thread is always thread 0.
+		_thread_index = 0;
+
+		_workers = (Thread *)a.allocate(sizeof(Thread) * num_workers, alignof(Thread));
+		for (u32 ii = 0; ii < num_workers; ++ii) {
+			new (&_workers[ii]) Thread();
+			_workers[ii].start(worker_main, (void *)(uintptr_t)(ii + 1));
+		}
+	}
+
+	void shutdown()
+	{
+		CE_ASSERT(_thread_index == 0, "Job system must be shut down from the thread that started it");
+
+		const u32 num_workers = _num_threads - 1;
+
+		_quit.store(1);
+		_semaphore.post(num_workers);
+
+		Allocator &a = default_allocator();
+		for (u32 ii = 0; ii < num_workers; ++ii) {
+			_workers[ii].stop();
+			_workers[ii].~Thread();
+		}
+		a.deallocate(_workers);
+		_workers = NULL;
+
+		for (u32 ii = 0; ii < _num_threads; ++ii) {
+			a.deallocate(_threads[ii].jobs);
+			_threads[ii].~JobThreadData();
+		}
+		a.deallocate(_threads);
+		_threads = NULL;
+
+		_num_threads = 0;
+		_thread_index = UINT32_MAX;
+	}
+
+} // namespace job_system_globals
+
+} // namespace crown
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/thread/types.h"
+#include "core/types.h"
+
+namespace crown
+{
+typedef void (*JobFunction)(void *data);
+typedef void (*ParallelForFunction)(u32 begin, u32 end, void *data);
+
+/// Functions to run work on a fixed pool of worker threads.
+///
+/// Each thread owns a work-stealing deque: jobs are pushed to and popped from
+/// the bottom of the deque of the thread that runs them, while idle threads
+/// steal from the top of the deques of other threads.
+///
+/// @note
+/// Jobs can only be created and run from the main thread (the thread that
+/// called job_system_globals::init()) or from inside other jobs. Each thread
+/// can have at most 4096 jobs in flight.
+///
+/// @ingroup Thread
+namespace job_system
+{
+	/// Creates a new job that calls @a function with @a data when executed.
+	/// If @a parent is not NULL, @a parent will not be considered finished
+	/// until the new job finishes. The job does not start until job_system::run()
+	/// is called.
+	Job *create(JobFunction function, void *data = NULL, Job *parent = NULL);
+
+	/// Schedules @a continuation to run as soon as @a job finishes.
+	/// Must be called before @a job is run.
+	void add_continuation(Job *job, Job *continuation);
+
+	/// Schedules @a job for execution.
+	void run(Job *job);
+
+	/// Waits for @a job (and all its children) to finish. The calling thread
+	/// executes pending jobs while waiting.
+	void wait(const Job *job);
+
+	/// Returns whether @a job (and all its children) finished.
+	bool is_finished(const Job *job);
+
+	/// Calls @a function over the range [0; @a count) split into chunks of at
+	/// most @a grain_size items and waits for all of them to finish. If the
+	/// job system is not running or there is only one chunk, @a function is
+	/// called directly on the calling thread.
+	void parallel_for(u32 count, u32 grain_size, ParallelForFunction function, void *data = NULL);
+
+	/// Returns the total number of threads executing jobs, including the main thread.
+	u32 num_threads();
+
+	/// Returns the index of the calling thread in the range [0; num_threads())
+	/// or UINT32_MAX if the calling thread is not managed by the job system.
+	u32 thread_index();
+
+} // namespace job_system
+
+namespace job_system_globals
+{
+	/// Starts @a num_workers worker threads. If @a num_workers is UINT32_MAX,
+	/// one worker per logical processor minus one (for the main thread) is
+	/// started.
+	void init(u32 num_workers = UINT32_MAX);
+
+	/// Waits for all worker threads to exit.
+	void shutdown();
+
+} // namespace job_system_globals
+
+} // namespace crown
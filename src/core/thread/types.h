@@ -9,6 +9,7 @@ namespace crown
 {
 struct AtomicInt;
 struct ConditionVariable;
+struct Job;
 struct Mutex;
 struct ScopedMutex;
 struct Semaphore;
@@ -12,6 +12,7 @@
 #include "core/containers/hash_set.inl"
 #include "core/containers/vector.inl"
 #include "core/filesystem/file.h"
+#include "core/filesystem/file_memory.inl"
 #include "core/filesystem/file_monitor.h"
 #include "core/filesystem/filesystem_disk.h"
 #include "core/filesystem/path.h"
@@ -19,13 +20,19 @@
 #include "core/json/json.h"
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
+#include "core/lz4.h"
 #include "core/math/aabb.inl"
+#include "core/math/aabb_tree.h"
+#include "core/math/bvh.h"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
+#include "core/math/frustum.inl"
+#include "core/math/intersection.h"
 #include "core/math/math.h"
 #include "core/math/matrix3x3.inl"
 #include "core/math/matrix4x4.inl"
 #include "core/math/quaternion.inl"
+#include "core/math/random.h"
 #include "core/math/sphere.inl"
 #include "core/math/vector2.inl"
 #include "core/math/vector3.inl"
@@ -41,10 +48,30 @@
 #include "core/strings/string_id.inl"
 #include "core/strings/string_view.inl"
 #include "core/thread/condition_variable.h"
+#include "core/thread/job_system.h"
 #include "core/thread/mutex.h"
 #include "core/thread/thread.h"
 #include "core/time.h"
+#include "resource/font_resource.h"
 #include "resource/lua_resource.h"
+#include "resource/mesh_resource.h"
+#include "resource/package_resource.h"
+#include "resource/particle_system_resource.h"
+#include "resource/resource_loader.h"
+#include "resource/resource_manager.h"
+#include "resource/tilemap_resource.h"
+#include "world/gui.h"
+#include "world/material_manager.h"
+#include "world/occlusion_buffer.h"
+#include "world/particle_emitter.h"
+#include "world/render_world.h"
+#include "world/scene_graph.h"
+#include "world/shader_manager.h"
+#include "world/unit_manager.h"
+#include "world/unit_map.inl"
+#include <atomic>
+#include <float.h>  // FLT_MAX
+#include <stdint.h> // UINT32_MAX
 #include <stdlib.h> // EXIT_SUCCESS, EXIT_FAILURE
 #include <stdio.h>  // printf
 
@@ -204,6 +231,41 @@ static void test_hash_set()
 	memory_globals::shutdown();
 }
 
+static void test_unit_map()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		UnitMap m(a);
+		const UnitId u0 = { 0 };
+		const UnitId u7 = { 7 };
+		const UnitId u7_gen1 = { 7 | (1u << UNIT_INDEX_BITS) };
+
+		ENSURE(!unit_map::has(m, u0));
+		ENSURE(unit_map::get(m, u7, 42) == 42);
+
+		unit_map::set(m, u7, 3);
+		ENSURE(unit_map::has(m, u7));
+		ENSURE(unit_map::get(m, u7, 42) == 3);
+		ENSURE(!unit_map::has(m, u0));
+
+		// Same index, different generation.
+		ENSURE(!unit_map::has(m, u7_gen1));
+		ENSURE(unit_map::get(m, u7_gen1, 42) == 42);
+
+		unit_map::remove(m, u7_gen1);
+		ENSURE(unit_map::has(m, u7));
+
+		unit_map::remove(m, u7);
+		ENSURE(!unit_map::has(m, u7));
+
+		unit_map::set(m, u7_gen1, 5);
+		ENSURE(unit_map::get(m, u7_gen1, 42) == 5);
+		ENSURE(!unit_map::has(m, u7));
+	}
+	memory_globals::shutdown();
+}
+
 static void test_vector2()
 {
 	{
@@ -748,6 +810,62 @@ static void test_matrix4x4()
 		q = rotation(m);
 		ENSURE(memcmp(&q, &QUATERNION_IDENTITY, sizeof(q)) == 0);
 	}
+	{
+		// Batch kernels must match the scalar reference.
+		Vector3 pos[7];
+		Quaternion rot[7];
+		Vector3 scl[7];
+		Matrix4x4 a[7];
+		Matrix4x4 b[7];
+		for (u32 i = 0; i < countof(pos); ++i) {
+			const f32 f = f32(i) + 1.0f;
+			pos[i] = vector3(f, -2.0f*f, 0.5f*f);
+			Vector3 axis = vector3(1.0f, f, -0.5f*f);
+			rot[i] = from_axis_angle(normalize(axis), 0.7f*f);
+			scl[i] = vector3(1.0f + 0.1f*f, 2.0f - 0.2f*f, 0.5f + 0.3f*f);
+		}
+
+		to_matrix_batch(a, pos, rot, scl, countof(a));
+		for (u32 i = 0; i < countof(a); ++i) {
+			Matrix4x4 r = from_quaternion_translation(rot[i], pos[i]);
+			set_scale(r, scl[i]);
+
+			const f32 *ra = to_float_ptr(a[i]);
+			const f32 *rr = to_float_ptr(r);
+			for (u32 j = 0; j < 16; ++j)
+				ENSURE(fequal(ra[j], rr[j], 0.0001f));
+		}
+
+		for (u32 i = 0; i < countof(b); ++i)
+			b[i] = a[countof(a) - 1 - i];
+
+		Matrix4x4 c[7];
+		mul_batch(c, a, b, countof(c));
+		for (u32 i = 0; i < countof(c); ++i) {
+			const f32 *ra = to_float_ptr(a[i]);
+			const f32 *rb = to_float_ptr(b[i]);
+			const f32 *rc = to_float_ptr(c[i]);
+			for (u32 row = 0; row < 4; ++row) {
+				for (u32 col = 0; col < 4; ++col) {
+					const f32 r = ra[row*4 + 0] * rb[0*4 + col]
+						+ ra[row*4 + 1] * rb[1*4 + col]
+						+ ra[row*4 + 2] * rb[2*4 + col]
+						+ ra[row*4 + 3] * rb[3*4 + col]
+						;
+					ENSURE(fequal(rc[row*4 + col], r, 0.0001f));
+				}
+			}
+		}
+
+		Vector3 pts[7];
+		transform_points(pts, pos, countof(pts), a[3]);
+		for (u32 i = 0; i < countof(pts); ++i) {
+			const Matrix4x4 &m = a[3];
+			ENSURE(fequal(pts[i].x, pos[i].x*m.x.x + pos[i].y*m.y.x + pos[i].z*m.z.x + m.t.x, 0.0001f));
+			ENSURE(fequal(pts[i].y, pos[i].x*m.x.y + pos[i].y*m.y.y + pos[i].z*m.z.y + m.t.y, 0.0001f));
+			ENSURE(fequal(pts[i].z, pos[i].x*m.x.z + pos[i].y*m.y.z + pos[i].z*m.z.z + m.t.z, 0.0001f));
+		}
+	}
 }
 
 static void test_aabb()
@@ -901,12 +1019,561 @@ static void test_sphere()
 	}
 }
 
+static void test_intersection()
+{
+	{
+		// Frustum is the box [-1; 1] x [-1; 1] x [0; 1].
+		Frustum f;
+		frustum::from_matrix(f, MATRIX4X4_IDENTITY);
+
+		OBB obbs[7];
+		Matrix4x4 world[7];
+		for (u32 i = 0; i < countof(obbs); ++i) {
+			obbs[i].half_extents = vector3(0.5f, 0.5f, 0.5f);
+			world[i] = MATRIX4X4_IDENTITY;
+		}
+		obbs[0].tm = from_translation(vector3(0.0f, 0.0f, 0.5f));
+		obbs[0].half_extents = vector3(0.25f, 0.25f, 0.25f);
+		obbs[1].tm = from_translation(vector3(3.0f, 0.0f, 0.5f));
+		obbs[2].tm = from_translation(vector3(1.2f, 0.0f, 0.5f));
+		obbs[3].tm = from_translation(vector3(0.0f, 0.0f, -2.0f));
+		obbs[4].tm = from_quaternion_translation(from_axis_angle(VECTOR3_ZAXIS, PI/4.0f), vector3(1.6f, 0.0f, 0.5f));
+		obbs[5].tm = from_translation(vector3(0.0f, 1.7f, 0.5f));
+		world[5] = from_translation(vector3(0.0f, -1.0f, 0.0f));
+		obbs[6].tm = MATRIX4X4_IDENTITY;
+		world[6] = from_translation(vector3(0.0f, 0.0f, 5.0f));
+
+		u32 visible[7];
+		for (u32 i = 0; i < countof(visible); ++i)
+			visible[i] = i;
+		const u32 num = obb_intersects_frustum_batch(visible, countof(visible), obbs, world, f);
+		ENSURE(num == 4);
+		ENSURE(visible[0] == 0);
+		ENSURE(visible[1] == 2);
+		ENSURE(visible[2] == 4);
+		ENSURE(visible[3] == 5);
+	}
+	{
+		AABB b;
+		b.min = vector3(-1.0f, -1.0f, -1.0f);
+		b.max = vector3( 1.0f,  1.0f,  1.0f);
+
+		AABB c;
+		c.min = vector3(0.5f, 0.5f, 0.5f);
+		c.max = vector3(2.0f, 2.0f, 2.0f);
+		ENSURE(aabb_intersects_aabb(b, c));
+		c.min.x = 1.5f;
+		ENSURE(!aabb_intersects_aabb(b, c));
+
+		const Sphere s0 = { vector3(2.0f, 2.0f, 0.0f), 1.5f };
+		const Sphere s1 = { vector3(2.0f, 2.0f, 0.0f), 1.0f };
+		ENSURE(sphere_intersects_aabb(s0, b));
+		ENSURE(!sphere_intersects_aabb(s1, b));
+
+		Frustum f;
+		frustum::from_matrix(f, MATRIX4X4_IDENTITY);
+		ENSURE(aabb_intersects_frustum(b, f));
+		b.min.z = -3.0f;
+		b.max.z = -2.0f;
+		ENSURE(!aabb_intersects_frustum(b, f));
+
+		const Vector3 inv_dir = vector3(1.0f/0.5f, 1.0f/FLT_MIN, 1.0f/FLT_MIN);
+		ENSURE(fequal(ray_aabb_intersection(vector3(-5.0f, 0.0f, -2.5f), inv_dir, b), 8.0f));
+		ENSURE(ray_aabb_intersection(vector3(-5.0f, 3.0f, -2.5f), inv_dir, b) == -1.0f);
+	}
+}
+
+static f32 test_bvh_ray_aabb(u32 primitive, const Vector3 &from, const Vector3 &dir, void *user_data)
+{
+	const AABB &b = ((const AABB *)user_data)[primitive];
+	return ray_obb_intersection(from, dir, from_translation(aabb::center(b)), (b.max - b.min) * 0.5f);
+}
+
+static void test_bvh()
+{
+	{
+		Bvh b;
+		b.nodes = NULL;
+		b.primitives = NULL;
+		bvh::build(b, NULL, 0);
+		ENSURE(b.num_nodes == 0);
+		ENSURE(bvh::cast_ray(b, VECTOR3_ZERO, VECTOR3_ZAXIS, test_bvh_ray_aabb, NULL) == -1.0f);
+	}
+	{
+		// 10x10x10 unit boxes spaced 2 units apart.
+		AABB boxes[1000];
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			const Vector3 c = vector3(f32(i % 10) * 2.0f, f32((i / 10) % 10) * 2.0f, f32(i / 100) * 2.0f);
+			boxes[i].min = c - vector3(0.5f, 0.5f, 0.5f);
+			boxes[i].max = c + vector3(0.5f, 0.5f, 0.5f);
+		}
+
+		BvhNode nodes[1999];
+		u32 primitives[1000];
+		Bvh b;
+		b.nodes = nodes;
+		b.primitives = primitives;
+		bvh::build(b, boxes, countof(boxes));
+		ENSURE(b.num_nodes > 0 && b.num_nodes <= bvh::max_nodes(countof(boxes)));
+		ENSURE(fequal(nodes[0].aabb.min.x, -0.5f));
+		ENSURE(fequal(nodes[0].aabb.max.z, 18.5f));
+
+		// Every primitive is referenced exactly once.
+		u32 count[1000] = { 0 };
+		for (u32 i = 0; i < countof(primitives); ++i)
+			++count[primitives[i]];
+		for (u32 i = 0; i < countof(count); ++i)
+			ENSURE(count[i] == 1);
+
+		// Hits the nearest box along +z.
+		u32 hit = UINT32_MAX;
+		f32 t = bvh::cast_ray(b, vector3(4.0f, 6.0f, -10.0f), VECTOR3_ZAXIS, test_bvh_ray_aabb, boxes, &hit);
+		ENSURE(fequal(t, 9.5f));
+		ENSURE(hit == 2 + 3*10);
+
+		// Hits the nearest box along -x.
+		t = bvh::cast_ray(b, vector3(30.0f, 2.0f, 8.0f), -VECTOR3_XAXIS, test_bvh_ray_aabb, boxes, &hit);
+		ENSURE(fequal(t, 11.5f));
+		ENSURE(hit == 9 + 1*10 + 4*100);
+
+		// Passes between boxes.
+		t = bvh::cast_ray(b, vector3(1.0f, 1.0f, -10.0f), VECTOR3_ZAXIS, test_bvh_ray_aabb, boxes, &hit);
+		ENSURE(t == -1.0f);
+
+		// Matches brute force along a diagonal.
+		const Vector3 from = vector3(-5.0f, -3.0f, -4.0f);
+		const Vector3 dir = vector3(1.0f, 0.9f, 1.1f);
+		f32 tmin = FLT_MAX;
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			const f32 ti = test_bvh_ray_aabb(i, from, dir, boxes);
+			if (ti >= 0.0f)
+				tmin = min(tmin, ti);
+		}
+		t = bvh::cast_ray(b, from, dir, test_bvh_ray_aabb, boxes);
+		ENSURE(tmin != FLT_MAX);
+		ENSURE(fequal(t, tmin));
+	}
+}
+
+static void test_aabb_tree()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		AabbTree t(a);
+		ENSURE(aabb_tree::size(t) == 0);
+		ENSURE(aabb_tree::height(t) == 0);
+
+		Random rnd(42);
+		AABB boxes[512];
+		u32 proxies[512];
+		bool alive[512];
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			const Vector3 c = vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float()) * 100.0f;
+			const Vector3 e = vector3(rnd.unit_float(), rnd.unit_float(), rnd.unit_float()) + vector3(0.1f, 0.1f, 0.1f);
+			boxes[i].min = c - e;
+			boxes[i].max = c + e;
+			proxies[i] = aabb_tree::create(t, boxes[i], i);
+			alive[i] = true;
+		}
+		ENSURE(aabb_tree::size(t) == countof(boxes));
+		ENSURE(aabb_tree::height(t) <= 20);
+
+		// Move some proxies far away and destroy others.
+		for (u32 i = 0; i < countof(boxes); i += 3) {
+			const Vector3 d = vector3(50.0f, 0.0f, 0.0f);
+			boxes[i].min += d;
+			boxes[i].max += d;
+			ENSURE(aabb_tree::move(t, proxies[i], boxes[i]));
+			ENSURE(!aabb_tree::move(t, proxies[i], boxes[i]));
+		}
+		for (u32 i = 1; i < countof(boxes); i += 5) {
+			aabb_tree::destroy(t, proxies[i]);
+			alive[i] = false;
+		}
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			if (alive[i])
+				ENSURE(aabb_tree::user_data(t, proxies[i]) == i);
+		}
+
+		// Queries match brute force, modulo the proxies' margin.
+		Array<u32> result(a);
+		AABB q;
+		q.min = vector3(20.0f, 20.0f, 20.0f);
+		q.max = vector3(60.0f, 50.0f, 70.0f);
+		aabb_tree::query_box(t, result, q);
+		u32 num_expected = 0;
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			if (alive[i] && aabb_intersects_aabb(boxes[i], q))
+				++num_expected;
+		}
+		ENSURE(array::size(result) >= num_expected);
+		for (u32 i = 0; i < array::size(result); ++i) {
+			const u32 id = result[i];
+			ENSURE(alive[id]);
+			ENSURE(aabb_intersects_aabb(aabb_tree::fat_aabb(t, proxies[id]), q));
+		}
+
+		array::clear(result);
+		const Sphere s = { vector3(50.0f, 50.0f, 50.0f), 25.0f };
+		aabb_tree::query_sphere(t, result, s);
+		num_expected = 0;
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			if (alive[i] && sphere_intersects_aabb(s, boxes[i]))
+				++num_expected;
+		}
+		ENSURE(array::size(result) >= num_expected);
+		for (u32 i = 0; i < array::size(result); ++i)
+			ENSURE(sphere_intersects_aabb(s, aabb_tree::fat_aabb(t, proxies[result[i]])));
+
+		// Frustum is the box [-1; 1] x [-1; 1] x [0; 1].
+		array::clear(result);
+		Frustum f;
+		frustum::from_matrix(f, MATRIX4X4_IDENTITY);
+		aabb_tree::query_frustum(t, result, f);
+		for (u32 i = 0; i < array::size(result); ++i)
+			ENSURE(aabb_intersects_frustum(aabb_tree::fat_aabb(t, proxies[result[i]]), f));
+
+		// Ray casts return the nearest box.
+		const Vector3 from = vector3(-10.0f, 40.0f, 45.0f);
+		const Vector3 dir = aabb::center(boxes[7]) - from;
+		f32 tmin = FLT_MAX;
+		u32 nearest = UINT32_MAX;
+		for (u32 i = 0; i < countof(boxes); ++i) {
+			const f32 ti = test_bvh_ray_aabb(i, from, dir, boxes);
+			if (alive[i] && ti >= 0.0f && ti < tmin) {
+				tmin = ti;
+				nearest = i;
+			}
+		}
+		u32 hit = UINT32_MAX;
+		const f32 tt = aabb_tree::cast_ray(t, from, dir, test_bvh_ray_aabb, boxes, &hit);
+		ENSURE(nearest != UINT32_MAX);
+		ENSURE(fequal(tt, tmin));
+		ENSURE(hit == nearest);
+
+		aabb_tree::clear(t);
+		ENSURE(aabb_tree::size(t) == 0);
+		ENSURE(aabb_tree::cast_ray(t, from, dir, test_bvh_ray_aabb, boxes) == -1.0f);
+	}
+	memory_globals::shutdown();
+}
+
+static void test_occlusion_buffer()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		// Perspective projection looking down +z, near 0.1, far 100.
+		const f32 n = 0.1f;
+		const f32 f = 100.0f;
+		Matrix4x4 proj = MATRIX4X4_IDENTITY;
+		proj.z = vector4(0.0f, 0.0f, f/(f - n), 1.0f);
+		proj.t = vector4(0.0f, 0.0f, -n*f/(f - n), 0.0f);
+
+		// Quad at z = 5 covering [-2, 2] in x and y.
+		const Vector3 vertices[] =
+		{
+			{ -2.0f, -2.0f, 5.0f },
+			{  2.0f, -2.0f, 5.0f },
+			{  2.0f,  2.0f, 5.0f },
+			{ -2.0f,  2.0f, 5.0f }
+		};
+		const u16 indices[] = { 0, 1, 2, 0, 2, 3 };
+
+		OBB obb;
+		obb.tm = MATRIX4X4_IDENTITY;
+		obb.half_extents = vector3(0.5f, 0.5f, 0.5f);
+
+		OcclusionBuffer *ob = CE_NEW(a, OcclusionBuffer)(a);
+		ob->clear(proj);
+		ob->update_tiles();
+		ENSURE(!ob->is_occluded(obb, from_translation(vector3(0.0f, 0.0f, 10.0f))));
+
+		ob->add_occluder(MATRIX4X4_IDENTITY, vertices, sizeof(Vector3), countof(vertices), indices, countof(indices));
+		ob->update_tiles();
+		ENSURE(ob->_num_triangles == 2);
+		ENSURE( ob->is_occluded(obb, from_translation(vector3(0.0f, 0.0f, 10.0f))));
+		ENSURE( ob->is_occluded(obb, from_translation(vector3(1.8f, 0.0f, 10.0f))));
+		ENSURE(!ob->is_occluded(obb, from_translation(vector3(0.0f, 0.0f,  2.0f))));
+		ENSURE(!ob->is_occluded(obb, from_translation(vector3(8.0f, 0.0f, 10.0f))));
+		ENSURE(!ob->is_occluded(obb, from_translation(vector3(0.0f, 0.0f, -1.0f))));
+
+		// Winding does not matter.
+		const u16 flipped[] = { 0, 2, 1, 0, 3, 2 };
+		ob->clear(proj);
+		ob->add_occluder(MATRIX4X4_IDENTITY, vertices, sizeof(Vector3), countof(vertices), flipped, countof(flipped));
+		ob->update_tiles();
+		ENSURE(ob->is_occluded(obb, from_translation(vector3(0.0f, 0.0f, 10.0f))));
+		CE_DELETE(a, ob);
+	}
+	memory_globals::shutdown();
+}
+
+static void test_render_world()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		// Quad in the xy plane covering [-1, 1] in x and y.
+		const Vector3 vertices[] =
+		{
+			{ -1.0f, -1.0f, 0.0f },
+			{  1.0f, -1.0f, 0.0f },
+			{  1.0f,  1.0f, 0.0f },
+			{ -1.0f,  1.0f, 0.0f }
+		};
+		const u16 indices[] = { 0, 1, 2, 0, 2, 3 };
+		AABB tris[2];
+		for (u32 i = 0; i < countof(tris); ++i) {
+			const Vector3 v[] = { vertices[indices[i*3 + 0]], vertices[indices[i*3 + 1]], vertices[indices[i*3 + 2]] };
+			aabb::from_points(tris[i], countof(v), v);
+		}
+
+		BvhNode nodes[3];
+		u32 primitives[2];
+		MeshGeometry mg;
+		mg.vertices.num = countof(vertices);
+		mg.vertices.stride = sizeof(Vector3);
+		mg.vertices.data = (char *)vertices;
+		mg.indices.num = countof(indices);
+		mg.indices.data = (char *)indices;
+		mg.bvh.nodes = nodes;
+		mg.bvh.primitives = primitives;
+		bvh::build(mg.bvh, tris, countof(tris));
+		mg.obb.tm = MATRIX4X4_IDENTITY;
+		mg.obb.half_extents = vector3(1.0f, 1.0f, 0.1f);
+
+		// Two overlapping meshes at z = 5 and z = 2.
+		RenderWorld::MeshManager mm(a, NULL);
+		mm.allocate(2);
+		const f32 z[] = { 5.0f, 2.0f };
+		for (u32 i = 0; i < countof(z); ++i) {
+			mm._data.geometry[i] = &mg;
+			mm._data.world[i] = from_translation(vector3(0.0f, 0.0f, z[i]));
+			mm._data.obb[i] = mg.obb;
+			mm._data.proxy[i] = aabb_tree::create(mm._tree, mm.world_aabb(i), i);
+		}
+		mm._data.size = 2;
+		mm._data.first_hidden = 2;
+
+		// Returns the nearest mesh.
+		MeshInstance hit = { UINT32_MAX };
+		ENSURE(fequal(mm.cast_ray(hit, vector3(0.5f, 0.0f, -10.0f), VECTOR3_ZAXIS), 12.0f));
+		ENSURE(hit.i == 1);
+		ENSURE(fequal(mm.cast_ray(hit, vector3(0.0f, 0.5f, 10.0f), -VECTOR3_ZAXIS), 5.0f));
+		ENSURE(hit.i == 0);
+
+		// Misses both.
+		hit.i = UINT32_MAX;
+		ENSURE(mm.cast_ray(hit, vector3(3.0f, 0.0f, -10.0f), VECTOR3_ZAXIS) == -1.0f);
+		ENSURE(hit.i == UINT32_MAX);
+
+		// Hidden meshes are ignored.
+		mm._data.first_hidden = 1;
+		ENSURE(fequal(mm.cast_ray(hit, vector3(0.5f, 0.0f, -10.0f), VECTOR3_ZAXIS), 15.0f));
+		ENSURE(hit.i == 0);
+
+		mm.destroy();
+	}
+	memory_globals::shutdown();
+}
+
+/// Returns the number of times @a unit appears in @a units.
+static u32 test_count_unit(const Array<UnitId> &units, UnitId unit)
+{
+	u32 num = 0;
+	for (u32 i = 0; i < array::size(units); ++i)
+		num += units[i] == unit;
+	return num;
+}
+
+/// Returns whether parents come before their children in @a sg, units map to
+/// their nodes and the list of changed nodes matches the nodes' indices into it.
+static bool test_scene_graph_is_valid(SceneGraph &sg)
+{
+	for (u32 i = 0; i < sg._data.size; ++i) {
+		if (is_valid(sg._data.parent[i]) && sg._data.parent[i].i >= i)
+			return false;
+		if (sg.instance(sg._data.unit[i]).i != i)
+			return false;
+		if (sg._data.changed_index[i] != UINT32_MAX && sg._changed[sg._data.changed_index[i]] != i)
+			return false;
+	}
+	for (u32 i = 0; i < array::size(sg._changed); ++i) {
+		if (sg._data.changed_index[sg._changed[i]] != i)
+			return false;
+	}
+	return true;
+}
+
+static void test_scene_graph()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		UnitManager um(a);
+		SceneGraph sg(a, um);
+		Array<UnitId> units(a);
+		Array<Matrix4x4> poses(a);
+
+		// Children are stored before their parents.
+		const UnitId c = um.create();
+		const UnitId b = um.create();
+		const UnitId r = um.create();
+		const UnitId d = um.create();
+		sg.create(c, VECTOR3_ZERO, QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.create(b, VECTOR3_ZERO, QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.create(r, vector3(1.0f, 0.0f, 0.0f), QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.create(d, vector3(10.0f, 0.0f, 0.0f), QUATERNION_IDENTITY, VECTOR3_ONE);
+
+		sg.link(sg.instance(r), sg.instance(b), vector3(0.0f, 2.0f, 0.0f));
+		sg.link(sg.instance(b), sg.instance(c), vector3(0.0f, 0.0f, 3.0f));
+		ENSURE(sg._unsorted);
+		sg.update();
+		ENSURE(!sg._unsorted);
+		ENSURE(test_scene_graph_is_valid(sg));
+		ENSURE(sg.instance(r).i < sg.instance(b).i);
+		ENSURE(sg.instance(b).i < sg.instance(c).i);
+		ENSURE(translation(sg._data.world[sg.instance(r).i]) == vector3(1.0f, 0.0f, 0.0f));
+		ENSURE(translation(sg._data.world[sg.instance(b).i]) == vector3(1.0f, 2.0f, 0.0f));
+		ENSURE(translation(sg._data.world[sg.instance(c).i]) == vector3(1.0f, 2.0f, 3.0f));
+		ENSURE(translation(sg._data.world[sg.instance(d).i]) == vector3(10.0f, 0.0f, 0.0f));
+
+		// Nothing changed after clear_changed().
+		sg.clear_changed();
+		sg.get_changed(units, poses);
+		ENSURE(array::size(units) == 0);
+		ENSURE(array::size(poses) == 0);
+
+		// Moving the root recomputes all its descendants in one update().
+		sg.set_local_position(sg.instance(r), vector3(5.0f, 0.0f, 0.0f));
+		sg.set_local_position(sg.instance(r), vector3(4.0f, 0.0f, 0.0f));
+		sg.update();
+		ENSURE(sg._first_dirty == UINT32_MAX);
+		ENSURE(translation(sg._data.world[sg.instance(r).i]) == vector3(4.0f, 0.0f, 0.0f));
+		ENSURE(translation(sg._data.world[sg.instance(b).i]) == vector3(4.0f, 2.0f, 0.0f));
+		ENSURE(translation(sg._data.world[sg.instance(c).i]) == vector3(4.0f, 2.0f, 3.0f));
+
+		// Only the moved nodes are changed, each once.
+		sg.set_world_pose(sg.instance(d), from_translation(vector3(10.0f, 1.0f, 0.0f)));
+		sg.set_world_pose(sg.instance(d), from_translation(vector3(10.0f, 0.0f, 0.0f)));
+		sg.get_changed(units, poses);
+		ENSURE(array::size(units) == 4);
+		ENSURE(test_count_unit(units, r) == 1);
+		ENSURE(test_count_unit(units, b) == 1);
+		ENSURE(test_count_unit(units, c) == 1);
+		ENSURE(test_count_unit(units, d) == 1);
+		for (u32 i = 0; i < array::size(units); ++i)
+			ENSURE(translation(poses[i]) == sg.world_position(sg.instance(units[i])));
+
+		sg.clear_changed();
+		array::clear(units);
+		array::clear(poses);
+		sg.get_changed(units, poses);
+		ENSURE(array::size(units) == 0);
+
+		// Changed nodes are tracked across a sort.
+		const UnitId e = um.create();
+		sg.create(e, vector3(0.0f, 5.0f, 0.0f), QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.set_local_position(sg.instance(d), vector3(11.0f, 0.0f, 0.0f));
+		sg.link(sg.instance(e), sg.instance(d), vector3(1.0f, 0.0f, 0.0f));
+		ENSURE(sg._unsorted);
+		sg.get_changed(units, poses);
+		ENSURE(!sg._unsorted);
+		ENSURE(test_scene_graph_is_valid(sg));
+		ENSURE(array::size(units) == 1);
+		ENSURE(units[0] == d);
+		ENSURE(translation(poses[0]) == vector3(1.0f, 5.0f, 0.0f));
+
+		// Destroying a changed node removes it from the changed nodes.
+		sg.set_local_position(sg.instance(b), vector3(0.0f, 3.0f, 0.0f));
+		array::clear(units);
+		array::clear(poses);
+		sg.get_changed(units, poses);
+		ENSURE(array::size(units) == 3);
+		sg.destroy(sg.instance(d));
+		ENSURE(!sg.has(d));
+		ENSURE(test_scene_graph_is_valid(sg));
+		array::clear(units);
+		array::clear(poses);
+		sg.get_changed(units, poses);
+		ENSURE(array::size(units) == 2);
+		ENSURE(test_count_unit(units, d) == 0);
+		ENSURE(test_count_unit(units, b) == 1);
+		ENSURE(test_count_unit(units, c) == 1);
+		for (u32 i = 0; i < array::size(units); ++i)
+			ENSURE(translation(poses[i]) == sg.world_position(sg.instance(units[i])));
+		ENSURE(translation(sg._data.world[sg.instance(c).i]) == vector3(4.0f, 3.0f, 3.0f));
+
+		// Destroying a node while a sort is pending.
+		const Vector3 c_pos = sg.world_position(sg.instance(c));
+		const UnitId f = um.create();
+		const UnitId g = um.create();
+		sg.create(f, VECTOR3_ZERO, QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.create(g, vector3(0.0f, 0.0f, 7.0f), QUATERNION_IDENTITY, VECTOR3_ONE);
+		sg.link(sg.instance(g), sg.instance(f), vector3(1.0f, 0.0f, 0.0f));
+		ENSURE(sg._unsorted);
+		sg.destroy(sg.instance(g));
+		ENSURE(!sg._unsorted);
+		ENSURE(!sg.has(g));
+		ENSURE(sg.num_nodes() == 5);
+		ENSURE(test_scene_graph_is_valid(sg));
+		ENSURE(!is_valid(sg._data.parent[sg.instance(f).i]));
+		ENSURE(sg.world_position(sg.instance(f)) == vector3(1.0f, 0.0f, 7.0f));
+		ENSURE(sg.world_position(sg.instance(c)) == c_pos);
+	}
+	memory_globals::shutdown();
+}
+
 static void test_murmur()
 {
 	const u64 n = murmur64("murmur64", 8, 0);
 	ENSURE(n == 0x90631502d1a3432bu);
 }
 
+static void test_lz4()
+{
+	memory_globals::init();
+	{
+		Allocator &a = default_allocator();
+		const u32 size = 100000;
+		u8 *src = (u8 *)a.allocate(size);
+		u8 *dst = (u8 *)a.allocate(lz4::compress_bound(size));
+		u8 *out = (u8 *)a.allocate(size);
+
+		// Runs, repeated patterns and noise.
+		Random rnd(1);
+		for (u32 i = 0; i < size; ++i) {
+			if (i < size/4)
+				src[i] = u8(i / 100);
+			else if (i < size/2)
+				src[i] = "crown engine "[i % 13];
+			else
+				src[i] = u8(rnd.integer(256));
+		}
+
+		const u32 sizes[] = { 0, 1, 12, 13, 100, size/2, size };
+		for (u32 i = 0; i < countof(sizes); ++i) {
+			const u32 n = lz4::compress(dst, lz4::compress_bound(sizes[i]), src, sizes[i]);
+			ENSURE(n > 0);
+			ENSURE(lz4::decompress(out, sizes[i], dst, n));
+			ENSURE(memcmp(out, src, sizes[i]) == 0);
+		}
+
+		const u32 n = lz4::compress(dst, lz4::compress_bound(size/2), src, size/2);
+		ENSURE(n < size/8);
+		ENSURE(!lz4::decompress(out, size/2 - 1, dst, n));
+		ENSURE(!lz4::decompress(out, size/2, dst, n - 1));
+		ENSURE(lz4::compress(dst, n - 1, src, size/2) == 0);
+
+		a.deallocate(out);
+		a.deallocate(dst);
+		a.deallocate(src);
+	}
+	memory_globals::shutdown();
+}
+
 static void test_string_id()
 {
 	memory_globals::init();
@@ -1510,6 +2177,68 @@ static void test_thread()
 	ENSURE(thread.exit_code() == 0xbadc0d3);
 }
 
+static void test_job_system()
+{
+	memory_globals::init();
+	job_system_globals::init(3);
+	{
+		ENSURE(job_system::num_threads() == 4);
+		ENSURE(job_system::thread_index() == 0);
+	}
+	{
+		u32 values[10000];
+		job_system::parallel_for(countof(values), 64, [](u32 begin, u32 end, void *data) {
+				u32 *out = (u32 *)data;
+				for (u32 ii = begin; ii < end; ++ii)
+					out[ii] = ii * 2;
+			}
+			, values
+			);
+
+		u32 num_wrong = 0;
+		for (u32 ii = 0; ii < countof(values); ++ii)
+			num_wrong += values[ii] != ii * 2;
+		ENSURE(num_wrong == 0);
+	}
+	{
+		std::atomic_int counter(0);
+		Job *root = job_system::create([](void *) {});
+		for (u32 ii = 0; ii < 100; ++ii) {
+			Job *child = job_system::create([](void *data) {
+					((std::atomic_int *)data)->fetch_add(1);
+				}
+				, &counter
+				, root
+				);
+			job_system::run(child);
+		}
+		job_system::run(root);
+		job_system::wait(root);
+		ENSURE(job_system::is_finished(root));
+		ENSURE(counter.load() == 100);
+	}
+	{
+		std::atomic_int counter(0);
+		Job *first = job_system::create([](void *data) {
+				((std::atomic_int *)data)->fetch_add(1);
+			}
+			, &counter
+			);
+		Job *second = job_system::create([](void *data) {
+				std::atomic_int *counter = (std::atomic_int *)data;
+				counter->store(counter->load() * 10);
+			}
+			, &counter
+			);
+		job_system::add_continuation(first, second);
+		job_system::run(first);
+		job_system::wait(second);
+		ENSURE(counter.load() == 10);
+	}
+	job_system_globals::shutdown();
+	memory_globals::shutdown();
+}
+
 static void test_process()
 {
 #if !CROWN_PLATFORM_EMSCRIPTEN && !CROWN_PLATFORM_WINDOWS
@@ -1558,6 +2287,42 @@ static void test_filesystem()
 		DeleteResult dr = os::delete_directory(dir);
 		ENSURE(dr.error == DeleteResult::SUCCESS);
 	}
+	memory_globals::init();
+	{
+		Guid id = guid::new_guid();
+		char name[GUID_BUF_LEN];
+		guid::to_string(name, sizeof(name), id);
+
+		FilesystemDisk fs(default_allocator());
+		fs.set_prefix("/tmp");
+		ENSURE(fs.map(name) == NULL);
+
+		File *file = fs.open(name, FileOpenMode::WRITE);
+		fs.close(*file);
+		ENSURE(fs.map(name) == NULL); // Empty files cannot be mapped.
+
+		file = fs.open(name, FileOpenMode::WRITE);
+		file->write("crown", 5);
+		fs.close(*file);
+
+		FileMemory *mapped = fs.map(name);
+		ENSURE(mapped != NULL);
+		ENSURE(mapped->size() == 5);
+		ENSURE(memcmp(mapped->_memory, "crown", 5) == 0);
+
+		// Changes to the mapping are not written back.
+		*(u8 *)mapped->_memory = 'C';
+		fs.close(*mapped);
+
+		char data[5];
+		file = fs.open(name, FileOpenMode::READ);
+		ENSURE(file->read(data, sizeof(data)) == 5);
+		ENSURE(memcmp(data, "crown", 5) == 0);
+		fs.close(*file);
+
+		fs.delete_file(name);
+	}
+	memory_globals::shutdown();
 	guid_globals::shutdown();
 #endif // if CROWN_PLATFORM_POSIX
 }
@@ -1785,6 +2550,309 @@ static void test_option()
 	memory_globals::shutdown();
 }
 
+static void test_mesh_resource()
+{
+	memory_globals::init();
+	{
+		MeshLod lods[3];
+		lods[0].screen_size = 1.0f;
+		lods[1].screen_size = 0.5f;
+		lods[2].screen_size = 0.25f;
+
+		MeshGeometry mg;
+		mg.num_lods = countof(lods);
+		mg.lods = lods;
+
+		ENSURE(mesh_resource::lod(&mg, 0, 2.0f) == 0);
+		ENSURE(mesh_resource::lod(&mg, 0, 0.4f) == 1);
+		ENSURE(mesh_resource::lod(&mg, 0, 0.1f) == 2);
+		ENSURE(mesh_resource::lod(&mg, 2, 0.8f) == 0);
+		// Hysteresis: sizes close to the threshold keep the current LOD.
+		ENSURE(mesh_resource::lod(&mg, 0, 0.48f) == 0);
+		ENSURE(mesh_resource::lod(&mg, 1, 0.52f) == 1);
+		ENSURE(mesh_resource::lod(&mg, 1, 0.24f) == 1);
+		ENSURE(mesh_resource::lod(&mg, 2, 0.26f) == 2);
+		ENSURE(mesh_resource::lod(&mg, 5, 0.1f) == 2);
+	}
+#if CROWN_CAN_COMPILE
+	{
+		// Flat 10x10 grid in the xy plane.
+		const u32 n = 10;
+		Vector3 positions[(n + 1)*(n + 1)];
+		u16 indices[n*n*6];
+		for (u32 y = 0; y <= n; ++y) {
+			for (u32 x = 0; x <= n; ++x)
+				positions[y*(n + 1) + x] = vector3(f32(x), f32(y), 0.0f);
+		}
+		for (u32 y = 0; y < n; ++y) {
+			for (u32 x = 0; x < n; ++x) {
+				const u16 v = u16(y*(n + 1) + x);
+				u16 *q = &indices[(y*n + x)*6];
+				q[0] = v; q[1] = v + 1;     q[2] = v + n + 2;
+				q[3] = v; q[4] = v + n + 2; q[5] = v + n + 1;
+			}
+		}
+
+		u16 out[countof(indices)];
+		u32 tris[countof(indices)/3];
+		const u32 num = mesh_resource_internal::simplify(out
+			, tris
+			, indices
+			, countof(indices)
+			, positions
+			, countof(positions)
+			, countof(indices)/4
+			);
+		ENSURE(num > 0);
+		ENSURE(num <= countof(indices)/4);
+		ENSURE(num % 3 == 0);
+
+		// The grid keeps its area and orientation.
+		f32 area = 0.0f;
+		for (u32 i = 0; i < num; i += 3) {
+			const Vector3 c = cross(positions[out[i + 1]] - positions[out[i]], positions[out[i + 2]] - positions[out[i]]);
+			ENSURE(c.z > 0.0f);
+			ENSURE(tris[i/3] < countof(indices)/3);
+			area += c.z * 0.5f;
+		}
+		ENSURE(fequal(area, f32(n*n), 0.001f));
+	}
+#endif // if CROWN_CAN_COMPILE
+	memory_globals::shutdown();
+}
+
+static void test_tilemap_resource()
+{
+	memory_globals::init();
+	{
+		// 20x10 tiles, 2 layers, 16x16 chunks: 2x1 chunks.
+		TilemapResource tr;
+		tr.width = 20;
+		tr.height = 10;
+		tr.num_layers = 2;
+		tr.chunk_size = 16;
+		tr.num_chunks_x = 2;
+		tr.num_chunks_y = 1;
+
+		const u32 nct = 2*16*16;
+		ENSURE(tilemap_resource::num_chunks(&tr) == 2);
+		ENSURE(tilemap_resource::num_chunk_tiles(&tr) == nct);
+		ENSURE(tilemap_resource::tile_offset(&tr, 0, 0, 0) == 0);
+		ENSURE(tilemap_resource::tile_offset(&tr, 0, 15, 0) == 15);
+		ENSURE(tilemap_resource::tile_offset(&tr, 0, 0, 1) == 16);
+		ENSURE(tilemap_resource::tile_offset(&tr, 1, 0, 0) == 16*16);
+		ENSURE(tilemap_resource::tile_offset(&tr, 0, 16, 0) == nct);
+		ENSURE(tilemap_resource::tile_offset(&tr, 1, 19, 9) == nct + 16*16 + 9*16 + 3);
+	}
+	memory_globals::shutdown();
+}
+
+static void test_font_resource()
+{
+	memory_globals::init();
+	{
+		struct
+		{
+			FontResource fr;
+			CodePoint codes[5];
+			GlyphData glyphs[5];
+		} font;
+		memset(&font, 0, sizeof(font));
+		font.fr.num_glyphs = 5;
+
+		const CodePoint codes[] = { 32, 65, 97, 0xe8, 0x20ac };
+		for (u32 i = 0; i < countof(codes); ++i) {
+			font.codes[i] = codes[i];
+			font.glyphs[i].x = f32(i);
+		}
+
+		const GlyphData deffault = {};
+		for (u32 i = 0; i < countof(codes); ++i)
+			ENSURE(font_resource::glyph(&font.fr, codes[i], &deffault) == &font.glyphs[i]);
+		ENSURE(font_resource::glyph(&font.fr, 0, &deffault) == &deffault);
+		ENSURE(font_resource::glyph(&font.fr, 66, &deffault) == &deffault);
+		ENSURE(font_resource::glyph(&font.fr, 0x10000, &deffault) == &deffault);
+	}
+	memory_globals::shutdown();
+}
+
+static void test_gui()
+{
+	memory_globals::init();
+	Allocator &a = default_allocator();
+	{
+		struct
+		{
+			FontResource fr;
+			CodePoint codes[3];
+			GlyphData glyphs[3];
+		} font;
+		memset(&font, 0, sizeof(font));
+		font.fr.texture_size = 256;
+		font.fr.font_size = 16;
+		font.fr.num_glyphs = 3;
+
+		const CodePoint codes[] = { 65, 0xe8, 0x20ac };
+		for (u32 i = 0; i < countof(codes); ++i) {
+			font.codes[i] = codes[i];
+			font.glyphs[i].x = f32(i + 1) * 16.0f;
+			font.glyphs[i].width = 8.0f;
+			font.glyphs[i].height = 8.0f;
+			font.glyphs[i].x_advance = 8.0f;
+		}
+
+		FilesystemDisk fs(a);
+		ResourceLoader rl(fs, false);
+		ResourceManager rm(rl);
+		ShaderManager sm(a);
+		MaterialManager mm(a);
+		GuiBuffer gb(a, rm, sm, mm);
+		const StringId64 font_name("font");
+		hash_map::set(gb._fonts, font_name, (const FontResource *)&font.fr);
+
+		// Multi-byte sequences decode to a single code point.
+		const GuiBuffer::TextLayout tl = gb.layout("A\xc3\xa8\xe2\x82\xac", font_name, 16);
+		ENSURE(tl.num == 3);
+		for (u32 i = 0; i < tl.num; ++i)
+			ENSURE(fequal(gb._glyphs[tl.first + i].uv0.x, font.glyphs[i].x / 256.0f));
+
+		// Invalid bytes are skipped.
+		const GuiBuffer::TextLayout inv = gb.layout("A\xff\xc3\xa8\x80\xe2\x82\xac", font_name, 16);
+		ENSURE(inv.num == 3);
+		for (u32 i = 0; i < inv.num; ++i)
+			ENSURE(fequal(gb._glyphs[inv.first + i].uv0.x, font.glyphs[i].x / 256.0f));
+
+		// Same text, same layout.
+		const u32 num_glyphs = array::size(gb._glyphs);
+		ENSURE(gb.layout("A\xc3\xa8\xe2\x82\xac", font_name, 16).first == tl.first);
+		ENSURE(array::size(gb._glyphs) == num_glyphs);
+
+		// A layout cached under the same key but for another text is not reused.
+		const char *euro = "\xe2\x82\xac";
+		const u64 key = murmur64(euro, strlen32(euro), font_name._id ^ 16);
+		hash_map::set(gb._layouts, key, tl);
+		const GuiBuffer::TextLayout eu = gb.layout(euro, font_name, 16);
+		ENSURE(eu.num == 1);
+		ENSURE(eu.first != tl.first);
+		ENSURE(fequal(gb._glyphs[eu.first].uv0.x, font.glyphs[2].x / 256.0f));
+	}
+	memory_globals::shutdown();
+}
+
+static void test_package_resource()
+{
+	memory_globals::init();
+	{
+		struct
+		{
+			PackageResource pr;
+			ResourceOffset offsets[4];
+		} pkg = {};
+		pkg.pr.num_resources = 4;
+
+		// Sorted by type, then name.
+		const u64 ids[][2] = { { 1, 10 }, { 1, 20 }, { 2, 5 }, { 3, 10 } };
+		for (u32 i = 0; i < countof(ids); ++i) {
+			pkg.offsets[i].type = StringId64(ids[i][0]);
+			pkg.offsets[i].name = StringId64(ids[i][1]);
+		}
+
+		for (u32 i = 0; i < countof(ids); ++i)
+			ENSURE(package_resource::find(&pkg.pr, StringId64(ids[i][0]), StringId64(ids[i][1])) == &pkg.offsets[i]);
+		ENSURE(package_resource::find(&pkg.pr, StringId64(u64(1)), StringId64(u64(5))) == NULL);
+		ENSURE(package_resource::find(&pkg.pr, StringId64(u64(2)), StringId64(u64(10))) == NULL);
+		ENSURE(package_resource::find(&pkg.pr, StringId64(u64(4)), StringId64(u64(10))) == NULL);
+	}
+#if CROWN_CAN_COMPILE
+	{
+		// Compressible, incompressible and partial block.
+		const u32 size = 2*PACKAGE_RESOURCE_BLOCK_SIZE + 1000;
+		Array<u8> src(default_allocator());
+		array::resize(src, size);
+		Random rnd(7);
+		for (u32 i = 0; i < size; ++i)
+			src[i] = (i / PACKAGE_RESOURCE_BLOCK_SIZE) == 1 ? u8(rnd.integer()) : u8(i % 13);
+
+		Buffer packed(default_allocator());
+		const u32 packed_size = package_resource_internal::compress(packed, array::begin(src), size);
+		ENSURE(packed_size == array::size(packed));
+		ENSURE(packed_size > 0 && packed_size < size);
+
+		const u32 header_size = u32(sizeof(PackageResource) + sizeof(ResourceOffset) + 15) & ~15u;
+		u8 *mem = (u8 *)default_allocator().allocate(header_size + packed_size, 16);
+		PackageResource *pr = (PackageResource *)mem;
+		ResourceOffset *ro = (ResourceOffset *)(pr + 1);
+		pr->num_resources = 1;
+		ro->offset = 0;
+		ro->size = size;
+		ro->packed_size = packed_size;
+		memcpy(mem + header_size, array::begin(packed), packed_size);
+		ENSURE(package_resource::data(pr) == mem + header_size);
+		ENSURE(package_resource::num_blocks(ro) == 3);
+
+		Array<u8> dst(default_allocator());
+		array::resize(dst, size);
+		for (u32 bb = 0; bb < package_resource::num_blocks(ro); ++bb)
+			ENSURE(package_resource::decompress_block(array::begin(dst), pr, ro, bb));
+		ENSURE(memcmp(array::begin(dst), array::begin(src), size) == 0);
+
+		// Block ends past the resource data are rejected.
+		((u32 *)(mem + header_size))[2] = packed_size;
+		ENSURE(!package_resource::decompress_block(array::begin(dst), pr, ro, 2));
+
+		default_allocator().deallocate(mem);
+	}
+#endif // if CROWN_CAN_COMPILE
+	memory_globals::shutdown();
+}
+
+static void test_particle_emitter()
+{
+	memory_globals::init();
+	{
+		ParticleSystemResource psr;
+		memset(&psr, 0, sizeof(psr));
+		psr.max_particles = 6;
+		psr.spawn_rate = 10.0f;
+		psr.lifetime_min = 1.0f;
+		psr.lifetime_max = 1.0f;
+		psr.velocity_min = vector3(1.0f, 0.0f, 0.0f);
+		psr.velocity_max = vector3(1.0f, 0.0f, 0.0f);
+		psr.size_start = 2.0f;
+		psr.size_end = 2.0f;
+		psr.color_start = COLOR4_WHITE;
+		psr.color_end = COLOR4_WHITE;
+
+		ParticleEmitter pe(default_allocator(), psr.max_particles, 0);
+		ENSURE(pe._capacity == 8);
+
+		// 10 particles spawned, 4 of them over budget.
+		pe.update(psr, MATRIX4X4_IDENTITY, 1.0f);
+		ENSURE(pe._num == 6);
+		ENSURE(pe._num_dropped == 4);
+		ENSURE(fequal(pe._aabb.min.x, -1.0f));
+		ENSURE(fequal(pe._aabb.max.x, 1.0f));
+
+		// Particles move along x and expire after their lifetime.
+		psr.spawn_rate = 0.0f;
+		pe.update(psr, MATRIX4X4_IDENTITY, 0.5f);
+		ENSURE(pe._num == 6);
+		ENSURE(pe._num_dropped == 0);
+		ENSURE(fequal(pe._px[5], 0.5f));
+		ENSURE(fequal(pe._aabb.max.x, 1.5f));
+
+		f32 data[6*8];
+		pe.fill_instance_data(data, pe._num, psr);
+		ENSURE(fequal(data[5*8 + 0], 0.5f));
+		ENSURE(fequal(data[5*8 + 3], 2.0f));
+		ENSURE(fequal(data[5*8 + 7], 1.0f));
+
+		pe.update(psr, MATRIX4X4_IDENTITY, 0.5f);
+		ENSURE(pe._num == 0);
+	}
+	memory_globals::shutdown();
+}
+
 static void test_lua_resource()
 {
 #if CROWN_CAN_COMPILE
@@ -1948,6 +3016,7 @@ int main_unit_tests()
 	RUN_TEST(test_vector);
 	RUN_TEST(test_hash_map);
 	RUN_TEST(test_hash_set);
+	RUN_TEST(test_unit_map);
 	RUN_TEST(test_vector2);
 	RUN_TEST(test_vector3);
 	RUN_TEST(test_vector4);
@@ -1957,7 +3026,14 @@ int main_unit_tests()
 	RUN_TEST(test_matrix4x4);
 	RUN_TEST(test_aabb);
 	RUN_TEST(test_sphere);
+	RUN_TEST(test_intersection);
+	RUN_TEST(test_bvh);
+	RUN_TEST(test_aabb_tree);
+	RUN_TEST(test_occlusion_buffer);
+	RUN_TEST(test_render_world);
+	RUN_TEST(test_scene_graph);
 	RUN_TEST(test_murmur);
+	RUN_TEST(test_lz4);
 	RUN_TEST(test_string_id);
 	RUN_TEST(test_dynamic_string);
 	RUN_TEST(test_string_view);
@@ -1967,10 +3043,17 @@ int main_unit_tests()
 	RUN_TEST(test_path);
 	RUN_TEST(test_command_line);
 	RUN_TEST(test_thread);
+	RUN_TEST(test_job_system);
 	RUN_TEST(test_process);
 	RUN_TEST(test_filesystem);
 	RUN_TEST(test_file_monitor);
 	RUN_TEST(test_option);
+	RUN_TEST(test_mesh_resource);
+	RUN_TEST(test_tilemap_resource);
+	RUN_TEST(test_font_resource);
+	RUN_TEST(test_gui);
+	RUN_TEST(test_package_resource);
+	RUN_TEST(test_particle_emitter);
 	RUN_TEST(test_lua_resource);
 
 	return EXIT_SUCCESS;
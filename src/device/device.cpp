@@ -26,6 +26,7 @@
 #include "core/strings/string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/string_stream.inl"
+#include "core/thread/job_system.h"
 #include "core/time.h"
 #include "core/types.h"
 #include "device/console_server.h"
@@ -57,6 +58,7 @@
 #include "world/audio.h"
 #include "world/material_manager.h"
 #include "world/physics.h"
+#include "world/render_world.h"
 #include "world/shader_manager.h"
 #include "world/unit_manager.h"
 #include "world/world.h"
@@ -196,6 +198,20 @@ struct BgfxAllocator : public bx::AllocatorI
 	}
 };
 
+// Materials cache texture and shader handles: look them up again when
+// textures or shaders go offline.
+static void device_texture_offline(StringId64 id, ResourceManager &rm)
+{
+	texture_resource_internal::offline(id, rm);
+	device()->_material_manager->invalidate_bindings();
+}
+
+static void device_shader_offline(StringId64 id, ResourceManager &rm)
+{
+	shader_resource_internal::offline(id, rm);
+	device()->_material_manager->invalidate_bindings();
+}
+
 static void device_command_pause(ConsoleServer & /*cs*/, u32 /*client_id*/, const JsonArray & /*args*/, void * /*user_data*/)
 {
 	device()->pause();
@@ -206,6 +222,22 @@ static void device_command_unpause(ConsoleServer & /*cs*/, u32 /*client_id*/, co
 	device()->unpause();
 }
 
+static void device_command_loader_stats(ConsoleServer & /*cs*/, u32 /*client_id*/, const JsonArray & /*args*/, void *user_data)
+{
+	const ResourceLoader *rl = ((Device *)user_data)->_resource_loader;
+	const u64 unpacked_size = rl->_unpacked_size;
+	const u64 packed_size = rl->_packed_size;
+	const f64 unpack_time = time::seconds(rl->_unpack_time);
+
+	logi(DEVICE, "Decompressed %.2f MiB from %.2f MiB (ratio %.2f) in " TIME_FMT " (%.2f MiB/s)"
+		, f64(unpacked_size) / (1024.0*1024.0)
+		, f64(packed_size) / (1024.0*1024.0)
+		, packed_size ? f64(unpacked_size) / f64(packed_size) : 1.0
+		, unpack_time
+		, unpack_time > 0.0 ? f64(unpacked_size) / (1024.0*1024.0) / unpack_time : 0.0
+		);
+}
+
 static void device_message_resize(ConsoleServer & /*cs*/, u32 /*client_id*/, const char *json, void * /*user_data*/)
 {
 	TempAllocator256 ta;
@@ -259,6 +291,7 @@ Device::Device(const DeviceOptions &opts, ConsoleServer &cs)
 	, _height(CROWN_DEFAULT_WINDOW_HEIGHT)
 	, _quit(false)
 	, _paused(false)
+	, _srgb_backbuffer(false)
 	, _needs_draw(1)
 {
 	list::init_head(_worlds);
@@ -305,6 +338,24 @@ bool Device::process_events()
 
 	return exit;
 }
+
+bool Device::post_process() const
+{
+	return _options._parent_window != 0 || !_srgb_backbuffer;
+}
+
+u32 Device::reset_flags() const
+{
+	u32 flags = _boot_config.vsync ? BGFX_RESET_VSYNC : BGFX_RESET_NONE;
+
+	// Without post-processing nothing converts the linear output to gamma
+	// space: let the backbuffer do it.
+	if (!post_process())
+		flags |= BGFX_RESET_SRGB_BACKBUFFER;
+
+	return flags;
+}
+
 bool Device::frame()
 {
 	if (CE_UNLIKELY(process_events() || _quit))
@@ -319,7 +370,7 @@ bool Device::frame()
 	if (CE_UNLIKELY(_width != _prev_width || _height != _prev_height)) {
 		_prev_width = _width;
 		_prev_height = _height;
-		bgfx::reset(_width, _height, (_boot_config.vsync ? BGFX_RESET_VSYNC : BGFX_RESET_NONE));
+		bgfx::reset(_width, _height, reset_flags());
 		_pipeline->reset(_width, _height);
 
 		// Force pipeline reset in one cycle.
@@ -395,6 +446,7 @@ void Device::run()
 
 	_console_server->register_command_name("pause",   "Pause the engine",  device_command_pause,   this);
 	_console_server->register_command_name("unpause", "Resume the engine", device_command_unpause, this);
+	_console_server->register_command_name("loader_stats", "Print resource decompression statistics", device_command_loader_stats, this);
 
 	_console_server->register_message_type("resize",  device_message_resize,  this);
 	_console_server->register_message_type("frame",   device_message_frame,   this);
@@ -435,6 +487,12 @@ void Device::run()
 	logi(DEVICE, "Crown %s %s %s", CROWN_VERSION, CROWN_PLATFORM_NAME, CROWN_ARCH_NAME);
 
 	profiler_globals::init();
+#if CROWN_PLATFORM_EMSCRIPTEN
+	job_system_globals::init(0);
+#else
+	job_system_globals::init();
+#endif
+	logi(DEVICE, "Job system running with %u threads", job_system::num_threads());
 
 	_shader_manager   = CE_NEW(_allocator, ShaderManager)(default_allocator());
 	_material_manager = CE_NEW(_allocator, MaterialManager)(default_allocator());
@@ -467,14 +525,16 @@ void Device::run()
 	_resource_manager->register_type(RESOURCE_TYPE_MATERIAL,         RESOURCE_VERSION_MATERIAL,         NULL,      NULL,        mtr::online, mtr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_MESH,             RESOURCE_VERSION_MESH,             mhr::load, mhr::unload, mhr::online, mhr::offline);
 	_resource_manager->register_type(RESOURCE_TYPE_PACKAGE,          RESOURCE_VERSION_PACKAGE,          NULL,      NULL,        NULL,        NULL);
+	_resource_manager->register_type(RESOURCE_TYPE_PARTICLE_SYSTEM,  RESOURCE_VERSION_PARTICLE_SYSTEM,  NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_PHYSICS_CONFIG,   RESOURCE_VERSION_PHYSICS_CONFIG,   NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_SCRIPT,           RESOURCE_VERSION_SCRIPT,           NULL,      NULL,        NULL,        NULL);
-	_resource_manager->register_type(RESOURCE_TYPE_SHADER,           RESOURCE_VERSION_SHADER,           shr::load, shr::unload, shr::online, shr::offline);
+	_resource_manager->register_type(RESOURCE_TYPE_SHADER,           RESOURCE_VERSION_SHADER,           shr::load, shr::unload, shr::online, device_shader_offline);
 	_resource_manager->register_type(RESOURCE_TYPE_SOUND,            RESOURCE_VERSION_SOUND,            NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE,           RESOURCE_VERSION_SPRITE,           NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_SPRITE_ANIMATION, RESOURCE_VERSION_SPRITE_ANIMATION, NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_STATE_MACHINE,    RESOURCE_VERSION_STATE_MACHINE,    NULL,      NULL,        NULL,        NULL);
-	_resource_manager->register_type(RESOURCE_TYPE_TEXTURE,          RESOURCE_VERSION_TEXTURE,          txr::load, txr::unload, txr::online, txr::offline);
+	_resource_manager->register_type(RESOURCE_TYPE_TEXTURE,          RESOURCE_VERSION_TEXTURE,          txr::load, txr::unload, txr::online, device_texture_offline);
+	_resource_manager->register_type(RESOURCE_TYPE_TILEMAP,          RESOURCE_VERSION_TILEMAP,          NULL,      NULL,        NULL,        NULL);
 	_resource_manager->register_type(RESOURCE_TYPE_UNIT,             RESOURCE_VERSION_UNIT,             NULL,      NULL,        NULL,        NULL);
 
 	// Read config
@@ -538,12 +598,13 @@ void Device::run()
 	bgfx::Init init;
 	init.resolution.width  = _width;
 	init.resolution.height = _height;
-	init.resolution.reset  = _boot_config.vsync ? BGFX_RESET_VSYNC : BGFX_RESET_NONE;
+	init.resolution.reset  = reset_flags();
 	init.callback  = _bgfx_callback;
 	init.allocator = _bgfx_allocator;
 	init.platformData.ndt = _window->native_display();
 	init.platformData.nwh = _window->native_handle();
 	init.vendorId = BGFX_PCI_ID_NONE;
+	init.limits.maxEncoders = u16(job_system::num_threads()); // One per thread submitting draw calls.
 #if CROWN_PLATFORM_ANDROID || CROWN_PLATFORM_EMSCRIPTEN
 	init.type = bgfx::RendererType::OpenGLES;
 #elif CROWN_PLATFORM_LINUX
@@ -555,6 +616,13 @@ void Device::run()
 #endif
 	bgfx::init(init);
 
+	// The sRGB backbuffer can only be requested once the renderer's caps are
+	// known; fall back to gamma correction in the post-processing otherwise.
+	_srgb_backbuffer = _options._parent_window == 0
+		&& (bgfx::getCaps()->formats[init.resolution.format] & BGFX_CAPS_FORMAT_TEXTURE_2D_SRGB) != 0;
+	if (_srgb_backbuffer)
+		bgfx::reset(_width, _height, reset_flags());
+
 	_input_manager    = CE_NEW(_allocator, InputManager)(default_allocator());
 	_unit_manager     = CE_NEW(_allocator, UnitManager)(default_allocator());
 	_py_wrapper       = CE_NEW(_allocator, PyWrapper)();
@@ -574,7 +642,7 @@ void Device::run()
 
 	auto cc = _boot_config.boot_script_name.c_str();
 	_pipeline = CE_NEW(_allocator, Pipeline)();
-	_pipeline->create(_width, _height);
+	_pipeline->create(_width, _height, post_process());
 
 	graph_globals::init(_allocator, *_shader_manager, *_console_server);
 
@@ -621,6 +689,7 @@ void Device::run()
 
 	CE_DELETE(_allocator, _data_filesystem);
 
+	job_system_globals::shutdown();
 	profiler_globals::shutdown();
 
 	_allocator.clear();
@@ -692,6 +761,7 @@ void Device::render(World &world, UnitId camera_unit)
 	bgfx::setViewTransform(VIEW_SPRITE_6, to_float_ptr(view), to_float_ptr(proj));
 	bgfx::setViewTransform(VIEW_SPRITE_7, to_float_ptr(view), to_float_ptr(proj));
 	bgfx::setViewTransform(VIEW_MESH, to_float_ptr(view), to_float_ptr(proj));
+	bgfx::setViewTransform(VIEW_PARTICLE, to_float_ptr(view), to_float_ptr(proj));
 	bgfx::setViewTransform(VIEW_DEBUG, to_float_ptr(view), to_float_ptr(proj));
 	bgfx::setViewTransform(VIEW_GUI, to_float_ptr(MATRIX4X4_IDENTITY), to_float_ptr(ortho_proj));
 	bgfx::setViewTransform(VIEW_SELECTION, to_float_ptr(view), to_float_ptr(proj));
@@ -718,6 +788,7 @@ void Device::render(World &world, UnitId camera_unit)
 	bgfx::setViewRect(VIEW_SPRITE_6, 0, 0, _width, _height);
 	bgfx::setViewRect(VIEW_SPRITE_7, 0, 0, _width, _height);
 	bgfx::setViewRect(VIEW_MESH, 0, 0, _width, _height);
+	bgfx::setViewRect(VIEW_PARTICLE, 0, 0, _width, _height);
 	bgfx::setViewRect(VIEW_DEBUG, 0, 0, _width, _height);
 	bgfx::setViewRect(VIEW_GUI, 0, 0, _width, _height);
 	bgfx::setViewRect(VIEW_SELECTION, 0, 0, _width, _height);
@@ -731,6 +802,8 @@ void Device::render(World &world, UnitId camera_unit)
 	bgfx::setViewMode(VIEW_SPRITE_5, bgfx::ViewMode::DepthAscending);
 	bgfx::setViewMode(VIEW_SPRITE_6, bgfx::ViewMode::DepthAscending);
 	bgfx::setViewMode(VIEW_SPRITE_7, bgfx::ViewMode::DepthAscending);
+	bgfx::setViewMode(VIEW_MESH, bgfx::ViewMode::DepthAscending); // See RenderWorld::MeshManager::draw().
+	bgfx::setViewMode(VIEW_PARTICLE, bgfx::ViewMode::DepthDescending); // See RenderWorld::ParticleManager::draw().
 	bgfx::setViewMode(VIEW_GUI, bgfx::ViewMode::Sequential);
 	bgfx::setViewMode(VIEW_BLIT, bgfx::ViewMode::Sequential);
 
@@ -743,6 +816,7 @@ void Device::render(World &world, UnitId camera_unit)
 	bgfx::setViewFrameBuffer(VIEW_SPRITE_6, _pipeline->_main_frame_buffer);
 	bgfx::setViewFrameBuffer(VIEW_SPRITE_7, _pipeline->_main_frame_buffer);
 	bgfx::setViewFrameBuffer(VIEW_MESH, _pipeline->_main_frame_buffer);
+	bgfx::setViewFrameBuffer(VIEW_PARTICLE, _pipeline->_main_frame_buffer);
 	bgfx::setViewFrameBuffer(VIEW_DEBUG, _pipeline->_main_frame_buffer);
 	bgfx::setViewFrameBuffer(VIEW_GUI, _pipeline->_main_frame_buffer);
 	bgfx::setViewFrameBuffer(VIEW_SELECTION, _pipeline->_selection_frame_buffer);
@@ -758,13 +832,17 @@ void Device::render(World &world, UnitId camera_unit)
 	bgfx::touch(VIEW_SPRITE_6);
 	bgfx::touch(VIEW_SPRITE_7);
 	bgfx::touch(VIEW_MESH);
+	bgfx::touch(VIEW_PARTICLE);
 	bgfx::touch(VIEW_DEBUG);
 	bgfx::touch(VIEW_GUI);
-	bgfx::touch(VIEW_SELECTION);
+	if (world._render_world->has_selection()) {
+		bgfx::touch(VIEW_SELECTION);
+		_pipeline->_outline = true;
+	}
 	bgfx::touch(VIEW_GRAPH);
 	bgfx::touch(VIEW_BLIT);
 
-	world.render(view);
+	world.render(view, proj);
 }
 
 World *Device::create_world()
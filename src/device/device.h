@@ -67,6 +67,7 @@ struct Device
 
 	bool _quit;
 	bool _paused;
+	bool _srgb_backbuffer; ///< Whether the backbuffer converts the linear output to gamma space.
 	std::atomic_int _needs_draw;
 
 	///
@@ -84,6 +85,15 @@ struct Device
 	/// Simulate one frame.
 	bool frame();
 
+	/// Returns whether the frame is post-processed before being presented.
+	/// The editor needs it to draw the outline of the selected units, and so
+	/// do renderers without an sRGB backbuffer, to apply gamma correction;
+	/// otherwise views render straight to the backbuffer.
+	bool post_process() const;
+
+	/// Returns the flags to pass to bgfx::reset().
+	u32 reset_flags() const;
+
 	/// Runs the engine.
 	void run();
 
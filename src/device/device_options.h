@@ -31,6 +31,7 @@ struct DeviceOptions
 	Option<bool> _do_compile;
 	Option<bool> _do_continue;
 	Option<bool> _do_bundle;
+	Option<bool> _bundle_compression;
 	Option<bool> _server;
 	Option<bool> _pumped;
 	Option<bool> _hidden;
@@ -530,7 +530,7 @@ namespace graph_globals
 	void init(Allocator &a, ShaderManager &sm, ConsoleServer &cs)
 	{
 		_allocator = &a;
-		_lines = CE_NEW(a, DebugLine)(sm, false);
+		_lines = CE_NEW(a, DebugLine)(a, sm, false);
 
 		cs.register_command_name("graph", "Plot selected profiler data", graph_internal::handle_command, NULL);
 	}
@@ -6,6 +6,7 @@
 #include "config.h"
 
 #if CROWN_PLATFORM_EMSCRIPTEN
+#include "core/benchmarks.h"
 #include "core/command_line.h"
 #include "core/containers/array.inl"
 #include "core/guid.h"
@@ -480,12 +481,19 @@ int main(int argc, char **argv)
 {
 	using namespace crown;
 
-#if CROWN_BUILD_UNIT_TESTS
+#if CROWN_BUILD_UNIT_TESTS || CROWN_BUILD_BENCHMARKS
 	CommandLine cl(argc, (const char **)argv);
+#endif
+#if CROWN_BUILD_UNIT_TESTS
 	if (cl.has_option("run-unit-tests")) {
 		return main_unit_tests();
 	}
 #endif
+#if CROWN_BUILD_BENCHMARKS
+	if (cl.has_option("run-benchmarks")) {
+		return main_benchmarks();
+	}
+#endif
 
 	InitGlobals m;
 	CE_UNUSED(m);
@@ -105,11 +105,14 @@ Pipeline::Pipeline()
 	, _selection_texture_sampler(BGFX_INVALID_HANDLE)
 	, _selection_depth_texture_sampler(BGFX_INVALID_HANDLE)
 	, _outline_color_uniform(BGFX_INVALID_HANDLE)
+	, _post_process(true)
+	, _outline(false)
 {
 }
 
-void Pipeline::create(uint16_t width, uint16_t height)
+void Pipeline::create(uint16_t width, uint16_t height, bool post_process)
 {
+	_post_process = post_process;
 	reset(width, height);
 
 	_main_color_texture_sampler = bgfx::createUniform("s_color", bgfx::UniformType::Sampler);
@@ -137,40 +140,44 @@ void Pipeline::destroy()
 	bgfx::destroy(_selection_depth_texture);
 	bgfx::destroy(_selection_texture);
 
-	bgfx::destroy(_main_frame_buffer);
-	bgfx::destroy(_main_depth_texture);
-	bgfx::destroy(_main_color_texture);
+	if (bgfx::isValid(_main_frame_buffer)) {
+		bgfx::destroy(_main_frame_buffer);
+		bgfx::destroy(_main_depth_texture);
+		bgfx::destroy(_main_color_texture);
+	}
 }
 
 void Pipeline::reset(u16 width, u16 height)
 {
-	// Create main frame buffer.
-	if (bgfx::isValid(_main_color_texture))
-		bgfx::destroy(_main_color_texture);
-	_main_color_texture = bgfx::createTexture2D(width
-		, height
-		, false
-		, 1
-		, bgfx::TextureFormat::BGRA8
-		, BGFX_TEXTURE_RT
-		);
-	if (bgfx::isValid(_main_depth_texture))
-		bgfx::destroy(_main_depth_texture);
-	_main_depth_texture = bgfx::createTexture2D(width
-		, height
-		, false
-		, 1
-		, bgfx::TextureFormat::D24S8
-		, BGFX_TEXTURE_RT
-		);
-	const bgfx::TextureHandle _main_frame_buffer_attachments[] =
-	{
-		_main_color_texture,
-		_main_depth_texture
-	};
-	if (bgfx::isValid(_main_frame_buffer))
-		bgfx::destroy(_main_frame_buffer);
-	_main_frame_buffer = bgfx::createFrameBuffer(countof(_main_frame_buffer_attachments), _main_frame_buffer_attachments);
+	if (_post_process) {
+		// Create main frame buffer.
+		if (bgfx::isValid(_main_color_texture))
+			bgfx::destroy(_main_color_texture);
+		_main_color_texture = bgfx::createTexture2D(width
+			, height
+			, false
+			, 1
+			, bgfx::TextureFormat::BGRA8
+			, BGFX_TEXTURE_RT
+			);
+		if (bgfx::isValid(_main_depth_texture))
+			bgfx::destroy(_main_depth_texture);
+		_main_depth_texture = bgfx::createTexture2D(width
+			, height
+			, false
+			, 1
+			, bgfx::TextureFormat::D24S8
+			, BGFX_TEXTURE_RT
+			);
+		const bgfx::TextureHandle _main_frame_buffer_attachments[] =
+		{
+			_main_color_texture,
+			_main_depth_texture
+		};
+		if (bgfx::isValid(_main_frame_buffer))
+			bgfx::destroy(_main_frame_buffer);
+		_main_frame_buffer = bgfx::createFrameBuffer(countof(_main_frame_buffer_attachments), _main_frame_buffer_attachments);
+	}
 
 	// Create outline frame buffer.
 	if (bgfx::isValid(_selection_texture))
@@ -203,6 +210,12 @@ void Pipeline::reset(u16 width, u16 height)
 
 void Pipeline::render(ShaderManager &sm, StringId32 program, u8 view, u16 width, u16 height)
 {
+	const bool outline = _outline;
+	_outline = false;
+
+	if (!_post_process)
+		return;
+
 	const bgfx::Caps *caps = bgfx::getCaps();
 
 	f32 ortho[16];
@@ -224,6 +237,9 @@ void Pipeline::render(ShaderManager &sm, StringId32 program, u8 view, u16 width,
 	sm.submit(program, view, 0, UINT64_MAX);
 
 #if !CROWN_PLATFORM_EMSCRIPTEN
+	if (!outline)
+		return;
+
 	bgfx::setTexture(0, _selection_texture_sampler, _selection_texture, samplerFlags);
 	bgfx::setTexture(1, _selection_depth_texture_sampler, _selection_depth_texture, samplerFlags);
 	bgfx::setTexture(2, _main_depth_texture_sampler, _main_depth_texture, samplerFlags);
@@ -231,6 +247,8 @@ void Pipeline::render(ShaderManager &sm, StringId32 program, u8 view, u16 width,
 	const f32 outline_color[] = { 1.0f, 0.37f, 0.05f, 1.0f };
 	bgfx::setUniform(_outline_color_uniform, outline_color);
 	sm.submit(STRING_ID_32("outline", UINT32_C(0xb6b58d80)), view, 0, UINT64_MAX);
+#else
+	CE_UNUSED(outline);
 #endif
 }
 
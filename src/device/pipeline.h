@@ -17,6 +17,7 @@
 #define VIEW_SPRITE_6    7
 #define VIEW_SPRITE_7    8
 #define VIEW_MESH       16
+#define VIEW_PARTICLE   17
 #define VIEW_SELECTION  32
 #define VIEW_DEBUG     100
 #define VIEW_GUI       128
@@ -46,11 +47,19 @@ struct Pipeline
 	bgfx::UniformHandle _selection_depth_texture_sampler;
 	bgfx::UniformHandle _outline_color_uniform;
 
+	/// Whether views render to the main frame buffer, which render() then
+	/// blits to the backbuffer. Otherwise the main frame buffer is not
+	/// created and views render straight to the sRGB backbuffer.
+	bool _post_process;
+
+	/// Whether render() draws the outline of the selected units this frame.
+	bool _outline;
+
 	///
 	Pipeline();
 
-	///
-	void create(u16 width, u16 height);
+	/// Creates the frame buffers. See _post_process.
+	void create(u16 width, u16 height, bool post_process);
 
 	///
 	void destroy();
@@ -58,7 +67,8 @@ struct Pipeline
 	///
 	void reset(u16 width, u16 height);
 
-	///
+	/// Blits the main frame buffer to the backbuffer and draws the outline of
+	/// the selected units, if any. Does nothing if _post_process is false.
 	void render(ShaderManager &sm, StringId32 program, u8 view, u16 width, u16 height);
 };
 
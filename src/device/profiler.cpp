@@ -10,6 +10,7 @@
 #include "core/time.h"
 #include "device/profiler.h"
 #include <new>
+#include <string.h> // strncpy
 
 namespace crown
 {
@@ -100,7 +101,8 @@ namespace profiler
 	void record_vector3(const char *name, const Vector3 &value)
 	{
 		RecordVector3 ev;
-		ev.name = name;
+		strncpy(ev.name, name, sizeof(ev.name) - 1);
+		ev.name[sizeof(ev.name) - 1] = '\0';
 		ev.value = value;
 
 		push(ProfilerEventType::RECORD_VECTOR3, ev);
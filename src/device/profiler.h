@@ -36,7 +36,7 @@ struct RecordFloat
 
 struct RecordVector3
 {
-	const char *name;
+	char name[32]; ///< Copied: it may point to resource memory.
 	Vector3 value;
 };
 
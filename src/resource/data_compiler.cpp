@@ -37,6 +37,7 @@
 #include "resource/material_resource.h"
 #include "resource/mesh_resource.h"
 #include "resource/package_resource.h"
+#include "resource/particle_system_resource.h"
 #include "resource/physics_resource.h"
 #include "resource/resource_id.inl"
 #include "resource/shader_resource.h"
@@ -44,6 +45,7 @@
 #include "resource/sprite_resource.h"
 #include "resource/state_machine_resource.h"
 #include "resource/texture_resource.h"
+#include "resource/tilemap_resource.h"
 #include "resource/types.h"
 #include "resource/unit_resource.h"
 #include <algorithm>
@@ -242,6 +244,29 @@ static void console_command_compile(ConsoleServer &cs, u32 client_id, const char
 	cs.send(client_id, string_stream::c_str(ss));
 }
 
+static void console_command_compress(ConsoleServer &cs, u32 client_id, const JsonArray &args, void *user_data)
+{
+	DataCompiler *dc = (DataCompiler *)user_data;
+
+	if (array::size(args) == 2) {
+		TempAllocator64 ta;
+		DynamicString enable(ta);
+		sjson::parse_string(enable, args[1]);
+
+		if (enable == "on" || enable == "off") {
+			dc->_bundle_compression = enable == "on";
+		} else {
+			cs.error(client_id, "Usage: compress [on|off]");
+			return;
+		}
+	} else if (array::size(args) != 1) {
+		cs.error(client_id, "Usage: compress [on|off]");
+		return;
+	}
+
+	logi(DATA_COMPILER, "Bundle compression is %s", dc->_bundle_compression ? "on" : "off");
+}
+
 static void console_command_quit(ConsoleServer & /*cs*/, u32 /*client_id*/, const char * /*json*/, void * /*user_data*/)
 {
 	_quit = true;
@@ -574,7 +599,11 @@ DataCompiler::DataCompiler(const DeviceOptions &opts, ConsoleServer &cs)
 	, _file_monitor(default_allocator())
 	, _data_revisions(default_allocator())
 	, _revision(0)
+	, _bundle_compression(opts._bundle_compression)
+	, _bundle_size(0)
+	, _bundle_packed_size(0)
 {
+	cs.register_command_name("compress", "Enable or disable compression of bundled resources", console_command_compress, this);
 	cs.register_message_type("compile", console_command_compile, this);
 	cs.register_message_type("quit", console_command_quit, this);
 	cs.register_message_type("refresh_list", console_command_refresh_list, this);
@@ -1119,6 +1148,8 @@ bool DataCompiler::compile(const char *data_dir, const char *platform_name)
 
 		if (_options->_do_bundle) {
 			time_start = time::now();
+			_bundle_size = 0;
+			_bundle_packed_size = 0;
 			// Find the set of resources to be compiled, removed etc.
 			Vector<DynamicString> to_bundle(default_allocator());
 
@@ -1210,6 +1241,13 @@ bool DataCompiler::compile(const char *data_dir, const char *platform_name)
 			if (success) {
 				if (vector::size(to_bundle)) {
 					logi(DATA_COMPILER, "Bundled data in " TIME_FMT, time::seconds(time::now() - time_start));
+					if (_bundle_compression && _bundle_size != 0) {
+						logi(DATA_COMPILER, "Compressed %.1f MiB of resources to %.1f MiB (%.1f%%)"
+							, f64(_bundle_size) / (1024.0*1024.0)
+							, f64(_bundle_packed_size) / (1024.0*1024.0)
+							, 100.0 * f64(_bundle_packed_size) / f64(_bundle_size)
+							);
+					}
 				} else {
 					logi(DATA_COMPILER, "Bundles are up to date");
 				}
@@ -1429,6 +1467,7 @@ int main_data_compiler(const DeviceOptions &opts)
 	namespace mhr = mesh_resource_internal;
 	namespace mtr = material_resource_internal;
 	namespace pcr = physics_config_resource_internal;
+	namespace psr = particle_system_resource_internal;
 	namespace phr = physics_resource_internal;
 	namespace pkr = package_resource_internal;
 	namespace sar = sprite_animation_resource_internal;
@@ -1436,6 +1475,7 @@ int main_data_compiler(const DeviceOptions &opts)
 	namespace shr = shader_resource_internal;
 	namespace smr = state_machine_internal;
 	namespace spr = sprite_resource_internal;
+	namespace tmr = tilemap_resource_internal;
 	namespace txr = texture_resource_internal;
 	namespace utr = unit_resource_internal;
 
@@ -1446,6 +1486,7 @@ int main_data_compiler(const DeviceOptions &opts)
 	dc->register_compiler("material",         RESOURCE_VERSION_MATERIAL,         mtr::compile);
 	dc->register_compiler("mesh",             RESOURCE_VERSION_MESH,             mhr::compile);
 	dc->register_compiler("package",          RESOURCE_VERSION_PACKAGE,          pkr::compile);
+	dc->register_compiler("particle_system",  RESOURCE_VERSION_PARTICLE_SYSTEM,  psr::compile);
 	dc->register_compiler("physics_config",   RESOURCE_VERSION_PHYSICS_CONFIG,   pcr::compile);
 	dc->register_compiler("lua",              RESOURCE_VERSION_SCRIPT,           lur::compile);
 	dc->register_compiler("shader",           RESOURCE_VERSION_SHADER,           shr::compile);
@@ -1454,6 +1495,7 @@ int main_data_compiler(const DeviceOptions &opts)
 	dc->register_compiler("sprite_animation", RESOURCE_VERSION_SPRITE_ANIMATION, sar::compile);
 	dc->register_compiler("state_machine",    RESOURCE_VERSION_STATE_MACHINE,    smr::compile);
 	dc->register_compiler("texture",          RESOURCE_VERSION_TEXTURE,          txr::compile);
+	dc->register_compiler("tilemap",          RESOURCE_VERSION_TILEMAP,          tmr::compile);
 	dc->register_compiler("unit",             RESOURCE_VERSION_UNIT,             utr::compile);
 
 	dc->add_ignore_glob("*.bak");
@@ -65,6 +65,9 @@ struct DataCompiler
 	SourceIndex _source_index;
 	HashMap<StringId64, u32> _data_revisions;
 	u32 _revision;
+	bool _bundle_compression;  // Whether to compress the bundled resources.
+	u64 _bundle_size;          // Size of the resources bundled by the last compile().
+	u64 _bundle_packed_size;   // Size of the same resources in the bundles.
 
 	void add_file(const char *path);
 	void remove_file(const char *path);
@@ -26,13 +26,18 @@ namespace font_resource
 		const CodePoint *codes  = (CodePoint *)&fr[1];
 		const GlyphData *glyphs = (GlyphData *)(codes + fr->num_glyphs);
 
-		// FIXME: Can do binary search
-		for (u32 i = 0; i < fr->num_glyphs; ++i) {
-			if (codes[i] == cp)
-				return &glyphs[i];
+		// Code points are sorted by the compiler.
+		u32 first = 0;
+		u32 last = fr->num_glyphs;
+		while (first < last) {
+			const u32 mid = first + (last - first) / 2;
+			if (codes[mid] < cp)
+				first = mid + 1;
+			else
+				last = mid;
 		}
 
-		return deffault;
+		return first < fr->num_glyphs && codes[first] == cp ? &glyphs[first] : deffault;
 	}
 
 } // namespace font_resource
@@ -304,6 +304,9 @@ namespace material_resource_internal
 		MaterialResource mr;
 		mr.version             = RESOURCE_HEADER(RESOURCE_VERSION_MATERIAL);
 		mr.shader              = shader.to_string_id();
+		shader                += "+INSTANCED";
+		mr.shader_instanced    = shader.to_string_id();
+		mr._pad0               = 0;
 		mr.num_textures        = array::size(texdata);
 		mr.texture_data_offset = sizeof(mr);
 		mr.num_uniforms        = array::size(unidata);
@@ -314,6 +317,8 @@ namespace material_resource_internal
 		// Write
 		opts.write(mr.version);
 		opts.write(mr.shader);
+		opts.write(mr.shader_instanced);
+		opts.write(mr._pad0);
 		opts.write(mr.num_textures);
 		opts.write(mr.texture_data_offset);
 		opts.write(mr.num_uniforms);
@@ -17,6 +17,8 @@ struct MaterialResource
 {
 	u32 version;
 	StringId32 shader;
+	StringId32 shader_instanced; // Shader with the INSTANCED define appended.
+	u32 _pad0;
 	u32 num_textures;
 	u32 texture_data_offset;
 	u32 num_uniforms;
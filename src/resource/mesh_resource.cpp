@@ -11,10 +11,13 @@
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
 #include "core/math/aabb.inl"
+#include "core/math/bvh.h"
 #include "core/math/constants.h"
+#include "core/math/intersection.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector2.inl"
 #include "core/math/vector3.inl"
+#include "core/math/vector4.inl"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
@@ -22,8 +25,10 @@
 #include "resource/compile_options.inl"
 #include "resource/mesh_resource.h"
 #include "resource/resource_manager.h"
+#include <algorithm>
 #include <bx/readerwriter.h>
 #include <bx/error.h>
+#include <string.h> // memcpy
 #include <vertexlayout.h> // bgfx::write, bgfx::read
 
 namespace crown
@@ -96,6 +101,56 @@ const MeshGeometry *MeshResource::geometry(StringId32 name) const
 
 namespace mesh_resource_internal
 {
+	static const Vector3 &vertex(const MeshGeometry &mg, u32 i)
+	{
+		return *(const Vector3 *)(mg.vertices.data + i*mg.vertices.stride);
+	}
+
+	/// Builds the triangle BVH of @a mg and allocates it from @a a.
+	static void build_bvh(MeshGeometry &mg, Allocator &a)
+	{
+		const u32 num_tris = mg.indices.num / 3;
+		const u16 *inds = (const u16 *)mg.indices.data;
+
+		mg.bvh.nodes = NULL;
+		mg.bvh.primitives = NULL;
+		mg.bvh.num_nodes = 0;
+
+		if (num_tris == 0)
+			return;
+
+		Array<AABB> aabbs(default_allocator());
+		Array<BvhNode> nodes(default_allocator());
+		Array<u32> primitives(default_allocator());
+		array::resize(aabbs, num_tris);
+		array::resize(nodes, bvh::max_nodes(num_tris));
+		array::resize(primitives, num_tris);
+
+		for (u32 i = 0; i < num_tris; ++i) {
+			const Vector3 v[] =
+			{
+				vertex(mg, inds[i*3 + 0]),
+				vertex(mg, inds[i*3 + 1]),
+				vertex(mg, inds[i*3 + 2])
+			};
+			aabb::from_points(aabbs[i], countof(v), v);
+		}
+
+		Bvh b;
+		b.nodes = array::begin(nodes);
+		b.primitives = array::begin(primitives);
+		bvh::build(b, array::begin(aabbs), num_tris);
+
+		// Copy the nodes actually used next to the primitives.
+		const u32 nodes_size = b.num_nodes*sizeof(BvhNode);
+		const u32 primitives_size = num_tris*sizeof(u32);
+		mg.bvh.nodes = (BvhNode *)a.allocate(nodes_size + primitives_size, alignof(BvhNode));
+		mg.bvh.primitives = (u32 *)&mg.bvh.nodes[b.num_nodes];
+		mg.bvh.num_nodes = b.num_nodes;
+		memcpy(mg.bvh.nodes, b.nodes, nodes_size);
+		memcpy(mg.bvh.primitives, b.primitives, primitives_size);
+	}
+
 	void *load(File &file, Allocator &a)
 	{
 		BinaryReader br(file);
@@ -131,24 +186,33 @@ namespace mesh_resource_internal
 			u32 num_inds;
 			br.read(num_inds);
 
+			u32 num_lods;
+			br.read(num_lods);
+
+			const u32 lsize = num_lods*sizeof(MeshLod);
 			const u32 vsize = num_verts*stride;
 			const u32 isize = num_inds*sizeof(u16);
 
-			const u32 size = sizeof(MeshGeometry) + vsize + isize;
+			const u32 size = sizeof(MeshGeometry) + lsize + vsize + isize;
 
 			MeshGeometry *mg = (MeshGeometry *)a.allocate(size);
 			mg->obb             = obb;
 			mg->layout          = layout;
 			mg->vertex_buffer   = BGFX_INVALID_HANDLE;
 			mg->index_buffer    = BGFX_INVALID_HANDLE;
+			mg->num_lods        = num_lods;
+			mg->lods            = (MeshLod *)&mg[1];
 			mg->vertices.num    = num_verts;
 			mg->vertices.stride = stride;
-			mg->vertices.data   = (char *)&mg[1];
-			mg->indices.num     = num_inds;
+			mg->vertices.data   = (char *)&mg->lods[num_lods];
 			mg->indices.data    = mg->vertices.data + vsize;
 
+			br.read(mg->lods, lsize);
 			br.read(mg->vertices.data, vsize);
 			br.read(mg->indices.data, isize);
+			mg->indices.num     = mg->lods[0].num_indices;
+
+			build_bvh(*mg, a);
 
 			mr->geometry_names[i] = name;
 			mr->geometries[i] = mg;
@@ -164,8 +228,9 @@ namespace mesh_resource_internal
 		for (u32 i = 0; i < array::size(mr->geometries); ++i) {
 			MeshGeometry &mg = *mr->geometries[i];
 
+			const MeshLod &last = mg.lods[mg.num_lods - 1];
 			const u32 vsize = mg.vertices.num * mg.vertices.stride;
-			const u32 isize = mg.indices.num * sizeof(u16);
+			const u32 isize = (last.first_index + last.num_indices) * sizeof(u16);
 
 			const bgfx::Memory *vmem = bgfx::makeRef(mg.vertices.data, vsize);
 			const bgfx::Memory *imem = bgfx::makeRef(mg.indices.data, isize);
@@ -196,6 +261,7 @@ namespace mesh_resource_internal
 		MeshResource *mr = (MeshResource *)res;
 
 		for (u32 i = 0; i < array::size(mr->geometries); ++i) {
+			a.deallocate(mr->geometries[i]->bvh.nodes);
 			a.deallocate(mr->geometries[i]);
 		}
 		CE_DELETE(a, (MeshResource *)res);
@@ -203,9 +269,318 @@ namespace mesh_resource_internal
 
 } // namespace mesh_resource_internal
 
+namespace mesh_resource
+{
+	static f32 ray_triangle(u32 primitive, const Vector3 &from, const Vector3 &dir, void *user_data)
+	{
+		const MeshGeometry &mg = *(const MeshGeometry *)user_data;
+		const u16 *inds = (const u16 *)mg.indices.data;
+
+		return ray_triangle_intersection(from
+			, dir
+			, mesh_resource_internal::vertex(mg, inds[primitive*3 + 0])
+			, mesh_resource_internal::vertex(mg, inds[primitive*3 + 1])
+			, mesh_resource_internal::vertex(mg, inds[primitive*3 + 2])
+			);
+	}
+
+	f32 cast_ray(const MeshGeometry *mg, const Matrix4x4 &tm, const Vector3 &from, const Vector3 &dir)
+	{
+		// Cast the ray in object space. The transform is affine so the
+		// distance along the ray does not change.
+		const Matrix4x4 inv = get_inverted(tm);
+		const Vector4 local_dir = vector4(dir.x, dir.y, dir.z, 0.0f) * inv;
+
+		return bvh::cast_ray(mg->bvh
+			, from * inv
+			, vector3(local_dir.x, local_dir.y, local_dir.z)
+			, ray_triangle
+			, (void *)mg
+			);
+	}
+
+	u32 lod(const MeshGeometry *mg, u32 lod, f32 screen_size)
+	{
+		lod = min(lod, mg->num_lods - 1);
+
+		while (lod + 1 < mg->num_lods && screen_size < mg->lods[lod + 1].screen_size * (1.0f - CROWN_MESH_LOD_HYSTERESIS))
+			++lod;
+		while (lod > 0 && screen_size > mg->lods[lod].screen_size * (1.0f + CROWN_MESH_LOD_HYSTERESIS))
+			--lod;
+
+		return lod;
+	}
+
+} // namespace mesh_resource
+
 #if CROWN_CAN_COMPILE
 namespace mesh_resource_internal
 {
+	/// Symmetric 4x4 matrix measuring the squared distance of a point from
+	/// a set of planes.
+	struct Quadric
+	{
+		f64 a2, ab, ac, ad;
+		f64 b2, bc, bd;
+		f64 c2, cd;
+		f64 d2;
+	};
+
+	static void quadric_add_plane(Quadric &q, const Vector3 &n, f32 d, f32 weight)
+	{
+		q.a2 += weight * n.x*n.x;
+		q.ab += weight * n.x*n.y;
+		q.ac += weight * n.x*n.z;
+		q.ad += weight * n.x*d;
+		q.b2 += weight * n.y*n.y;
+		q.bc += weight * n.y*n.z;
+		q.bd += weight * n.y*d;
+		q.c2 += weight * n.z*n.z;
+		q.cd += weight * n.z*d;
+		q.d2 += weight * d*d;
+	}
+
+	static void quadric_add(Quadric &q, const Quadric &b)
+	{
+		q.a2 += b.a2;
+		q.ab += b.ab;
+		q.ac += b.ac;
+		q.ad += b.ad;
+		q.b2 += b.b2;
+		q.bc += b.bc;
+		q.bd += b.bd;
+		q.c2 += b.c2;
+		q.cd += b.cd;
+		q.d2 += b.d2;
+	}
+
+	static f64 quadric_error(const Quadric &q, const Vector3 &v)
+	{
+		const f64 x = v.x;
+		const f64 y = v.y;
+		const f64 z = v.z;
+		return q.a2*x*x + 2.0*q.ab*x*y + 2.0*q.ac*x*z + 2.0*q.ad*x
+			+ q.b2*y*y + 2.0*q.bc*y*z + 2.0*q.bd*y
+			+ q.c2*z*z + 2.0*q.cd*z
+			+ q.d2
+			;
+	}
+
+	struct Collapse
+	{
+		u16 from;
+		u16 to;
+		f64 cost;
+
+		bool operator<(const Collapse &other) const
+		{
+			return cost < other.cost;
+		}
+	};
+
+	static bool has_vertex(const u16 *tri, u16 v)
+	{
+		return tri[0] == v || tri[1] == v || tri[2] == v;
+	}
+
+	/// Returns whether moving the vertex @a from onto @a to flips any of the
+	/// triangles (adj, num_adj) around @a from that survive the collapse.
+	static bool collapse_flips(const u16 *indices, const u32 *adj, u32 num_adj, u16 from, u16 to, const Vector3 *positions)
+	{
+		for (u32 i = 0; i < num_adj; ++i) {
+			const u16 *tri = &indices[adj[i]*3];
+			if (has_vertex(tri, to))
+				continue;
+
+			Vector3 p[3];
+			Vector3 q[3];
+			for (u32 j = 0; j < 3; ++j) {
+				p[j] = positions[tri[j]];
+				q[j] = tri[j] == from ? positions[to] : p[j];
+			}
+
+			const Vector3 n0 = cross(p[1] - p[0], p[2] - p[0]);
+			const Vector3 n1 = cross(q[1] - q[0], q[2] - q[0]);
+			if (dot(n0, n1) <= 0.0f)
+				return true;
+		}
+
+		return false;
+	}
+
+	u32 simplify(u16 *out
+		, u32 *triangles
+		, const u16 *indices
+		, u32 num_indices
+		, const Vector3 *positions
+		, u32 num_positions
+		, u32 target_num_indices
+		)
+	{
+		Array<u16> cur(default_allocator());
+		Array<u32> cur_tris(default_allocator());
+		array::push(cur, indices, num_indices);
+		array::resize(cur_tris, num_indices / 3);
+		for (u32 i = 0; i < num_indices / 3; ++i)
+			cur_tris[i] = i;
+
+		// Accumulate the planes of the triangles around each vertex,
+		// weighted by area.
+		Array<Quadric> quadrics(default_allocator());
+		array::resize(quadrics, num_positions);
+		memset(array::begin(quadrics), 0, num_positions * sizeof(Quadric));
+
+		for (u32 i = 0; i < num_indices; i += 3) {
+			const Vector3 &p0 = positions[indices[i + 0]];
+			Vector3 n = cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+			const f32 len = length(n);
+			if (len == 0.0f)
+				continue;
+
+			n *= 1.0f / len;
+			const f32 d = -dot(n, p0);
+			for (u32 j = 0; j < 3; ++j)
+				quadric_add_plane(quadrics[indices[i + j]], n, d, len * 0.5f);
+		}
+
+		// Lock the vertices on open edges (edges used by a single triangle)
+		// to preserve the outline of the mesh.
+		Array<bool> locked(default_allocator());
+		array::resize(locked, num_positions);
+		memset(array::begin(locked), 0, num_positions * sizeof(bool));
+		{
+			Array<u32> edges(default_allocator());
+			array::resize(edges, num_indices);
+			for (u32 i = 0; i < num_indices; ++i) {
+				const u32 a = indices[i];
+				const u32 b = indices[i - i%3 + (i + 1)%3];
+				edges[i] = min(a, b) << 16 | max(a, b);
+			}
+			std::sort(array::begin(edges), array::end(edges));
+
+			for (u32 i = 0; i < num_indices;) {
+				u32 j = i + 1;
+				while (j < num_indices && edges[j] == edges[i])
+					++j;
+				if (j - i == 1) {
+					locked[edges[i] >> 16] = true;
+					locked[edges[i] & 0xffff] = true;
+				}
+				i = j;
+			}
+		}
+
+		Array<u32> adj_offsets(default_allocator());
+		Array<u32> adj(default_allocator());
+		Array<Collapse> collapses(default_allocator());
+		Array<u16> remap(default_allocator());
+		Array<bool> touched(default_allocator());
+		array::resize(adj_offsets, num_positions + 1);
+		array::resize(remap, num_positions);
+		array::resize(touched, num_positions);
+
+		// Collapse edges in passes, cheapest first. The triangles around a
+		// collapsed vertex are left alone for the rest of the pass so that
+		// costs and flip checks stay valid.
+		while (array::size(cur) > target_num_indices) {
+			const u32 num_cur = array::size(cur);
+
+			// Triangles around each vertex.
+			memset(array::begin(adj_offsets), 0, (num_positions + 1) * sizeof(u32));
+			for (u32 i = 0; i < num_cur; ++i)
+				++adj_offsets[cur[i] + 1];
+			for (u32 i = 0; i < num_positions; ++i)
+				adj_offsets[i + 1] += adj_offsets[i];
+			array::resize(adj, num_cur);
+			for (u32 i = 0; i < num_cur; ++i)
+				adj[adj_offsets[cur[i]]++] = i / 3;
+			for (u32 i = num_positions; i > 0; --i)
+				adj_offsets[i] = adj_offsets[i - 1];
+			adj_offsets[0] = 0;
+
+			array::clear(collapses);
+			for (u32 i = 0; i < num_cur; ++i) {
+				const u16 a = cur[i];
+				const u16 b = cur[i - i%3 + (i + 1)%3];
+
+				Quadric q = quadrics[a];
+				quadric_add(q, quadrics[b]);
+
+				if (!locked[a]) {
+					Collapse c = { a, b, quadric_error(q, positions[b]) };
+					array::push_back(collapses, c);
+				}
+				if (!locked[b]) {
+					Collapse c = { b, a, quadric_error(q, positions[a]) };
+					array::push_back(collapses, c);
+				}
+			}
+			std::sort(array::begin(collapses), array::end(collapses));
+
+			for (u32 i = 0; i < num_positions; ++i)
+				remap[i] = u16(i);
+			memset(array::begin(touched), 0, num_positions * sizeof(bool));
+
+			u32 num_tris = num_cur / 3;
+			u32 num_collapsed = 0;
+			for (u32 i = 0; i < array::size(collapses) && num_tris*3 > target_num_indices; ++i) {
+				const Collapse &c = collapses[i];
+				if (touched[c.from] || touched[c.to])
+					continue;
+
+				const u32 *from_adj = &adj[adj_offsets[c.from]];
+				const u32 num_from_adj = adj_offsets[c.from + 1] - adj_offsets[c.from];
+				bool ring_touched = false;
+				for (u32 j = 0; j < num_from_adj * 3 && !ring_touched; ++j)
+					ring_touched = touched[cur[from_adj[j/3]*3 + j%3]];
+				if (ring_touched)
+					continue;
+
+				if (collapse_flips(array::begin(cur), from_adj, num_from_adj, c.from, c.to, positions))
+					continue;
+
+				for (u32 j = 0; j < num_from_adj; ++j) {
+					const u16 *tri = &cur[from_adj[j]*3];
+					if (has_vertex(tri, c.to))
+						--num_tris;
+					touched[tri[0]] = true;
+					touched[tri[1]] = true;
+					touched[tri[2]] = true;
+				}
+
+				remap[c.from] = c.to;
+				quadric_add(quadrics[c.to], quadrics[c.from]);
+				++num_collapsed;
+			}
+
+			if (num_collapsed == 0)
+				break;
+
+			// Remove the triangles that became degenerate.
+			u32 num = 0;
+			for (u32 i = 0; i < num_cur; i += 3) {
+				const u16 a = remap[cur[i + 0]];
+				const u16 b = remap[cur[i + 1]];
+				const u16 c = remap[cur[i + 2]];
+				if (a == b || b == c || c == a)
+					continue;
+
+				cur_tris[num / 3] = cur_tris[i / 3];
+				cur[num++] = a;
+				cur[num++] = b;
+				cur[num++] = c;
+			}
+			array::resize(cur, num);
+			array::resize(cur_tris, num / 3);
+		}
+
+		memcpy(out, array::begin(cur), array::size(cur) * sizeof(u16));
+		if (triangles != NULL)
+			memcpy(triangles, array::begin(cur_tris), array::size(cur_tris) * sizeof(u32));
+
+		return array::size(cur);
+	}
+
 	static void parse_float_array(Array<f32> &output, const char *json)
 	{
 		TempAllocator4096 ta;
@@ -247,6 +622,7 @@ namespace mesh_resource_internal
 		u32 _vertex_stride;
 		Array<char> _vertex_buffer;
 		Array<u16> _index_buffer;
+		Array<MeshLod> _lods;
 
 		AABB _aabb;
 		OBB _obb;
@@ -271,6 +647,7 @@ namespace mesh_resource_internal
 			, _vertex_stride(0)
 			, _vertex_buffer(default_allocator())
 			, _index_buffer(default_allocator())
+			, _lods(default_allocator())
 			, _has_normal(false)
 			, _has_uv(false)
 		{
@@ -293,6 +670,7 @@ namespace mesh_resource_internal
 			_vertex_stride = 0;
 			array::clear(_vertex_buffer);
 			array::clear(_index_buffer);
+			array::clear(_lods);
 
 			aabb::reset(_aabb);
 			memset(&_obb, 0, sizeof(_obb));
@@ -302,7 +680,7 @@ namespace mesh_resource_internal
 			_has_uv = false;
 		}
 
-		void parse_indices(const char *json)
+		void parse_indices(Array<u16> &position_indices, Array<u16> &normal_indices, Array<u16> &uv_indices, const char *json)
 		{
 			TempAllocator4096 ta;
 			JsonObject obj(ta);
@@ -311,17 +689,148 @@ namespace mesh_resource_internal
 			JsonArray data_json(ta);
 			sjson::parse_array(data_json, obj["data"]);
 
-			parse_index_array(_position_indices, data_json[0]);
+			parse_index_array(position_indices, data_json[0]);
 
 			if (_has_normal) {
-				parse_index_array(_normal_indices, data_json[1]);
+				parse_index_array(normal_indices, data_json[1]);
 			}
 			if (_has_uv) {
-				parse_index_array(_uv_indices, data_json[2]);
+				parse_index_array(uv_indices, data_json[2]);
+			}
+		}
+
+		/// Appends a vertex and an index to the buffers for each of the
+		/// (position, normal, uv) indices.
+		void add_vertices(const Array<u16> &position_indices, const Array<u16> &normal_indices, const Array<u16> &uv_indices)
+		{
+			u16 index = u16(array::size(_vertex_buffer) / _vertex_stride);
+			for (u32 i = 0; i < array::size(position_indices); ++i) {
+				array::push_back(_index_buffer, index++);
+
+				const u16 p_idx = position_indices[i] * 3;
+				Vector3 xyz;
+				xyz.x = _positions[p_idx + 0];
+				xyz.y = _positions[p_idx + 1];
+				xyz.z = _positions[p_idx + 2];
+				array::push(_vertex_buffer, (char *)&xyz, sizeof(xyz));
+
+				if (_has_normal) {
+					const u16 n_idx = normal_indices[i] * 3;
+					Vector3 n;
+					n.x = _normals[n_idx + 0];
+					n.y = _normals[n_idx + 1];
+					n.z = _normals[n_idx + 2];
+					array::push(_vertex_buffer, (char *)&n, sizeof(n));
+				}
+				if (_has_uv) {
+					const u16 t_idx = uv_indices[i] * 2;
+					Vector2 uv;
+					uv.x = _uvs[t_idx + 0];
+					uv.y = _uvs[t_idx + 1];
+					array::push(_vertex_buffer, (char *)&uv, sizeof(uv));
+				}
+			}
+		}
+
+		/// Appends to the index buffer a simplified version of LOD 0 with
+		/// at most @a target_num_indices indices.
+		void generate_lod(u32 target_num_indices)
+		{
+			const u32 num_positions = array::size(_positions) / 3;
+			const Vector3 *positions = (const Vector3 *)array::begin(_positions);
+			const u32 num_indices = _lods[0].num_indices;
+
+			// Weld equal positions so that seams do not look like open edges.
+			Array<u16> sorted(default_allocator());
+			Array<u16> welded(default_allocator());
+			array::resize(sorted, num_positions);
+			array::resize(welded, num_positions);
+			for (u32 i = 0; i < num_positions; ++i)
+				sorted[i] = u16(i);
+			std::sort(array::begin(sorted), array::end(sorted), [&](u16 a, u16 b) {
+					const Vector3 &pa = positions[a];
+					const Vector3 &pb = positions[b];
+					if (pa.x != pb.x) return pa.x < pb.x;
+					if (pa.y != pb.y) return pa.y < pb.y;
+					return pa.z < pb.z;
+				});
+			for (u32 i = 0; i < num_positions; ++i) {
+				const bool same = i > 0 && positions[sorted[i]] == positions[sorted[i - 1]];
+				welded[sorted[i]] = same ? welded[sorted[i - 1]] : sorted[i];
+			}
+
+			Array<u16> lod0(default_allocator());
+			Array<u16> first_vertex(default_allocator());
+			array::resize(lod0, num_indices);
+			array::resize(first_vertex, num_positions);
+			for (u32 i = num_indices; i > 0; --i) {
+				lod0[i - 1] = welded[_position_indices[i - 1]];
+				first_vertex[lod0[i - 1]] = _index_buffer[i - 1];
+			}
+
+			Array<u16> indices(default_allocator());
+			Array<u32> triangles(default_allocator());
+			array::resize(indices, num_indices);
+			array::resize(triangles, num_indices / 3);
+			const u32 num = simplify(array::begin(indices)
+				, array::begin(triangles)
+				, array::begin(lod0)
+				, num_indices
+				, positions
+				, num_positions
+				, target_num_indices
+				);
+
+			// Triangles are a subset of LOD 0 with some corners moved. Keep
+			// the attributes of the corners that did not move.
+			for (u32 i = 0; i < num; ++i) {
+				const u32 corner = triangles[i / 3]*3 + i%3;
+				const u16 v = lod0[corner] == indices[i] ? _index_buffer[corner] : first_vertex[indices[i]];
+				array::push_back(_index_buffer, v);
 			}
 		}
 
-		void parse(const char *geometry)
+		void parse_lods(const char *json)
+		{
+			TempAllocator4096 ta;
+			JsonArray lods(ta);
+			sjson::parse_array(lods, json);
+
+			Array<u16> position_indices(default_allocator());
+			Array<u16> normal_indices(default_allocator());
+			Array<u16> uv_indices(default_allocator());
+
+			f32 scale = 1.0f;
+			for (u32 i = 0; i < array::size(lods); ++i) {
+				JsonObject obj(ta);
+				sjson::parse_object(obj, lods[i]);
+				scale *= 0.5f;
+
+				MeshLod lod;
+				lod.first_index = array::size(_index_buffer);
+				lod.screen_size = json_object::has(obj, "screen_size")
+					? sjson::parse_float(obj["screen_size"])
+					: scale
+					;
+
+				if (json_object::has(obj, "indices")) {
+					// Triangles from source, sharing the vertex attributes of LOD 0.
+					parse_indices(position_indices, normal_indices, uv_indices, obj["indices"]);
+					add_vertices(position_indices, normal_indices, uv_indices);
+				} else {
+					const f32 ratio = json_object::has(obj, "ratio")
+						? sjson::parse_float(obj["ratio"])
+						: scale
+						;
+					generate_lod(u32(_lods[0].num_indices/3 * ratio) * 3);
+				}
+
+				lod.num_indices = array::size(_index_buffer) - lod.first_index;
+				array::push_back(_lods, lod);
+			}
+		}
+
+		void parse(const char *geometry, const char *default_lods)
 		{
 			TempAllocator4096 ta;
 			JsonObject obj(ta);
@@ -339,7 +848,7 @@ namespace mesh_resource_internal
 				parse_float_array(_uvs, obj["texcoord"]);
 			}
 
-			parse_indices(obj["indices"]);
+			parse_indices(_position_indices, _normal_indices, _uv_indices, obj["indices"]);
 
 			_vertex_stride = 0;
 			_vertex_stride += 3 * sizeof(f32);
@@ -347,35 +856,17 @@ namespace mesh_resource_internal
 			_vertex_stride += (_has_uv     ? 2 * sizeof(f32) : 0);
 
 			// Generate vb/ib
-			array::resize(_index_buffer, array::size(_position_indices));
+			add_vertices(_position_indices, _normal_indices, _uv_indices);
 
-			u16 index = 0;
-			for (u32 i = 0; i < array::size(_position_indices); ++i) {
-				_index_buffer[i] = index++;
-
-				const u16 p_idx = _position_indices[i] * 3;
-				Vector3 xyz;
-				xyz.x = _positions[p_idx + 0];
-				xyz.y = _positions[p_idx + 1];
-				xyz.z = _positions[p_idx + 2];
-				array::push(_vertex_buffer, (char *)&xyz, sizeof(xyz));
+			MeshLod lod0;
+			lod0.first_index = 0;
+			lod0.num_indices = array::size(_index_buffer);
+			lod0.screen_size = 1.0f;
+			array::push_back(_lods, lod0);
 
-				if (_has_normal) {
-					const u16 n_idx = _normal_indices[i] * 3;
-					Vector3 n;
-					n.x = _normals[n_idx + 0];
-					n.y = _normals[n_idx + 1];
-					n.z = _normals[n_idx + 2];
-					array::push(_vertex_buffer, (char *)&n, sizeof(n));
-				}
-				if (_has_uv) {
-					const u16 t_idx = _uv_indices[i] * 2;
-					Vector2 uv;
-					uv.x = _uvs[t_idx + 0];
-					uv.y = _uvs[t_idx + 1];
-					array::push(_vertex_buffer, (char *)&uv, sizeof(uv));
-				}
-			}
+			const char *lods = json_object::has(obj, "lods") ? obj["lods"] : default_lods;
+			if (lods != NULL)
+				parse_lods(lods);
 
 			// Vertex layout
 			_layout.begin();
@@ -411,12 +902,19 @@ namespace mesh_resource_internal
 			_opts.write(_vertex_stride);
 			_opts.write(array::size(_index_buffer));
 
+			_opts.write(array::size(_lods));
+			for (u32 i = 0; i < array::size(_lods); ++i) {
+				_opts.write(_lods[i].first_index);
+				_opts.write(_lods[i].num_indices);
+				_opts.write(_lods[i].screen_size);
+			}
+
 			_opts.write(_vertex_buffer);
 			_opts.write(array::begin(_index_buffer), array::size(_index_buffer) * sizeof(u16));
 		}
 	};
 
-	s32 compile_node(MeshCompiler &mc, CompileOptions &opts, const JsonObject &geometries, const HashMap<StringView, const char *>::Entry *entry)
+	s32 compile_node(MeshCompiler &mc, CompileOptions &opts, const JsonObject &geometries, const char *lods, const HashMap<StringView, const char *>::Entry *entry)
 	{
 		TempAllocator4096 ta;
 		const StringView key = entry->first;
@@ -430,7 +928,7 @@ namespace mesh_resource_internal
 		sjson::parse(obj_node, node);
 
 		mc.reset();
-		mc.parse(geometry);
+		mc.parse(geometry, lods);
 		mc.write();
 
 		if (json_object::has(obj_node, "children")) {
@@ -442,7 +940,7 @@ namespace mesh_resource_internal
 			for (; cur != end; ++cur) {
 				JSON_OBJECT_SKIP_HOLE(children, cur);
 
-				s32 err = compile_node(mc, opts, geometries, cur);
+				s32 err = compile_node(mc, opts, geometries, lods, cur);
 				DATA_COMPILER_ENSURE(err == 0, opts);
 			}
 		}
@@ -463,6 +961,9 @@ namespace mesh_resource_internal
 		JsonObject nodes(ta);
 		sjson::parse(nodes, obj["nodes"]);
 
+		// LODs of the geometries that do not specify their own.
+		const char *lods = json_object::has(obj, "lods") ? obj["lods"] : NULL;
+
 		opts.write(RESOURCE_HEADER(RESOURCE_VERSION_MESH));
 		opts.write(json_object::size(geometries));
 
@@ -473,7 +974,7 @@ namespace mesh_resource_internal
 		for (; cur != end; ++cur) {
 			JSON_OBJECT_SKIP_HOLE(nodes, cur);
 
-			s32 err = compile_node(mc, opts, geometries, cur);
+			s32 err = compile_node(mc, opts, geometries, lods, cur);
 			DATA_COMPILER_ENSURE(err == 0, opts);
 		}
 
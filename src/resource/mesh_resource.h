@@ -29,6 +29,14 @@ struct IndexData
 	char *data; // size = num*sizeof(u16)
 };
 
+/// Level of detail of a MeshGeometry.
+struct MeshLod
+{
+	u32 first_index;
+	u32 num_indices;
+	f32 screen_size; ///< Projected size, relative to the viewport height, below which this LOD is used.
+};
+
 struct MeshGeometry
 {
 	bgfx::VertexLayout layout;
@@ -36,7 +44,10 @@ struct MeshGeometry
 	bgfx::IndexBufferHandle index_buffer;
 	OBB obb;
 	VertexData vertices;
-	IndexData indices;
+	IndexData indices; ///< Indices of lods[0].
+	Bvh bvh; ///< Triangles in object space.
+	u32 num_lods;
+	MeshLod *lods; ///< From the most to the least detailed.
 };
 
 struct MeshResource
@@ -59,6 +70,36 @@ namespace mesh_resource_internal
 	void offline(StringId64 /*id*/, ResourceManager & /*rm*/);
 	void unload(Allocator &a, void *res);
 
+	/// Simplifies the triangles (indices, num_indices) whose vertices are
+	/// @a positions by collapsing their edges until no more than
+	/// @a target_num_indices indices are left. Each collapse merges a vertex
+	/// into one of its neighbours, so no new vertices are created. Writes the
+	/// remaining triangles to @a out and, if @a triangles is not NULL, the
+	/// index of the source triangle of each of them. Returns the number of
+	/// indices written.
+	u32 simplify(u16 *out
+		, u32 *triangles
+		, const u16 *indices
+		, u32 num_indices
+		, const Vector3 *positions
+		, u32 num_positions
+		, u32 target_num_indices
+		);
+
 } // namespace mesh_resource_internal
 
+namespace mesh_resource
+{
+	/// Returns the distance along ray (from, dir) to the nearest triangle of
+	/// the geometry @a mg transformed by @a tm or -1.0 if no intersection.
+	f32 cast_ray(const MeshGeometry *mg, const Matrix4x4 &tm, const Vector3 &from, const Vector3 &dir);
+
+	/// Returns the LOD of @a mg to use when its projected size is
+	/// @a screen_size and @a lod is the LOD currently in use. A LOD switch
+	/// only happens once the size crosses the threshold by
+	/// CROWN_MESH_LOD_HYSTERESIS, so that objects do not pop back and forth.
+	u32 lod(const MeshGeometry *mg, u32 lod, f32 screen_size);
+
+} // namespace mesh_resource
+
 } // namespace crown
@@ -13,6 +13,7 @@
 #include "core/filesystem/reader_writer.inl"
 #include "core/json/json_object.inl"
 #include "core/json/sjson.h"
+#include "core/lz4.h"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
@@ -20,6 +21,8 @@
 #include "resource/data_compiler.h"
 #include "resource/package_resource.h"
 #include "resource/resource_id.inl"
+#include <algorithm>
+#include <string.h> // memcpy
 
 namespace crown
 {
@@ -34,7 +37,9 @@ struct hash<ResourceOffset>
 
 bool operator<(const ResourceOffset &a, const ResourceOffset &b)
 {
-	return a.type < b.type;
+	return a.type < b.type
+		|| (a.type == b.type && a.name < b.name)
+		;
 }
 
 bool operator==(const ResourceOffset &a, const ResourceOffset &b)
@@ -107,6 +112,50 @@ namespace package_resource_internal
 		return 0;
 	}
 
+	u32 compress(Buffer &output, const void *data, u32 size)
+	{
+		const u32 num_blocks = (size + PACKAGE_RESOURCE_BLOCK_SIZE - 1) / PACKAGE_RESOURCE_BLOCK_SIZE;
+		const u32 header_size = num_blocks*sizeof(u32);
+		if (num_blocks == 0 || header_size >= size)
+			return 0;
+
+		// Compress into the worst-case space after the end of output and
+		// trim it at the end.
+		const u32 first = array::size(output);
+		array::resize(output, first + size);
+		u32 *block_ends = (u32 *)&output[first];
+		u32 end = 0;
+
+		for (u32 bb = 0; bb < num_blocks; ++bb) {
+			const u8 *block = (const u8 *)data + bb*PACKAGE_RESOURCE_BLOCK_SIZE;
+			const u32 block_size = min(size - bb*PACKAGE_RESOURCE_BLOCK_SIZE, u32(PACKAGE_RESOURCE_BLOCK_SIZE));
+			const u32 avail = size - header_size - end;
+			char *dst = &output[first + header_size + end];
+
+			// Store the block as-is unless it gets smaller.
+			u32 n = lz4::compress(dst, min(avail, block_size - 1), block, block_size);
+			if (n == 0) {
+				if (block_size > avail) {
+					array::resize(output, first);
+					return 0;
+				}
+				memcpy(dst, block, block_size);
+				n = block_size;
+			}
+
+			end += n;
+			block_ends[bb] = end;
+		}
+
+		if (header_size + end >= size) {
+			array::resize(output, first);
+			return 0;
+		}
+
+		array::resize(output, first + header_size + end);
+		return header_size + end;
+	}
+
 	s32 compile(CompileOptions &opts)
 	{
 		TempAllocator4096 ta;
@@ -190,6 +239,9 @@ namespace package_resource_internal
 			array::push_back(resources, *cur);
 		}
 
+		// Sort the list so that resources can be found with a binary search.
+		std::sort(array::begin(resources), array::end(resources));
+
 		// Write
 		opts.write(RESOURCE_HEADER(RESOURCE_VERSION_PACKAGE));
 		opts.write(array::size(resources));
@@ -208,20 +260,33 @@ namespace package_resource_internal
 
 				// Append data to bundle.
 				File *data_file = opts._data_filesystem.open(dest.c_str(), FileOpenMode::READ);
-				const u32 data_size = data_file->size();
+				Buffer data = opts.read_all(data_file);
+				opts._data_filesystem.close(*data_file);
+				const u32 data_size = array::size(data);
 
 				// Align data to a 16-bytes boundary.
 				bundle.align(16);
 				const u32 data_offset = array::size(bundle_data);
 
-				file::copy(bundle_file, *data_file, data_size);
-				opts._data_filesystem.close(*data_file);
+				u32 packed_size = 0;
+				if (opts._data_compiler._bundle_compression) {
+					packed_size = compress(bundle_data, array::begin(data), data_size);
+					bundle_file.seek_to_end();
+				}
+				if (packed_size == 0) {
+					bundle.write(array::begin(data), data_size);
+					packed_size = data_size;
+				}
+				opts._data_compiler._bundle_size += data_size;
+				opts._data_compiler._bundle_packed_size += packed_size;
 
 				// Write ResourceOffset.
 				opts.write(resources[ii].type);
 				opts.write(resources[ii].name);
 				opts.write(data_offset);
 				opts.write(data_size);
+				opts.write(packed_size);
+				opts.write(u32(0));
 			}
 
 			// Write bundled data.
@@ -233,6 +298,8 @@ namespace package_resource_internal
 				opts.write(resources[ii].name);
 				opts.write(UINT32_MAX);
 				opts.write(UINT32_MAX);
+				opts.write(UINT32_MAX);
+				opts.write(u32(0));
 			}
 		}
 
@@ -250,12 +317,54 @@ namespace package_resource
 		return ro + index;
 	}
 
+	const ResourceOffset *find(const PackageResource *pr, StringId64 type, StringId64 name)
+	{
+		ResourceOffset key;
+		key.type = type;
+		key.name = name;
+
+		const ResourceOffset *begin = resource_offset(pr, 0);
+		const ResourceOffset *end = resource_offset(pr, pr->num_resources);
+		const ResourceOffset *ro = std::lower_bound(begin, end, key);
+		return ro != end && *ro == key ? ro : NULL;
+	}
+
 	const u8 *data(const PackageResource *pr)
 	{
 		const u8 *data_offset = (u8 *)resource_offset(pr, pr->num_resources);
 		return (u8 *)memory::align_top(data_offset, 16);
 	}
 
+	u32 num_blocks(const ResourceOffset *ro)
+	{
+		if (ro->packed_size == ro->size)
+			return 0;
+
+		return (ro->size + PACKAGE_RESOURCE_BLOCK_SIZE - 1) / PACKAGE_RESOURCE_BLOCK_SIZE;
+	}
+
+	bool decompress_block(void *dst, const PackageResource *pr, const ResourceOffset *ro, u32 block)
+	{
+		const u32 nb = num_blocks(ro);
+		CE_ENSURE(block < nb);
+
+		const u32 *block_ends = (const u32 *)(data(pr) + ro->offset);
+		const u8 *blocks = (const u8 *)&block_ends[nb];
+		const u32 begin = block == 0 ? 0 : block_ends[block - 1];
+		const u32 end = block_ends[block];
+		if (begin > end || end > ro->packed_size - nb*sizeof(u32))
+			return false;
+
+		u8 *out = (u8 *)dst + block*PACKAGE_RESOURCE_BLOCK_SIZE;
+		const u32 size = min(ro->size - block*PACKAGE_RESOURCE_BLOCK_SIZE, u32(PACKAGE_RESOURCE_BLOCK_SIZE));
+		if (end - begin == size) {
+			memcpy(out, blocks + begin, size);
+			return true;
+		}
+
+		return lz4::decompress(out, size, blocks + begin, end - begin);
+	}
+
 } // namespace package_resource
 
 } // namespace crown
@@ -12,6 +12,9 @@
 #include "core/strings/types.h"
 #include "resource/types.h"
 
+/// Size of the data compressed in a block.
+#define PACKAGE_RESOURCE_BLOCK_SIZE (64*1024)
+
 namespace crown
 {
 struct ResourceOffset
@@ -19,19 +22,33 @@ struct ResourceOffset
 	StringId64 type;
 	StringId64 name;
 	u32 offset;      ///< Relative offset from package_resource::data().
-	u32 size;
+	u32 size;        ///< Size of the resource data.
+	u32 packed_size; ///< Size in the package; less than size if the data is compressed.
+	u32 _pad;
 };
 
 struct PackageResource
 {
 	u32 version;
 	u32 num_resources;
-	// ResourceOffset offsets[num_resources]
+	// ResourceOffset offsets[num_resources] (sorted by type, then name)
 	// Data (16-bytes aligned)
 };
 
+// Compressed resources are split in blocks of PACKAGE_RESOURCE_BLOCK_SIZE
+// bytes (the last may be smaller) and each block is compressed with lz4 on
+// its own, so that blocks can be decompressed in parallel:
+//
+// u32 block_ends[num_blocks] // End of each block, relative to the first block.
+// Blocks data                // Blocks that do not compress are stored as-is.
+
 namespace package_resource_internal
 {
+	/// Appends the @a size bytes at @a data to @a output, compressed in blocks.
+	/// Returns the number of bytes appended, or 0 if the data does not compress
+	/// and nothing has been appended.
+	u32 compress(Buffer &output, const void *data, u32 size);
+
 	s32 compile(CompileOptions &opts);
 
 } // namespace package_resource_internal
@@ -41,9 +58,22 @@ namespace package_resource
 	///
 	const ResourceOffset *resource_offset(const PackageResource *pr, u32 index);
 
+	/// Returns the offset of the resource @a type and @a name in the package
+	/// resource @a pr, or NULL if the package does not contain it.
+	const ResourceOffset *find(const PackageResource *pr, StringId64 type, StringId64 name);
+
 	/// Returns a pointer to the data segment of the package resource @a pr.
 	const u8 *data(const PackageResource *pr);
 
+	/// Returns the number of blocks the resource @a ro is compressed into, or
+	/// 0 if it is not compressed.
+	u32 num_blocks(const ResourceOffset *ro);
+
+	/// Decompresses the block @a block of the resource @a ro in the package
+	/// resource @a pr. @a dst must hold ro->size bytes; the block is written
+	/// at its offset inside @a dst. Returns false if the block is corrupted.
+	bool decompress_block(void *dst, const PackageResource *pr, const ResourceOffset *ro, u32 block);
+
 } // namespace package_resource
 
 } // namespace crown
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+#include "core/containers/array.inl"
+#include "core/json/json_object.inl"
+#include "core/json/sjson.h"
+#include "core/memory/temp_allocator.inl"
+#include "core/strings/dynamic_string.inl"
+#include "resource/compile_options.inl"
+#include "resource/particle_system_resource.h"
+#include <string.h> // strncpy
+
+namespace crown
+{
+#if CROWN_CAN_COMPILE
+namespace particle_system_resource_internal
+{
+	s32 compile(CompileOptions &opts)
+	{
+		Buffer buf = opts.read();
+
+		TempAllocator4096 ta;
+		JsonObject obj(ta);
+		sjson::parse(obj, buf);
+
+		const Vector2 lifetime = sjson::parse_vector2(obj["lifetime"]);
+		const Vector2 size     = sjson::parse_vector2(obj["size"]);
+
+		ParticleSystemResource psr;
+		memset(&psr, 0, sizeof(psr));
+		psr.version       = RESOURCE_HEADER(RESOURCE_VERSION_PARTICLE_SYSTEM);
+		psr.max_particles = sjson::parse_int    (obj["max_particles"]);
+		psr.spawn_rate    = sjson::parse_float  (obj["spawn_rate"]);
+		psr.lifetime_min  = lifetime.x;
+		psr.lifetime_max  = lifetime.y;
+		psr.velocity_min  = sjson::parse_vector3(obj["velocity_min"]);
+		psr.velocity_max  = sjson::parse_vector3(obj["velocity_max"]);
+		psr.acceleration  = sjson::parse_vector3(obj["acceleration"]);
+		psr.size_start    = size.x;
+		psr.size_end      = size.y;
+		psr.color_start   = sjson::parse_vector4(obj["color_start"]);
+		psr.color_end     = sjson::parse_vector4(obj["color_end"]);
+
+		DATA_COMPILER_ASSERT(psr.max_particles > 0
+			, opts
+			, "max_particles must be greater than zero"
+			);
+		DATA_COMPILER_ASSERT(psr.lifetime_min > 0.0f && psr.lifetime_min <= psr.lifetime_max
+			, opts
+			, "Invalid lifetime: [%f, %f]"
+			, psr.lifetime_min
+			, psr.lifetime_max
+			);
+
+		DynamicString name(ta);
+		if (json_object::has(obj, "name"))
+			sjson::parse_string(name, obj["name"]);
+		else
+			name = opts.source_path();
+		strncpy(psr.name, name.c_str(), sizeof(psr.name) - 1);
+
+		opts.write(psr.version);
+		opts.write(psr.max_particles);
+		opts.write(psr.spawn_rate);
+		opts.write(psr.lifetime_min);
+		opts.write(psr.lifetime_max);
+		opts.write(psr.velocity_min);
+		opts.write(psr.velocity_max);
+		opts.write(psr.acceleration);
+		opts.write(psr.size_start);
+		opts.write(psr.size_end);
+		opts.write(psr.color_start);
+		opts.write(psr.color_end);
+		opts.write(psr.name, sizeof(psr.name));
+
+		return 0;
+	}
+
+} // namespace particle_system_resource_internal
+#endif // if CROWN_CAN_COMPILE
+
+} // namespace crown
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/math/types.h"
+#include "core/types.h"
+#include "resource/types.h"
+
+namespace crown
+{
+/// Emitter of camera-facing particles.
+///
+/// Particles are spawned at the origin of the emitter with a random velocity
+/// and lifetime, then move under a constant acceleration while their size
+/// and color are interpolated over their lifetime.
+struct ParticleSystemResource
+{
+	u32 version;
+	u32 max_particles;    ///< Maximum number of particles alive at once.
+	f32 spawn_rate;       ///< Particles spawned per second.
+	f32 lifetime_min;     ///< In seconds.
+	f32 lifetime_max;     ///< In seconds.
+	Vector3 velocity_min; ///< Initial velocity in emitter space.
+	Vector3 velocity_max; ///< Initial velocity in emitter space.
+	Vector3 acceleration; ///< In world space.
+	f32 size_start;       ///< Size at spawn time in meters.
+	f32 size_end;         ///< Size at death time in meters.
+	Color4 color_start;   ///< Color at spawn time.
+	Color4 color_end;     ///< Color at death time.
+	char name[32];        ///< Name of the emitter's counters in the profiler.
+};
+
+namespace particle_system_resource_internal
+{
+	s32 compile(CompileOptions &opts);
+
+} // namespace particle_system_resource_internal
+
+} // namespace crown
@@ -16,6 +16,7 @@
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
 #include "core/thread/scoped_mutex.inl"
+#include "core/time.h"
 #include "device/log.h"
 #include "resource/package_resource.h"
 #include "resource/resource_id.inl"
@@ -34,7 +35,22 @@ ResourceLoader::ResourceLoader(Filesystem &data_filesystem, bool is_bundle)
 	, _loaded(default_allocator())
 	, _fallback(default_allocator())
 	, _exit(false)
+	, _unpack_exit(false)
+	, _unpack_dst(NULL)
+	, _unpack_package(NULL)
+	, _unpack_resource(NULL)
+	, _unpack_next_block(0)
+	, _unpack_failed(false)
+	, _unpacked_size(0)
+	, _packed_size(0)
+	, _unpack_time(0)
 {
+	// Only bundles contain compressed resources.
+	if (_is_bundle) {
+		for (u32 ii = 0; ii < countof(_unpack_threads); ++ii)
+			_unpack_threads[ii].start([](void *thiz) { return ((ResourceLoader *)thiz)->run_unpack(); }, this);
+	}
+
 	_thread.start([](void *thiz) { return ((ResourceLoader *)thiz)->run(); }, this);
 }
 
@@ -43,6 +59,14 @@ ResourceLoader::~ResourceLoader()
 	_exit = true;
 	_requests_condition.signal(); // Spurious wake to exit thread
 	_thread.stop();
+
+	// The loader thread has stopped: no resource is being decompressed.
+	if (_is_bundle) {
+		_unpack_exit = true;
+		_unpack_begin.post(countof(_unpack_threads));
+		for (u32 ii = 0; ii < countof(_unpack_threads); ++ii)
+			_unpack_threads[ii].stop();
+	}
 }
 
 bool ResourceLoader::add_request(const ResourceRequest &rr)
@@ -59,6 +83,54 @@ void ResourceLoader::register_fallback(StringId64 type, StringId64 name)
 	hash_map::set(_fallback, type, name);
 }
 
+s32 ResourceLoader::run_unpack()
+{
+	while (1) {
+		_unpack_begin.wait();
+		if (_unpack_exit)
+			break;
+
+		unpack_blocks();
+		_unpack_end.post();
+	}
+
+	return 0;
+}
+
+void ResourceLoader::unpack_blocks()
+{
+	const u32 num_blocks = package_resource::num_blocks(_unpack_resource);
+
+	u32 block;
+	while ((block = _unpack_next_block.fetch_add(1)) < num_blocks) {
+		if (!package_resource::decompress_block(_unpack_dst, _unpack_package, _unpack_resource, block))
+			_unpack_failed = true;
+	}
+}
+
+bool ResourceLoader::unpack(void *dst, const PackageResource *pr, const ResourceOffset *ro)
+{
+	const s64 time_start = time::now();
+
+	_unpack_dst = dst;
+	_unpack_package = pr;
+	_unpack_resource = ro;
+	_unpack_next_block = 0;
+	_unpack_failed = false;
+
+	// Only wake as many threads as there are blocks left for them.
+	const u32 num_threads = min(package_resource::num_blocks(ro) - 1, u32(countof(_unpack_threads)));
+	_unpack_begin.post(num_threads);
+	unpack_blocks();
+	for (u32 ii = 0; ii < num_threads; ++ii)
+		_unpack_end.wait();
+
+	_unpacked_size += ro->size;
+	_packed_size += ro->packed_size;
+	_unpack_time += time::now() - time_start;
+	return !_unpack_failed;
+}
+
 s32 ResourceLoader::run()
 {
 	while (1) {
@@ -79,7 +151,18 @@ s32 ResourceLoader::run()
 			destination_path(path, res_id);
 
 			if (_is_bundle) {
-				if (rr.type == RESOURCE_TYPE_PACKAGE || rr.type == RESOURCE_TYPE_CONFIG) {
+				// Map packages so that the resources they contain can be
+				// used in place, without reading the whole bundle upfront.
+				FileMemory *mapped = NULL;
+				if (rr.type == RESOURCE_TYPE_PACKAGE && rr.load_function == NULL)
+					mapped = _data_filesystem.map(path.c_str());
+
+				if (mapped != NULL) {
+					rr.allocator = NULL;
+					rr.data = (void *)mapped->_memory;
+					rr.file = mapped;
+					CE_ASSERT(*(u32 *)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
+				} else if (rr.type == RESOURCE_TYPE_PACKAGE || rr.type == RESOURCE_TYPE_CONFIG) {
 					File *file = _data_filesystem.open(path.c_str(), FileOpenMode::READ);
 					CE_ASSERT(file->is_open(), "Cannot load " RESOURCE_ID_FMT, res_id);
 
@@ -99,23 +182,33 @@ s32 ResourceLoader::run()
 					const PackageResource *pkg = (PackageResource *)rr.resource_manager->get(RESOURCE_TYPE_PACKAGE, rr.package_name);
 
 					// Find the resource inside the package.
-					for (u32 ii = 0; ii < pkg->num_resources; ++ii) {
-						const ResourceOffset *offt = package_resource::resource_offset(pkg, ii);
-						if (offt->type == rr.type && offt->name == rr.name) {
-							const void *resource_data = package_resource::data(pkg) + offt->offset;
-
-							// Load the resource.
-							if (rr.load_function) {
-								FileMemory fm(resource_data, offt->size);
-								rr.data = rr.load_function(fm, *rr.allocator);
-							} else {
-								rr.allocator = NULL;
-								rr.data = (void *)resource_data;
-								CE_ASSERT(*(u32 *)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
-							}
-
-							break;
-						}
+					const ResourceOffset *offt = package_resource::find(pkg, rr.type, rr.name);
+					CE_ASSERT(offt != NULL, "Resource not in package: " RESOURCE_ID_FMT, res_id._id);
+					const void *resource_data = package_resource::data(pkg) + offt->offset;
+
+					// Decompress the resource in the resource heap if it is the
+					// final destination of the data, in a temporary buffer otherwise.
+					void *unpacked = NULL;
+					Allocator &unpack_allocator = rr.load_function ? default_allocator() : *rr.allocator;
+					if (offt->packed_size != offt->size) {
+						unpacked = unpack_allocator.allocate(offt->size, 16);
+						const bool success = unpack(unpacked, pkg, offt);
+						CE_ASSERT(success, "Corrupted resource: " RESOURCE_ID_FMT, res_id._id);
+						CE_UNUSED(success);
+						resource_data = unpacked;
+					}
+
+					// Load the resource.
+					if (rr.load_function) {
+						FileMemory fm(resource_data, offt->size);
+						rr.data = rr.load_function(fm, *rr.allocator);
+						if (unpacked != NULL)
+							unpack_allocator.deallocate(unpacked);
+					} else {
+						if (unpacked == NULL)
+							rr.allocator = NULL;
+						rr.data = (void *)resource_data;
+						CE_ASSERT(*(u32 *)rr.data == RESOURCE_HEADER(rr.version), "Wrong version");
 					}
 				}
 			} else {
@@ -5,15 +5,18 @@
 
 #pragma once
 
+#include "config.h"
 #include "core/containers/types.h"
 #include "core/filesystem/types.h"
 #include "core/strings/string_id.h"
 #include "core/thread/condition_variable.h"
 #include "core/thread/mutex.h"
+#include "core/thread/semaphore.h"
 #include "core/thread/spsc_queue.inl"
 #include "core/thread/thread.h"
 #include "core/types.h"
 #include "resource/types.h"
+#include <atomic>
 
 namespace crown
 {
@@ -29,6 +32,7 @@ struct ResourceRequest
 	LoadFunction load_function;
 	Allocator *allocator;
 	void *data;
+	File *file;      ///< File mapped in memory holding data, or NULL.
 };
 
 /// Loads resources in a background thread.
@@ -48,12 +52,39 @@ struct ResourceLoader
 	ConditionVariable _requests_condition;
 	bool _exit;
 
+	// Blocks of a compressed resource are decompressed by the loader thread
+	// and the unpack threads together.
+	Thread _unpack_threads[CROWN_RESOURCE_LOADER_UNPACK_THREADS];
+	Semaphore _unpack_begin;
+	Semaphore _unpack_end;
+	bool _unpack_exit;
+	void *_unpack_dst;
+	const PackageResource *_unpack_package;
+	const ResourceOffset *_unpack_resource;
+	std::atomic_uint _unpack_next_block;
+	std::atomic_bool _unpack_failed;
+
+	// Decompression stats.
+	std::atomic<u64> _unpacked_size;
+	std::atomic<u64> _packed_size;
+	std::atomic<s64> _unpack_time;
+
 	///
 	void add_loaded(ResourceRequest rr);
 
 	/// Do not call explicitly.
 	s32 run();
 
+	/// Do not call explicitly.
+	s32 run_unpack();
+
+	/// Decompresses the blocks of the current resource until none is left.
+	void unpack_blocks();
+
+	/// Decompresses the resource @a ro of the package @a pr into @a dst.
+	/// Returns false if the resource is corrupted.
+	bool unpack(void *dst, const PackageResource *pr, const ResourceOffset *ro);
+
 	/// Read resources from @a data_filesystem. Is bundle specifies whether
 	/// the filesystem contains bundled data.
 	explicit ResourceLoader(Filesystem &data_filesystem, bool is_bundle);
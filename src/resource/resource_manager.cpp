@@ -5,6 +5,7 @@
 
 #include "core/containers/array.inl"
 #include "core/containers/hash_map.inl"
+#include "core/filesystem/filesystem.h"
 #include "core/memory/temp_allocator.inl"
 #include "core/strings/dynamic_string.inl"
 #include "core/strings/string_id.inl"
@@ -35,7 +36,7 @@ bool operator==(const ResourceManager::ResourceEntry &a, const ResourceManager::
 		;
 }
 
-const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL, NULL };
+const ResourceManager::ResourceEntry ResourceManager::ResourceEntry::NOT_FOUND = { 0xffffffffu, NULL, NULL, NULL };
 
 template<>
 struct hash<ResourceManager::ResourcePair>
@@ -65,7 +66,7 @@ ResourceManager::~ResourceManager()
 		const StringId64 type = cur->first.type;
 		const StringId64 name = cur->first.name;
 		on_offline(type, name);
-		on_unload(type, cur->second.allocator, cur->second.data);
+		on_unload(type, cur->second);
 	}
 }
 
@@ -92,6 +93,7 @@ bool ResourceManager::try_load(StringId64 package_name, StringId64 type, StringI
 		rr.load_function = rtd.load;
 		rr.allocator = &_resource_heap;
 		rr.data = NULL;
+		rr.file = NULL;
 
 		return _loader->add_request(rr);
 	}
@@ -107,7 +109,7 @@ void ResourceManager::unload(StringId64 type, StringId64 name)
 
 	if (--entry.references == 0) {
 		on_offline(type, name);
-		on_unload(type, entry.allocator, entry.data);
+		on_unload(type, entry);
 
 		hash_map::remove(_rm, id);
 	}
@@ -175,6 +177,7 @@ void ResourceManager::complete_requests()
 		entry.references = 1;
 		entry.data = rr.data;
 		entry.allocator = rr.allocator;
+		entry.file = rr.file;
 
 		ResourcePair id = { rr.type, rr.name };
 
@@ -212,17 +215,22 @@ void ResourceManager::on_offline(StringId64 type, StringId64 name)
 		func(name, *this);
 }
 
-void ResourceManager::on_unload(StringId64 type, Allocator *allocator, void *data)
+void ResourceManager::on_unload(StringId64 type, const ResourceEntry &entry)
 {
-	if (allocator == NULL)
+	if (entry.file != NULL) {
+		_loader->_data_filesystem.close(*entry.file);
+		return;
+	}
+
+	if (entry.allocator == NULL)
 		return;
 
 	UnloadFunction func = hash_map::get(_type_data, type, ResourceTypeData()).unload;
 
 	if (func)
-		func(*allocator, data);
+		func(*entry.allocator, entry.data);
 	else
-		allocator->deallocate(data);
+		entry.allocator->deallocate(entry.data);
 }
 
 } // namespace crown
@@ -38,6 +38,7 @@ struct ResourceManager
 		u32 references;
 		Allocator *allocator;
 		void *data;
+		File *file;      ///< File mapped in memory holding data, or NULL.
 
 		static const ResourceEntry NOT_FOUND;
 	};
@@ -62,7 +63,7 @@ struct ResourceManager
 
 	void on_online(StringId64 type, StringId64 name);
 	void on_offline(StringId64 type, StringId64 name);
-	void on_unload(StringId64 type, Allocator *allocator, void *data);
+	void on_unload(StringId64 type, const ResourceEntry &entry);
 
 	/// Uses @a rl to load resources.
 	explicit ResourceManager(ResourceLoader &rl);
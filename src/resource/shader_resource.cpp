@@ -1200,17 +1200,18 @@ namespace shader_resource_internal
 
 			StringStream vs_code(default_allocator());
 			StringStream fs_code(default_allocator());
-			vs_code << shader._vs_input_output.c_str();
+			// Defines come first so that $input/$output can depend on them.
 			for (u32 i = 0; i < vector::size(defines); ++i) {
 				vs_code << "#define " << defines[i].c_str() << "\n";
 			}
+			vs_code << shader._vs_input_output.c_str();
 			vs_code << included_code.c_str();
 			vs_code << shader._code.c_str();
 			vs_code << shader._vs_code.c_str();
-			fs_code << shader._fs_input_output.c_str();
 			for (u32 i = 0; i < vector::size(defines); ++i) {
 				fs_code << "#define " << defines[i].c_str() << "\n";
 			}
+			fs_code << shader._fs_input_output.c_str();
 			fs_code << included_code.c_str();
 			fs_code << shader._code.c_str();
 			fs_code << shader._fs_code.c_str();
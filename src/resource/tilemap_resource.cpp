@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+#include "core/containers/array.inl"
+#include "core/json/json_object.inl"
+#include "core/json/sjson.h"
+#include "core/math/vector2.inl"
+#include "core/memory/temp_allocator.inl"
+#include "resource/compile_options.inl"
+#include "resource/tilemap_resource.h"
+
+namespace crown
+{
+namespace tilemap_resource
+{
+	u32 num_chunks(const TilemapResource *tr)
+	{
+		return tr->num_chunks_x * tr->num_chunks_y;
+	}
+
+	u32 num_chunk_tiles(const TilemapResource *tr)
+	{
+		return tr->num_layers * tr->chunk_size * tr->chunk_size;
+	}
+
+	const u16 *tiles(const TilemapResource *tr)
+	{
+		return (u16 *)&tr[1];
+	}
+
+	u32 tile_offset(const TilemapResource *tr, u32 layer, u32 x, u32 y)
+	{
+		CE_ENSURE(layer < tr->num_layers);
+		CE_ENSURE(x < tr->width);
+		CE_ENSURE(y < tr->height);
+
+		const u32 cs = tr->chunk_size;
+		const u32 chunk = (y / cs)*tr->num_chunks_x + x / cs;
+		return chunk*num_chunk_tiles(tr) + (layer*cs + y % cs)*cs + x % cs;
+	}
+
+} // namespace tilemap_resource
+
+#if CROWN_CAN_COMPILE
+namespace tilemap_resource_internal
+{
+	s32 compile(CompileOptions &opts)
+	{
+		Buffer buf = opts.read();
+
+		TempAllocator4096 ta;
+		JsonObject obj(ta);
+		sjson::parse(obj, buf);
+
+		JsonObject tileset(ta);
+		sjson::parse_object(tileset, obj["tileset"]);
+		const f32 tileset_width  = sjson::parse_float(tileset["width"]);
+		const f32 tileset_height = sjson::parse_float(tileset["height"]);
+		const f32 tile_width     = sjson::parse_float(tileset["tile_width"]);
+		const f32 tile_height    = sjson::parse_float(tileset["tile_height"]);
+		DATA_COMPILER_ASSERT(tile_width > 0.0f && tile_height > 0.0f
+			, opts
+			, "Tile size must be greater than zero"
+			);
+
+		JsonArray layers(ta);
+		sjson::parse_array(layers, obj["layers"]);
+
+		TilemapResource tr;
+		tr.version         = RESOURCE_HEADER(RESOURCE_VERSION_TILEMAP);
+		tr.width           = sjson::parse_int(obj["width"]);
+		tr.height          = sjson::parse_int(obj["height"]);
+		tr.num_layers      = array::size(layers);
+		tr.chunk_size      = CROWN_TILEMAP_CHUNK_SIZE;
+		tr.num_chunks_x    = (tr.width + tr.chunk_size - 1) / tr.chunk_size;
+		tr.num_chunks_y    = (tr.height + tr.chunk_size - 1) / tr.chunk_size;
+		tr.tileset_columns = u32(tileset_width / tile_width);
+		tr.tile_size       = vector2(tile_width / CROWN_DEFAULT_PIXELS_PER_METER, tile_height / CROWN_DEFAULT_PIXELS_PER_METER);
+		tr.tile_uv_size    = vector2(tile_width / tileset_width, tile_height / tileset_height);
+
+		// Each chunk is drawn with 16-bit indices.
+		DATA_COMPILER_ASSERT(tilemap_resource::num_chunk_tiles(&tr)*4 <= UINT16_MAX + 1u
+			, opts
+			, "Too many layers: %u"
+			, tr.num_layers
+			);
+
+		// Pack the rows of each layer into chunks. Tiles outside the map in
+		// the last row and column of chunks are left empty.
+		Array<u16> tiles(default_allocator());
+		array::resize(tiles, tilemap_resource::num_chunks(&tr) * tilemap_resource::num_chunk_tiles(&tr));
+		memset(array::begin(tiles), 0, array::size(tiles)*sizeof(u16));
+
+		const u32 num_cells = tr.tileset_columns * u32(tileset_height / tile_height);
+		for (u32 ll = 0; ll < tr.num_layers; ++ll) {
+			TempAllocator512 tal;
+			JsonObject layer(tal);
+			sjson::parse_object(layer, layers[ll]);
+
+			JsonArray layer_tiles(default_allocator());
+			sjson::parse_array(layer_tiles, layer["tiles"]);
+			DATA_COMPILER_ASSERT(array::size(layer_tiles) == tr.width * tr.height
+				, opts
+				, "Layer %u must have width * height tiles"
+				, ll
+				);
+
+			for (u32 yy = 0; yy < tr.height; ++yy) {
+				for (u32 xx = 0; xx < tr.width; ++xx) {
+					const s32 tile = sjson::parse_int(layer_tiles[yy*tr.width + xx]);
+					DATA_COMPILER_ASSERT(tile >= 0 && u32(tile) <= num_cells
+						, opts
+						, "Tile out of tileset: %d"
+						, tile
+						);
+
+					tiles[tilemap_resource::tile_offset(&tr, ll, xx, yy)] = u16(tile);
+				}
+			}
+		}
+
+		opts.write(tr.version);
+		opts.write(tr.width);
+		opts.write(tr.height);
+		opts.write(tr.num_layers);
+		opts.write(tr.chunk_size);
+		opts.write(tr.num_chunks_x);
+		opts.write(tr.num_chunks_y);
+		opts.write(tr.tileset_columns);
+		opts.write(tr.tile_size);
+		opts.write(tr.tile_uv_size);
+		opts.write(array::begin(tiles), array::size(tiles)*sizeof(u16));
+
+		return 0;
+	}
+
+} // namespace tilemap_resource_internal
+#endif // if CROWN_CAN_COMPILE
+
+} // namespace crown
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/math/types.h"
+#include "core/types.h"
+#include "resource/types.h"
+
+namespace crown
+{
+/// Grid of tiles drawn from a tileset texture.
+///
+/// Tiles are stored in square chunks of chunk_size tiles per side, each
+/// holding the tiles of all the layers. A tile is 0 if empty or the index
+/// plus one of its cell in the tileset, counting left to right, top to
+/// bottom.
+struct TilemapResource
+{
+	u32 version;
+	u32 width;            ///< Width in tiles.
+	u32 height;           ///< Height in tiles.
+	u32 num_layers;
+	u32 chunk_size;       ///< Width and height of a chunk in tiles.
+	u32 num_chunks_x;
+	u32 num_chunks_y;
+	u32 tileset_columns;  ///< Number of cells in a row of the tileset.
+	Vector2 tile_size;    ///< Size of a tile in meters.
+	Vector2 tile_uv_size; ///< Size of a cell in the tileset texture.
+	// u16 tiles[num_chunks_y][num_chunks_x][num_layers][chunk_size][chunk_size]
+};
+
+namespace tilemap_resource_internal
+{
+	s32 compile(CompileOptions &opts);
+
+} // namespace tilemap_resource_internal
+
+namespace tilemap_resource
+{
+	/// Returns the number of chunks in the tilemap @a tr.
+	u32 num_chunks(const TilemapResource *tr);
+
+	/// Returns the number of tiles in each chunk of the tilemap @a tr.
+	u32 num_chunk_tiles(const TilemapResource *tr);
+
+	/// Returns the tiles of the tilemap @a tr.
+	const u16 *tiles(const TilemapResource *tr);
+
+	/// Returns the offset into tiles() of the tile at column @a x and row
+	/// @a y of @a layer.
+	u32 tile_offset(const TilemapResource *tr, u32 layer, u32 x, u32 y);
+
+} // namespace tilemap_resource
+
+} // namespace crown
@@ -26,13 +26,16 @@ struct LuaResource;
 struct MaterialResource;
 struct MeshResource;
 struct PackageResource;
+struct ParticleSystemResource;
 struct PhysicsConfigResource;
+struct ResourceOffset;
 struct ShaderResource;
 struct ShapeResource;
 struct SoundResource;
 struct SpriteAnimationResource;
 struct SpriteResource;
 struct TextureResource;
+struct TilemapResource;
 struct UnitResource;
 
 struct Platform
@@ -61,6 +64,7 @@ struct Platform
 #define RESOURCE_TYPE_MATERIAL         STRING_ID_64("material",         UINT64_C(0xeac0b497876adedf))
 #define RESOURCE_TYPE_MESH             STRING_ID_64("mesh",             UINT64_C(0x48ff313713a997a1))
 #define RESOURCE_TYPE_PACKAGE          STRING_ID_64("package",          UINT64_C(0xad9c6d9ed1e5e77a))
+#define RESOURCE_TYPE_PARTICLE_SYSTEM  STRING_ID_64("particle_system",  UINT64_C(0x98654f88cc53e046))
 #define RESOURCE_TYPE_PHYSICS_CONFIG   STRING_ID_64("physics_config",   UINT64_C(0x72e3cc03787a11a1))
 #define RESOURCE_TYPE_SCRIPT           STRING_ID_64("lua",              UINT64_C(0xa14e8dfa2cd117e2))
 #define RESOURCE_TYPE_SHADER           STRING_ID_64("shader",           UINT64_C(0xcce8d5b5f5ae333f))
@@ -68,6 +72,7 @@ struct Platform
 #define RESOURCE_TYPE_SPRITE_ANIMATION STRING_ID_64("sprite_animation", UINT64_C(0x487e78e3f87f238d))
 #define RESOURCE_TYPE_SPRITE           STRING_ID_64("sprite",           UINT64_C(0x8d5871f9ebdb651c))
 #define RESOURCE_TYPE_TEXTURE          STRING_ID_64("texture",          UINT64_C(0xcd4238c6a0c69e32))
+#define RESOURCE_TYPE_TILEMAP          STRING_ID_64("tilemap",          UINT64_C(0x3c40e019516c1a0e))
 
 #define RESOURCE_NAME_INVALID StringId64(u64(0))
 #define PACKAGE_RESOURCE_NONE RESOURCE_NAME_INVALID
@@ -77,18 +82,20 @@ struct Platform
 #define RESOURCE_VERSION_STATE_MACHINE    RESOURCE_VERSION(5)
 #define RESOURCE_VERSION_CONFIG           RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_FONT             RESOURCE_VERSION(1)
-#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(9)
+#define RESOURCE_VERSION_UNIT             RESOURCE_VERSION(10)
 #define RESOURCE_VERSION_LEVEL            (RESOURCE_VERSION_UNIT + 4) //!< Level embeds UnitResource
-#define RESOURCE_VERSION_MATERIAL         RESOURCE_VERSION(4)
-#define RESOURCE_VERSION_MESH             RESOURCE_VERSION(5)
-#define RESOURCE_VERSION_PACKAGE          RESOURCE_VERSION(6)
+#define RESOURCE_VERSION_MATERIAL         RESOURCE_VERSION(5)
+#define RESOURCE_VERSION_MESH             RESOURCE_VERSION(6)
+#define RESOURCE_VERSION_PACKAGE          RESOURCE_VERSION(8)
+#define RESOURCE_VERSION_PARTICLE_SYSTEM  RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_PHYSICS_CONFIG   RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_SCRIPT           RESOURCE_VERSION(4)
-#define RESOURCE_VERSION_SHADER           RESOURCE_VERSION(12)
+#define RESOURCE_VERSION_SHADER           RESOURCE_VERSION(13)
 #define RESOURCE_VERSION_SOUND            RESOURCE_VERSION(1)
 #define RESOURCE_VERSION_SPRITE_ANIMATION RESOURCE_VERSION(2)
 #define RESOURCE_VERSION_SPRITE           RESOURCE_VERSION(3)
 #define RESOURCE_VERSION_TEXTURE          RESOURCE_VERSION(8)
+#define RESOURCE_VERSION_TILEMAP          RESOURCE_VERSION(1)
 
 #define RESOURCE_MAGIC                    u32(0x9B) //!< Non-UTF8 to early out on file type detection
 #define RESOURCE_HEADER(version)          u32((version & 0x00ffffff) << 8 | RESOURCE_MAGIC)
@@ -149,9 +149,9 @@ static s32 compile_mesh_renderer(Buffer &output, const char *json, CompileOption
 	mrd.material_resource = sjson::parse_resource_name(obj["material"]);
 	mrd.geometry_name     = sjson::parse_string_id    (obj["geometry_name"]);
 	mrd.visible           = sjson::parse_bool         (obj["visible"]);
+	mrd.occluder          = json_object::has(obj, "occluder") ? sjson::parse_bool(obj["occluder"]) : false;
 	mrd._pad0[0]          = 0;
 	mrd._pad0[1]          = 0;
-	mrd._pad0[2]          = 0;
 
 	FileBuffer fb(output);
 	BinaryWriter bw(fb);
@@ -159,9 +159,9 @@ static s32 compile_mesh_renderer(Buffer &output, const char *json, CompileOption
 	bw.write(mrd.material_resource);
 	bw.write(mrd.geometry_name);
 	bw.write(mrd.visible);
+	bw.write(mrd.occluder);
 	bw.write(mrd._pad0[0]);
 	bw.write(mrd._pad0[1]);
-	bw.write(mrd._pad0[2]);
 	return 0;
 }
 
@@ -218,6 +218,108 @@ static s32 compile_sprite_renderer(Buffer &output, const char *json, CompileOpti
 	return 0;
 }
 
+static s32 compile_tilemap_renderer(Buffer &output, const char *json, CompileOptions &opts)
+{
+	TempAllocator4096 ta;
+	JsonObject obj(ta);
+	sjson::parse(obj, json);
+
+	DynamicString tilemap_resource(ta);
+	sjson::parse_string(tilemap_resource, obj["tilemap_resource"]);
+	DATA_COMPILER_ASSERT_RESOURCE_EXISTS("tilemap"
+		, tilemap_resource.c_str()
+		, opts
+		);
+	opts.add_requirement("tilemap", tilemap_resource.c_str());
+
+	DynamicString material(ta);
+	sjson::parse_string(material, obj["material"]);
+	DATA_COMPILER_ASSERT_RESOURCE_EXISTS("material"
+		, material.c_str()
+		, opts
+		);
+	opts.add_requirement("material", material.c_str());
+
+	TilemapRendererDesc trd;
+	trd.tilemap_resource  = sjson::parse_resource_name(obj["tilemap_resource"]);
+	trd.material_resource = sjson::parse_resource_name(obj["material"]);
+	trd.layer             = sjson::parse_int          (obj["layer"]);
+	trd.depth             = sjson::parse_int          (obj["depth"]);
+	trd.visible           = sjson::parse_bool         (obj["visible"]);
+	trd._pad0[0]          = 0;
+	trd._pad0[1]          = 0;
+	trd._pad0[2]          = 0;
+	trd._pad1[0]          = 0;
+	trd._pad1[1]          = 0;
+	trd._pad1[2]          = 0;
+	trd._pad1[3]          = 0;
+
+	FileBuffer fb(output);
+	BinaryWriter bw(fb);
+	bw.write(trd.tilemap_resource);
+	bw.write(trd.material_resource);
+	bw.write(trd.layer);
+	bw.write(trd.depth);
+	bw.write(trd.visible);
+	bw.write(trd._pad0[0]);
+	bw.write(trd._pad0[1]);
+	bw.write(trd._pad0[2]);
+	bw.write(trd._pad1[0]);
+	bw.write(trd._pad1[1]);
+	bw.write(trd._pad1[2]);
+	bw.write(trd._pad1[3]);
+	return 0;
+}
+
+static s32 compile_particle_system(Buffer &output, const char *json, CompileOptions &opts)
+{
+	TempAllocator4096 ta;
+	JsonObject obj(ta);
+	sjson::parse(obj, json);
+
+	DynamicString particle_system_resource(ta);
+	sjson::parse_string(particle_system_resource, obj["particle_system_resource"]);
+	DATA_COMPILER_ASSERT_RESOURCE_EXISTS("particle_system"
+		, particle_system_resource.c_str()
+		, opts
+		);
+	opts.add_requirement("particle_system", particle_system_resource.c_str());
+
+	DynamicString material(ta);
+	sjson::parse_string(material, obj["material"]);
+	DATA_COMPILER_ASSERT_RESOURCE_EXISTS("material"
+		, material.c_str()
+		, opts
+		);
+	opts.add_requirement("material", material.c_str());
+
+	ParticleSystemDesc psd;
+	psd.particle_system_resource = sjson::parse_resource_name(obj["particle_system_resource"]);
+	psd.material_resource        = sjson::parse_resource_name(obj["material"]);
+	psd.visible                  = sjson::parse_bool         (obj["visible"]);
+	psd._pad0[0]                 = 0;
+	psd._pad0[1]                 = 0;
+	psd._pad0[2]                 = 0;
+	psd._pad1[0]                 = 0;
+	psd._pad1[1]                 = 0;
+	psd._pad1[2]                 = 0;
+	psd._pad1[3]                 = 0;
+
+	FileBuffer fb(output);
+	BinaryWriter bw(fb);
+	bw.write(psd.particle_system_resource);
+	bw.write(psd.material_resource);
+	bw.write(psd.visible);
+	bw.write(psd._pad0[0]);
+	bw.write(psd._pad0[1]);
+	bw.write(psd._pad0[2]);
+	bw.write(psd._pad1[0]);
+	bw.write(psd._pad1[1]);
+	bw.write(psd._pad1[2]);
+	bw.write(psd._pad1[3]);
+	return 0;
+}
+
 static s32 compile_light(Buffer &output, const char *json, CompileOptions &opts)
 {
 	TempAllocator4096 ta;
@@ -309,6 +411,8 @@ UnitCompiler::UnitCompiler(CompileOptions &opts)
 	register_component_compiler("camera",                  &compile_camera,                              1.0f);
 	register_component_compiler("mesh_renderer",           &compile_mesh_renderer,                       1.0f);
 	register_component_compiler("sprite_renderer",         &compile_sprite_renderer,                     1.0f);
+	register_component_compiler("tilemap_renderer",        &compile_tilemap_renderer,                    1.0f);
+	register_component_compiler("particle_system",         &compile_particle_system,                     1.0f);
 	register_component_compiler("light",                   &compile_light,                               1.0f);
 	register_component_compiler("script",                  &compile_script,                              1.0f);
 	register_component_compiler("collider",                &physics_resource_internal::compile_collider, 1.0f);
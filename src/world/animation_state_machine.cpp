@@ -4,7 +4,6 @@
  */
 
 #include "core/containers/array.inl"
-#include "core/containers/hash_map.inl"
 #include "core/containers/types.h"
 #include "core/memory/globals.h"
 #include "core/strings/string_id.inl"
@@ -16,6 +15,7 @@
 #include "world/event_stream.inl"
 #include "world/types.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 
 namespace crown
 {
@@ -52,7 +52,7 @@ AnimationStateMachine::~AnimationStateMachine()
 
 StateMachineInstance AnimationStateMachine::create(UnitId unit, const AnimationStateMachineDesc &desc)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a state machine component");
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a state machine component");
 
 	const StateMachineResource *smr = (StateMachineResource *)_resource_manager->get(RESOURCE_TYPE_STATE_MACHINE, desc.state_machine_resource);
 
@@ -72,7 +72,7 @@ StateMachineInstance AnimationStateMachine::create(UnitId unit, const AnimationS
 
 	u32 last = array::size(_animations);
 	array::push_back(_animations, anim);
-	hash_map::set(_map, unit, last);
+	unit_map::set(_map, unit, last);
 
 	return make_instance(last);
 }
@@ -87,18 +87,18 @@ void AnimationStateMachine::destroy(StateMachineInstance state_machine)
 	_animations[state_machine.i] = _animations[last_i];
 
 	array::pop_back(_animations);
-	hash_map::set(_map, last_u, state_machine.i);
-	hash_map::remove(_map, u);
+	unit_map::set(_map, last_u, state_machine.i);
+	unit_map::remove(_map, u);
 }
 
 StateMachineInstance AnimationStateMachine::instance(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
 }
 
 bool AnimationStateMachine::has(UnitId unit)
 {
-	return hash_map::has(_map, unit);
+	return unit_map::has(_map, unit);
 }
 
 u32 AnimationStateMachine::variable_id(StateMachineInstance state_machine, StringId32 name)
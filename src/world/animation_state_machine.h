@@ -10,6 +10,7 @@
 #include "resource/types.h"
 #include "world/event_stream.h"
 #include "world/types.h"
+#include "world/unit_map.h"
 
 namespace crown
 {
@@ -38,7 +39,7 @@ struct AnimationStateMachine
 	u32 _marker;
 	ResourceManager *_resource_manager;
 	UnitManager *_unit_manager;
-	HashMap<UnitId, u32> _map;
+	UnitMap _map;
 	Array<Animation> _animations;
 	EventStream _events;
 	UnitDestroyCallback _unit_destroy_callback;
@@ -3,14 +3,17 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include "core/containers/array.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
 #include "core/math/frustum.inl"
 #include "core/math/intersection.h"
 #include "core/math/math.h"
+#include "core/math/matrix3x3.inl"
 #include "core/math/matrix4x4.inl"
 #include "core/math/obb.inl"
 #include "core/math/vector3.inl"
+#include "core/math/vector4.inl"
 #include "core/strings/string_id.inl"
 #include "device/pipeline.h"
 #include "resource/mesh_resource.h"
@@ -23,11 +26,114 @@
 
 namespace crown
 {
-DebugLine::DebugLine(ShaderManager &sm, bool depth_test)
+/// Line lists of the unit primitives. See DebugLine::PrimitiveType.
+struct UnitPrimitives
+{
+	static const u32 NUM_LINES = 0
+		+ DebugLine::NUM_SEGMENTS   // CIRCLE
+		+ DebugLine::NUM_SEGMENTS*3 // SPHERE
+		+ 12                        // BOX
+		+ DebugLine::NUM_SEGMENTS*2 // CONE
+		;
+
+	DebugLine::Line lines[NUM_LINES];
+	Vector3 points[NUM_LINES*2]; ///< Ends of each line in lines, packed for transform_points().
+	u32 first[DebugLine::PrimitiveType::COUNT + 1]; ///< First line of each primitive.
+
+	UnitPrimitives()
+	{
+		u32 num = 0;
+
+		first[DebugLine::PrimitiveType::CIRCLE] = num;
+		add_circle(num, MATRIX3X3_IDENTITY, VECTOR3_ZERO, false);
+
+		// Circles around the x, y and z axes.
+		first[DebugLine::PrimitiveType::SPHERE] = num;
+		add_circle(num, { VECTOR3_YAXIS, VECTOR3_ZAXIS, VECTOR3_XAXIS }, VECTOR3_ZERO, false);
+		add_circle(num, { VECTOR3_ZAXIS, VECTOR3_XAXIS, VECTOR3_YAXIS }, VECTOR3_ZERO, false);
+		add_circle(num, MATRIX3X3_IDENTITY, VECTOR3_ZERO, false);
+
+		first[DebugLine::PrimitiveType::BOX] = num;
+		for (u32 i = 0; i < 4; ++i) {
+			const f32 a = (i & 1) ? 1.0f : -1.0f;
+			const f32 b = (i & 2) ? 1.0f : -1.0f;
+			add_line(num, vector3(-1.0f, a, b), vector3(1.0f, a, b));
+			add_line(num, vector3(a, -1.0f, b), vector3(a, 1.0f, b));
+			add_line(num, vector3(a, b, -1.0f), vector3(a, b, 1.0f));
+		}
+
+		first[DebugLine::PrimitiveType::CONE] = num;
+		add_circle(num, MATRIX3X3_IDENTITY, VECTOR3_ZAXIS, true);
+
+		first[DebugLine::PrimitiveType::COUNT] = num;
+		CE_ENSURE(num == NUM_LINES);
+	}
+
+	void add_line(u32 &num, const Vector3 &p0, const Vector3 &p1)
+	{
+		lines[num].p0 = p0;
+		lines[num].c0 = UINT32_MAX;
+		lines[num].p1 = p1;
+		lines[num].c1 = UINT32_MAX;
+		points[num*2 + 0] = p0;
+		points[num*2 + 1] = p1;
+		++num;
+	}
+
+	/// Adds a circle of radius 1 in the plane z = 0 rotated by @a m. If
+	/// @a spokes is true, each segment is also connected to @a tip.
+	void add_circle(u32 &num, const Matrix3x3 &m, const Vector3 &tip, bool spokes)
+	{
+		const f32 step = PI_TWO / f32(DebugLine::NUM_SEGMENTS);
+		for (u32 i = 0; i < DebugLine::NUM_SEGMENTS; ++i) {
+			const Vector3 from = vector3(fcos(step*i), fsin(step*i), 0.0f) * m;
+			const Vector3 to = vector3(fcos(step*(i + 1)), fsin(step*(i + 1)), 0.0f) * m;
+			add_line(num, from, to);
+			if (spokes)
+				add_line(num, from, tip);
+		}
+	}
+};
+
+static const UnitPrimitives &unit_primitives()
+{
+	static const UnitPrimitives up;
+	return up;
+}
+
+/// Returns the transform of a circle of @a radius at @a center whose axis
+/// is the normalized vector @a normal.
+static Matrix4x4 circle_tm(const Vector3 &center, f32 radius, const Vector3 &normal)
+{
+	const Vector3 arr[] =
+	{
+		{ normal.z,             normal.z, -normal.x - normal.y },
+		{ -normal.y - normal.z, normal.x, normal.x             }
+	};
+	const int idx = ((normal.z != 0.0f) && (-normal.x != normal.y));
+	Vector3 right = arr[idx];
+	normalize(right);
+
+	const Vector3 x = right * radius;
+	const Vector3 y = cross(right, normal) * radius;
+	const Vector3 z = normal * radius;
+
+	Matrix4x4 tm;
+	tm.x = vector4(x.x, x.y, x.z, 0.0f);
+	tm.y = vector4(y.x, y.y, y.z, 0.0f);
+	tm.z = vector4(z.x, z.y, z.z, 0.0f);
+	tm.t = vector4(center.x, center.y, center.z, 1.0f);
+	return tm;
+}
+
+DebugLine::DebugLine(Allocator &a, ShaderManager &sm, bool depth_test)
 	: _marker(DEBUG_LINE_MARKER)
 	, _shader_manager(&sm)
 	, _shader(depth_test ? "debug_line" : "debug_line_noz")
-	, _num(0)
+	, _shader_instanced(depth_test ? "debug_line+INSTANCED" : "debug_line_noz+INSTANCED")
+	, _primitives_vb(BGFX_INVALID_HANDLE)
+	, _lines(a)
+	, _primitives(a)
 {
 	_vertex_layout.begin();
 	_vertex_layout.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float);
@@ -37,20 +143,20 @@ DebugLine::DebugLine(ShaderManager &sm, bool depth_test)
 
 DebugLine::~DebugLine()
 {
+	if (bgfx::isValid(_primitives_vb))
+		bgfx::destroy(_primitives_vb);
+
 	_marker = 0;
 }
 
 void DebugLine::add_line(const Vector3 &start, const Vector3 &end, const Color4 &color)
 {
-	if (_num >= MAX_LINES)
-		return;
-
-	_lines[_num].p0 = start;
-	_lines[_num].c0 = to_abgr(color);
-	_lines[_num].p1 = end;
-	_lines[_num].c1 = to_abgr(color);
-
-	++_num;
+	Line line;
+	line.p0 = start;
+	line.c0 = to_abgr(color);
+	line.p1 = end;
+	line.c1 = line.c0;
+	array::push_back(_lines, line);
 }
 
 void DebugLine::add_axes(const Matrix4x4 &m, f32 length)
@@ -79,17 +185,14 @@ void DebugLine::add_arc(const Vector3 &center, f32 radius, const Vector3 &plane_
 
 void DebugLine::add_circle(const Vector3 &center, f32 radius, const Vector3 &normal, const Color4 &color, u32 segments)
 {
-	const Vector3 arr[] =
-	{
-		{ normal.z,             normal.z, -normal.x - normal.y },
-		{ -normal.y - normal.z, normal.x, normal.x             }
-	};
-	const int idx = ((normal.z != 0.0f) && (-normal.x != normal.y));
-	Vector3 right = arr[idx];
-	normalize(right);
+	if (segments == NUM_SEGMENTS) {
+		add_primitive(PrimitiveType::CIRCLE, circle_tm(center, radius, normal), color);
+		return;
+	}
 
-	const Vector3 x = right * radius;
-	const Vector3 y = cross(right, normal) * radius;
+	const Matrix4x4 tm = circle_tm(center, radius, normal);
+	const Vector3 x = vector3(tm.x.x, tm.x.y, tm.x.z);
+	const Vector3 y = vector3(tm.y.x, tm.y.y, tm.y.z);
 	const f32 step = PI_TWO / (f32)(segments > 3 ? segments : 3);
 	Vector3 from = center - y;
 
@@ -105,17 +208,19 @@ void DebugLine::add_cone(const Vector3 &base_center, const Vector3 &tip, f32 rad
 {
 	Vector3 normal = tip - base_center;
 	normalize(normal);
-	const Vector3 arr[] =
-	{
-		{ normal.z,             normal.z, -normal.x - normal.y },
-		{ -normal.y - normal.z, normal.x, normal.x             }
-	};
-	const int idx = ((normal.z != 0.0f) && (-normal.x != normal.y));
-	Vector3 right = arr[idx];
-	normalize(right);
 
-	const Vector3 x = right * radius;
-	const Vector3 y = cross(right, normal) * radius;
+	Matrix4x4 tm = circle_tm(base_center, radius, normal);
+
+	if (segments == NUM_SEGMENTS) {
+		// Stretch the unit cone so that its tip lands on tip.
+		const Vector3 axis = tip - base_center;
+		tm.z = vector4(axis.x, axis.y, axis.z, 0.0f);
+		add_primitive(PrimitiveType::CONE, tm, color);
+		return;
+	}
+
+	const Vector3 x = vector3(tm.x.x, tm.x.y, tm.x.z);
+	const Vector3 y = vector3(tm.y.x, tm.y.y, tm.y.z);
 	const f32 step = PI_TWO / (f32)(segments > 3 ? segments : 3);
 	Vector3 from = base_center - y;
 
@@ -130,6 +235,16 @@ void DebugLine::add_cone(const Vector3 &base_center, const Vector3 &tip, f32 rad
 
 void DebugLine::add_sphere(const Vector3 &center, const f32 radius, const Color4 &color, u32 segments)
 {
+	if (segments == NUM_SEGMENTS) {
+		Matrix4x4 tm = MATRIX4X4_IDENTITY;
+		tm.x.x = radius;
+		tm.y.y = radius;
+		tm.z.z = radius;
+		tm.t = vector4(center.x, center.y, center.z, 1.0f);
+		add_primitive(PrimitiveType::SPHERE, tm, color);
+		return;
+	}
+
 	add_circle(center, radius, VECTOR3_XAXIS, color, segments);
 	add_circle(center, radius, VECTOR3_YAXIS, color, segments);
 	add_circle(center, radius, VECTOR3_ZAXIS, color, segments);
@@ -159,26 +274,20 @@ void DebugLine::add_frustum(const Matrix4x4 &mvp, const Color4 &color)
 
 void DebugLine::add_obb(const Matrix4x4 &tm, const Vector3 &half_extents, const Color4 &color)
 {
-	Vector3 vertices[8];
-	obb::to_vertices(vertices, { tm, half_extents });
-
-	// Bottom face.
-	add_line(vertices[0], vertices[1], color);
-	add_line(vertices[1], vertices[2], color);
-	add_line(vertices[2], vertices[3], color);
-	add_line(vertices[3], vertices[0], color);
-
-	// Top face.
-	add_line(vertices[4], vertices[5], color);
-	add_line(vertices[5], vertices[6], color);
-	add_line(vertices[6], vertices[7], color);
-	add_line(vertices[7], vertices[4], color);
+	Matrix4x4 box = tm;
+	box.x *= half_extents.x;
+	box.y *= half_extents.y;
+	box.z *= half_extents.z;
+	add_primitive(PrimitiveType::BOX, box, color);
+}
 
-	// Connect faces.
-	add_line(vertices[0], vertices[4], color);
-	add_line(vertices[1], vertices[5], color);
-	add_line(vertices[2], vertices[6], color);
-	add_line(vertices[3], vertices[7], color);
+void DebugLine::add_primitive(PrimitiveType::Enum type, const Matrix4x4 &tm, const Color4 &color)
+{
+	Primitive p;
+	p.tm = tm;
+	p.color = color;
+	p.type = type;
+	array::push_back(_primitives, p);
 }
 
 void DebugLine::add_mesh(const Matrix4x4 &tm, const void *vertices, u32 stride, const u16 *indices, u32 num, const Color4 &color)
@@ -200,23 +309,90 @@ void DebugLine::add_mesh(const Matrix4x4 &tm, const void *vertices, u32 stride,
 
 void DebugLine::reset()
 {
-	_num = 0;
+	array::clear(_lines);
+	array::clear(_primitives);
 }
 
 void DebugLine::submit(u8 view_id)
 {
-	if (!_num)
+	const UnitPrimitives &up = unit_primitives();
+	const u32 num_primitives = array::size(_primitives);
+	const bool instancing = (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0
+		&& _shader_manager->has(_shader_instanced)
+		;
+
+	if (!instancing) {
+		// Tessellate primitives into lines.
+		Vector3 points[UnitPrimitives::NUM_LINES*2];
+		for (u32 i = 0; i < num_primitives; ++i) {
+			const Primitive &p = _primitives[i];
+			const u32 first = up.first[p.type];
+			const u32 num = up.first[p.type + 1] - first;
+			transform_points(points, up.points + first*2, num*2, p.tm);
+
+			const u32 abgr = to_abgr(p.color);
+			const u32 first_line = array::size(_lines);
+			array::resize(_lines, first_line + num);
+			for (u32 j = 0; j < num; ++j) {
+				Line &l = _lines[first_line + j];
+				l.p0 = points[j*2 + 0];
+				l.c0 = abgr;
+				l.p1 = points[j*2 + 1];
+				l.c1 = abgr;
+			}
+		}
+		array::clear(_primitives);
+	}
+
+	const u32 num_lines = min(array::size(_lines), bgfx::getAvailTransientVertexBuffer(array::size(_lines) * 2, _vertex_layout) / 2);
+	if (num_lines != 0) {
+		bgfx::TransientVertexBuffer tvb;
+		bgfx::allocTransientVertexBuffer(&tvb, num_lines * 2, _vertex_layout);
+		memcpy(tvb.data, array::begin(_lines), sizeof(Line) * num_lines);
+
+		bgfx::setVertexBuffer(0, &tvb, 0, num_lines * 2);
+		_shader_manager->submit(_shader, view_id);
+	}
+
+	if (!instancing || num_primitives == 0)
 		return;
 
-	if (!bgfx::getAvailTransientVertexBuffer(_num * 2, _vertex_layout))
+	if (!bgfx::isValid(_primitives_vb))
+		_primitives_vb = bgfx::createVertexBuffer(bgfx::makeRef(up.lines, sizeof(up.lines)), _vertex_layout);
+
+	// Instance data is the world matrix, then the color.
+	const u16 stride = sizeof(Matrix4x4) + sizeof(Color4);
+	const u32 num = bgfx::getAvailInstanceDataBuffer(num_primitives, stride);
+	if (num == 0)
 		return;
 
-	bgfx::TransientVertexBuffer tvb;
-	bgfx::allocTransientVertexBuffer(&tvb, _num * 2, _vertex_layout);
-	memcpy(tvb.data, _lines, sizeof(Line) * _num);
+	bgfx::InstanceDataBuffer idb;
+	bgfx::allocInstanceDataBuffer(&idb, num, stride);
+
+	// Group instances by primitive type.
+	u32 offset[PrimitiveType::COUNT + 1] = { 0 };
+	for (u32 i = 0; i < num; ++i)
+		++offset[_primitives[i].type + 1];
+	for (u32 t = 0; t < PrimitiveType::COUNT; ++t)
+		offset[t + 1] += offset[t];
+
+	u32 next[PrimitiveType::COUNT];
+	memcpy(next, offset, sizeof(next));
+	for (u32 i = 0; i < num; ++i) {
+		const Primitive &p = _primitives[i];
+		u8 *data = idb.data + next[p.type]++ * stride;
+		memcpy(data, &p.tm, sizeof(p.tm));
+		memcpy(data + sizeof(p.tm), &p.color, sizeof(p.color));
+	}
+
+	for (u32 t = 0; t < PrimitiveType::COUNT; ++t) {
+		if (offset[t] == offset[t + 1])
+			continue;
 
-	bgfx::setVertexBuffer(0, &tvb, 0, _num * 2);
-	_shader_manager->submit(_shader, view_id);
+		bgfx::setVertexBuffer(0, _primitives_vb, up.first[t]*2, (up.first[t + 1] - up.first[t])*2);
+		bgfx::setInstanceDataBuffer(&idb, offset[t], offset[t + 1] - offset[t]);
+		_shader_manager->submit(_shader_instanced, view_id);
+	}
 }
 
 } // namespace crown
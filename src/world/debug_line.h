@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "core/containers/types.h"
 #include "core/math/types.h"
 #include "core/strings/string_id.h"
 #include "core/types.h"
@@ -17,12 +18,15 @@ namespace crown
 {
 /// Draws lines.
 ///
+/// Circles, spheres, boxes and cones with the default number of segments are
+/// stored as transforms of unit primitives and drawn with instancing; all
+/// other shapes are tessellated into lines.
+///
 /// @ingroup World
 struct DebugLine
 {
 	/// Default number of segments.
 	static const u32 NUM_SEGMENTS = 36;
-	static const u32 MAX_LINES = 32768;
 
 	struct Line
 	{
@@ -32,16 +36,39 @@ struct DebugLine
 		u32 c1;
 	};
 
+	/// Enumerates unit primitives.
+	struct PrimitiveType
+	{
+		enum Enum
+		{
+			CIRCLE, ///< Radius 1 around the z axis.
+			SPHERE, ///< Radius 1, drawn as three circles.
+			BOX,    ///< From (-1, -1, -1) to (1, 1, 1).
+			CONE,   ///< Base of radius 1 around the z axis, tip at (0, 0, 1).
+
+			COUNT
+		};
+	};
+
+	/// Instance of a unit primitive.
+	struct Primitive
+	{
+		Matrix4x4 tm;
+		Color4 color;
+		u32 type; ///< PrimitiveType::Enum
+	};
+
 	u32 _marker;
 	ShaderManager *_shader_manager;
 	StringId32 _shader;
+	StringId32 _shader_instanced;
 	bgfx::VertexLayout _vertex_layout;
-
-	u32 _num;
-	Line _lines[MAX_LINES];
+	bgfx::VertexBufferHandle _primitives_vb; ///< Unit primitives, created in submit().
+	Array<Line> _lines;
+	Array<Primitive> _primitives;
 
 	/// Whether to enable @a depth_test
-	DebugLine(ShaderManager &sm, bool depth_test);
+	DebugLine(Allocator &a, ShaderManager &sm, bool depth_test);
 
 	///
 	~DebugLine();
@@ -71,13 +98,16 @@ struct DebugLine
 	/// Adds a frustum defined by @mvp.
 	void add_frustum(const Matrix4x4 &mvp, const Color4 &color);
 
+	/// Adds the unit primitive @a type transformed by @a tm.
+	void add_primitive(PrimitiveType::Enum type, const Matrix4x4 &tm, const Color4 &color);
+
 	/// Adds the mesh described by (vertices, stride, indices, num).
 	void add_mesh(const Matrix4x4 &tm, const void *vertices, u32 stride, const u16 *indices, u32 num, const Color4 &color);
 
-	/// Resets all the lines.
+	/// Resets all the lines and primitives.
 	void reset();
 
-	/// Submits the lines to renderer for drawing.
+	/// Submits the lines and primitives to renderer for drawing.
 	void submit(u8 view_id = VIEW_DEBUG);
 };
 
@@ -3,14 +3,19 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include "config.h"
+#include "core/containers/array.inl"
+#include "core/containers/hash_map.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/vector2.inl"
 #include "core/math/vector3.inl"
+#include "core/murmur.h"
 #include "core/strings/string.inl"
 #include "core/strings/string_id.inl"
 #include "core/strings/utf8.h"
+#include "device/log.h"
 #include "resource/font_resource.h"
 #include "resource/material_resource.h"
 #include "resource/resource_manager.h"
@@ -18,26 +23,26 @@
 #include "world/material_manager.h"
 #include "world/shader_manager.h"
 #include <bgfx/bgfx.h>
+#include <string.h> // memcpy, memcmp
 
-namespace crown
-{
-GuiBuffer::GuiBuffer(ShaderManager &sm)
-	: _shader_manager(&sm)
-	, _num_vertices(0)
-	, _num_indices(0)
-	, _vertex_buffer()
-	, _index_buffer()
-{
-}
+LOG_SYSTEM(GUI, "gui")
 
-void *GuiBuffer::vertex_buffer_end()
+namespace crown
 {
-	return _vertex_buffer.data + _num_vertices*24;
-}
-
-void *GuiBuffer::index_buffer_end()
+GuiBuffer::GuiBuffer(Allocator &a, ResourceManager &rm, ShaderManager &sm, MaterialManager &mm)
+	: _resource_manager(&rm)
+	, _shader_manager(&sm)
+	, _material_manager(&mm)
+	, _vertices(a)
+	, _indices(a)
+	, _primitives(a)
+	, _batches(a)
+	, _materials(a)
+	, _fonts(a)
+	, _layouts(a)
+	, _glyphs(a)
+	, _texts(a)
 {
-	return _index_buffer.data + _num_indices*2;
 }
 
 void GuiBuffer::create()
@@ -51,43 +56,192 @@ void GuiBuffer::create()
 
 void GuiBuffer::reset()
 {
-	_num_vertices = 0;
-	_num_indices = 0;
+	array::clear(_vertices);
+	array::clear(_indices);
+	array::clear(_primitives);
+	array::clear(_batches);
+
+	// Resources may be unloaded between frames.
+	hash_map::clear(_materials);
+	hash_map::clear(_fonts);
+}
+
+Material *GuiBuffer::material(StringId64 id)
+{
+	Material *mat = hash_map::get(_materials, id, (Material *)NULL);
+	if (mat == NULL) {
+		const MaterialResource *mr = (MaterialResource *)_resource_manager->get(RESOURCE_TYPE_MATERIAL, id);
+		mat = _material_manager->create_material(mr);
+		hash_map::set(_materials, id, mat);
+	}
+
+	return mat;
+}
+
+const FontResource *GuiBuffer::font(StringId64 id)
+{
+	const FontResource *fr = hash_map::get(_fonts, id, (const FontResource *)NULL);
+	if (fr == NULL) {
+		fr = (const FontResource *)_resource_manager->get(RESOURCE_TYPE_FONT, id);
+		hash_map::set(_fonts, id, fr);
+	}
+
+	return fr;
+}
+
+GuiBuffer::TextLayout GuiBuffer::layout(const char *str, StringId64 font, u32 font_size)
+{
+	const FontResource *fr = this->font(font);
+	const u32 len = strlen32(str);
+	const u64 key = murmur64(str, len, font._id ^ font_size);
+
+	const TextLayout deffault = { 0, 0, 0, 0, NULL };
+	const TextLayout tl = hash_map::get(_layouts, key, deffault);
+	// Keys may collide: the layout must have been made from the same text.
+	if (tl.font == fr
+		&& tl.text_len == len
+		&& memcmp(array::begin(_texts) + tl.text, str, len) == 0
+		)
+		return tl;
+
+	// A text has at most one glyph per byte.
+	if (array::size(_texts) + len > CROWN_GUI_MAX_CACHED_GLYPHS) {
+		hash_map::clear(_layouts);
+		array::clear(_glyphs);
+		array::clear(_texts);
+	}
+
+	TextLayout layout;
+	layout.first = array::size(_glyphs);
+	layout.num = 0;
+	layout.text = array::size(_texts);
+	layout.text_len = len;
+	layout.font = fr;
+	array::push(_texts, str, len);
+
+	const f32 scale = (f32)font_size / (f32)fr->font_size;
+	f32 pen_advance_x = 0.0f;
+	f32 pen_advance_y = 0.0f;
+
+	u32 state = UTF8_ACCEPT;
+	u32 code_point = 0;
+	for (u32 i = 0; i < len; ++i) {
+		// Multi-byte sequences are decoded across iterations.
+		const u32 res = utf8::decode(&state, &code_point, u8(str[i]));
+		if (res == UTF8_REJECT) {
+			state = UTF8_ACCEPT;
+			continue;
+		} else if (res != UTF8_ACCEPT) {
+			continue;
+		}
+
+		switch (code_point) {
+		case '\n':
+			pen_advance_x = 0.0f;
+			pen_advance_y -= scale*fr->font_size;
+			continue;
+
+		case '\t':
+			pen_advance_x += scale*font_size*4;
+			continue;
+		}
+
+		const GlyphData deffault_glyph = {};
+		const GlyphData *glyph = font_resource::glyph(fr, code_point, &deffault_glyph);
+
+		if (glyph->width > 0.0f && glyph->height > 0.0f) {
+			const f32 baseline = glyph->height - glyph->y_offset;
+
+			GlyphQuad gq;
+			gq.pos0.x = pen_advance_x + scale*glyph->x_offset;
+			gq.pos0.y = pen_advance_y - scale*baseline;
+			gq.pos1.x = gq.pos0.x + scale*glyph->width;
+			gq.pos1.y = gq.pos0.y + scale*glyph->height;
+			gq.uv0.x  = glyph->x / fr->texture_size;
+			gq.uv1.y  = glyph->y / fr->texture_size; // Upper-left char corner
+			gq.uv1.x  = glyph->width  / fr->texture_size + gq.uv0.x;
+			gq.uv0.y  = glyph->height / fr->texture_size + gq.uv1.y; // Bottom-left char corner
+			array::push_back(_glyphs, gq);
+			++layout.num;
+		}
 
-	bgfx::allocTransientVertexBuffer(&_vertex_buffer, 4096, _pos_tex_col);
-	bgfx::allocTransientIndexBuffer(&_index_buffer, 6144);
+		pen_advance_x += scale*glyph->x_advance;
+	}
+
+	hash_map::set(_layouts, key, layout);
+	return layout;
 }
 
-void GuiBuffer::submit(u32 num_vertices, u32 num_indices, const Matrix4x4 &world)
+GuiBuffer::VertexData *GuiBuffer::add(Material *material, u32 num_vertices, u32 num_indices, u32 **indices)
 {
-	bgfx::setVertexBuffer(0, &_vertex_buffer, _num_vertices, num_vertices);
-	bgfx::setIndexBuffer(&_index_buffer, _num_indices, num_indices);
-	bgfx::setTransform(to_float_ptr(world));
+	// VIEW_GUI is sequential: only merge with the previous primitive, so that
+	// overlapping primitives are still drawn in the order they were added.
+	if (array::size(_batches) == 0 || array::back(_batches).material != material) {
+		Batch b;
+		b.material = material;
+		b.first_index = array::size(_indices);
+		b.num_indices = 0;
+		array::push_back(_batches, b);
+	}
+	array::back(_batches).num_indices += num_indices;
 
-	_shader_manager->submit(STRING_ID_32("gui", UINT32_C(0x66dbf9a2)), VIEW_GUI);
+	Primitive p;
+	p.first_vertex = array::size(_vertices);
+	p.first_index = array::size(_indices);
+	p.num_indices = num_indices;
+	array::push_back(_primitives, p);
 
-	_num_vertices += num_vertices;
-	_num_indices += num_indices;
+	array::resize(_vertices, p.first_vertex + num_vertices);
+	array::resize(_indices, p.first_index + num_indices);
+
+	*indices = array::begin(_indices) + p.first_index;
+	return array::begin(_vertices) + p.first_vertex;
 }
 
-void GuiBuffer::submit_with_material(u32 num_vertices, u32 num_indices, const Matrix4x4 &world, ResourceManager &rm, Material *material)
+void GuiBuffer::submit()
 {
-	bgfx::setVertexBuffer(0, &_vertex_buffer, _num_vertices, num_vertices);
-	bgfx::setIndexBuffer(&_index_buffer, _num_indices, num_indices);
-	bgfx::setTransform(to_float_ptr(world));
+	const u32 num_vertices = array::size(_vertices);
+	const u32 num_indices = array::size(_indices);
+	if (num_indices == 0)
+		return;
+
+	if (bgfx::getAvailTransientVertexBuffer(num_vertices, _pos_tex_col) < num_vertices
+		|| bgfx::getAvailTransientIndexBuffer(num_indices, true) < num_indices
+		) {
+		logw(GUI, "Not enough transient buffer space for %u vertices", num_vertices);
+		return;
+	}
+
+	bgfx::TransientVertexBuffer tvb;
+	bgfx::TransientIndexBuffer tib;
+	bgfx::allocTransientVertexBuffer(&tvb, num_vertices, _pos_tex_col);
+	bgfx::allocTransientIndexBuffer(&tib, num_indices, true);
+	memcpy(tvb.data, array::begin(_vertices), num_vertices*sizeof(VertexData));
+
+	u32 *dst = (u32 *)tib.data;
+	for (u32 i = 0; i < array::size(_primitives); ++i) {
+		const Primitive &p = _primitives[i];
+
+		for (u32 j = 0; j < p.num_indices; ++j)
+			dst[p.first_index + j] = p.first_vertex + _indices[p.first_index + j];
+	}
 
-	material->bind(rm, *_shader_manager, VIEW_GUI);
+	for (u32 i = 0; i < array::size(_batches); ++i) {
+		const Batch &b = _batches[i];
 
-	_num_vertices += num_vertices;
-	_num_indices += num_indices;
+		bgfx::setVertexBuffer(0, &tvb, 0, num_vertices);
+		bgfx::setIndexBuffer(&tib, b.first_index, b.num_indices);
+
+		if (b.material != NULL)
+			b.material->bind(*_resource_manager, *_shader_manager, VIEW_GUI);
+		else
+			_shader_manager->submit(STRING_ID_32("gui", UINT32_C(0x66dbf9a2)), VIEW_GUI);
+	}
 }
 
-Gui::Gui(GuiBuffer &gb, ResourceManager &rm, ShaderManager &sm, MaterialManager &mm)
+Gui::Gui(GuiBuffer &gb)
 	: _marker(DEBUG_GUI_MARKER)
 	, _buffer(&gb)
-	, _resource_manager(&rm)
-	, _shader_manager(&sm)
-	, _material_manager(&mm)
 	, _world(MATRIX4X4_IDENTITY)
 {
 	_node.next = NULL;
@@ -106,34 +260,26 @@ void Gui::move(const Vector2 &pos)
 
 void Gui::triangle_3d(const Vector3 &a, const Vector3 &b, const Vector3 &c, const Color4 &color)
 {
-	VertexData *vd = (VertexData *)_buffer->vertex_buffer_end();
-	vd[0].pos.x = a.x;
-	vd[0].pos.y = a.y;
-	vd[0].pos.z = a.z;
-	vd[0].uv.x  = 0.0f;
-	vd[0].uv.y  = 0.0f;
-	vd[0].col   = to_abgr(color);
-
-	vd[1].pos.x = b.x;
-	vd[1].pos.y = b.y;
-	vd[1].pos.z = b.z;
-	vd[1].uv.x  = 1.0f;
-	vd[1].uv.y  = 0.0f;
-	vd[1].col   = to_abgr(color);
-
-	vd[2].pos.x = c.x;
-	vd[2].pos.y = c.y;
-	vd[2].pos.z = c.z;
-	vd[2].uv.x  = 1.0f;
-	vd[2].uv.y  = 1.0f;
-	vd[2].col   = to_abgr(color);
-
-	u16 *inds = (u16 *)_buffer->index_buffer_end();
+	u32 *inds;
+	VertexData *vd = _buffer->add(NULL, 3, 3, &inds);
+	vd[0].pos  = a * _world;
+	vd[0].uv.x = 0.0f;
+	vd[0].uv.y = 0.0f;
+	vd[0].col  = to_abgr(color);
+
+	vd[1].pos  = b * _world;
+	vd[1].uv.x = 1.0f;
+	vd[1].uv.y = 0.0f;
+	vd[1].col  = to_abgr(color);
+
+	vd[2].pos  = c * _world;
+	vd[2].uv.x = 1.0f;
+	vd[2].uv.y = 1.0f;
+	vd[2].col  = to_abgr(color);
+
 	inds[0] = 0;
 	inds[1] = 1;
 	inds[2] = 2;
-
-	_buffer->submit(3, 3, _world);
 }
 
 void Gui::triangle(const Vector2 &a, const Vector2 &b, const Vector2 &c, const Color4 &color)
@@ -143,44 +289,34 @@ void Gui::triangle(const Vector2 &a, const Vector2 &b, const Vector2 &c, const C
 
 void Gui::rect_3d(const Vector3 &pos, const Vector2 &size, const Color4 &color)
 {
-	VertexData *vd = (VertexData *)_buffer->vertex_buffer_end();
-	vd[0].pos.x = pos.x;
-	vd[0].pos.y = pos.y;
-	vd[0].pos.z = pos.z;
-	vd[0].uv.x  = 0.0f;
-	vd[0].uv.y  = 1.0f;
-	vd[0].col   = to_abgr(color);
-
-	vd[1].pos.x = pos.x + size.x;
-	vd[1].pos.y = pos.y;
-	vd[1].pos.z = pos.z;
-	vd[1].uv.x  = 1.0f;
-	vd[1].uv.y  = 1.0f;
-	vd[1].col   = to_abgr(color);
-
-	vd[2].pos.x = pos.x + size.x;
-	vd[2].pos.y = pos.y + size.y;
-	vd[2].pos.z = pos.z;
-	vd[2].uv.x  = 1.0f;
-	vd[2].uv.y  = 0.0f;
-	vd[2].col   = to_abgr(color);
-
-	vd[3].pos.x = pos.x;
-	vd[3].pos.y = pos.y + size.y;
-	vd[3].pos.z = pos.z;
-	vd[3].uv.x  = 0.0f;
-	vd[3].uv.y  = 0.0f;
-	vd[3].col   = to_abgr(color);
-
-	u16 *inds = (u16 *)_buffer->index_buffer_end();
+	u32 *inds;
+	VertexData *vd = _buffer->add(NULL, 4, 6, &inds);
+	vd[0].pos  = vector3(pos.x, pos.y, pos.z) * _world;
+	vd[0].uv.x = 0.0f;
+	vd[0].uv.y = 1.0f;
+	vd[0].col  = to_abgr(color);
+
+	vd[1].pos  = vector3(pos.x + size.x, pos.y, pos.z) * _world;
+	vd[1].uv.x = 1.0f;
+	vd[1].uv.y = 1.0f;
+	vd[1].col  = to_abgr(color);
+
+	vd[2].pos  = vector3(pos.x + size.x, pos.y + size.y, pos.z) * _world;
+	vd[2].uv.x = 1.0f;
+	vd[2].uv.y = 0.0f;
+	vd[2].col  = to_abgr(color);
+
+	vd[3].pos  = vector3(pos.x, pos.y + size.y, pos.z) * _world;
+	vd[3].uv.x = 0.0f;
+	vd[3].uv.y = 0.0f;
+	vd[3].col  = to_abgr(color);
+
 	inds[0] = 0;
 	inds[1] = 1;
 	inds[2] = 2;
 	inds[3] = 0;
 	inds[4] = 2;
 	inds[5] = 3;
-
-	_buffer->submit(4, 6, _world);
 }
 
 void Gui::rect(const Vector2 &pos, const Vector2 &size, const Color4 &color)
@@ -190,51 +326,34 @@ void Gui::rect(const Vector2 &pos, const Vector2 &size, const Color4 &color)
 
 void Gui::image_uv_3d(const Vector3 &pos, const Vector2 &size, const Vector2 &uv0, const Vector2 &uv1, StringId64 material, const Color4 &color)
 {
-	VertexData *vd = (VertexData *)_buffer->vertex_buffer_end();
-	vd[0].pos.x = pos.x;
-	vd[0].pos.y = pos.y;
-	vd[0].pos.z = pos.z;
-	vd[0].uv.x  = uv0.x;
-	vd[0].uv.y  = uv1.y;
-	vd[0].col   = to_abgr(color);
-
-	vd[1].pos.x = pos.x + size.x;
-	vd[1].pos.y = pos.y;
-	vd[1].pos.z = pos.z;
-	vd[1].uv.x  = uv1.x;
-	vd[1].uv.y  = uv1.y;
-	vd[1].col   = to_abgr(color);
-
-	vd[2].pos.x = pos.x + size.x;
-	vd[2].pos.y = pos.y + size.y;
-	vd[2].pos.z = pos.z;
-	vd[2].uv.x  = uv1.x;
-	vd[2].uv.y  = uv0.y;
-	vd[2].col   = to_abgr(color);
-
-	vd[3].pos.x = pos.x;
-	vd[3].pos.y = pos.y + size.y;
-	vd[3].pos.z = pos.z;
-	vd[3].uv.x  = uv0.x;
-	vd[3].uv.y  = uv0.y;
-	vd[3].col   = to_abgr(color);
-
-	u16 *inds = (u16 *)_buffer->index_buffer_end();
+	u32 *inds;
+	VertexData *vd = _buffer->add(_buffer->material(material), 4, 6, &inds);
+	vd[0].pos  = vector3(pos.x, pos.y, pos.z) * _world;
+	vd[0].uv.x = uv0.x;
+	vd[0].uv.y = uv1.y;
+	vd[0].col  = to_abgr(color);
+
+	vd[1].pos  = vector3(pos.x + size.x, pos.y, pos.z) * _world;
+	vd[1].uv.x = uv1.x;
+	vd[1].uv.y = uv1.y;
+	vd[1].col  = to_abgr(color);
+
+	vd[2].pos  = vector3(pos.x + size.x, pos.y + size.y, pos.z) * _world;
+	vd[2].uv.x = uv1.x;
+	vd[2].uv.y = uv0.y;
+	vd[2].col  = to_abgr(color);
+
+	vd[3].pos  = vector3(pos.x, pos.y + size.y, pos.z) * _world;
+	vd[3].uv.x = uv0.x;
+	vd[3].uv.y = uv0.y;
+	vd[3].col  = to_abgr(color);
+
 	inds[0] = 0;
 	inds[1] = 1;
 	inds[2] = 2;
 	inds[3] = 0;
 	inds[4] = 2;
 	inds[5] = 3;
-
-	const MaterialResource *mr = (MaterialResource *)_resource_manager->get(RESOURCE_TYPE_MATERIAL, material);
-	_material_manager->create_material(mr);
-	_buffer->submit_with_material(4
-		, 6
-		, _world
-		, *_resource_manager
-		, _material_manager->get(mr)
-		);
 }
 
 void Gui::image_uv(const Vector2 &pos, const Vector2 &size, const Vector2 &uv0, const Vector2 &uv1, StringId64 material, const Color4 &color)
@@ -254,112 +373,49 @@ void Gui::image(const Vector2 &pos, const Vector2 &size, StringId64 material, co
 
 void Gui::text_3d(const Vector3 &pos, u32 font_size, const char *str, StringId64 font, StringId64 material, const Color4 &color)
 {
-	const MaterialResource *mr = (MaterialResource *)_resource_manager->get(RESOURCE_TYPE_MATERIAL, material);
-	_material_manager->create_material(mr);
-
-	const FontResource *fr = (FontResource *)_resource_manager->get(RESOURCE_TYPE_FONT, font);
-	const f32 scale = (f32)font_size / (f32)fr->font_size;
-
-	f32 pen_x;
-	f32 pen_y;
-	f32 pen_advance_x = 0.0f;
-	f32 pen_advance_y = 0.0f;
-
-	VertexData *vd = (VertexData *)_buffer->vertex_buffer_end();
-	u16 *id = (u16 *)_buffer->index_buffer_end();
-
-	const u32 len = strlen32(str);
-	u32 num_vertices = 0;
-	u32 num_indices = 0;
-	for (u32 i = 0; i < len; ++i) {
-		switch (str[i]) {
-		case '\n':
-			pen_advance_x = 0.0f;
-			pen_advance_y -= scale*fr->font_size;
-			continue;
-
-		case '\t':
-			pen_advance_x += scale*font_size*4;
-			continue;
-		}
-
-		u32 state = 0;
-		u32 code_point = 0;
-		if (utf8::decode(&state, &code_point, str[i]) == UTF8_ACCEPT) {
-			const GlyphData deffault_glyph = {};
-			const GlyphData *glyph = font_resource::glyph(fr, code_point, &deffault_glyph);
-
-			const f32 baseline = glyph->height - glyph->y_offset;
-
-			// Set pen position
-			pen_x = pos.x + scale*glyph->x_offset;
-			pen_y = pos.y - scale*baseline;
-
-			// Position coords
-			const f32 x0 = (pen_x + pen_advance_x);
-			const f32 y0 = (pen_y + pen_advance_y);
-			const f32 x1 = (pen_x + pen_advance_x + scale*glyph->width);
-			const f32 y1 = (pen_y + pen_advance_y + scale*glyph->height);
-
-			// Texture coords
-			const f32 u0 = glyph->x / fr->texture_size;
-			const f32 v1 = glyph->y / fr->texture_size; // Upper-left char corner
-			const f32 u1 = glyph->width  / fr->texture_size + u0;
-			const f32 v0 = glyph->height / fr->texture_size + v1; // Bottom-left char corner
-
-			// Fill vertex buffer
-			vd[0].pos.x = x0;
-			vd[0].pos.y = y0;
-			vd[0].pos.z = pos.z;
-			vd[0].uv.x  = u0;
-			vd[0].uv.y  = v0;
-			vd[0].col   = to_abgr(color);
-
-			vd[1].pos.x = x1;
-			vd[1].pos.y = y0;
-			vd[1].pos.z = pos.z;
-			vd[1].uv.x  = u1;
-			vd[1].uv.y  = v0;
-			vd[1].col   = to_abgr(color);
-
-			vd[2].pos.x = x1;
-			vd[2].pos.y = y1;
-			vd[2].pos.z = pos.z;
-			vd[2].uv.x  = u1;
-			vd[2].uv.y  = v1;
-			vd[2].col   = to_abgr(color);
-
-			vd[3].pos.x = x0;
-			vd[3].pos.y = y1;
-			vd[3].pos.z = pos.z;
-			vd[3].uv.x  = u0;
-			vd[3].uv.y  = v1;
-			vd[3].col   = to_abgr(color);
-
-			// Fill index buffer
-			id[0] = num_vertices + 0;
-			id[1] = num_vertices + 1;
-			id[2] = num_vertices + 2;
-			id[3] = num_vertices + 0;
-			id[4] = num_vertices + 2;
-			id[5] = num_vertices + 3;
-
-			// Advance pen position
-			pen_advance_x += scale*glyph->x_advance;
-
-			vd += 4;
-			id += 6;
-			num_vertices += 4;
-			num_indices  += 6;
-		}
+	const GuiBuffer::TextLayout tl = _buffer->layout(str, font, font_size);
+	const u32 col = to_abgr(color);
+
+	u32 *inds;
+	VertexData *vd = _buffer->add(_buffer->material(material), tl.num*4, tl.num*6, &inds);
+
+	for (u32 i = 0; i < tl.num; ++i) {
+		const GuiBuffer::GlyphQuad &gq = _buffer->_glyphs[tl.first + i];
+		const f32 x0 = pos.x + gq.pos0.x;
+		const f32 y0 = pos.y + gq.pos0.y;
+		const f32 x1 = pos.x + gq.pos1.x;
+		const f32 y1 = pos.y + gq.pos1.y;
+
+		vd[0].pos  = vector3(x0, y0, pos.z) * _world;
+		vd[0].uv.x = gq.uv0.x;
+		vd[0].uv.y = gq.uv0.y;
+		vd[0].col  = col;
+
+		vd[1].pos  = vector3(x1, y0, pos.z) * _world;
+		vd[1].uv.x = gq.uv1.x;
+		vd[1].uv.y = gq.uv0.y;
+		vd[1].col  = col;
+
+		vd[2].pos  = vector3(x1, y1, pos.z) * _world;
+		vd[2].uv.x = gq.uv1.x;
+		vd[2].uv.y = gq.uv1.y;
+		vd[2].col  = col;
+
+		vd[3].pos  = vector3(x0, y1, pos.z) * _world;
+		vd[3].uv.x = gq.uv0.x;
+		vd[3].uv.y = gq.uv1.y;
+		vd[3].col  = col;
+
+		inds[0] = i*4 + 0;
+		inds[1] = i*4 + 1;
+		inds[2] = i*4 + 2;
+		inds[3] = i*4 + 0;
+		inds[4] = i*4 + 2;
+		inds[5] = i*4 + 3;
+
+		vd += 4;
+		inds += 6;
 	}
-
-	_buffer->submit_with_material(num_vertices
-		, num_indices
-		, _world
-		, *_resource_manager
-		, _material_manager->get(mr)
-		);
 }
 
 void Gui::text(const Vector2 &pos, u32 font_size, const char *str, StringId64 font, StringId64 material, const Color4 &color)
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "core/containers/types.h"
 #include "core/list.h"
 #include "core/math/types.h"
 #include "device/pipeline.h"
@@ -16,35 +17,97 @@
 
 namespace crown
 {
+/// Vertices and indices of the Gui primitives of a frame.
+///
+/// Primitives are grouped by material and each group is drawn with a single
+/// call in submit(). Groups are drawn in the order their material was first
+/// used in the frame.
 struct GuiBuffer
 {
-	ShaderManager *_shader_manager;
-	u32 _num_vertices;
-	u32 _num_indices;
-	bgfx::VertexLayout _pos_tex_col;
-	bgfx::TransientVertexBuffer _vertex_buffer;
-	bgfx::TransientIndexBuffer _index_buffer;
+	struct VertexData
+	{
+		Vector3 pos;
+		Vector2 uv;
+		u32 col;
+	};
 
-	///
-	explicit GuiBuffer(ShaderManager &sm);
+	/// Consecutive primitives drawn with the same material.
+	struct Batch
+	{
+		Material *material; ///< NULL for the "gui" shader.
+		u32 first_index;
+		u32 num_indices;
+	};
 
-	///
-	void *vertex_buffer_end();
+	/// Indices added by a single call to add().
+	struct Primitive
+	{
+		u32 first_vertex;
+		u32 first_index;
+		u32 num_indices;
+	};
+
+	/// Quad of a glyph relative to the origin of the text.
+	struct GlyphQuad
+	{
+		Vector2 pos0;
+		Vector2 pos1;
+		Vector2 uv0;
+		Vector2 uv1;
+	};
+
+	/// Glyphs of a text in _glyphs.
+	struct TextLayout
+	{
+		u32 first;
+		u32 num;
+		u32 text;                 ///< Offset of the text in _texts.
+		u32 text_len;
+		const FontResource *font; ///< Font the layout was made with.
+	};
+
+	ResourceManager *_resource_manager;
+	ShaderManager *_shader_manager;
+	MaterialManager *_material_manager;
+	bgfx::VertexLayout _pos_tex_col;
+	Array<VertexData> _vertices;
+	Array<u32> _indices;
+	Array<Primitive> _primitives;
+	Array<Batch> _batches;
+	HashMap<StringId64, Material *> _materials;         // Materials used in this frame.
+	HashMap<StringId64, const FontResource *> _fonts;   // Fonts used in this frame.
+	HashMap<u64, TextLayout> _layouts;                  // Keyed by text, font and size.
+	Array<GlyphQuad> _glyphs;
+	Array<char> _texts;                                 // Texts of the cached layouts.
 
 	///
-	void *index_buffer_end();
+	GuiBuffer(Allocator &a, ResourceManager &rm, ShaderManager &sm, MaterialManager &mm);
 
 	///
 	void create();
 
-	///
+	/// Discards the primitives of the previous frame.
 	void reset();
 
-	///
-	void submit(u32 num_vertices, u32 num_indices, const Matrix4x4 &world);
+	/// Returns the material @a id.
+	Material *material(StringId64 id);
 
-	///
-	void submit_with_material(u32 num_vertices, u32 num_indices, const Matrix4x4 &world, ResourceManager &rm, Material *material);
+	/// Returns the font @a id.
+	const FontResource *font(StringId64 id);
+
+	/// Returns the glyphs of the UTF-8 text @a str drawn with @a font at
+	/// @a font_size. Layouts are cached across frames.
+	TextLayout layout(const char *str, StringId64 font, u32 font_size);
+
+	/// Adds a primitive of @a num_vertices vertices and @a num_indices
+	/// indices drawn with @a material, or with the "gui" shader if
+	/// @a material is NULL. Returns the vertices to be filled; the indices
+	/// to be filled are returned in @a indices and are relative to the
+	/// first vertex.
+	VertexData *add(Material *material, u32 num_vertices, u32 num_indices, u32 **indices);
+
+	/// Submits the primitives to renderer for drawing.
+	void submit();
 };
 
 /// Immediate mode Gui.
@@ -52,29 +115,15 @@ struct GuiBuffer
 /// @ingroup World
 struct Gui
 {
-	struct VertexData
-	{
-		Vector3 pos;
-		Vector2 uv;
-		u32 col;
-	};
-
-	struct IndexData
-	{
-		u16 a;
-		u16 b;
-	};
+	typedef GuiBuffer::VertexData VertexData;
 
 	u32 _marker;
 	GuiBuffer *_buffer;
-	ResourceManager *_resource_manager;
-	ShaderManager *_shader_manager;
-	MaterialManager *_material_manager;
 	Matrix4x4 _world;
 	ListNode _node;
 
 	///
-	Gui(GuiBuffer &gb, ResourceManager &rm, ShaderManager &sm, MaterialManager &mm);
+	explicit Gui(GuiBuffer &gb);
 
 	///
 	~Gui();
@@ -13,27 +13,68 @@
 
 namespace crown
 {
-void Material::bind(ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth) const
+void Material::resolve(ResourceManager &rm, ShaderManager &sm)
 {
 	using namespace material_resource;
 
-	// Set samplers
 	for (u32 i = 0; i < _resource->num_textures; ++i) {
 		const TextureData *td   = texture_data(_resource, i);
 		const TextureHandle *th = texture_handle(_resource, i, _data);
 
 		const TextureResource *teximg = (TextureResource *)rm.get(RESOURCE_TYPE_TEXTURE, td->id);
 
+		_textures[i].sampler = u16(th->sampler_handle);
+		_textures[i].texture = teximg->handle.idx;
+		_textures[i].flags   = sm.sampler_state(_resource->shader, td->name);
+	}
+
+	_state   = sm.state(_resource->shader);
+	_program = sm.program(_resource->shader);
+	_state_instanced   = BGFX_STATE_DEFAULT;
+	_program_instanced = BGFX_INVALID_HANDLE;
+	if (sm.has(_resource->shader_instanced)) {
+		_state_instanced   = sm.state(_resource->shader_instanced);
+		_program_instanced = sm.program(_resource->shader_instanced);
+	}
+
+	_resolved = true;
+}
+
+void Material::bind(ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth)
+{
+	bgfx::Encoder *encoder = bgfx::begin();
+	bind(encoder, rm, sm, view, depth);
+	bgfx::end(encoder);
+}
+
+void Material::bind(bgfx::Encoder *encoder, ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth)
+{
+	set_parameters(encoder, rm, sm);
+	sm.submit(encoder, _resource->shader, view, depth);
+}
+
+void Material::set_parameters(ResourceManager &rm, ShaderManager &sm)
+{
+	bgfx::Encoder *encoder = bgfx::begin();
+	set_parameters(encoder, rm, sm);
+	bgfx::end(encoder);
+}
+
+void Material::set_parameters(bgfx::Encoder *encoder, ResourceManager &rm, ShaderManager &sm)
+{
+	using namespace material_resource;
+
+	if (!_resolved)
+		resolve(rm, sm);
+
+	// Set samplers
+	for (u32 i = 0; i < _resource->num_textures; ++i) {
 		bgfx::UniformHandle sampler;
 		bgfx::TextureHandle texture;
-		sampler.idx = th->sampler_handle;
-		texture.idx = teximg->handle.idx;
-
-		bgfx::setTexture(i
-			, sampler
-			, texture
-			, sm.sampler_state(_resource->shader, td->name)
-			);
+		sampler.idx = _textures[i].sampler;
+		texture.idx = _textures[i].texture;
+
+		encoder->setTexture(i, sampler, texture, _textures[i].flags);
 	}
 
 	// Set uniforms
@@ -42,10 +83,8 @@ void Material::bind(ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth)
 
 		bgfx::UniformHandle buh;
 		buh.idx = uh->uniform_handle;
-		bgfx::setUniform(buh, (char *)uh + sizeof(uh->uniform_handle));
+		encoder->setUniform(buh, (char *)uh + sizeof(uh->uniform_handle));
 	}
-
-	sm.submit(_resource->shader, view, depth);
 }
 
 void Material::set_float(StringId32 name, f32 value)
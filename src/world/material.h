@@ -8,6 +8,7 @@
 #include "core/math/types.h"
 #include "resource/types.h"
 #include "world/types.h"
+#include <bgfx/bgfx.h>
 
 namespace crown
 {
@@ -16,11 +17,42 @@ namespace crown
 /// @ingroup World
 struct Material
 {
+	/// Texture binding resolved from the material resource.
+	struct Texture
+	{
+		u16 sampler; // bgfx::UniformHandle
+		u16 texture; // bgfx::TextureHandle
+		u32 flags;   // Sampler state
+	};
+
 	const MaterialResource *_resource;
 	char *_data;
+	Texture *_textures;
+	u64 _state;
+	bgfx::ProgramHandle _program;
+	u64 _state_instanced;
+	bgfx::ProgramHandle _program_instanced; ///< Invalid if there is no instanced shader.
+	bool _resolved;
+
+	/// Looks up the shader programs and states, and the texture handles and
+	/// sampler states used by bind().
+	/// This is done lazily by bind() after the material is created or after
+	/// its bindings are invalidated by MaterialManager::invalidate_bindings().
+	void resolve(ResourceManager &rm, ShaderManager &sm);
 
 	///
-	void bind(ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth = 0) const;
+	void bind(ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth = 0);
+
+	/// Same as bind() but submits through @a encoder.
+	void bind(bgfx::Encoder *encoder, ResourceManager &rm, ShaderManager &sm, u8 view, s32 depth = 0);
+
+	/// Sets the textures and uniforms of the material without submitting.
+	void set_parameters(ResourceManager &rm, ShaderManager &sm);
+
+	/// Sets the textures and uniforms of the material in @a encoder without
+	/// submitting. The material must be resolved first if @a encoder is used
+	/// from a thread other than the main one.
+	void set_parameters(bgfx::Encoder *encoder, ResourceManager &rm, ShaderManager &sm);
 
 	/// Sets the @a value of the variable @a name.
 	void set_float(StringId32 name, f32 value);
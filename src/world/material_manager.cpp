@@ -5,6 +5,7 @@
 
 #include "core/containers/hash_map.inl"
 #include "core/filesystem/file.h"
+#include "core/memory/memory.inl"
 #include "core/strings/string_id.inl"
 #include "resource/material_resource.h"
 #include "resource/resource_manager.h"
@@ -95,10 +96,15 @@ Material *MaterialManager::create_material(const MaterialResource *resource)
 	if (mat != NULL)
 		return mat;
 
-	const u32 size = sizeof(Material) + resource->dynamic_data_size;
+	const u32 size = sizeof(Material)
+		+ resource->dynamic_data_size
+		+ resource->num_textures*sizeof(Material::Texture) + alignof(Material::Texture)
+		;
 	mat = (Material *)_allocator->allocate(size);
 	mat->_resource = resource;
 	mat->_data     = (char *)&mat[1];
+	mat->_textures = (Material::Texture *)memory::align_top(mat->_data + resource->dynamic_data_size, alignof(Material::Texture));
+	mat->_resolved = false;
 
 	const char *data = (char *)resource + resource->dynamic_data_offset;
 	memcpy(mat->_data, data, resource->dynamic_data_size);
@@ -121,4 +127,15 @@ Material *MaterialManager::get(const MaterialResource *resource)
 	return hash_map::get(_materials, resource, (Material *)NULL);
 }
 
+void MaterialManager::invalidate_bindings()
+{
+	auto cur = hash_map::begin(_materials);
+	auto end = hash_map::end(_materials);
+	for (; cur != end; ++cur) {
+		HASH_MAP_SKIP_HOLE(_materials, cur);
+
+		cur->second->_resolved = false;
+	}
+}
+
 } // namespace crown
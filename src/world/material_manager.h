@@ -39,6 +39,10 @@ struct MaterialManager
 
 	/// Returns the instance of the material @a resource.
 	Material *get(const MaterialResource *resource);
+
+	/// Forces all materials to look up their texture bindings again.
+	/// Must be called whenever a texture or a shader goes offline.
+	void invalidate_bindings();
 };
 
 } // namespace crown
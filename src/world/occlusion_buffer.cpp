@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/containers/array.inl"
+#include "core/math/math.h"
+#include "core/math/matrix4x4.inl"
+#include "core/math/obb.inl"
+#include "core/math/simd.inl"
+#include "core/math/vector3.inl"
+#include "core/math/vector4.inl"
+#include "world/occlusion_buffer.h"
+#include <float.h> // FLT_MAX
+#include <math.h>  // ceilf
+
+namespace crown
+{
+/// Vertices closer than this to the eye plane are considered to cross the near plane.
+#define OCCLUSION_MIN_W 1.0e-4f
+
+/// Returns the clip-space position @a c in screen space. z is the depth.
+static Vector3 to_screen(const Vector4 &c)
+{
+	const f32 inv_w = 1.0f / c.w;
+
+	Vector3 s;
+	s.x = (c.x*inv_w*0.5f + 0.5f) * f32(OcclusionBuffer::WIDTH);
+	s.y = (c.y*inv_w*0.5f + 0.5f) * f32(OcclusionBuffer::HEIGHT);
+	s.z = c.z*inv_w;
+	return s;
+}
+
+OcclusionBuffer::OcclusionBuffer(Allocator &a)
+	: _view_proj(MATRIX4X4_IDENTITY)
+	, _clip(a)
+	, _num_triangles(0)
+{
+	clear(MATRIX4X4_IDENTITY);
+}
+
+void OcclusionBuffer::clear(const Matrix4x4 &view_proj)
+{
+	_view_proj = view_proj;
+	_num_triangles = 0;
+
+	const f32x4 cleared = simd::splat(FLT_MAX);
+	for (u32 i = 0; i < countof(_depth); i += 4)
+		simd::store(&_depth[i], cleared);
+}
+
+void OcclusionBuffer::add_occluder(const Matrix4x4 &world
+	, const void *vertices
+	, u32 stride
+	, u32 num_vertices
+	, const u16 *indices
+	, u32 num_indices
+	)
+{
+	const Matrix4x4 mvp = world * _view_proj;
+
+	array::resize(_clip, num_vertices);
+	for (u32 i = 0; i < num_vertices; ++i) {
+		const Vector3 &v = *(const Vector3 *)((const char *)vertices + i*stride);
+		_clip[i] = vector4(v.x, v.y, v.z, 1.0f) * mvp;
+	}
+
+	const f32x4 zero = simd::splat(0.0f);
+	const f32x4 outside = simd::splat(FLT_MAX);
+	const f32x4 step = simd::set(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (u32 i = 0; i < num_indices; i += 3) {
+		const Vector4 &v0 = _clip[indices[i + 0]];
+		const Vector4 &v1 = _clip[indices[i + 1]];
+		const Vector4 &v2 = _clip[indices[i + 2]];
+
+		// Clipping would be needed: skip the triangle. This never makes
+		// anything occluded that would not be otherwise.
+		if (v0.w < OCCLUSION_MIN_W || v1.w < OCCLUSION_MIN_W || v2.w < OCCLUSION_MIN_W)
+			continue;
+
+		const Vector3 p0 = to_screen(v0);
+		Vector3 p1 = to_screen(v1);
+		Vector3 p2 = to_screen(v2);
+
+		// Occluders are rasterized regardless of their winding.
+		f32 area = (p1.x - p0.x)*(p2.y - p0.y) - (p1.y - p0.y)*(p2.x - p0.x);
+		if (area == 0.0f)
+			continue;
+		if (area < 0.0f) {
+			exchange(p1, p2);
+			area = -area;
+		}
+
+		// Bounding rectangle, with x aligned to four pixels.
+		const s32 x0 = s32(clamp(min(p0.x, min(p1.x, p2.x)), 0.0f, f32(WIDTH))) & ~3;
+		const s32 x1 = s32(ceilf(clamp(max(p0.x, max(p1.x, p2.x)), 0.0f, f32(WIDTH))));
+		const s32 y0 = s32(clamp(min(p0.y, min(p1.y, p2.y)), 0.0f, f32(HEIGHT)));
+		const s32 y1 = s32(ceilf(clamp(max(p0.y, max(p1.y, p2.y)), 0.0f, f32(HEIGHT))));
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		++_num_triangles;
+
+		// Edge functions e(x, y) = a*x + b*y + c, positive inside the triangle.
+		const f32 a0 = p1.y - p2.y, b0 = p2.x - p1.x, c0 = -(a0*p1.x + b0*p1.y);
+		const f32 a1 = p2.y - p0.y, b1 = p0.x - p2.x, c1 = -(a1*p2.x + b1*p2.y);
+		const f32 a2 = p0.y - p1.y, b2 = p1.x - p0.x, c2 = -(a2*p0.x + b2*p0.y);
+
+		// Depth is linear in screen space: z(x, y) = az*x + bz*y + cz.
+		const f32 inv_area = 1.0f / area;
+		const f32 az = (a0*p0.z + a1*p1.z + a2*p2.z) * inv_area;
+		const f32 bz = (b0*p0.z + b1*p1.z + b2*p2.z) * inv_area;
+		const f32 cz = (c0*p0.z + c1*p1.z + c2*p2.z) * inv_area;
+
+		const f32x4 a0x4 = simd::splat(a0);
+		const f32x4 a1x4 = simd::splat(a1);
+		const f32x4 a2x4 = simd::splat(a2);
+		const f32x4 azx4 = simd::splat(az);
+		const f32x4 e0_step = simd::splat(a0*4.0f);
+		const f32x4 e1_step = simd::splat(a1*4.0f);
+		const f32x4 e2_step = simd::splat(a2*4.0f);
+		const f32x4 z_step = simd::splat(az*4.0f);
+		const f32x4 px = simd::add(simd::splat(f32(x0)), step);
+
+		for (s32 y = y0; y < y1; ++y) {
+			const f32 py = f32(y) + 0.5f;
+			const f32x4 e0y = simd::splat(b0*py + c0);
+			const f32x4 e1y = simd::splat(b1*py + c1);
+			const f32x4 e2y = simd::splat(b2*py + c2);
+			const f32x4 zy = simd::splat(bz*py + cz);
+
+			f32 *row = &_depth[y*WIDTH];
+			f32x4 e0 = simd::madd(a0x4, px, e0y);
+			f32x4 e1 = simd::madd(a1x4, px, e1y);
+			f32x4 e2 = simd::madd(a2x4, px, e2y);
+			f32x4 z = simd::madd(azx4, px, zy);
+
+			for (s32 x = x0; x < x1; x += 4) {
+				const f32x4 inside = simd::min(e0, simd::min(e1, e2));
+				const f32x4 depth = simd::select_lt(inside, zero, outside, z);
+				simd::store(&row[x], simd::min(simd::load(&row[x]), depth));
+
+				e0 = simd::add(e0, e0_step);
+				e1 = simd::add(e1, e1_step);
+				e2 = simd::add(e2, e2_step);
+				z = simd::add(z, z_step);
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::update_tiles()
+{
+	for (u32 ty = 0; ty < TILES_Y; ++ty) {
+		for (u32 tx = 0; tx < TILES_X; ++tx) {
+			f32x4 farthest = simd::splat(-FLT_MAX);
+
+			for (u32 y = ty*TILE_SIZE; y < (ty + 1)*TILE_SIZE; ++y) {
+				const f32 *row = &_depth[y*WIDTH + tx*TILE_SIZE];
+				for (u32 x = 0; x < TILE_SIZE; x += 4)
+					farthest = simd::max(farthest, simd::load(&row[x]));
+			}
+
+			f32 r[4];
+			simd::store(r, farthest);
+			_tiles[ty*TILES_X + tx] = max(max(r[0], r[1]), max(r[2], r[3]));
+		}
+	}
+}
+
+bool OcclusionBuffer::is_occluded(const OBB &obb, const Matrix4x4 &world) const
+{
+	if (_num_triangles == 0)
+		return false;
+
+	Vector3 vertices[8];
+	obb::to_vertices(vertices, obb);
+	const Matrix4x4 mvp = world * _view_proj;
+
+	Vector3 smin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Vector3 smax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (u32 i = 0; i < countof(vertices); ++i) {
+		const Vector4 c = vector4(vertices[i].x, vertices[i].y, vertices[i].z, 1.0f) * mvp;
+
+		// The box crosses the near plane: assume it is visible.
+		if (c.w < OCCLUSION_MIN_W)
+			return false;
+
+		const Vector3 s = to_screen(c);
+		smin = min(smin, s);
+		smax = max(smax, s);
+	}
+
+	const u32 tx0 = u32(clamp(smin.x, 0.0f, f32(WIDTH - 1))) / TILE_SIZE;
+	const u32 tx1 = u32(clamp(smax.x, 0.0f, f32(WIDTH - 1))) / TILE_SIZE;
+	const u32 ty0 = u32(clamp(smin.y, 0.0f, f32(HEIGHT - 1))) / TILE_SIZE;
+	const u32 ty1 = u32(clamp(smax.y, 0.0f, f32(HEIGHT - 1))) / TILE_SIZE;
+
+	// The box is visible if any tile it covers has something behind its
+	// nearest point.
+	for (u32 ty = ty0; ty <= ty1; ++ty) {
+		for (u32 tx = tx0; tx <= tx1; ++tx) {
+			if (_tiles[ty*TILES_X + tx] >= smin.z)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace crown
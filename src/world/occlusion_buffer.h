@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/containers/types.h"
+#include "core/math/types.h"
+#include "core/memory/types.h"
+#include "core/types.h"
+
+namespace crown
+{
+/// Low resolution depth buffer used to cull objects hidden behind occluders.
+///
+/// Occluders are rasterized on the CPU four pixels at a time. The buffer is
+/// then reduced to a grid of tiles storing the farthest depth of their
+/// pixels, and bounding boxes are tested against the tiles they cover.
+/// Tests are conservative: a box is reported as occluded only when it is
+/// entirely behind the occluders.
+///
+/// @ingroup World
+struct OcclusionBuffer
+{
+	static const u32 WIDTH = 256;
+	static const u32 HEIGHT = 128;
+	static const u32 TILE_SIZE = 8;
+	static const u32 TILES_X = WIDTH / TILE_SIZE;
+	static const u32 TILES_Y = HEIGHT / TILE_SIZE;
+
+	Matrix4x4 _view_proj;
+	Array<Vector4> _clip; // Occluder vertices in clip space.
+	u32 _num_triangles;   // Triangles rasterized since last clear().
+	f32 _depth[WIDTH * HEIGHT];
+	f32 _tiles[TILES_X * TILES_Y];
+
+	///
+	explicit OcclusionBuffer(Allocator &a);
+
+	/// Clears the buffer and sets the @a view_proj matrix used to project
+	/// occluders and boxes.
+	void clear(const Matrix4x4 &view_proj);
+
+	/// Rasterizes the mesh described by (vertices, stride, num_vertices, indices,
+	/// num_indices) and transformed by @a world. Triangles crossing the near
+	/// plane are skipped.
+	void add_occluder(const Matrix4x4 &world
+		, const void *vertices
+		, u32 stride
+		, u32 num_vertices
+		, const u16 *indices
+		, u32 num_indices
+		);
+
+	/// Updates the tiles after all the occluders have been added.
+	void update_tiles();
+
+	/// Returns whether the box @a obb transformed by @a world is hidden by the
+	/// occluders. update_tiles() must be called first.
+	bool is_occluded(const OBB &obb, const Matrix4x4 &world) const;
+};
+
+} // namespace crown
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "core/math/aabb.inl"
+#include "core/math/math.h"
+#include "core/math/matrix4x4.inl"
+#include "core/math/simd.inl"
+#include "core/math/vector3.inl"
+#include "core/memory/memory.inl"
+#include "resource/particle_system_resource.h"
+#include "world/particle_emitter.h"
+#include <float.h>  // FLT_MAX
+#include <string.h> // memset
+
+namespace crown
+{
+ParticleEmitter::ParticleEmitter(Allocator &a, u32 max_particles, s32 seed)
+	: _allocator(&a)
+	, _capacity((max_particles + 3) & ~3u)
+	, _max(max_particles)
+	, _num(0)
+	, _num_dropped(0)
+	, _spawn_time(0.0f)
+	, _random(seed)
+{
+	const u32 bytes = 8*_capacity*sizeof(f32);
+	_buffer = _allocator->allocate(bytes, 16);
+	memset(_buffer, 0, bytes);
+
+	_px           = (f32 *)_buffer;
+	_py           = _px + _capacity;
+	_pz           = _py + _capacity;
+	_vx           = _pz + _capacity;
+	_vy           = _vx + _capacity;
+	_vz           = _vy + _capacity;
+	_age          = _vz + _capacity;
+	_inv_lifetime = _age + _capacity;
+
+	aabb::reset(_aabb);
+}
+
+ParticleEmitter::~ParticleEmitter()
+{
+	_allocator->deallocate(_buffer);
+}
+
+void ParticleEmitter::simulate(const Vector3 &acceleration, f32 dt)
+{
+	const f32x4 dtx4 = simd::splat(dt);
+	const f32x4 dvx = simd::splat(acceleration.x*dt);
+	const f32x4 dvy = simd::splat(acceleration.y*dt);
+	const f32x4 dvz = simd::splat(acceleration.z*dt);
+
+	// Particles past _num are simulated too: the capacity is a multiple of
+	// four and their results are never read.
+	for (u32 i = 0; i < _num; i += 4) {
+		const f32x4 vx = simd::add(simd::load(&_vx[i]), dvx);
+		const f32x4 vy = simd::add(simd::load(&_vy[i]), dvy);
+		const f32x4 vz = simd::add(simd::load(&_vz[i]), dvz);
+		simd::store(&_vx[i], vx);
+		simd::store(&_vy[i], vy);
+		simd::store(&_vz[i], vz);
+		simd::store(&_px[i], simd::madd(vx, dtx4, simd::load(&_px[i])));
+		simd::store(&_py[i], simd::madd(vy, dtx4, simd::load(&_py[i])));
+		simd::store(&_pz[i], simd::madd(vz, dtx4, simd::load(&_pz[i])));
+		simd::store(&_age[i], simd::madd(simd::load(&_inv_lifetime[i]), dtx4, simd::load(&_age[i])));
+	}
+
+	// Remove dead particles by moving the last particle in their place.
+	for (u32 i = 0; i < _num;) {
+		if (_age[i] < 1.0f) {
+			++i;
+			continue;
+		}
+
+		const u32 last = --_num;
+		_px[i]           = _px[last];
+		_py[i]           = _py[last];
+		_pz[i]           = _pz[last];
+		_vx[i]           = _vx[last];
+		_vy[i]           = _vy[last];
+		_vz[i]           = _vz[last];
+		_age[i]          = _age[last];
+		_inv_lifetime[i] = _inv_lifetime[last];
+	}
+}
+
+void ParticleEmitter::spawn(const ParticleSystemResource &psr, const Matrix4x4 &world, f32 dt)
+{
+	if (psr.spawn_rate <= 0.0f)
+		return;
+
+	_spawn_time += dt;
+	const u32 num = u32(_spawn_time * psr.spawn_rate);
+	_spawn_time -= f32(num) / psr.spawn_rate;
+
+	const Vector3 pos = translation(world);
+	const Vector3 ax = x(world);
+	const Vector3 ay = y(world);
+	const Vector3 az = z(world);
+
+	for (u32 n = 0; n < num; ++n) {
+		if (_num == _max) {
+			_num_dropped += num - n;
+			break;
+		}
+
+		const Vector3 v = vector3(lerp(psr.velocity_min.x, psr.velocity_max.x, _random.unit_float())
+			, lerp(psr.velocity_min.y, psr.velocity_max.y, _random.unit_float())
+			, lerp(psr.velocity_min.z, psr.velocity_max.z, _random.unit_float())
+			);
+		const Vector3 wv = ax*v.x + ay*v.y + az*v.z;
+		const f32 lifetime = lerp(psr.lifetime_min, psr.lifetime_max, _random.unit_float());
+
+		const u32 i = _num++;
+		_px[i]           = pos.x;
+		_py[i]           = pos.y;
+		_pz[i]           = pos.z;
+		_vx[i]           = wv.x;
+		_vy[i]           = wv.y;
+		_vz[i]           = wv.z;
+		_age[i]          = 0.0f;
+		_inv_lifetime[i] = 1.0f / lifetime;
+	}
+}
+
+void ParticleEmitter::update(const ParticleSystemResource &psr, const Matrix4x4 &world, f32 dt)
+{
+	_num_dropped = 0;
+	simulate(psr.acceleration, dt);
+	spawn(psr, world, dt);
+
+	aabb::reset(_aabb);
+	if (_num == 0)
+		return;
+
+	f32x4 min_x = simd::splat(FLT_MAX);
+	f32x4 min_y = simd::splat(FLT_MAX);
+	f32x4 min_z = simd::splat(FLT_MAX);
+	f32x4 max_x = simd::splat(-FLT_MAX);
+	f32x4 max_y = simd::splat(-FLT_MAX);
+	f32x4 max_z = simd::splat(-FLT_MAX);
+
+	// Lanes past _num hold stale data: the last group is handled one
+	// particle at a time.
+	const u32 num_groups = _num & ~3u;
+	for (u32 i = 0; i < num_groups; i += 4) {
+		const f32x4 px = simd::load(&_px[i]);
+		const f32x4 py = simd::load(&_py[i]);
+		const f32x4 pz = simd::load(&_pz[i]);
+		min_x = simd::min(min_x, px);
+		min_y = simd::min(min_y, py);
+		min_z = simd::min(min_z, pz);
+		max_x = simd::max(max_x, px);
+		max_y = simd::max(max_y, py);
+		max_z = simd::max(max_z, pz);
+	}
+
+	f32 r[6][4];
+	simd::store(r[0], min_x);
+	simd::store(r[1], min_y);
+	simd::store(r[2], min_z);
+	simd::store(r[3], max_x);
+	simd::store(r[4], max_y);
+	simd::store(r[5], max_z);
+
+	for (u32 i = num_groups; i < _num; ++i) {
+		r[0][0] = min(r[0][0], _px[i]);
+		r[1][0] = min(r[1][0], _py[i]);
+		r[2][0] = min(r[2][0], _pz[i]);
+		r[3][0] = max(r[3][0], _px[i]);
+		r[4][0] = max(r[4][0], _py[i]);
+		r[5][0] = max(r[5][0], _pz[i]);
+	}
+
+	_aabb.min.x = min(min(r[0][0], r[0][1]), min(r[0][2], r[0][3]));
+	_aabb.min.y = min(min(r[1][0], r[1][1]), min(r[1][2], r[1][3]));
+	_aabb.min.z = min(min(r[2][0], r[2][1]), min(r[2][2], r[2][3]));
+	_aabb.max.x = max(max(r[3][0], r[3][1]), max(r[3][2], r[3][3]));
+	_aabb.max.y = max(max(r[4][0], r[4][1]), max(r[4][2], r[4][3]));
+	_aabb.max.z = max(max(r[5][0], r[5][1]), max(r[5][2], r[5][3]));
+
+	// Particles are quads centered at their position.
+	const f32 half_size = max(psr.size_start, psr.size_end) * 0.5f;
+	_aabb.min -= vector3(half_size, half_size, half_size);
+	_aabb.max += vector3(half_size, half_size, half_size);
+}
+
+void ParticleEmitter::fill_instance_data(void *data, u32 num, const ParticleSystemResource &psr) const
+{
+	CE_ENSURE(num <= _num);
+
+	const f32x4 size0 = simd::splat(psr.size_start);
+	const f32x4 dsize = simd::splat(psr.size_end - psr.size_start);
+	const f32x4 r0 = simd::splat(psr.color_start.x);
+	const f32x4 g0 = simd::splat(psr.color_start.y);
+	const f32x4 b0 = simd::splat(psr.color_start.z);
+	const f32x4 a0 = simd::splat(psr.color_start.w);
+	const f32x4 dr = simd::splat(psr.color_end.x - psr.color_start.x);
+	const f32x4 dg = simd::splat(psr.color_end.y - psr.color_start.y);
+	const f32x4 db = simd::splat(psr.color_end.z - psr.color_start.z);
+	const f32x4 da = simd::splat(psr.color_end.w - psr.color_start.w);
+
+	f32 *out = (f32 *)data;
+	for (u32 i = 0; i < num; i += 4) {
+		const f32x4 t = simd::load(&_age[i]);
+
+		// Transpose four particles' components into four instances.
+		f32x4 p[4] = { simd::load(&_px[i]), simd::load(&_py[i]), simd::load(&_pz[i]), simd::madd(t, dsize, size0) };
+		f32x4 c[4] = { simd::madd(t, dr, r0), simd::madd(t, dg, g0), simd::madd(t, db, b0), simd::madd(t, da, a0) };
+		simd::transpose(p[0], p[1], p[2], p[3]);
+		simd::transpose(c[0], c[1], c[2], c[3]);
+
+		const u32 n = min(num - i, 4u);
+		for (u32 j = 0; j < n; ++j) {
+			simd::store(&out[(i + j)*8 + 0], p[j]);
+			simd::store(&out[(i + j)*8 + 4], c[j]);
+		}
+	}
+}
+
+} // namespace crown
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/math/random.h"
+#include "core/math/types.h"
+#include "core/memory/types.h"
+#include "core/types.h"
+#include "resource/types.h"
+
+namespace crown
+{
+/// Particles of a single emitter.
+///
+/// Particles are stored as separate arrays of components and simulated four
+/// at a time. Their number never exceeds the capacity given at construction:
+/// particles spawned beyond it are dropped and counted.
+///
+/// @ingroup World
+struct ParticleEmitter
+{
+	/// Per-particle data of the "particle" shader: position and size,
+	/// then color.
+	static const u32 INSTANCE_STRIDE = 2*sizeof(Vector4);
+
+	Allocator *_allocator;
+	void *_buffer;
+	u32 _capacity;     // Multiple of 4.
+	u32 _max;          // Maximum number of particles alive at once.
+	u32 _num;          // Particles alive.
+	u32 _num_dropped;  // Particles dropped by the last update().
+	f32 _spawn_time;   // Time since the last particle was spawned.
+	Random _random;
+	AABB _aabb;        // Box enclosing the particles alive.
+	f32 *_px, *_py, *_pz; // World-space position.
+	f32 *_vx, *_vy, *_vz; // World-space velocity.
+	f32 *_age;         // Age divided by lifetime, in [0; 1).
+	f32 *_inv_lifetime;
+
+	///
+	ParticleEmitter(Allocator &a, u32 max_particles, s32 seed);
+
+	///
+	~ParticleEmitter();
+
+	///
+	ParticleEmitter(const ParticleEmitter &) = delete;
+
+	///
+	ParticleEmitter &operator=(const ParticleEmitter &) = delete;
+
+	/// Advances the particles by @a dt seconds under @a acceleration.
+	/// Particles that reach the end of their life are removed.
+	void simulate(const Vector3 &acceleration, f32 dt);
+
+	/// Spawns the particles emitted by @a psr in @a dt seconds from the
+	/// emitter at @a world.
+	void spawn(const ParticleSystemResource &psr, const Matrix4x4 &world, f32 dt);
+
+	/// Simulates the particles, spawns new ones and updates _aabb.
+	void update(const ParticleSystemResource &psr, const Matrix4x4 &world, f32 dt);
+
+	/// Writes the instance data of the first @a num particles to @a data.
+	/// See INSTANCE_STRIDE.
+	void fill_instance_data(void *data, u32 num, const ParticleSystemResource &psr) const;
+};
+
+} // namespace crown
@@ -7,12 +7,12 @@
 
 #if CROWN_PHYSICS_BULLET
 #include "core/containers/array.inl"
-#include "core/containers/hash_map.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix4x4.inl"
 #include "core/math/quaternion.inl"
 #include "core/math/vector3.inl"
+#include "core/memory/memory.inl"
 #include "core/memory/proxy_allocator.h"
 #include "core/strings/string_id.inl"
 #include "device/log.h"
@@ -23,6 +23,7 @@
 #include "world/physics.h"
 #include "world/physics_world.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 #include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
 #include <BulletCollision/CollisionDispatch/btCollisionObject.h>
 #include <BulletCollision/CollisionDispatch/btDefaultCollisionConfiguration.h>
@@ -154,6 +155,18 @@ struct MyDebugDrawer : public btIDebugDraw
 		_lines->add_line(start, end, COLOR4_ORANGE);
 	}
 
+	void drawSphere(btScalar radius, const btTransform &transform, const btVector3 & /*color*/) override
+	{
+		_lines->add_sphere(to_vector3(transform.getOrigin()), radius, COLOR4_ORANGE);
+	}
+
+	void drawBox(const btVector3 &bbMin, const btVector3 &bbMax, const btTransform &trans, const btVector3 & /*color*/) override
+	{
+		Matrix4x4 tm = MATRIX4X4_IDENTITY;
+		set_translation(tm, to_vector3((bbMin + bbMax) * 0.5f));
+		_lines->add_obb(tm * to_matrix4x4(trans), to_vector3((bbMax - bbMin) * 0.5f), COLOR4_ORANGE);
+	}
+
 	void drawContactPoint(const btVector3 &pointOnB, const btVector3 & /*normalOnB*/, btScalar /*distance*/, int /*lifeTime*/, const btVector3 & /*color*/) override
 	{
 		const Vector3 from = to_vector3(pointOnB);
@@ -214,8 +227,8 @@ struct PhysicsWorldImpl
 	Allocator *_allocator;
 	UnitManager *_unit_manager;
 
-	HashMap<UnitId, u32> _collider_map;
-	HashMap<UnitId, u32> _actor_map;
+	UnitMap _collider_map;
+	UnitMap _actor_map;
 	Array<ColliderInstanceData> _collider;
 	Array<ActorInstanceData> _actor;
 	Array<btTypedConstraint *> _joints;
@@ -366,7 +379,7 @@ struct PhysicsWorldImpl
 		if (is_valid(ci))
 			_collider[ci.i].next.i = last;
 		else
-			hash_map::set(_collider_map, unit, last);
+			unit_map::set(_collider_map, unit, last);
 
 		array::push_back(_collider, cid);
 		return make_collider_instance(last);
@@ -401,9 +414,9 @@ struct PhysicsWorldImpl
 
 		if (collider.i == first.i) {
 			if (!is_valid(collider_next(collider)))
-				hash_map::remove(_collider_map, u);
+				unit_map::remove(_collider_map, u);
 			else
-				hash_map::set(_collider_map, u, collider_next(collider).i);
+				unit_map::set(_collider_map, u, collider_next(collider).i);
 		} else {
 			ColliderInstance prev = collider_previous(collider);
 			_collider[prev.i].next = collider_next(collider);
@@ -419,7 +432,7 @@ struct PhysicsWorldImpl
 		const ColliderInstance first_i = collider_first(u);
 
 		if (a.i == first_i.i) {
-			hash_map::set(_collider_map, u, b.i);
+			unit_map::set(_collider_map, u, b.i);
 		} else {
 			const ColliderInstance prev_a = collider_previous(a);
 			CE_ENSURE(prev_a.i != a.i);
@@ -429,7 +442,7 @@ struct PhysicsWorldImpl
 
 	ColliderInstance collider_first(UnitId unit)
 	{
-		return make_collider_instance(hash_map::get(_collider_map, unit, UINT32_MAX));
+		return make_collider_instance(unit_map::get(_collider_map, unit, UINT32_MAX));
 	}
 
 	ColliderInstance collider_next(ColliderInstance collider)
@@ -456,7 +469,7 @@ struct PhysicsWorldImpl
 
 	ActorInstance actor_create(UnitId unit, const ActorResource *ar, const Matrix4x4 &tm)
 	{
-		CE_ASSERT(!hash_map::has(_actor_map, unit), "Unit already has an actor component");
+		CE_ASSERT(!unit_map::has(_actor_map, unit), "Unit already has an actor component");
 
 		const PhysicsActor *actor_class = physics_config_resource::actor(_config_resource, ar->actor_class);
 		const PhysicsMaterial *material = physics_config_resource::material(_config_resource, ar->material);
@@ -533,7 +546,7 @@ struct PhysicsWorldImpl
 		aid.body = body;
 
 		array::push_back(_actor, aid);
-		hash_map::set(_actor_map, unit, last);
+		unit_map::set(_actor_map, unit, last);
 
 		return make_actor_instance(last);
 	}
@@ -554,13 +567,13 @@ struct PhysicsWorldImpl
 
 		array::pop_back(_actor);
 
-		hash_map::set(_actor_map, last_u, actor.i);
-		hash_map::remove(_actor_map, u);
+		unit_map::set(_actor_map, last_u, actor.i);
+		unit_map::remove(_actor_map, u);
 	}
 
 	ActorInstance actor(UnitId unit)
 	{
-		return make_actor_instance(hash_map::get(_actor_map, unit, UINT32_MAX));
+		return make_actor_instance(unit_map::get(_actor_map, unit, UINT32_MAX));
 	}
 
 	Vector3 actor_world_position(ActorInstance actor) const
@@ -933,7 +946,7 @@ struct PhysicsWorldImpl
 	void update_actor_world_poses(const UnitId *begin, const UnitId *end, const Matrix4x4 *begin_world)
 	{
 		for (; begin != end; ++begin, ++begin_world) {
-			const u32 ai = hash_map::get(_actor_map, *begin, UINT32_MAX);
+			const u32 ai = unit_map::get(_actor_map, *begin, UINT32_MAX);
 			if (ai == UINT32_MAX)
 				continue;
 
@@ -3,27 +3,42 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include "config.h"
 #include "core/containers/array.inl"
-#include "core/containers/hash_map.inl"
 #include "core/containers/hash_set.inl"
 #include "core/list.inl"
-#include "core/math/aabb.h"
+#include "core/math/aabb.inl"
 #include "core/math/color4.inl"
 #include "core/math/constants.h"
+#include "core/math/frustum.inl"
 #include "core/math/intersection.h"
 #include "core/math/matrix4x4.inl"
+#include "core/math/vector2.inl"
+#include "core/math/vector4.inl"
+#include "core/memory/temp_allocator.inl"
 #include "core/strings/string_id.inl"
+#include "core/thread/job_system.h"
 #include "device/pipeline.h"
+#include "device/profiler.h"
+#include "resource/material_resource.h"
 #include "resource/mesh_resource.h"
+#include "resource/particle_system_resource.h"
 #include "resource/resource_manager.h"
 #include "resource/sprite_resource.h"
+#include "resource/tilemap_resource.h"
 #include "world/debug_line.h"
 #include "world/material.h"
 #include "world/material_manager.h"
+#include "world/particle_emitter.h"
 #include "world/render_world.h"
 #include "world/shader_manager.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 #include <bgfx/bgfx.h>
+#include <bx/sort.h>
+#include <float.h> // FLT_MAX
+
+#define UPDATE_TRANSFORMS_GROUP_SIZE 64 // Mesh boxes transformed by each mul_batch().
 
 namespace crown
 {
@@ -32,11 +47,120 @@ static void unit_destroyed_callback_bridge(UnitId unit, void *user_ptr)
 	((RenderWorld *)user_ptr)->unit_destroyed_callback(unit);
 }
 
-static void selection_draw_override(UnitId unit_id, RenderWorld *rw)
+/// Returns the bounding sphere of the mesh bounding box @a obb transformed by @a world.
+static void mesh_bounding_sphere(Vector3 &center, f32 &radius, const OBB &obb, const Matrix4x4 &world)
+{
+	const Matrix4x4 tm = obb.tm * world;
+	center = translation(tm);
+	radius = length(vector3(length(x(tm)) * obb.half_extents.x
+		, length(y(tm)) * obb.half_extents.y
+		, length(z(tm)) * obb.half_extents.z
+		));
+}
+
+/// Returns the world-space box enclosing @a obb transformed by @a world.
+static AABB obb_to_aabb(const OBB &obb, const Matrix4x4 &world)
+{
+	AABB box;
+	box.min = -obb.half_extents;
+	box.max =  obb.half_extents;
+	return aabb::transformed(box, obb.tm * world);
+}
+
+/// Returns an encoder to submit draw calls from the calling thread. The main
+/// thread gets the same encoder used by the immediate bgfx API.
+static bgfx::Encoder *begin_encoder()
+{
+	bgfx::Encoder *encoder = bgfx::begin();
+	CE_ASSERT(encoder != NULL, "Too many bgfx encoders");
+	return encoder;
+}
+
+/// Sets the lights that can reach the sphere at @a center with @a radius.
+/// @a query is used as scratch space for the light tree query.
+static void set_mesh_lights(bgfx::Encoder *encoder, Array<u32> &query, RenderWorld *rw, const Vector3 &center, f32 radius)
+{
+	RenderWorld::LightManager &lm = rw->_light_manager;
+	const RenderWorld::LightManager::LightInstanceData &lid = lm._data;
+
+	Vector4 data[CROWN_MAX_LIGHTS_PER_MESH*4];
+	u32 num = 0;
+
+	// Directional lights reach every mesh.
+	for (u32 ii = 0; ii < array::size(lm._directional) && num < CROWN_MAX_LIGHTS_PER_MESH; ++ii) {
+		memcpy(&data[num*4], &rw->_light_data[lm._directional[ii]*4], sizeof(Vector4)*4);
+		++num;
+	}
+
+	const Sphere s = { center, radius };
+	array::clear(query);
+	aabb_tree::query_sphere(lm._tree, query, s);
+
+	for (u32 ii = 0; ii < array::size(query) && num < CROWN_MAX_LIGHTS_PER_MESH; ++ii) {
+		const u32 ll = query[ii];
+		const f32 reach = lid.range[ll] + radius;
+		if (length_squared(translation(lid.world[ll]) - center) > reach*reach)
+			continue;
+
+		memcpy(&data[num*4], &rw->_light_data[ll*4], sizeof(Vector4)*4);
+		++num;
+	}
+
+	const Vector4 count = { f32(num), 0.0f, 0.0f, 0.0f };
+	encoder->setUniform(rw->_u_light_count, &count);
+	if (num > 0)
+		encoder->setUniform(rw->_u_lights, data, num*4);
+}
+
+/// Returns the key used to sort a draw call. Keys are laid out from the most
+/// significant bit as:
+///
+/// opaque:      view:8 | translucent:1 | program:12 | material:12 | geometry:15 | depth:16
+/// translucent: view:8 | translucent:1 | ~depth:19 | program:12 | material:12 | geometry:12
+///
+/// so that opaque draws are grouped by state and sorted front-to-back while
+/// translucent draws are sorted back-to-front. Geometry is the vertex buffer
+/// followed by 3 bits of LOD, truncated to its low 12 bits in translucent keys.
+static u64 sort_key(u8 view, bool translucent, u16 program, const Material *material, u16 vbh, u32 lod, f32 depth)
+{
+	// Non-negative floats keep their order when compared as integers.
+	union
+	{
+		f32 f;
+		u32 u;
+	} f2u;
+	f2u.f = max(depth, 0.0f);
+
+	const u64 material_bits = (u64(uintptr_t(material)) * UINT64_C(0x9e3779b97f4a7c15)) >> 52;
+	const u64 program_bits = program & 0xfff;
+	// LODs share the vertex buffer but not the index range: they must not
+	// end up in the same run.
+	const u64 geometry_bits = (u64(vbh & 0xfff) << 3) | min(lod, 7u);
+
+	u64 key = u64(view) << 56;
+	if (translucent) {
+		const u64 depth_bits = f2u.u >> 12;
+		key |= UINT64_C(1) << 55;
+		key |= (~depth_bits & 0x7ffff) << 36;
+		key |= program_bits << 24;
+		key |= material_bits << 12;
+		key |= geometry_bits & 0xfff;
+	} else {
+		const u64 depth_bits = f2u.u >> 15;
+		key |= program_bits << 43;
+		key |= material_bits << 31;
+		key |= geometry_bits << 16;
+		key |= depth_bits;
+	}
+
+	return key;
+}
+
+static void selection_draw_override(bgfx::Encoder *encoder, UnitId unit_id, RenderWorld *rw)
 {
 	// FIXME: add support to multi-pass shaders and remove this function.
 	if (!hash_set::has(rw->_selection, unit_id)) {
-		bgfx::discard();
+		encoder->discard();
 		return;
 	}
 
@@ -52,9 +176,9 @@ static void selection_draw_override(UnitId unit_id, RenderWorld *rw)
 	data.y = 0.0f;
 	data.z = 0.0f;
 	data.w = 0.0f;
-	bgfx::setUniform(rw->_u_unit_id, &data);
+	encoder->setUniform(rw->_u_unit_id, &data);
 
-	rw->_shader_manager->submit(STRING_ID_32("selection", UINT32_C(0x17c0bc11)), VIEW_SELECTION);
+	rw->_shader_manager->submit(encoder, STRING_ID_32("selection", UINT32_C(0x17c0bc11)), VIEW_SELECTION);
 }
 
 RenderWorld::RenderWorld(Allocator &a, ResourceManager &rm, ShaderManager &sm, MaterialManager &mm, UnitManager &um)
@@ -63,9 +187,14 @@ RenderWorld::RenderWorld(Allocator &a, ResourceManager &rm, ShaderManager &sm, M
 	, _shader_manager(&sm)
 	, _material_manager(&mm)
 	, _unit_manager(&um)
+	, _light_data(a)
 	, _debug_drawing(false)
+	, _occlusion_culling(false)
+	, _occlusion_buffer(a)
 	, _mesh_manager(a, this)
 	, _sprite_manager(a, this)
+	, _tilemap_manager(a, this)
+	, _particle_manager(a, this)
 	, _light_manager(a)
 	, _selection(a)
 {
@@ -75,11 +204,8 @@ RenderWorld::RenderWorld(Allocator &a, ResourceManager &rm, ShaderManager &sm, M
 	_unit_destroy_callback.node.prev = NULL;
 	um.register_destroy_callback(&_unit_destroy_callback);
 
-	_u_light_position  = bgfx::createUniform("u_light_position", bgfx::UniformType::Vec4);
-	_u_light_direction = bgfx::createUniform("u_light_direction", bgfx::UniformType::Vec4);
-	_u_light_color     = bgfx::createUniform("u_light_color", bgfx::UniformType::Vec4);
-	_u_light_range     = bgfx::createUniform("u_light_range", bgfx::UniformType::Vec4);
-	_u_light_intensity = bgfx::createUniform("u_light_intensity", bgfx::UniformType::Vec4);
+	_u_lights      = bgfx::createUniform("u_lights", bgfx::UniformType::Vec4, CROWN_MAX_LIGHTS_PER_MESH*4);
+	_u_light_count = bgfx::createUniform("u_light_count", bgfx::UniformType::Vec4);
 
 	// Selection.
 	_u_unit_id = bgfx::createUniform("u_unit_id", bgfx::UniformType::Vec4);
@@ -89,16 +215,15 @@ RenderWorld::~RenderWorld()
 {
 	bgfx::destroy(_u_unit_id);
 
-	bgfx::destroy(_u_light_intensity);
-	bgfx::destroy(_u_light_range);
-	bgfx::destroy(_u_light_color);
-	bgfx::destroy(_u_light_direction);
-	bgfx::destroy(_u_light_position);
+	bgfx::destroy(_u_light_count);
+	bgfx::destroy(_u_lights);
 
 	_unit_manager->unregister_destroy_callback(&_unit_destroy_callback);
 
 	_mesh_manager.destroy();
 	_sprite_manager.destroy();
+	_tilemap_manager.destroy();
+	_particle_manager.destroy();
 	_light_manager.destroy();
 
 	_marker = 0;
@@ -142,6 +267,12 @@ void RenderWorld::mesh_set_visible(MeshInstance mesh, bool visible)
 	_mesh_manager.set_visible(mesh, visible);
 }
 
+void RenderWorld::mesh_set_occluder(MeshInstance mesh, bool occluder)
+{
+	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
+	_mesh_manager._data.occluder[mesh.i] = occluder;
+}
+
 OBB RenderWorld::mesh_obb(MeshInstance mesh)
 {
 	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
@@ -159,17 +290,83 @@ OBB RenderWorld::mesh_obb(MeshInstance mesh)
 f32 RenderWorld::mesh_cast_ray(MeshInstance mesh, const Vector3 &from, const Vector3 &dir)
 {
 	CE_ASSERT(mesh.i < _mesh_manager._data.size, "Index out of bounds");
-	const MeshGeometry *mg = _mesh_manager._data.geometry[mesh.i];
-	return ray_mesh_intersection(from
-		, dir
+	return mesh_resource::cast_ray(_mesh_manager._data.geometry[mesh.i]
 		, _mesh_manager._data.world[mesh.i]
-		, mg->vertices.data
-		, mg->vertices.stride
-		, (u16 *)mg->indices.data
-		, mg->indices.num
+		, from
+		, dir
 		);
 }
 
+f32 RenderWorld::world_cast_ray(MeshInstance &mesh, const Vector3 &from, const Vector3 &dir)
+{
+	return _mesh_manager.cast_ray(mesh, from, dir);
+}
+
+/// Appends to @a units the units of the instances of @a m whose box passes @a overlaps.
+template<typename Manager, typename Overlaps>
+static void append_units(Array<UnitId> &units, Manager &m, const Array<u32> &instances, Overlaps overlaps)
+{
+	for (u32 ii = 0; ii < array::size(instances); ++ii) {
+		const u32 i = instances[ii];
+		if (overlaps(m.world_aabb(i)))
+			array::push_back(units, m._data.unit[i]);
+	}
+}
+
+void RenderWorld::query_box(Array<UnitId> &units, const AABB &b)
+{
+	auto overlaps = [&b](const AABB &ib) { return aabb_intersects_aabb(ib, b); };
+
+	TempAllocator1024 ta;
+	Array<u32> instances(ta);
+	array::clear(units);
+
+	aabb_tree::query_box(_mesh_manager._tree, instances, b);
+	append_units(units, _mesh_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_box(_sprite_manager._tree, instances, b);
+	append_units(units, _sprite_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_box(_light_manager._tree, instances, b);
+	append_units(units, _light_manager, instances, overlaps);
+}
+
+void RenderWorld::query_sphere(Array<UnitId> &units, const Sphere &s)
+{
+	auto overlaps = [&s](const AABB &ib) { return sphere_intersects_aabb(s, ib); };
+
+	TempAllocator1024 ta;
+	Array<u32> instances(ta);
+	array::clear(units);
+
+	aabb_tree::query_sphere(_mesh_manager._tree, instances, s);
+	append_units(units, _mesh_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_sphere(_sprite_manager._tree, instances, s);
+	append_units(units, _sprite_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_sphere(_light_manager._tree, instances, s);
+	append_units(units, _light_manager, instances, overlaps);
+}
+
+void RenderWorld::query_frustum(Array<UnitId> &units, const Frustum &f)
+{
+	auto overlaps = [&f](const AABB &ib) { return aabb_intersects_frustum(ib, f); };
+
+	TempAllocator1024 ta;
+	Array<u32> instances(ta);
+	array::clear(units);
+
+	aabb_tree::query_frustum(_mesh_manager._tree, instances, f);
+	append_units(units, _mesh_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_frustum(_sprite_manager._tree, instances, f);
+	append_units(units, _sprite_manager, instances, overlaps);
+	array::clear(instances);
+	aabb_tree::query_frustum(_light_manager._tree, instances, f);
+	append_units(units, _light_manager, instances, overlaps);
+}
+
 SpriteInstance RenderWorld::sprite_create(UnitId unit, const SpriteRendererDesc &srd, const Matrix4x4 &tr)
 {
 	const SpriteResource *sr = (const SpriteResource *)_resource_manager->get(RESOURCE_TYPE_SPRITE, srd.sprite_resource);
@@ -194,6 +391,8 @@ void RenderWorld::sprite_set_sprite(SpriteInstance sprite, StringId64 sprite_res
 	CE_ASSERT(sprite.i < _sprite_manager._data.size, "Index out of bounds");
 	const SpriteResource *resource = (SpriteResource *)_resource_manager->get(RESOURCE_TYPE_SPRITE, sprite_resource_name);
 	_sprite_manager._data.resource[sprite.i] = resource;
+	_sprite_manager._data.obb[sprite.i] = resource->obb;
+	_sprite_manager.update_proxy(sprite.i);
 }
 
 Material *RenderWorld::sprite_material(SpriteInstance sprite)
@@ -249,7 +448,7 @@ OBB RenderWorld::sprite_obb(SpriteInstance sprite)
 {
 	CE_ASSERT(sprite.i < _sprite_manager._data.size, "Index out of bounds");
 
-	const OBB &obb = _sprite_manager._data.resource[sprite.i]->obb;
+	const OBB &obb = _sprite_manager._data.obb[sprite.i];
 	const Matrix4x4 &world = _sprite_manager._data.world[sprite.i];
 
 	OBB o;
@@ -293,6 +492,92 @@ f32 RenderWorld::sprite_cast_ray(SpriteInstance sprite, const Vector3 &from, con
 		);
 }
 
+TilemapInstance RenderWorld::tilemap_create(UnitId unit, const TilemapRendererDesc &trd, const Matrix4x4 &tr)
+{
+	const TilemapResource *tmr = (const TilemapResource *)_resource_manager->get(RESOURCE_TYPE_TILEMAP, trd.tilemap_resource);
+	const MaterialResource *mat_res = (MaterialResource *)_resource_manager->get(RESOURCE_TYPE_MATERIAL, trd.material_resource);
+	_material_manager->create_material(mat_res);
+	return _tilemap_manager.create(unit, tmr, trd, tr);
+}
+
+void RenderWorld::tilemap_destroy(TilemapInstance tilemap)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	_tilemap_manager.destroy(tilemap);
+}
+
+TilemapInstance RenderWorld::tilemap_instance(UnitId unit)
+{
+	return _tilemap_manager.tilemap(unit);
+}
+
+Material *RenderWorld::tilemap_material(TilemapInstance tilemap)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	return _tilemap_manager._data.material[tilemap.i];
+}
+
+void RenderWorld::tilemap_set_visible(TilemapInstance tilemap, bool visible)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	_tilemap_manager._data.visible[tilemap.i] = visible;
+}
+
+void RenderWorld::tilemap_set_layer(TilemapInstance tilemap, u32 layer)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	_tilemap_manager._data.layer[tilemap.i] = layer;
+}
+
+void RenderWorld::tilemap_set_depth(TilemapInstance tilemap, u32 depth)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	_tilemap_manager._data.depth[tilemap.i] = depth;
+}
+
+u32 RenderWorld::tilemap_tile(TilemapInstance tilemap, u32 layer, u32 x, u32 y)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	return _tilemap_manager.tile(tilemap.i, layer, x, y);
+}
+
+void RenderWorld::tilemap_set_tile(TilemapInstance tilemap, u32 layer, u32 x, u32 y, u32 tile)
+{
+	CE_ASSERT(tilemap.i < _tilemap_manager._data.size, "Index out of bounds");
+	_tilemap_manager.set_tile(tilemap.i, layer, x, y, tile);
+}
+
+ParticleSystemInstance RenderWorld::particle_system_create(UnitId unit, const ParticleSystemDesc &psd, const Matrix4x4 &tr)
+{
+	const ParticleSystemResource *psr = (const ParticleSystemResource *)_resource_manager->get(RESOURCE_TYPE_PARTICLE_SYSTEM, psd.particle_system_resource);
+	const MaterialResource *mat_res = (MaterialResource *)_resource_manager->get(RESOURCE_TYPE_MATERIAL, psd.material_resource);
+	_material_manager->create_material(mat_res);
+	return _particle_manager.create(unit, psr, psd, tr);
+}
+
+void RenderWorld::particle_system_destroy(ParticleSystemInstance ps)
+{
+	CE_ASSERT(ps.i < _particle_manager._data.size, "Index out of bounds");
+	_particle_manager.destroy(ps);
+}
+
+ParticleSystemInstance RenderWorld::particle_system_instance(UnitId unit)
+{
+	return _particle_manager.particle_system(unit);
+}
+
+void RenderWorld::particle_system_set_visible(ParticleSystemInstance ps, bool visible)
+{
+	CE_ASSERT(ps.i < _particle_manager._data.size, "Index out of bounds");
+	_particle_manager._data.visible[ps.i] = visible;
+}
+
+u32 RenderWorld::particle_system_num_particles(ParticleSystemInstance ps)
+{
+	CE_ASSERT(ps.i < _particle_manager._data.size, "Index out of bounds");
+	return _particle_manager._data.emitter[ps.i]->_num;
+}
+
 LightInstance RenderWorld::light_create(UnitId unit, const LightDesc &ld, const Matrix4x4 &tr)
 {
 	return _light_manager.create(unit, ld, tr);
@@ -349,12 +634,14 @@ void RenderWorld::light_set_type(LightInstance light, LightType::Enum type)
 {
 	CE_ASSERT(light.i < _light_manager._data.size, "Index out of bounds");
 	_light_manager._data.type[light.i] = type;
+	_light_manager.update_proxy(light.i);
 }
 
 void RenderWorld::light_set_range(LightInstance light, f32 range)
 {
 	CE_ASSERT(light.i < _light_manager._data.size, "Index out of bounds");
 	_light_manager._data.range[light.i] = range;
+	_light_manager.update_proxy(light.i);
 }
 
 void RenderWorld::light_set_intensity(LightInstance light, f32 intensity)
@@ -375,66 +662,207 @@ void RenderWorld::light_debug_draw(LightInstance light, DebugLine &dl)
 	_light_manager.debug_draw(light.i, 1, dl);
 }
 
-void RenderWorld::update_transforms(const UnitId *begin, const UnitId *end, const Matrix4x4 *world)
+struct UpdateTransformsData
 {
-	MeshManager::MeshInstanceData &mid = _mesh_manager._data;
-	SpriteManager::SpriteInstanceData &sid = _sprite_manager._data;
-	LightManager::LightInstanceData &lid = _light_manager._data;
+	RenderWorld *rw;
+	const UnitId *units;
+	const Matrix4x4 *world;
+	AABB *mesh_aabbs; ///< World box of the mesh owned by each unit, if any.
+};
 
-	for (; begin != end; ++begin, ++world) {
-		if (_mesh_manager.has(*begin)) {
-			MeshInstance mesh = _mesh_manager.mesh(*begin);
-			mid.world[mesh.i] = *world;
-		}
+/// Sets @a aabbs[slot[i]] to the world box of the mesh instance @a mesh[i]
+/// moved to @a world[i] for each i in [0; @a num).
+static void mesh_world_aabbs(AABB *aabbs, const RenderWorld::MeshManager &mm, const u32 *mesh, const u32 *slot, const Matrix4x4 *world, u32 num)
+{
+	Matrix4x4 tm[UPDATE_TRANSFORMS_GROUP_SIZE];
+	for (u32 i = 0; i < num; ++i)
+		tm[i] = mm._data.obb[mesh[i]].tm;
+	mul_batch(tm, tm, world, num);
+
+	for (u32 i = 0; i < num; ++i) {
+		AABB box;
+		box.min = -mm._data.obb[mesh[i]].half_extents;
+		box.max =  mm._data.obb[mesh[i]].half_extents;
+		aabbs[slot[i]] = aabb::transformed(box, tm[i]);
+	}
+}
 
-		if (_sprite_manager.has(*begin)) {
-			SpriteInstance sprite = _sprite_manager.sprite(*begin);
-			sid.world[sprite.i] = *world;
+void RenderWorld::update_transforms(const UnitId *begin, const UnitId *end, const Matrix4x4 *world)
+{
+	array::resize(_mesh_manager._aabbs_temp, u32(end - begin));
+
+	UpdateTransformsData utd;
+	utd.rw = this;
+	utd.units = begin;
+	utd.world = world;
+	utd.mesh_aabbs = array::begin(_mesh_manager._aabbs_temp);
+
+	// Each unit owns at most one instance per manager, so writes never alias.
+	job_system::parallel_for(u32(end - begin), 256, [](u32 begin, u32 end, void *data) {
+			UpdateTransformsData *utd = (UpdateTransformsData *)data;
+			MeshManager &mm = utd->rw->_mesh_manager;
+			SpriteManager &sm = utd->rw->_sprite_manager;
+			ParticleManager &pm = utd->rw->_particle_manager;
+			LightManager &lm = utd->rw->_light_manager;
+
+			// Mesh boxes are transformed in groups.
+			u32 meshes[UPDATE_TRANSFORMS_GROUP_SIZE];
+			u32 slots[UPDATE_TRANSFORMS_GROUP_SIZE];
+			Matrix4x4 worlds[UPDATE_TRANSFORMS_GROUP_SIZE];
+			u32 num_meshes = 0;
+
+			for (u32 ii = begin; ii < end; ++ii) {
+				const UnitId unit = utd->units[ii];
+
+				if (mm.has(unit)) {
+					MeshInstance mesh = mm.mesh(unit);
+					mm._data.world[mesh.i] = utd->world[ii];
+
+					meshes[num_meshes] = mesh.i;
+					slots[num_meshes] = ii;
+					worlds[num_meshes] = utd->world[ii];
+					if (++num_meshes == UPDATE_TRANSFORMS_GROUP_SIZE) {
+						mesh_world_aabbs(utd->mesh_aabbs, mm, meshes, slots, worlds, num_meshes);
+						num_meshes = 0;
+					}
+				}
+
+				if (sm.has(unit)) {
+					SpriteInstance sprite = sm.sprite(unit);
+					sm._data.world[sprite.i] = utd->world[ii];
+				}
+
+				if (pm.has(unit)) {
+					ParticleSystemInstance ps = pm.particle_system(unit);
+					pm._data.world[ps.i] = utd->world[ii];
+				}
+
+				if (lm.has(unit)) {
+					LightInstance light = lm.light(unit);
+					lm._data.world[light.i] = utd->world[ii];
+				}
+			}
+
+			mesh_world_aabbs(utd->mesh_aabbs, mm, meshes, slots, worlds, num_meshes);
 		}
+		, &utd
+		);
 
-		if (_light_manager.has(*begin)) {
-			LightInstance light = _light_manager.light(*begin);
-			lid.world[light.i] = *world;
+	// Trees are not thread-safe: move the proxies afterwards.
+	for (const UnitId *unit = begin; unit != end; ++unit) {
+		const MeshInstance mesh = _mesh_manager.mesh(*unit);
+		if (is_valid(mesh))
+			aabb_tree::move(_mesh_manager._tree, _mesh_manager._data.proxy[mesh.i], utd.mesh_aabbs[unit - begin]);
+
+		const SpriteInstance sprite = _sprite_manager.sprite(*unit);
+		if (is_valid(sprite))
+			_sprite_manager.update_proxy(sprite.i);
+
+		const LightInstance light = _light_manager.light(*unit);
+		if (is_valid(light))
+			_light_manager.update_proxy(light.i);
+
+		// Tilemaps are few and own many proxies each.
+		const TilemapInstance tilemap = _tilemap_manager.tilemap(*unit);
+		if (is_valid(tilemap)) {
+			_tilemap_manager._data.world[tilemap.i] = world[unit - begin];
+			_tilemap_manager.update_proxies(tilemap.i);
 		}
 	}
 }
 
-void RenderWorld::render(const Matrix4x4 &view)
+void RenderWorld::update_particles(f32 dt)
+{
+	_particle_manager.update(dt);
+}
+
+void RenderWorld::render(const Matrix4x4 &view, const Matrix4x4 &proj)
 {
 	LightManager::LightInstanceData &lid = _light_manager._data;
 
+	Frustum f;
+	frustum::from_matrix(f, view * proj);
+	_mesh_manager.cull(f);
+	_sprite_manager.cull(f);
+	_tilemap_manager.cull(f);
+	_particle_manager.cull(f);
+
+	const u32 meshes_in_frustum = array::size(_mesh_manager._visible);
+	u32 meshes_occluded = 0;
+	if (_occlusion_culling)
+		meshes_occluded = _mesh_manager.cull_occluded(_occlusion_buffer, view * proj);
+
+	_mesh_manager.select_lods(view * proj, fabs(proj.y.y));
+
+	RECORD_FLOAT("render_world.meshes_visible", f32(array::size(_mesh_manager._visible)));
+	RECORD_FLOAT("render_world.meshes_culled", f32(_mesh_manager._data.first_hidden - meshes_in_frustum));
+	RECORD_FLOAT("render_world.meshes_occluded", f32(meshes_occluded));
+	RECORD_FLOAT("render_world.occluder_triangles", f32(_occlusion_buffer._num_triangles));
+	RECORD_FLOAT("render_world.sprites_visible", f32(array::size(_sprite_manager._visible)));
+	RECORD_FLOAT("render_world.sprites_culled", f32(_sprite_manager._data.first_hidden - array::size(_sprite_manager._visible)));
+	RECORD_FLOAT("render_world.tilemap_chunks_visible", f32(array::size(_tilemap_manager._visible)));
+	RECORD_FLOAT("render_world.particle_systems_visible", f32(array::size(_particle_manager._visible)));
+
+	// Pack lights in view-space:
+	// 0: position, type
+	// 1: direction, range
+	// 2: color, intensity
+	// 3: cosine of spot angle
+	array::resize(_light_data, lid.size*4);
+	array::clear(_light_manager._directional);
 	for (u32 ll = 0; ll < lid.size; ++ll) {
-		const Vector4 ldir = normalize(lid.world[ll].z) * view;
-		const Vector3 lpos = translation(lid.world[ll]);
-
-		bgfx::setUniform(_u_light_position, to_float_ptr(lpos));
-		bgfx::setUniform(_u_light_direction, to_float_ptr(ldir));
-		bgfx::setUniform(_u_light_color, to_float_ptr(lid.color[ll]));
-		bgfx::setUniform(_u_light_range, &lid.range[ll]);
-		bgfx::setUniform(_u_light_intensity, &lid.intensity[ll]);
+		if (lid.type[ll] == LightType::DIRECTIONAL)
+			array::push_back(_light_manager._directional, ll);
 
-		_mesh_manager.draw(VIEW_MESH
-			, _resource_manager
-			, _shader_manager
-			);
+		const Vector3 lpos = translation(lid.world[ll]);
+		const Vector4 pos = vector4(lpos.x, lpos.y, lpos.z, 1.0f) * view;
+		const Vector4 dir = normalize(lid.world[ll].z) * view;
+		const Color4 &col = lid.color[ll];
+
+		_light_data[ll*4 + 0] = vector4(pos.x, pos.y, pos.z, f32(lid.type[ll]));
+		_light_data[ll*4 + 1] = vector4(dir.x, dir.y, dir.z, lid.range[ll]);
+		_light_data[ll*4 + 2] = vector4(col.x, col.y, col.z, lid.intensity[ll]);
+		_light_data[ll*4 + 3] = vector4(fcos(lid.spot_angle[ll]), 0.0f, 0.0f, 0.0f);
 	}
 
-	_sprite_manager.draw(VIEW_SPRITE_0
+	_mesh_manager.sort(VIEW_MESH, view, *_resource_manager, *_shader_manager);
+	_mesh_manager.draw(VIEW_MESH
 		, _resource_manager
 		, _shader_manager
 		);
 
-	// Render outlines.
-	_mesh_manager.draw(VIEW_SELECTION
+	_tilemap_manager.draw(VIEW_SPRITE_0
 		, _resource_manager
 		, _shader_manager
-		, selection_draw_override
 		);
-	_sprite_manager.draw(VIEW_SELECTION
+	_sprite_manager.draw(VIEW_SPRITE_0
 		, _resource_manager
 		, _shader_manager
-		, selection_draw_override
 		);
+	_particle_manager.draw(VIEW_PARTICLE
+		, view
+		, _resource_manager
+		, _shader_manager
+		);
+
+	// Render outlines.
+	if (has_selection()) {
+		_mesh_manager.draw(VIEW_SELECTION
+			, _resource_manager
+			, _shader_manager
+			, selection_draw_override
+			);
+		_sprite_manager.draw(VIEW_SELECTION
+			, _resource_manager
+			, _shader_manager
+			, selection_draw_override
+			);
+		_tilemap_manager.draw(VIEW_SELECTION
+			, _resource_manager
+			, _shader_manager
+			, selection_draw_override
+			);
+	}
 }
 
 void RenderWorld::debug_draw(DebugLine &dl)
@@ -458,6 +886,16 @@ void RenderWorld::enable_debug_drawing(bool enable)
 	_debug_drawing = enable;
 }
 
+void RenderWorld::enable_occlusion_culling(bool enable)
+{
+	_occlusion_culling = enable;
+}
+
+bool RenderWorld::has_selection()
+{
+	return hash_set::size(_selection) != 0;
+}
+
 void RenderWorld::unit_destroyed_callback(UnitId unit)
 {
 	{
@@ -474,6 +912,20 @@ void RenderWorld::unit_destroyed_callback(UnitId unit)
 			sprite_destroy(first);
 	}
 
+	{
+		TilemapInstance first = tilemap_instance(unit);
+
+		if (is_valid(first))
+			tilemap_destroy(first);
+	}
+
+	{
+		ParticleSystemInstance first = particle_system_instance(unit);
+
+		if (is_valid(first))
+			particle_system_destroy(first);
+	}
+
 	{
 		LightInstance first = light_instance(unit);
 
@@ -494,6 +946,8 @@ void RenderWorld::MeshManager::allocate(u32 num)
 		+ num*sizeof(Material *) + alignof(Material *)
 		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
 		+ num*sizeof(OBB) + alignof(OBB)
+		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(bool) + alignof(bool)
 		;
 
 	MeshInstanceData new_data;
@@ -509,6 +963,8 @@ void RenderWorld::MeshManager::allocate(u32 num)
 	new_data.material      = (Material **          )memory::align_top(new_data.mesh + num,     alignof(Material *));
 	new_data.world         = (Matrix4x4 *          )memory::align_top(new_data.material + num, alignof(Matrix4x4));
 	new_data.obb           = (OBB *                )memory::align_top(new_data.world + num,    alignof(OBB));
+	new_data.proxy         = (u32 *                )memory::align_top(new_data.obb + num,      alignof(u32));
+	new_data.occluder      = (bool *               )memory::align_top(new_data.proxy + num,    alignof(bool));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.resource, _data.resource, _data.size * sizeof(MeshResource *));
@@ -517,6 +973,8 @@ void RenderWorld::MeshManager::allocate(u32 num)
 	memcpy(new_data.material, _data.material, _data.size * sizeof(Material *));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
 	memcpy(new_data.obb, _data.obb, _data.size * sizeof(OBB));
+	memcpy(new_data.proxy, _data.proxy, _data.size * sizeof(u32));
+	memcpy(new_data.occluder, _data.occluder, _data.size * sizeof(bool));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -529,7 +987,7 @@ void RenderWorld::MeshManager::grow()
 
 MeshInstance RenderWorld::MeshManager::create(UnitId unit, const MeshResource *mr, const MeshRendererDesc &mrd, const Matrix4x4 &tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a mesh component");
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a mesh component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -544,11 +1002,16 @@ MeshInstance RenderWorld::MeshManager::create(UnitId unit, const MeshResource *m
 	_data.geometry[last] = mg;
 	_data.mesh[last].vbh = mg->vertex_buffer;
 	_data.mesh[last].ibh = mg->index_buffer;
+	_data.mesh[last].lod = 0;
+	_data.mesh[last].first_index = mg->lods[0].first_index;
+	_data.mesh[last].num_indices = mg->lods[0].num_indices;
 	_data.material[last] = _render_world->_material_manager->get(mat_res);
 	_data.world[last]    = tr;
 	_data.obb[last]      = mg->obb;
+	_data.proxy[last]    = aabb_tree::create(_tree, world_aabb(last), last);
+	_data.occluder[last] = mrd.occluder;
 
-	hash_map::set(_map, unit, last);
+	unit_map::set(_map, unit, last);
 	++_data.size;
 
 	if (mrd.visible) {
@@ -573,17 +1036,22 @@ void RenderWorld::MeshManager::destroy(MeshInstance inst)
 	const UnitId u      = _data.unit[inst.i];
 	const UnitId last_u = _data.unit[last];
 
+	aabb_tree::destroy(_tree, _data.proxy[inst.i]);
+	if (inst.i != last)
+		aabb_tree::set_user_data(_tree, _data.proxy[last], inst.i);
+
 	_data.unit[inst.i]     = _data.unit[last];
 	_data.resource[inst.i] = _data.resource[last];
 	_data.geometry[inst.i] = _data.geometry[last];
-	_data.mesh[inst.i].vbh = _data.mesh[last].vbh;
-	_data.mesh[inst.i].ibh = _data.mesh[last].ibh;
+	_data.mesh[inst.i]     = _data.mesh[last];
 	_data.material[inst.i] = _data.material[last];
 	_data.world[inst.i]    = _data.world[last];
 	_data.obb[inst.i]      = _data.obb[last];
+	_data.proxy[inst.i]    = _data.proxy[last];
+	_data.occluder[inst.i] = _data.occluder[last];
 
-	hash_map::set(_map, last_u, inst.i);
-	hash_map::remove(_map, u);
+	unit_map::set(_map, last_u, inst.i);
+	unit_map::remove(_map, u);
 	--_data.size;
 
 	// If item was hidden.
@@ -612,9 +1080,13 @@ void RenderWorld::MeshManager::swap(u32 inst_a, u32 inst_b)
 	exchange(_data.material[inst_a], _data.material[inst_b]);
 	exchange(_data.world[inst_a],    _data.world[inst_b]);
 	exchange(_data.obb[inst_a],      _data.obb[inst_b]);
+	exchange(_data.proxy[inst_a],    _data.proxy[inst_b]);
+	exchange(_data.occluder[inst_a], _data.occluder[inst_b]);
+	aabb_tree::set_user_data(_tree, _data.proxy[inst_a], inst_a);
+	aabb_tree::set_user_data(_tree, _data.proxy[inst_b], inst_b);
 
-	hash_map::set(_map, unit_a, inst_b);
-	hash_map::set(_map, unit_b, inst_a);
+	unit_map::set(_map, unit_a, inst_b);
+	unit_map::set(_map, unit_b, inst_a);
 }
 
 bool RenderWorld::MeshManager::has(UnitId unit)
@@ -641,7 +1113,7 @@ void RenderWorld::MeshManager::set_visible(MeshInstance inst, bool visible)
 
 MeshInstance RenderWorld::MeshManager::mesh(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
 }
 
 void RenderWorld::MeshManager::destroy()
@@ -649,18 +1121,308 @@ void RenderWorld::MeshManager::destroy()
 	_allocator->deallocate(_data.buffer);
 }
 
+/// Removes from @a visible the instances in the hidden partition.
+static void remove_hidden(Array<u32> &visible, u32 first_hidden)
+{
+	u32 num = 0;
+	for (u32 vv = 0; vv < array::size(visible); ++vv) {
+		if (visible[vv] < first_hidden)
+			visible[num++] = visible[vv];
+	}
+	array::resize(visible, num);
+}
+
+void RenderWorld::MeshManager::cull(const Frustum &f)
+{
+	// The tree only knows the fat boxes of the instances: test the
+	// candidates it returns against their exact boxes.
+	array::clear(_visible);
+	aabb_tree::query_frustum(_tree, _visible, f);
+	remove_hidden(_visible, _data.first_hidden);
+	array::resize(_visible, obb_intersects_frustum_batch(array::begin(_visible), array::size(_visible), _data.obb, _data.world, f));
+}
+
+u32 RenderWorld::MeshManager::cull_occluded(OcclusionBuffer &ob, const Matrix4x4 &view_proj)
+{
+	ob.clear(view_proj);
+
+	for (u32 vv = 0; vv < array::size(_visible); ++vv) {
+		const u32 ii = _visible[vv];
+		if (!_data.occluder[ii])
+			continue;
+
+		const MeshGeometry *mg = _data.geometry[ii];
+		ob.add_occluder(_data.world[ii]
+			, mg->vertices.data
+			, mg->vertices.stride
+			, mg->vertices.num
+			, (const u16 *)mg->indices.data
+			, mg->indices.num
+			);
+	}
+
+	ob.update_tiles();
+
+	// Occluders are never culled: they would be tested against themselves.
+	u32 num = 0;
+	for (u32 vv = 0; vv < array::size(_visible); ++vv) {
+		const u32 ii = _visible[vv];
+		if (_data.occluder[ii] || !ob.is_occluded(_data.obb[ii], _data.world[ii]))
+			_visible[num++] = ii;
+	}
+
+	const u32 num_occluded = array::size(_visible) - num;
+	array::resize(_visible, num);
+	return num_occluded;
+}
+
+void RenderWorld::MeshManager::select_lods(const Matrix4x4 &view_proj, f32 proj_scale)
+{
+	for (u32 vv = 0; vv < array::size(_visible); ++vv) {
+		const u32 ii = _visible[vv];
+		const MeshGeometry *mg = _data.geometry[ii];
+		if (mg->num_lods == 1)
+			continue;
+
+		Vector3 center;
+		f32 radius;
+		mesh_bounding_sphere(center, radius, _data.obb[ii], _data.world[ii]);
+
+		// Diameter of the bounding sphere relative to the viewport height.
+		const f32 w = center.x*view_proj.x.w + center.y*view_proj.y.w + center.z*view_proj.z.w + view_proj.t.w;
+		const f32 screen_size = w > radius ? radius*proj_scale / w : FLT_MAX;
+
+		MeshData &md = _data.mesh[ii];
+		md.lod = mesh_resource::lod(mg, md.lod, screen_size);
+		md.first_index = mg->lods[md.lod].first_index;
+		md.num_indices = mg->lods[md.lod].num_indices;
+	}
+}
+
+AABB RenderWorld::MeshManager::world_aabb(u32 i)
+{
+	return obb_to_aabb(_data.obb[i], _data.world[i]);
+}
+
+void RenderWorld::MeshManager::update_proxy(u32 i)
+{
+	aabb_tree::move(_tree, _data.proxy[i], world_aabb(i));
+}
+
+static f32 mesh_ray(u32 i, const Vector3 &from, const Vector3 &dir, void *user_data)
+{
+	const RenderWorld::MeshManager::MeshInstanceData &mid = *(RenderWorld::MeshManager::MeshInstanceData *)user_data;
+
+	if (i >= mid.first_hidden)
+		return -1.0f;
+
+	return mesh_resource::cast_ray(mid.geometry[i], mid.world[i], from, dir);
+}
+
+f32 RenderWorld::MeshManager::cast_ray(MeshInstance &mesh, const Vector3 &from, const Vector3 &dir)
+{
+	u32 hit;
+	const f32 t = aabb_tree::cast_ray(_tree, from, dir, mesh_ray, &_data, &hit);
+	if (t != -1.0f)
+		mesh = make_instance(hit);
+
+	return t;
+}
+
+struct MeshDrawData
+{
+	RenderWorld::MeshManager *mm;
+	ResourceManager *rm;
+	ShaderManager *sm;
+	RenderWorld::DrawOverride draw_override;
+	bgfx::InstanceDataBuffer idb;
+	u8 view;
+};
+
 void RenderWorld::MeshManager::draw(u8 view, ResourceManager *rm, ShaderManager *sm, DrawOverride draw_override)
 {
-	for (u32 ii = 0; ii < _data.first_hidden; ++ii) {
-		bgfx::setTransform(to_float_ptr(_data.world[ii]));
-		bgfx::setVertexBuffer(0, _data.mesh[ii].vbh);
-		bgfx::setIndexBuffer(_data.mesh[ii].ibh);
+	const u32 num_visible = array::size(_visible);
+	if (num_visible == 0)
+		return;
 
-		if (draw_override)
-			draw_override(_data.unit[ii], _render_world);
+	MeshDrawData mdd;
+	mdd.mm = this;
+	mdd.rm = rm;
+	mdd.sm = sm;
+	mdd.draw_override = draw_override;
+	mdd.view = view;
+
+	if (draw_override) {
+		job_system::parallel_for(num_visible, 256, [](u32 begin, u32 end, void *data) {
+				const MeshDrawData *mdd = (MeshDrawData *)data;
+				const MeshManager &mm = *mdd->mm;
+				bgfx::Encoder *encoder = begin_encoder();
+
+				for (u32 vv = begin; vv < end; ++vv) {
+					const u32 ii = mm._visible[vv];
+
+					encoder->setTransform(to_float_ptr(mm._data.world[ii]));
+					encoder->setVertexBuffer(0, mm._data.mesh[ii].vbh);
+					encoder->setIndexBuffer(mm._data.mesh[ii].ibh, mm._data.mesh[ii].first_index, mm._data.mesh[ii].num_indices);
+					mdd->draw_override(encoder, mm._data.unit[ii], mm._render_world);
+				}
+
+				bgfx::end(encoder);
+			}
+			, &mdd
+			);
+		return;
+	}
+
+	// Split _visible in batches, each drawn with a single (instanced) draw
+	// call. Materials are resolved here because resolving is not thread-safe.
+	const bool instancing = (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+	const u32 avail = instancing ? bgfx::getAvailInstanceDataBuffer(num_visible, sizeof(Matrix4x4)) : 0;
+	u32 num_instances = 0;
+	array::clear(_batches);
+
+	for (u32 vv = 0; vv < num_visible;) {
+		const u32 ii = _visible[vv];
+		Material *material = _data.material[ii];
+		if (!material->_resolved)
+			material->resolve(*rm, *sm);
+
+		u32 num = 1;
+		while (vv + num < num_visible) {
+			const u32 jj = _visible[vv + num];
+			if (_data.mesh[jj].vbh.idx != _data.mesh[ii].vbh.idx
+				|| _data.mesh[jj].ibh.idx != _data.mesh[ii].ibh.idx
+				|| _data.mesh[jj].first_index != _data.mesh[ii].first_index
+				|| _data.material[jj] != material
+				)
+				break;
+			++num;
+		}
+
+		if (num > 1 && bgfx::isValid(material->_program_instanced))
+			num = max(min(num, avail - num_instances), 1u);
 		else
-			_data.material[ii]->bind(*rm, *sm, view);
+			num = 1;
+
+		DrawBatch db;
+		db.first = vv;
+		db.num = num;
+		db.instance = UINT32_MAX;
+		if (num > 1) {
+			db.instance = num_instances;
+			num_instances += num;
+		}
+		array::push_back(_batches, db);
+
+		vv += num;
+	}
+
+	if (num_instances > 0)
+		bgfx::allocInstanceDataBuffer(&mdd.idb, num_instances, sizeof(Matrix4x4));
+
+	job_system::parallel_for(array::size(_batches), 64, [](u32 begin, u32 end, void *data) {
+			const MeshDrawData *mdd = (MeshDrawData *)data;
+			const MeshManager &mm = *mdd->mm;
+			bgfx::Encoder *encoder = begin_encoder();
+			TempAllocator1024 ta;
+			Array<u32> query(ta);
+			const Material *bound = NULL;
+
+			for (u32 bb = begin; bb < end; ++bb) {
+				const DrawBatch &db = mm._batches[bb];
+				const u32 ii = mm._visible[db.first];
+				Material *material = mm._data.material[ii];
+
+				Vector3 center;
+				f32 radius;
+				bgfx::ProgramHandle program;
+				u64 state;
+				if (db.instance != UINT32_MAX) {
+					// Lights are picked for the sphere that bounds all the instances.
+					AABB box;
+					aabb::reset(box);
+					for (u32 nn = 0; nn < db.num; ++nn) {
+						const u32 jj = mm._visible[db.first + nn];
+						memcpy(mdd->idb.data + (db.instance + nn)*sizeof(Matrix4x4), to_float_ptr(mm._data.world[jj]), sizeof(Matrix4x4));
+
+						mesh_bounding_sphere(center, radius, mm._data.obb[jj], mm._data.world[jj]);
+						box.min = min(box.min, center - vector3(radius, radius, radius));
+						box.max = max(box.max, center + vector3(radius, radius, radius));
+					}
+					center = aabb::center(box);
+					radius = aabb::radius(box);
+
+					encoder->setInstanceDataBuffer(&mdd->idb, db.instance, db.num);
+					program = material->_program_instanced;
+					state = material->_state_instanced;
+				} else {
+					mesh_bounding_sphere(center, radius, mm._data.obb[ii], mm._data.world[ii]);
+
+					encoder->setTransform(to_float_ptr(mm._data.world[ii]));
+					program = material->_program;
+					state = material->_state;
+				}
+
+				encoder->setVertexBuffer(0, mm._data.mesh[ii].vbh);
+				encoder->setIndexBuffer(mm._data.mesh[ii].ibh, mm._data.mesh[ii].first_index, mm._data.mesh[ii].num_indices);
+				set_mesh_lights(encoder, query, mm._render_world, center, radius);
+
+				// Batches are submitted with their index as depth so that
+				// VIEW_MESH keeps the order of _visible across encoders.
+				// Textures and uniforms set by the previous batch are still in
+				// effect if it used the same material.
+				if (material != bound) {
+					material->set_parameters(encoder, *mdd->rm, *mdd->sm);
+					bound = material;
+				}
+
+				const bool same_material = bb + 1 < end && mm._data.material[mm._visible[mm._batches[bb + 1].first]] == material;
+				encoder->setState(state);
+				encoder->submit(mdd->view
+					, program
+					, s32(bb)
+					, same_material ? (BGFX_DISCARD_ALL & ~BGFX_DISCARD_BINDINGS) : BGFX_DISCARD_ALL
+					);
+			}
+
+			bgfx::end(encoder);
+		}
+		, &mdd
+		);
+}
+
+void RenderWorld::MeshManager::sort(u8 view, const Matrix4x4 &view_tm, ResourceManager &rm, ShaderManager &sm)
+{
+	const u32 num = array::size(_visible);
+	array::resize(_sort_keys, num);
+	array::resize(_sort_keys_temp, num);
+	array::resize(_sort_items_temp, num);
+
+	for (u32 vv = 0; vv < num; ++vv) {
+		const u32 ii = _visible[vv];
+		Material *material = _data.material[ii];
+		if (!material->_resolved)
+			material->resolve(rm, sm);
+
+		const Vector3 pos = translation(_data.obb[ii].tm * _data.world[ii]);
+		const f32 depth = pos.x*view_tm.x.z + pos.y*view_tm.y.z + pos.z*view_tm.z.z + view_tm.t.z;
+
+		_sort_keys[vv] = sort_key(view
+			, (material->_state & BGFX_STATE_BLEND_MASK) != 0
+			, material->_program.idx
+			, material
+			, _data.mesh[ii].vbh.idx
+			, _data.mesh[ii].lod
+			, depth
+			);
 	}
+
+	bx::radixSort(array::begin(_sort_keys)
+		, array::begin(_sort_keys_temp)
+		, array::begin(_visible)
+		, array::begin(_sort_items_temp)
+		, num
+		);
 }
 
 void RenderWorld::SpriteManager::allocate(u32 num)
@@ -673,11 +1435,12 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 		+ num*sizeof(Material **) + alignof(Material *)
 		+ num*sizeof(u32) + alignof(u32)
 		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
-		+ num*sizeof(AABB) + alignof(AABB)
+		+ num*sizeof(OBB) + alignof(OBB)
 		+ num*sizeof(bool) + alignof(bool)
 		+ num*sizeof(bool) + alignof(bool)
 		+ num*sizeof(u32) + alignof(u32)
 		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(u32) + alignof(u32)
 		;
 
 	SpriteInstanceData new_data;
@@ -691,22 +1454,24 @@ void RenderWorld::SpriteManager::allocate(u32 num)
 	new_data.material = (Material **            )memory::align_top(new_data.resource + num, alignof(Material *));
 	new_data.frame    = (u32 *                  )memory::align_top(new_data.material + num, alignof(u32));
 	new_data.world    = (Matrix4x4 *            )memory::align_top(new_data.frame + num,    alignof(Matrix4x4));
-	new_data.aabb     = (AABB *                 )memory::align_top(new_data.world + num,    alignof(AABB));
-	new_data.flip_x   = (bool *                 )memory::align_top(new_data.aabb + num,     alignof(bool));
+	new_data.obb      = (OBB *                  )memory::align_top(new_data.world + num,    alignof(OBB));
+	new_data.flip_x   = (bool *                 )memory::align_top(new_data.obb + num,      alignof(bool));
 	new_data.flip_y   = (bool *                 )memory::align_top(new_data.flip_x + num,   alignof(bool));
 	new_data.layer    = (u32 *                  )memory::align_top(new_data.flip_y + num,   alignof(u32));
 	new_data.depth    = (u32 *                  )memory::align_top(new_data.layer + num,    alignof(u32));
+	new_data.proxy    = (u32 *                  )memory::align_top(new_data.depth + num,    alignof(u32));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.resource, _data.resource, _data.size * sizeof(SpriteResource**));
 	memcpy(new_data.material, _data.material, _data.size * sizeof(Material **));
 	memcpy(new_data.frame, _data.frame, _data.size * sizeof(u32));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
-	memcpy(new_data.aabb, _data.aabb, _data.size * sizeof(AABB));
+	memcpy(new_data.obb, _data.obb, _data.size * sizeof(OBB));
 	memcpy(new_data.flip_x, _data.flip_x, _data.size * sizeof(bool));
 	memcpy(new_data.flip_y, _data.flip_y, _data.size * sizeof(bool));
 	memcpy(new_data.layer, _data.layer, _data.size * sizeof(u32));
 	memcpy(new_data.depth, _data.depth, _data.size * sizeof(u32));
+	memcpy(new_data.proxy, _data.proxy, _data.size * sizeof(u32));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -719,7 +1484,7 @@ void RenderWorld::SpriteManager::grow()
 
 SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResource *sr, const SpriteRendererDesc &srd, const Matrix4x4 &tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a sprite component");
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a sprite component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -733,13 +1498,14 @@ SpriteInstance RenderWorld::SpriteManager::create(UnitId unit, const SpriteResou
 	_data.material[last] = _render_world->_material_manager->get(mat_res);
 	_data.frame[last]    = 0;
 	_data.world[last]    = tr;
-	_data.aabb[last]     = AABB();
+	_data.obb[last]      = sr->obb;
 	_data.flip_x[last]   = false;
 	_data.flip_y[last]   = false;
 	_data.layer[last]    = srd.layer;
 	_data.depth[last]    = srd.depth;
+	_data.proxy[last]    = aabb_tree::create(_tree, world_aabb(last), last);
 
-	hash_map::set(_map, unit, last);
+	unit_map::set(_map, unit, last);
 	++_data.size;
 
 	if (srd.visible) {
@@ -764,19 +1530,24 @@ void RenderWorld::SpriteManager::destroy(SpriteInstance inst)
 	const UnitId u      = _data.unit[inst.i];
 	const UnitId last_u = _data.unit[last];
 
+	aabb_tree::destroy(_tree, _data.proxy[inst.i]);
+	if (inst.i != last)
+		aabb_tree::set_user_data(_tree, _data.proxy[last], inst.i);
+
 	_data.unit[inst.i]     = _data.unit[last];
 	_data.resource[inst.i] = _data.resource[last];
 	_data.material[inst.i] = _data.material[last];
 	_data.frame[inst.i]    = _data.frame[last];
 	_data.world[inst.i]    = _data.world[last];
-	_data.aabb[inst.i]     = _data.aabb[last];
+	_data.obb[inst.i]      = _data.obb[last];
 	_data.flip_x[inst.i]   = _data.flip_x[last];
 	_data.flip_y[inst.i]   = _data.flip_y[last];
 	_data.layer[inst.i]    = _data.layer[last];
 	_data.depth[inst.i]    = _data.depth[last];
+	_data.proxy[inst.i]    = _data.proxy[last];
 
-	hash_map::set(_map, last_u, inst.i);
-	hash_map::remove(_map, u);
+	unit_map::set(_map, last_u, inst.i);
+	unit_map::remove(_map, u);
 	--_data.size;
 
 	// If item was hidden.
@@ -803,14 +1574,17 @@ void RenderWorld::SpriteManager::swap(u32 inst_a, u32 inst_b)
 	exchange(_data.material[inst_a], _data.material[inst_b]);
 	exchange(_data.frame[inst_a],    _data.frame[inst_b]);
 	exchange(_data.world[inst_a],    _data.world[inst_b]);
-	exchange(_data.aabb[inst_a],     _data.aabb[inst_b]);
+	exchange(_data.obb[inst_a],      _data.obb[inst_b]);
 	exchange(_data.flip_x[inst_a],   _data.flip_x[inst_b]);
 	exchange(_data.flip_y[inst_a],   _data.flip_y[inst_b]);
 	exchange(_data.layer[inst_a],    _data.layer[inst_b]);
 	exchange(_data.depth[inst_a],    _data.depth[inst_b]);
+	exchange(_data.proxy[inst_a],    _data.proxy[inst_b]);
+	aabb_tree::set_user_data(_tree, _data.proxy[inst_a], inst_a);
+	aabb_tree::set_user_data(_tree, _data.proxy[inst_b], inst_b);
 
-	hash_map::set(_map, unit_a, inst_b);
-	hash_map::set(_map, unit_b, inst_a);
+	unit_map::set(_map, unit_a, inst_b);
+	unit_map::set(_map, unit_b, inst_a);
 }
 
 bool RenderWorld::SpriteManager::has(UnitId unit)
@@ -837,108 +1611,883 @@ void RenderWorld::SpriteManager::set_visible(SpriteInstance inst, bool visible)
 
 SpriteInstance RenderWorld::SpriteManager::sprite(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
 }
 
 void RenderWorld::SpriteManager::destroy()
 {
+	if (bgfx::isValid(_quad_ib))
+		bgfx::destroy(_quad_ib);
+	if (bgfx::isValid(_quad_vb))
+		bgfx::destroy(_quad_vb);
+
 	_allocator->deallocate(_data.buffer);
 }
 
-void RenderWorld::SpriteManager::draw(u8 view, ResourceManager *rm, ShaderManager *sm, DrawOverride draw_override)
+void RenderWorld::SpriteManager::cull(const Frustum &f)
 {
-	bgfx::VertexLayout layout;
+	// The tree only knows the fat boxes of the instances: test the
+	// candidates it returns against their exact boxes.
+	array::clear(_visible);
+	aabb_tree::query_frustum(_tree, _visible, f);
+	remove_hidden(_visible, _data.first_hidden);
+	array::resize(_visible, obb_intersects_frustum_batch(array::begin(_visible), array::size(_visible), _data.obb, _data.world, f));
+}
+
+AABB RenderWorld::SpriteManager::world_aabb(u32 i)
+{
+	return obb_to_aabb(_data.obb[i], _data.world[i]);
+}
+
+void RenderWorld::SpriteManager::update_proxy(u32 i)
+{
+	aabb_tree::move(_tree, _data.proxy[i], world_aabb(i));
+}
+
+/// Unit quad drawn by instanced sprites: (x, y, z) position, (u, v) corner.
+static const f32 s_sprite_quad_vertices[] =
+{
+	0.0f, 0.0f, 0.0f, 0.0f, 0.0f, // A
+	1.0f, 0.0f, 0.0f, 1.0f, 0.0f, // B
+	1.0f, 0.0f, 1.0f, 1.0f, 1.0f, // C
+	0.0f, 0.0f, 1.0f, 0.0f, 1.0f  // D
+};
+
+static const u16 s_sprite_quad_indices[] =
+{
+	0, 1, 2,
+	0, 2, 3
+};
+
+void RenderWorld::SpriteManager::quad(SpriteQuad &quad, u32 i) const
+{
+	const f32 *frame = sprite_resource::frame_data(_data.resource[i]
+		, _data.frame[i] % _data.resource[i]->num_frames
+		);
+	const Matrix4x4 &world = _data.world[i];
+
+	quad.translation = world.t;
+	quad.x = world.x;
+	quad.z = world.z;
+	quad.rect = vector4(frame[0], frame[2], frame[10], frame[12]); // A.xz, C.xz
+	quad.uv = vector4(frame[3], frame[4], frame[13], frame[14]);   // A.uv, C.uv
+
+	if (_data.flip_x[i])
+		exchange(quad.uv.x, quad.uv.z);
+
+	if (_data.flip_y[i])
+		exchange(quad.uv.y, quad.uv.w);
+}
+
+void RenderWorld::SpriteManager::vertices(SpriteVertex *vertices, u32 i) const
+{
+	SpriteQuad q;
+	quad(q, i);
+
+	// Same as the "sprite" shader does with instance data.
+	for (u32 vv = 0; vv < 4; ++vv) {
+		const f32 s = s_sprite_quad_vertices[vv*5 + 3];
+		const f32 t = s_sprite_quad_vertices[vv*5 + 4];
+
+		vertices[vv].position = vector3(lerp(q.rect.x, q.rect.z, s), 0.0f, lerp(q.rect.y, q.rect.w, t)) * _data.world[i];
+		vertices[vv].uv = vector2(lerp(q.uv.x, q.uv.z, s), lerp(q.uv.y, q.uv.w, t));
+	}
+}
+
+struct SpriteDrawData
+{
+	RenderWorld::SpriteManager *spm;
+	ResourceManager *rm;
+	ShaderManager *sm;
+	RenderWorld::DrawOverride draw_override;
+	bgfx::InstanceDataBuffer idb;
 	bgfx::TransientVertexBuffer tvb;
 	bgfx::TransientIndexBuffer tib;
-	f32 *vdata;
-	u16 *idata;
+	u32 num_quads; // Quads that fit in tvb and tib.
+	u8 view;
+};
+
+/// Fills @a sdd's transient buffers with the quads of the visible instances
+/// [begin, end).
+static void sprite_fill_quads(const SpriteDrawData *sdd, u32 begin, u32 end)
+{
+	const RenderWorld::SpriteManager &spm = *sdd->spm;
+	RenderWorld::SpriteManager::SpriteVertex *vdata = (RenderWorld::SpriteManager::SpriteVertex *)sdd->tvb.data;
+	u32 *idata = (u32 *)sdd->tib.data;
+
+	for (u32 vv = begin; vv < end; ++vv) {
+		spm.vertices(&vdata[vv*4], spm._visible[vv]);
+
+		idata[vv*6 + 0] = vv*4 + 0;
+		idata[vv*6 + 1] = vv*4 + 1;
+		idata[vv*6 + 2] = vv*4 + 2;
+		idata[vv*6 + 3] = vv*4 + 0;
+		idata[vv*6 + 4] = vv*4 + 2;
+		idata[vv*6 + 5] = vv*4 + 3;
+	}
+}
+
+/// Allocates @a sdd's transient buffers to hold up to @a num quads.
+/// Indices are 32-bit because 16-bit ones would address at most 16384
+/// sprites.
+static void sprite_alloc_quads(SpriteDrawData &sdd, u32 num, const bgfx::VertexLayout &layout)
+{
+	num = min(num, bgfx::getAvailTransientVertexBuffer(4*num, layout) / 4);
+	num = min(num, bgfx::getAvailTransientIndexBuffer(6*num, true) / 6);
+
+	sdd.num_quads = 0;
+	if (num == 0)
+		return;
 
-	// Allocate vertex and index buffers.
-	if (_data.first_hidden) {
-		layout.begin();
-		layout.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float);
-		layout.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, false);
-		layout.end();
+	bgfx::allocTransientVertexBuffer(&sdd.tvb, 4*num, layout);
+	bgfx::allocTransientIndexBuffer(&sdd.tib, 6*num, true);
+	sdd.num_quads = num;
+}
 
-		bgfx::allocTransientVertexBuffer(&tvb, 4*_data.first_hidden, layout);
-		bgfx::allocTransientIndexBuffer(&tib, 6*_data.first_hidden);
+void RenderWorld::SpriteManager::draw(u8 view, ResourceManager *rm, ShaderManager *sm, DrawOverride draw_override)
+{
+	const u32 num_visible = array::size(_visible);
+	if (num_visible == 0)
+		return;
 
-		vdata = (f32 *)tvb.data;
-		idata = (u16 *)tib.data;
+	if (!bgfx::isValid(_quad_vb)) {
+		_quad_vb = bgfx::createVertexBuffer(bgfx::makeRef(s_sprite_quad_vertices, sizeof(s_sprite_quad_vertices)), _layout);
+		_quad_ib = bgfx::createIndexBuffer(bgfx::makeRef(s_sprite_quad_indices, sizeof(s_sprite_quad_indices)));
 	}
 
-	// Render all sprites.
-	for (u32 ii = 0; ii < _data.first_hidden; ++ii) {
-		const f32 *frame = sprite_resource::frame_data(_data.resource[ii]
-			, _data.frame[ii] % _data.resource[ii]->num_frames
+	SpriteDrawData sdd;
+	sdd.spm = this;
+	sdd.rm = rm;
+	sdd.sm = sm;
+	sdd.draw_override = draw_override;
+	sdd.num_quads = 0;
+	sdd.view = view;
+
+	if (draw_override) {
+		// Overrides bring their own shader, which knows nothing about
+		// instance data: draw world-space vertices.
+		sprite_alloc_quads(sdd, num_visible, _layout);
+
+		job_system::parallel_for(sdd.num_quads, 256, [](u32 begin, u32 end, void *data) {
+				const SpriteDrawData *sdd = (SpriteDrawData *)data;
+				const SpriteManager &spm = *sdd->spm;
+				bgfx::Encoder *encoder = begin_encoder();
+
+				sprite_fill_quads(sdd, begin, end);
+
+				for (u32 vv = begin; vv < end; ++vv) {
+					encoder->setVertexBuffer(0, &sdd->tvb);
+					encoder->setIndexBuffer(&sdd->tib, vv*6, 6);
+					sdd->draw_override(encoder, spm._data.unit[spm._visible[vv]], spm._render_world);
+				}
+
+				bgfx::end(encoder);
+			}
+			, &sdd
 			);
+		return;
+	}
+
+	// Group sprites by layer, depth and material so that each group can
+	// be drawn with a single call.
+	array::resize(_sort_keys, num_visible);
+	array::resize(_sort_keys_temp, num_visible);
+	array::resize(_sort_items_temp, num_visible);
+
+	for (u32 vv = 0; vv < num_visible; ++vv) {
+		const u32 ii = _visible[vv];
+		const u64 material_bits = (u64(uintptr_t(_data.material[ii])) * UINT64_C(0x9e3779b97f4a7c15)) >> 40;
+		_sort_keys[vv] = (u64(_data.layer[ii] & 0xff) << 56)
+			| (u64(_data.depth[ii]) << 24)
+			| material_bits
+			;
+	}
 
-		f32 u0 = frame[ 3]; // u
-		f32 v0 = frame[ 4]; // v
+	bx::radixSort(array::begin(_sort_keys)
+		, array::begin(_sort_keys_temp)
+		, array::begin(_visible)
+		, array::begin(_sort_items_temp)
+		, num_visible
+		);
 
-		f32 u1 = frame[ 8]; // u
-		f32 v1 = frame[ 9]; // v
+	// Split _visible in batches. Instanced batches only upload the frame
+	// rectangles and the transform of each sprite, the others fall back to
+	// world-space vertices. Materials are resolved here because resolving
+	// is not thread-safe.
+	const bool instancing = (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+	const u32 avail = instancing ? bgfx::getAvailInstanceDataBuffer(num_visible, sizeof(SpriteQuad)) : 0;
+	u32 num_instances = 0;
+	bool fallback = false;
+	array::clear(_batches);
+
+	for (u32 vv = 0; vv < num_visible;) {
+		const u32 ii = _visible[vv];
+		Material *material = _data.material[ii];
+		if (!material->_resolved)
+			material->resolve(*rm, *sm);
+
+		u32 num = 1;
+		while (vv + num < num_visible) {
+			const u32 jj = _visible[vv + num];
+			if (_data.layer[jj] != _data.layer[ii]
+				|| _data.depth[jj] != _data.depth[ii]
+				|| _data.material[jj] != material
+				)
+				break;
+			++num;
+		}
 
-		f32 u2 = frame[13]; // u
-		f32 v2 = frame[14]; // v
+		DrawBatch db;
+		db.first = vv;
+		db.instance = UINT32_MAX;
+		if (num_instances < avail && bgfx::isValid(material->_program_instanced)) {
+			num = min(num, avail - num_instances);
+			db.instance = num_instances;
+			num_instances += num;
+		} else {
+			fallback = true;
+		}
+		db.num = num;
+		array::push_back(_batches, db);
 
-		f32 u3 = frame[18]; // u
-		f32 v3 = frame[19]; // v
+		vv += num;
+	}
 
-		if (_data.flip_x[ii]) {
-			f32 u;
-			u = u0; u0 = u1; u1 = u;
-			u = u2; u2 = u3; u3 = u;
+	if (num_instances > 0)
+		bgfx::allocInstanceDataBuffer(&sdd.idb, num_instances, sizeof(SpriteQuad));
+
+	// Fallback quads are stored at the position of their sprites in _visible.
+	if (fallback)
+		sprite_alloc_quads(sdd, num_visible, _layout);
+
+	job_system::parallel_for(array::size(_batches), 64, [](u32 begin, u32 end, void *data) {
+			const SpriteDrawData *sdd = (SpriteDrawData *)data;
+			const SpriteManager &spm = *sdd->spm;
+			bgfx::Encoder *encoder = begin_encoder();
+
+			for (u32 bb = begin; bb < end; ++bb) {
+				const DrawBatch &db = spm._batches[bb];
+				const u32 ii = spm._visible[db.first];
+				Material *material = spm._data.material[ii];
+
+				bgfx::ProgramHandle program;
+				u64 state;
+				if (db.instance != UINT32_MAX) {
+					SpriteQuad *quads = (SpriteQuad *)sdd->idb.data + db.instance;
+					for (u32 nn = 0; nn < db.num; ++nn)
+						spm.quad(quads[nn], spm._visible[db.first + nn]);
+
+					encoder->setInstanceDataBuffer(&sdd->idb, db.instance, db.num);
+					encoder->setVertexBuffer(0, spm._quad_vb);
+					encoder->setIndexBuffer(spm._quad_ib);
+					program = material->_program_instanced;
+					state = material->_state_instanced;
+				} else {
+					if (db.first >= sdd->num_quads)
+						continue;
+
+					const u32 num = min(db.num, sdd->num_quads - db.first);
+					sprite_fill_quads(sdd, db.first, db.first + num);
+
+					encoder->setVertexBuffer(0, &sdd->tvb);
+					encoder->setIndexBuffer(&sdd->tib, db.first*6, num*6);
+					program = material->_program;
+					state = material->_state;
+				}
+
+				material->set_parameters(encoder, *sdd->rm, *sdd->sm);
+				encoder->setState(state);
+				encoder->submit(spm._data.layer[ii] + sdd->view
+					, program
+					, spm._data.depth[ii]
+					);
+			}
+
+			bgfx::end(encoder);
 		}
+		, &sdd
+		);
+}
+
+void RenderWorld::ParticleManager::allocate(u32 num)
+{
+	CE_ENSURE(num > _data.size);
 
-		if (_data.flip_y[ii]) {
-			f32 v;
-			v = v0; v0 = v2; v2 = v;
-			v = v1; v1 = v3; v3 = v;
+	const u32 bytes = 0
+		+ num*sizeof(UnitId) + alignof(UnitId)
+		+ num*sizeof(ParticleSystemResource **) + alignof(ParticleSystemResource *)
+		+ num*sizeof(Material **) + alignof(Material *)
+		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
+		+ num*sizeof(ParticleEmitter **) + alignof(ParticleEmitter *)
+		+ num*sizeof(bool) + alignof(bool)
+		;
+
+	ParticleSystemInstanceData new_data;
+	new_data.size = _data.size;
+	new_data.capacity = num;
+	new_data.buffer = _allocator->allocate(bytes);
+
+	new_data.unit     = (UnitId *                       )memory::align_top(new_data.buffer,         alignof(UnitId));
+	new_data.resource = (const ParticleSystemResource **)memory::align_top(new_data.unit + num,     alignof(ParticleSystemResource *));
+	new_data.material = (Material **                    )memory::align_top(new_data.resource + num, alignof(Material *));
+	new_data.world    = (Matrix4x4 *                    )memory::align_top(new_data.material + num, alignof(Matrix4x4));
+	new_data.emitter  = (ParticleEmitter **             )memory::align_top(new_data.world + num,    alignof(ParticleEmitter *));
+	new_data.visible  = (bool *                         )memory::align_top(new_data.emitter + num,  alignof(bool));
+
+	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
+	memcpy(new_data.resource, _data.resource, _data.size * sizeof(ParticleSystemResource **));
+	memcpy(new_data.material, _data.material, _data.size * sizeof(Material **));
+	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
+	memcpy(new_data.emitter, _data.emitter, _data.size * sizeof(ParticleEmitter **));
+	memcpy(new_data.visible, _data.visible, _data.size * sizeof(bool));
+
+	_allocator->deallocate(_data.buffer);
+	_data = new_data;
+}
+
+void RenderWorld::ParticleManager::grow()
+{
+	allocate(_data.capacity * 2 + 1);
+}
+
+ParticleSystemInstance RenderWorld::ParticleManager::create(UnitId unit, const ParticleSystemResource *psr, const ParticleSystemDesc &psd, const Matrix4x4 &tr)
+{
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a particle system component");
+
+	if (_data.size == _data.capacity)
+		grow();
+
+	const u32 last = _data.size;
+
+	const MaterialResource *mat_res = (const MaterialResource *)_render_world->_resource_manager->get(RESOURCE_TYPE_MATERIAL, psd.material_resource);
+
+	_data.unit[last]     = unit;
+	_data.resource[last] = psr;
+	_data.material[last] = _render_world->_material_manager->get(mat_res);
+	_data.world[last]    = tr;
+	_data.emitter[last]  = CE_NEW(*_allocator, ParticleEmitter)(*_allocator, psr->max_particles, s32(unit._idx));
+	_data.visible[last]  = psd.visible;
+
+	unit_map::set(_map, unit, last);
+	++_data.size;
+
+	return make_instance(last);
+}
+
+void RenderWorld::ParticleManager::destroy(ParticleSystemInstance ps)
+{
+	CE_ASSERT(ps.i < _data.size, "Index out of bounds");
+
+	const u32 last = _data.size - 1;
+	const UnitId u = _data.unit[ps.i];
+	const UnitId last_u = _data.unit[last];
+
+	CE_DELETE(*_allocator, _data.emitter[ps.i]);
+
+	_data.unit[ps.i]     = _data.unit[last];
+	_data.resource[ps.i] = _data.resource[last];
+	_data.material[ps.i] = _data.material[last];
+	_data.world[ps.i]    = _data.world[last];
+	_data.emitter[ps.i]  = _data.emitter[last];
+	_data.visible[ps.i]  = _data.visible[last];
+
+	unit_map::set(_map, last_u, ps.i);
+	unit_map::remove(_map, u);
+	--_data.size;
+}
+
+bool RenderWorld::ParticleManager::has(UnitId unit)
+{
+	return is_valid(particle_system(unit));
+}
+
+ParticleSystemInstance RenderWorld::ParticleManager::particle_system(UnitId unit)
+{
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
+}
+
+void RenderWorld::ParticleManager::destroy()
+{
+	for (u32 ii = 0; ii < _data.size; ++ii)
+		CE_DELETE(*_allocator, _data.emitter[ii]);
+
+	if (bgfx::isValid(_quad_ib))
+		bgfx::destroy(_quad_ib);
+	if (bgfx::isValid(_quad_vb))
+		bgfx::destroy(_quad_vb);
+
+	_allocator->deallocate(_data.buffer);
+}
+
+struct ParticleUpdateData
+{
+	RenderWorld::ParticleManager *pm;
+	f32 dt;
+};
+
+void RenderWorld::ParticleManager::update(f32 dt)
+{
+	ParticleUpdateData pud;
+	pud.pm = this;
+	pud.dt = dt;
+
+	// Emitters own their particles: each one is updated by a single job.
+	job_system::parallel_for(_data.size, 16, [](u32 begin, u32 end, void *data) {
+			const ParticleUpdateData *pud = (ParticleUpdateData *)data;
+			ParticleManager &pm = *pud->pm;
+
+			for (u32 ii = begin; ii < end; ++ii)
+				pm._data.emitter[ii]->update(*pm._data.resource[ii], pm._data.world[ii], pud->dt);
 		}
+		, &pud
+		);
 
-		vdata[ 0] = frame[ 0]; // x
-		vdata[ 1] = frame[ 1]; // y
-		vdata[ 2] = frame[ 2]; // z
-		vdata[ 3] = u0;
-		vdata[ 4] = v0;
-
-		vdata[ 5] = frame[ 5]; // x
-		vdata[ 6] = frame[ 6]; // y
-		vdata[ 7] = frame[ 7]; // z
-		vdata[ 8] = u1;
-		vdata[ 9] = v1;
-
-		vdata[10] = frame[10]; // x
-		vdata[11] = frame[11]; // y
-		vdata[12] = frame[12]; // z
-		vdata[13] = u2;
-		vdata[14] = v2;
-
-		vdata[15] = frame[15]; // x
-		vdata[16] = frame[16]; // y
-		vdata[17] = frame[17]; // z
-		vdata[18] = u3;
-		vdata[19] = v3;
-
-		vdata += 20;
-
-		*idata++ = ii*4 + 0;
-		*idata++ = ii*4 + 1;
-		*idata++ = ii*4 + 2;
-		*idata++ = ii*4 + 0;
-		*idata++ = ii*4 + 2;
-		*idata++ = ii*4 + 3;
-
-		bgfx::setTransform(to_float_ptr(_data.world[ii]));
-		bgfx::setVertexBuffer(0, &tvb);
-		bgfx::setIndexBuffer(&tib, ii*6, 6);
-
-		if (draw_override)
-			draw_override(_data.unit[ii], _render_world);
-		else
-			_data.material[ii]->bind(*rm, *sm, _data.layer[ii] + view, _data.depth[ii]);
+	u32 num_alive = 0;
+	u32 num_dropped = 0;
+	for (u32 ii = 0; ii < _data.size; ++ii) {
+		const ParticleEmitter *pe = _data.emitter[ii];
+		num_alive += pe->_num;
+		num_dropped += pe->_num_dropped;
+		RECORD_VECTOR3(_data.resource[ii]->name, vector3(f32(pe->_num), f32(pe->_max), f32(pe->_num_dropped)));
+	}
+
+	RECORD_FLOAT("render_world.particles_alive", f32(num_alive));
+	RECORD_FLOAT("render_world.particles_dropped", f32(num_dropped));
+}
+
+void RenderWorld::ParticleManager::cull(const Frustum &f)
+{
+	array::clear(_visible);
+
+	for (u32 ii = 0; ii < _data.size; ++ii) {
+		const ParticleEmitter *pe = _data.emitter[ii];
+		if (_data.visible[ii] && pe->_num != 0 && aabb_intersects_frustum(pe->_aabb, f))
+			array::push_back(_visible, ii);
+	}
+}
+
+struct ParticleDrawData
+{
+	RenderWorld::ParticleManager *pm;
+	ResourceManager *rm;
+	ShaderManager *sm;
+	const Matrix4x4 *view_tm;
+	const u32 *first;    // First instance of each visible emitter in idb.
+	bgfx::InstanceDataBuffer idb;
+	u8 view;
+};
+
+void RenderWorld::ParticleManager::draw(u8 view, const Matrix4x4 &view_tm, ResourceManager *rm, ShaderManager *sm)
+{
+	const u32 num_visible = array::size(_visible);
+	if (num_visible == 0)
+		return;
+
+	// Billboards are built from instance data only.
+	if ((bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING) == 0)
+		return;
+
+	if (!bgfx::isValid(_quad_vb)) {
+		_quad_vb = bgfx::createVertexBuffer(bgfx::makeRef(s_sprite_quad_vertices, sizeof(s_sprite_quad_vertices)), _layout);
+		_quad_ib = bgfx::createIndexBuffer(bgfx::makeRef(s_sprite_quad_indices, sizeof(s_sprite_quad_indices)));
+	}
+
+	// All emitters share one instance data buffer. Materials are resolved
+	// here because resolving is not thread-safe.
+	TempAllocator1024 ta;
+	Array<u32> first(ta);
+	array::resize(first, num_visible);
+
+	u32 num_instances = 0;
+	for (u32 vv = 0; vv < num_visible; ++vv) {
+		const u32 ii = _visible[vv];
+		Material *material = _data.material[ii];
+		if (!material->_resolved)
+			material->resolve(*rm, *sm);
+
+		first[vv] = num_instances;
+		num_instances += _data.emitter[ii]->_num;
+	}
+
+	num_instances = bgfx::getAvailInstanceDataBuffer(num_instances, ParticleEmitter::INSTANCE_STRIDE);
+	if (num_instances == 0)
+		return;
+
+	ParticleDrawData pdd;
+	pdd.pm = this;
+	pdd.rm = rm;
+	pdd.sm = sm;
+	pdd.view_tm = &view_tm;
+	pdd.first = array::begin(first);
+	pdd.view = view;
+	bgfx::allocInstanceDataBuffer(&pdd.idb, num_instances, ParticleEmitter::INSTANCE_STRIDE);
+
+	job_system::parallel_for(num_visible, 4, [](u32 begin, u32 end, void *data) {
+			const ParticleDrawData *pdd = (ParticleDrawData *)data;
+			const ParticleManager &pm = *pdd->pm;
+			const Matrix4x4 &view_tm = *pdd->view_tm;
+			bgfx::Encoder *encoder = begin_encoder();
+
+			for (u32 vv = begin; vv < end; ++vv) {
+				const u32 ii = pm._visible[vv];
+				const ParticleEmitter *pe = pm._data.emitter[ii];
+				const u32 first = pdd->first[vv];
+				if (first >= pdd->idb.num)
+					continue;
+
+				const u32 num = min(pe->_num, pdd->idb.num - first);
+				pe->fill_instance_data(pdd->idb.data + first*ParticleEmitter::INSTANCE_STRIDE, num, *pm._data.resource[ii]);
+
+				// Translucent: draw emitters back to front.
+				const Vector3 pos = aabb::center(pe->_aabb);
+				const f32 depth = pos.x*view_tm.x.z + pos.y*view_tm.y.z + pos.z*view_tm.z.z + view_tm.t.z;
+
+				Material *material = pm._data.material[ii];
+				encoder->setInstanceDataBuffer(&pdd->idb, first, num);
+				encoder->setVertexBuffer(0, pm._quad_vb);
+				encoder->setIndexBuffer(pm._quad_ib);
+				material->set_parameters(encoder, *pdd->rm, *pdd->sm);
+				pdd->sm->submit(encoder
+					, material->_resource->shader
+					, pdd->view
+					, s32(clamp(depth*1000.0f, 0.0f, 1.0e9f))
+					);
+			}
+
+			bgfx::end(encoder);
+		}
+		, &pdd
+		);
+}
+
+/// Fills the 4 vertices of @a tile at column @a x and row @a y of the
+/// tilemap @a tmr. Empty tiles get degenerate vertices.
+static void tile_vertices(RenderWorld::TilemapManager::TileVertex *vertices, const TilemapResource *tmr, u32 tile, u32 x, u32 y)
+{
+	if (tile == 0) {
+		memset(vertices, 0, 4*sizeof(*vertices));
+		return;
 	}
+
+	const u32 cell = tile - 1;
+	const f32 u0 = f32(cell % tmr->tileset_columns) * tmr->tile_uv_size.x;
+	const f32 v1 = f32(cell / tmr->tileset_columns) * tmr->tile_uv_size.y;
+	const f32 u1 = u0 + tmr->tile_uv_size.x;
+	const f32 v0 = v1 + tmr->tile_uv_size.y;
+
+	// Rows go down the z axis, like sprites do.
+	const f32 x0 = f32(x) * tmr->tile_size.x;
+	const f32 y1 = -f32(y) * tmr->tile_size.y;
+	const f32 x1 = x0 + tmr->tile_size.x;
+	const f32 y0 = y1 - tmr->tile_size.y;
+
+	// D -- C
+	// |    |
+	// A -- B
+	vertices[0].position = vector3(x0, 0.0f, y0);
+	vertices[0].uv = vector2(u0, v0);
+	vertices[1].position = vector3(x1, 0.0f, y0);
+	vertices[1].uv = vector2(u1, v0);
+	vertices[2].position = vector3(x1, 0.0f, y1);
+	vertices[2].uv = vector2(u1, v1);
+	vertices[3].position = vector3(x0, 0.0f, y1);
+	vertices[3].uv = vector2(u0, v1);
+}
+
+void RenderWorld::TilemapManager::allocate(u32 num)
+{
+	CE_ENSURE(num > _data.size);
+
+	const u32 bytes = 0
+		+ num*sizeof(UnitId) + alignof(UnitId)
+		+ num*sizeof(TilemapResource **) + alignof(TilemapResource *)
+		+ num*sizeof(Material **) + alignof(Material *)
+		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
+		+ num*sizeof(u16 *) + alignof(u16 *)
+		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(bool) + alignof(bool)
+		;
+
+	TilemapInstanceData new_data;
+	new_data.size = _data.size;
+	new_data.capacity = num;
+	new_data.buffer = _allocator->allocate(bytes);
+
+	new_data.unit        = (UnitId *                )memory::align_top(new_data.buffer,           alignof(UnitId));
+	new_data.resource    = (const TilemapResource **)memory::align_top(new_data.unit + num,       alignof(TilemapResource *));
+	new_data.material    = (Material **             )memory::align_top(new_data.resource + num,   alignof(Material *));
+	new_data.world       = (Matrix4x4 *             )memory::align_top(new_data.material + num,   alignof(Matrix4x4));
+	new_data.tiles       = (u16 **                  )memory::align_top(new_data.world + num,      alignof(u16 *));
+	new_data.first_chunk = (u32 *                   )memory::align_top(new_data.tiles + num,      alignof(u32));
+	new_data.layer       = (u32 *                   )memory::align_top(new_data.first_chunk + num, alignof(u32));
+	new_data.depth       = (u32 *                   )memory::align_top(new_data.layer + num,      alignof(u32));
+	new_data.visible     = (bool *                  )memory::align_top(new_data.depth + num,      alignof(bool));
+
+	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
+	memcpy(new_data.resource, _data.resource, _data.size * sizeof(TilemapResource **));
+	memcpy(new_data.material, _data.material, _data.size * sizeof(Material **));
+	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
+	memcpy(new_data.tiles, _data.tiles, _data.size * sizeof(u16 *));
+	memcpy(new_data.first_chunk, _data.first_chunk, _data.size * sizeof(u32));
+	memcpy(new_data.layer, _data.layer, _data.size * sizeof(u32));
+	memcpy(new_data.depth, _data.depth, _data.size * sizeof(u32));
+	memcpy(new_data.visible, _data.visible, _data.size * sizeof(bool));
+
+	_allocator->deallocate(_data.buffer);
+	_data = new_data;
+}
+
+void RenderWorld::TilemapManager::grow()
+{
+	allocate(_data.capacity * 2 + 1);
+}
+
+TilemapInstance RenderWorld::TilemapManager::create(UnitId unit, const TilemapResource *tmr, const TilemapRendererDesc &trd, const Matrix4x4 &tr)
+{
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a tilemap component");
+
+	if (_data.size == _data.capacity)
+		grow();
+
+	// All chunks share the same indices: a quad per tile, 4 vertices each.
+	if (!bgfx::isValid(_index_buffer)) {
+		const u32 num_quads = (UINT16_MAX + 1) / 4;
+		const bgfx::Memory *mem = bgfx::alloc(num_quads*6*sizeof(u16));
+		u16 *indices = (u16 *)mem->data;
+
+		for (u32 qq = 0; qq < num_quads; ++qq) {
+			*indices++ = u16(qq*4 + 0);
+			*indices++ = u16(qq*4 + 1);
+			*indices++ = u16(qq*4 + 2);
+			*indices++ = u16(qq*4 + 0);
+			*indices++ = u16(qq*4 + 2);
+			*indices++ = u16(qq*4 + 3);
+		}
+
+		_index_buffer = bgfx::createIndexBuffer(mem);
+	}
+
+	const u32 last = _data.size;
+	const u32 num_chunks = tilemap_resource::num_chunks(tmr);
+	const u32 num_chunk_tiles = tilemap_resource::num_chunk_tiles(tmr);
+	const u32 num_tiles = num_chunks*num_chunk_tiles;
+
+	const MaterialResource *mat_res = (const MaterialResource *)_render_world->_resource_manager->get(RESOURCE_TYPE_MATERIAL, trd.material_resource);
+
+	_data.unit[last]        = unit;
+	_data.resource[last]    = tmr;
+	_data.material[last]    = _render_world->_material_manager->get(mat_res);
+	_data.world[last]       = tr;
+	_data.tiles[last]       = (u16 *)_allocator->allocate(num_tiles*sizeof(u16));
+	_data.first_chunk[last] = array::size(_chunks);
+	_data.layer[last]       = trd.layer;
+	_data.depth[last]       = trd.depth;
+	_data.visible[last]     = trd.visible;
+
+	memcpy(_data.tiles[last], tilemap_resource::tiles(tmr), num_tiles*sizeof(u16));
+
+	const u32 cs = tmr->chunk_size;
+	for (u32 cc = 0; cc < num_chunks; ++cc) {
+		const u16 *tiles = &_data.tiles[last][cc*num_chunk_tiles];
+		const u32 cx = (cc % tmr->num_chunks_x)*cs;
+		const u32 cy = (cc / tmr->num_chunks_x)*cs;
+
+		const bgfx::Memory *mem = bgfx::alloc(num_chunk_tiles*4*sizeof(TileVertex));
+		TileVertex *vertices = (TileVertex *)mem->data;
+
+		Chunk chunk;
+		chunk.instance = last;
+		chunk.num_tiles = 0;
+		for (u32 tt = 0; tt < num_chunk_tiles; ++tt) {
+			tile_vertices(&vertices[tt*4], tmr, tiles[tt], cx + tt % cs, cy + (tt / cs) % cs);
+			chunk.num_tiles += tiles[tt] != 0;
+		}
+		chunk.vbh = bgfx::createDynamicVertexBuffer(mem, _layout);
+		chunk.proxy = UINT32_MAX;
+		array::push_back(_chunks, chunk);
+
+		const u32 c = array::size(_chunks) - 1;
+		_chunks[c].proxy = aabb_tree::create(_tree, world_aabb(c), c);
+	}
+
+	unit_map::set(_map, unit, last);
+	++_data.size;
+
+	return make_instance(last);
+}
+
+void RenderWorld::TilemapManager::destroy(TilemapInstance tilemap)
+{
+	CE_ASSERT(tilemap.i < _data.size, "Index out of bounds");
+
+	const u32 last = _data.size - 1;
+	const UnitId u = _data.unit[tilemap.i];
+	const UnitId last_u = _data.unit[last];
+
+	// Remove the chunks of the tilemap and close the gap in _chunks.
+	const u32 first = _data.first_chunk[tilemap.i];
+	const u32 num = tilemap_resource::num_chunks(_data.resource[tilemap.i]);
+	for (u32 cc = first; cc < first + num; ++cc) {
+		bgfx::destroy(_chunks[cc].vbh);
+		aabb_tree::destroy(_tree, _chunks[cc].proxy);
+	}
+
+	for (u32 cc = first + num; cc < array::size(_chunks); ++cc) {
+		_chunks[cc - num] = _chunks[cc];
+		aabb_tree::set_user_data(_tree, _chunks[cc - num].proxy, cc - num);
+	}
+	array::resize(_chunks, array::size(_chunks) - num);
+
+	for (u32 ii = 0; ii < _data.size; ++ii) {
+		if (_data.first_chunk[ii] > first)
+			_data.first_chunk[ii] -= num;
+	}
+
+	_allocator->deallocate(_data.tiles[tilemap.i]);
+
+	_data.unit[tilemap.i]        = _data.unit[last];
+	_data.resource[tilemap.i]    = _data.resource[last];
+	_data.material[tilemap.i]    = _data.material[last];
+	_data.world[tilemap.i]       = _data.world[last];
+	_data.tiles[tilemap.i]       = _data.tiles[last];
+	_data.first_chunk[tilemap.i] = _data.first_chunk[last];
+	_data.layer[tilemap.i]       = _data.layer[last];
+	_data.depth[tilemap.i]       = _data.depth[last];
+	_data.visible[tilemap.i]     = _data.visible[last];
+
+	// The chunks of the moved tilemap follow it.
+	if (tilemap.i != last) {
+		const u32 moved_first = _data.first_chunk[tilemap.i];
+		const u32 moved_num = tilemap_resource::num_chunks(_data.resource[tilemap.i]);
+		for (u32 cc = moved_first; cc < moved_first + moved_num; ++cc)
+			_chunks[cc].instance = tilemap.i;
+	}
+
+	unit_map::set(_map, last_u, tilemap.i);
+	unit_map::remove(_map, u);
+	--_data.size;
+}
+
+bool RenderWorld::TilemapManager::has(UnitId unit)
+{
+	return is_valid(tilemap(unit));
+}
+
+TilemapInstance RenderWorld::TilemapManager::tilemap(UnitId unit)
+{
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
+}
+
+void RenderWorld::TilemapManager::destroy()
+{
+	for (u32 cc = 0; cc < array::size(_chunks); ++cc)
+		bgfx::destroy(_chunks[cc].vbh);
+
+	for (u32 ii = 0; ii < _data.size; ++ii)
+		_allocator->deallocate(_data.tiles[ii]);
+
+	if (bgfx::isValid(_index_buffer))
+		bgfx::destroy(_index_buffer);
+
+	_allocator->deallocate(_data.buffer);
+}
+
+u32 RenderWorld::TilemapManager::tile(u32 i, u32 layer, u32 x, u32 y)
+{
+	return _data.tiles[i][tilemap_resource::tile_offset(_data.resource[i], layer, x, y)];
+}
+
+void RenderWorld::TilemapManager::set_tile(u32 i, u32 layer, u32 x, u32 y, u32 tile)
+{
+	const TilemapResource *tmr = _data.resource[i];
+	CE_ASSERT(tile <= UINT16_MAX, "Tile out of range");
+
+	const u32 offset = tilemap_resource::tile_offset(tmr, layer, x, y);
+	const u32 num_chunk_tiles = tilemap_resource::num_chunk_tiles(tmr);
+	u16 &old_tile = _data.tiles[i][offset];
+	if (old_tile == tile)
+		return;
+
+	Chunk &chunk = _chunks[_data.first_chunk[i] + offset / num_chunk_tiles];
+	chunk.num_tiles -= old_tile != 0;
+	chunk.num_tiles += tile != 0;
+	old_tile = u16(tile);
+
+	TileVertex vertices[4];
+	tile_vertices(vertices, tmr, tile, x, y);
+	bgfx::update(chunk.vbh, (offset % num_chunk_tiles)*4, bgfx::copy(vertices, sizeof(vertices)));
+}
+
+void RenderWorld::TilemapManager::cull(const Frustum &f)
+{
+	array::clear(_visible);
+	aabb_tree::query_frustum(_tree, _visible, f);
+
+	u32 num = 0;
+	for (u32 vv = 0; vv < array::size(_visible); ++vv) {
+		const Chunk &chunk = _chunks[_visible[vv]];
+		if (chunk.num_tiles != 0 && _data.visible[chunk.instance])
+			_visible[num++] = _visible[vv];
+	}
+	array::resize(_visible, num);
+}
+
+AABB RenderWorld::TilemapManager::world_aabb(u32 c)
+{
+	const u32 i = _chunks[c].instance;
+	const TilemapResource *tmr = _data.resource[i];
+	const u32 cc = c - _data.first_chunk[i];
+	const f32 w = f32(tmr->chunk_size) * tmr->tile_size.x;
+	const f32 h = f32(tmr->chunk_size) * tmr->tile_size.y;
+
+	// Same thickness as sprites.
+	OBB obb;
+	obb.tm = from_quaternion_translation(QUATERNION_IDENTITY
+		, vector3((f32(cc % tmr->num_chunks_x) + 0.5f)*w, 0.0f, -(f32(cc / tmr->num_chunks_x) + 0.5f)*h)
+		);
+	obb.half_extents = vector3(w*0.5f, 0.25f, h*0.5f);
+	return obb_to_aabb(obb, _data.world[i]);
+}
+
+void RenderWorld::TilemapManager::update_proxies(u32 i)
+{
+	const u32 first = _data.first_chunk[i];
+	const u32 num = tilemap_resource::num_chunks(_data.resource[i]);
+
+	for (u32 cc = first; cc < first + num; ++cc)
+		aabb_tree::move(_tree, _chunks[cc].proxy, world_aabb(cc));
+}
+
+void RenderWorld::TilemapManager::draw(u8 view, ResourceManager *rm, ShaderManager *sm, DrawOverride draw_override)
+{
+	if (array::size(_visible) == 0)
+		return;
+
+	bgfx::Encoder *encoder = begin_encoder();
+
+	for (u32 vv = 0; vv < array::size(_visible); ++vv) {
+		const Chunk &chunk = _chunks[_visible[vv]];
+		const u32 ii = chunk.instance;
+
+		encoder->setTransform(to_float_ptr(_data.world[ii]));
+		encoder->setVertexBuffer(0, chunk.vbh);
+		encoder->setIndexBuffer(_index_buffer, 0, tilemap_resource::num_chunk_tiles(_data.resource[ii])*6);
+
+		if (draw_override) {
+			draw_override(encoder, _data.unit[ii], _render_world);
+		} else {
+			_data.material[ii]->bind(encoder
+				, *rm
+				, *sm
+				, _data.layer[ii] + view
+				, _data.depth[ii]
+				);
+		}
+	}
+
+	bgfx::end(encoder);
 }
 
 void RenderWorld::LightManager::allocate(u32 num)
@@ -953,6 +2502,7 @@ void RenderWorld::LightManager::allocate(u32 num)
 		+ num*sizeof(f32) + alignof(f32)
 		+ num*sizeof(Color4) + alignof(Color4)
 		+ num*sizeof(u32) + alignof(u32)
+		+ num*sizeof(u32) + alignof(u32)
 		;
 
 	LightInstanceData new_data;
@@ -967,6 +2517,7 @@ void RenderWorld::LightManager::allocate(u32 num)
 	new_data.spot_angle = (f32 *      )memory::align_top(new_data.intensity + num,  alignof(f32));
 	new_data.color      = (Color4 *   )memory::align_top(new_data.spot_angle + num, alignof(Color4));
 	new_data.type       = (u32 *      )memory::align_top(new_data.color + num,      alignof(u32));
+	new_data.proxy      = (u32 *      )memory::align_top(new_data.type + num,       alignof(u32));
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
@@ -975,6 +2526,7 @@ void RenderWorld::LightManager::allocate(u32 num)
 	memcpy(new_data.spot_angle, _data.spot_angle, _data.size * sizeof(f32));
 	memcpy(new_data.color, _data.color, _data.size * sizeof(Color4));
 	memcpy(new_data.type, _data.type, _data.size * sizeof(u32));
+	memcpy(new_data.proxy, _data.proxy, _data.size * sizeof(u32));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -987,7 +2539,7 @@ void RenderWorld::LightManager::grow()
 
 LightInstance RenderWorld::LightManager::create(UnitId unit, const LightDesc &ld, const Matrix4x4 &tr)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a light component");
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a light component");
 
 	if (_data.size == _data.capacity)
 		grow();
@@ -1001,10 +2553,12 @@ LightInstance RenderWorld::LightManager::create(UnitId unit, const LightDesc &ld
 	_data.spot_angle[last] = ld.spot_angle;
 	_data.color[last]      = vector4(ld.color.x, ld.color.y, ld.color.z, 1.0f);
 	_data.type[last]       = ld.type;
+	_data.proxy[last]      = UINT32_MAX;
+	update_proxy(last);
 
 	++_data.size;
 
-	hash_map::set(_map, unit, last);
+	unit_map::set(_map, unit, last);
 	return make_instance(last);
 }
 
@@ -1016,6 +2570,11 @@ void RenderWorld::LightManager::destroy(LightInstance light)
 	const UnitId u      = _data.unit[light.i];
 	const UnitId last_u = _data.unit[last];
 
+	if (_data.proxy[light.i] != UINT32_MAX)
+		aabb_tree::destroy(_tree, _data.proxy[light.i]);
+	if (light.i != last && _data.proxy[last] != UINT32_MAX)
+		aabb_tree::set_user_data(_tree, _data.proxy[last], light.i);
+
 	_data.unit[light.i]       = _data.unit[last];
 	_data.world[light.i]      = _data.world[last];
 	_data.range[light.i]      = _data.range[last];
@@ -1023,11 +2582,12 @@ void RenderWorld::LightManager::destroy(LightInstance light)
 	_data.spot_angle[light.i] = _data.spot_angle[last];
 	_data.color[light.i]      = _data.color[last];
 	_data.type[light.i]       = _data.type[last];
+	_data.proxy[light.i]      = _data.proxy[last];
 
 	--_data.size;
 
-	hash_map::set(_map, last_u, light.i);
-	hash_map::remove(_map, u);
+	unit_map::set(_map, last_u, light.i);
+	unit_map::remove(_map, u);
 }
 
 bool RenderWorld::LightManager::has(UnitId unit)
@@ -1037,7 +2597,7 @@ bool RenderWorld::LightManager::has(UnitId unit)
 
 LightInstance RenderWorld::LightManager::light(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
 }
 
 void RenderWorld::LightManager::destroy()
@@ -1045,6 +2605,34 @@ void RenderWorld::LightManager::destroy()
 	_allocator->deallocate(_data.buffer);
 }
 
+AABB RenderWorld::LightManager::world_aabb(u32 i)
+{
+	const Vector3 pos = translation(_data.world[i]);
+	const Vector3 range = vector3(_data.range[i], _data.range[i], _data.range[i]);
+
+	AABB box;
+	box.min = pos - range;
+	box.max = pos + range;
+	return box;
+}
+
+void RenderWorld::LightManager::update_proxy(u32 i)
+{
+	u32 &proxy = _data.proxy[i];
+
+	if (_data.type[i] == LightType::DIRECTIONAL) {
+		// Directional lights affect everything and are not in the tree.
+		if (proxy != UINT32_MAX) {
+			aabb_tree::destroy(_tree, proxy);
+			proxy = UINT32_MAX;
+		}
+	} else if (proxy == UINT32_MAX) {
+		proxy = aabb_tree::create(_tree, world_aabb(i), i);
+	} else {
+		aabb_tree::move(_tree, proxy, world_aabb(i));
+	}
+}
+
 void RenderWorld::LightManager::debug_draw(u32 start_index, u32 num, DebugLine &dl)
 {
 	for (u32 i = start_index; i < start_index + num; ++i) {
@@ -6,11 +6,14 @@
 #pragma once
 
 #include "core/containers/types.h"
+#include "core/math/aabb_tree.h"
 #include "core/math/types.h"
 #include "core/strings/string_id.h"
 #include "resource/mesh_resource.h"
 #include "resource/types.h"
+#include "world/occlusion_buffer.h"
 #include "world/types.h"
+#include "world/unit_map.h"
 #include <bgfx/bgfx.h>
 
 namespace crown
@@ -44,6 +47,10 @@ struct RenderWorld
 	/// Sets whether the @a mesh is @a visible.
 	void mesh_set_visible(MeshInstance mesh, bool visible);
 
+	/// Sets whether the @a mesh is an @a occluder.
+	/// See enable_occlusion_culling().
+	void mesh_set_occluder(MeshInstance mesh, bool occluder);
+
 	/// Returns the OBB of the @a mesh.
 	OBB mesh_obb(MeshInstance mesh);
 
@@ -51,6 +58,24 @@ struct RenderWorld
 	/// or -1.0 if no intersection.
 	f32 mesh_cast_ray(MeshInstance mesh, const Vector3 &from, const Vector3 &dir);
 
+	/// Returns the distance along ray (from, dir) to intersection point with the
+	/// nearest visible mesh or -1.0 if no intersection. If a mesh is hit, @a mesh
+	/// is set to that mesh.
+	f32 world_cast_ray(MeshInstance &mesh, const Vector3 &from, const Vector3 &dir);
+
+	/// Fills @a units with the units owning a mesh, sprite or light whose
+	/// bounds intersect the box @a b. A unit owning more than one of these
+	/// is reported once for each.
+	void query_box(Array<UnitId> &units, const AABB &b);
+
+	/// Fills @a units with the units owning a mesh, sprite or light whose
+	/// bounds intersect the sphere @a s. See query_box().
+	void query_sphere(Array<UnitId> &units, const Sphere &s);
+
+	/// Fills @a units with the units owning a mesh, sprite or light whose
+	/// bounds intersect the frustum @a f. See query_box().
+	void query_frustum(Array<UnitId> &units, const Frustum &f);
+
 	/// Creates a new sprite instance.
 	SpriteInstance sprite_create(UnitId unit, const SpriteRendererDesc &srd, const Matrix4x4 &tr);
 
@@ -96,6 +121,50 @@ struct RenderWorld
 	/// @a sprite or -1.0 if no intersection.
 	f32 sprite_cast_ray(SpriteInstance sprite, const Vector3 &from, const Vector3 &dir, u32 &layer, u32 &depth);
 
+	/// Creates a new tilemap instance.
+	TilemapInstance tilemap_create(UnitId unit, const TilemapRendererDesc &trd, const Matrix4x4 &tr);
+
+	/// Destroys the @a tilemap.
+	void tilemap_destroy(TilemapInstance tilemap);
+
+	/// Returns the ID of the tilemap owned by the *unit*.
+	TilemapInstance tilemap_instance(UnitId unit);
+
+	/// Returns the material of the @a tilemap.
+	Material *tilemap_material(TilemapInstance tilemap);
+
+	/// Sets whether the @a tilemap is @a visible.
+	void tilemap_set_visible(TilemapInstance tilemap, bool visible);
+
+	/// Sets the layer of the @a tilemap.
+	void tilemap_set_layer(TilemapInstance tilemap, u32 layer);
+
+	/// Sets the depth of the @a tilemap.
+	void tilemap_set_depth(TilemapInstance tilemap, u32 depth);
+
+	/// Returns the tile at column @a x and row @a y of @a layer of the
+	/// @a tilemap. Tile 0 is empty, tile n is the cell n-1 of the tileset.
+	u32 tilemap_tile(TilemapInstance tilemap, u32 layer, u32 x, u32 y);
+
+	/// Sets the @a tile at column @a x and row @a y of @a layer of the
+	/// @a tilemap. See tilemap_tile().
+	void tilemap_set_tile(TilemapInstance tilemap, u32 layer, u32 x, u32 y, u32 tile);
+
+	/// Creates a new particle system instance.
+	ParticleSystemInstance particle_system_create(UnitId unit, const ParticleSystemDesc &psd, const Matrix4x4 &tr);
+
+	/// Destroys the particle system @a ps.
+	void particle_system_destroy(ParticleSystemInstance ps);
+
+	/// Returns the ID of the particle system owned by the *unit*.
+	ParticleSystemInstance particle_system_instance(UnitId unit);
+
+	/// Sets whether the particle system @a ps is @a visible.
+	void particle_system_set_visible(ParticleSystemInstance ps, bool visible);
+
+	/// Returns the number of particles alive in the particle system @a ps.
+	u32 particle_system_num_particles(ParticleSystemInstance ps);
+
 	/// Creates a new light instance.
 	LightInstance light_create(UnitId unit, const LightDesc &ld, const Matrix4x4 &tr);
 
@@ -140,19 +209,42 @@ struct RenderWorld
 
 	void update_transforms(const UnitId *begin, const UnitId *end, const Matrix4x4 *world);
 
-	void render(const Matrix4x4 &view);
+	/// Advances the simulation of all particle systems by @a dt seconds.
+	void update_particles(f32 dt);
+
+	/// Culls meshes and sprites against the frustum of @a view and @a proj
+	/// and renders the ones that are inside it.
+	void render(const Matrix4x4 &view, const Matrix4x4 &proj);
 
 	/// Sets whether to @a enable debug drawing
 	void enable_debug_drawing(bool enable);
 
+	/// Sets whether to @a enable occlusion culling. When enabled, visible
+	/// occluder meshes are rasterized into an OcclusionBuffer and meshes
+	/// entirely hidden behind them are not rendered.
+	void enable_occlusion_culling(bool enable);
+
 	/// Fills @a dl with debug lines
 	void debug_draw(DebugLine &dl);
 
+	/// Returns whether any unit is selected. The selection pass, which draws
+	/// the ids of the selected units for the editor, is skipped otherwise.
+	bool has_selection();
+
 	///
 	void unit_destroyed_callback(UnitId unit);
 
-	/// Callback to customize drawing of objects.
-	typedef void (*DrawOverride)(UnitId unit_id, RenderWorld *rw);
+	/// Callback to customize drawing of objects. It is called from multiple
+	/// threads, each with its own @a encoder.
+	typedef void (*DrawOverride)(bgfx::Encoder *encoder, UnitId unit_id, RenderWorld *rw);
+
+	/// Range of items in _visible drawn with a single draw call.
+	struct DrawBatch
+	{
+		u32 first;    ///< First item in _visible.
+		u32 num;      ///< Number of items.
+		u32 instance; ///< First instance in the instance data buffer or UINT32_MAX if not instanced.
+	};
 
 	/// List of meshes to be rendered.
 	struct MeshManager
@@ -161,6 +253,9 @@ struct RenderWorld
 		{
 			bgfx::VertexBufferHandle vbh;
 			bgfx::IndexBufferHandle ibh;
+			u32 lod;         ///< Index into MeshGeometry::lods.
+			u32 first_index; ///< First index of the current LOD.
+			u32 num_indices; ///< Number of indices of the current LOD.
 		};
 
 		struct MeshInstanceData
@@ -178,18 +273,34 @@ struct RenderWorld
 			Material **material;
 			Matrix4x4 *world;
 			OBB *obb;
+			u32 *proxy; // Proxy in _tree
+			bool *occluder;
 		};
 
 		Allocator *_allocator;
 		RenderWorld *_render_world;
-		HashMap<UnitId, u32> _map;
+		UnitMap _map;
 		MeshInstanceData _data;
+		AabbTree _tree;
+		Array<u32> _visible;
+		Array<u64> _sort_keys;
+		Array<u64> _sort_keys_temp;
+		Array<u32> _sort_items_temp;
+		Array<DrawBatch> _batches;
+		Array<AABB> _aabbs_temp; ///< World boxes computed by RenderWorld::update_transforms().
 
 		///
 		MeshManager(Allocator &a, RenderWorld *rw)
 			: _allocator(&a)
 			, _render_world(rw)
 			, _map(a)
+			, _tree(a)
+			, _visible(a)
+			, _sort_keys(a)
+			, _sort_keys_temp(a)
+			, _sort_items_temp(a)
+			, _batches(a)
+			, _aabbs_temp(a)
 		{
 			memset(&_data, 0, sizeof(_data));
 		}
@@ -221,7 +332,36 @@ struct RenderWorld
 		///
 		void swap(u32 inst_a, u32 inst_b);
 
-		///
+		/// Fills _visible with the visible instances that intersect the frustum @a f.
+		void cull(const Frustum &f);
+
+		/// Renders the occluders in _visible into @a ob and removes from
+		/// _visible the other instances it hides. Returns the number of
+		/// instances removed.
+		u32 cull_occluded(OcclusionBuffer &ob, const Matrix4x4 &view_proj);
+
+		/// Selects the LOD of the instances in _visible from their size once
+		/// projected with @a view_proj. @a proj_scale is the scale of the
+		/// projection along the vertical axis.
+		void select_lods(const Matrix4x4 &view_proj, f32 proj_scale);
+
+		/// Returns the world-space box enclosing the instance @a i.
+		AABB world_aabb(u32 i);
+
+		/// Moves the proxy of the instance @a i to enclose its current bounds.
+		void update_proxy(u32 i);
+
+		/// Returns the distance along ray (from, dir) to the nearest visible
+		/// instance or -1.0 if no intersection. See RenderWorld::world_cast_ray().
+		f32 cast_ray(MeshInstance &mesh, const Vector3 &from, const Vector3 &dir);
+
+		/// Sorts _visible by the sort key of each instance when drawn in
+		/// @a view with the camera @a view_tm.
+		void sort(u8 view, const Matrix4x4 &view_tm, ResourceManager &rm, ShaderManager &sm);
+
+		/// Draws the instances in _visible in @a view. Draw calls are split
+		/// in ranges of _visible submitted in parallel, one bgfx::Encoder per
+		/// range.
 		void draw(u8 view
 			, ResourceManager *rm
 			, ShaderManager *sm
@@ -238,6 +378,22 @@ struct RenderWorld
 	/// List of meshes to be rendered.
 	struct SpriteManager
 	{
+		struct SpriteVertex
+		{
+			Vector3 position; // World-space
+			Vector2 uv;
+		};
+
+		/// Per-instance data of instanced sprites, see the "sprite" shader.
+		struct SpriteQuad
+		{
+			Vector4 translation; // World-space
+			Vector4 x;           // World-space x axis
+			Vector4 z;           // World-space z axis
+			Vector4 rect;        // x0, z0, x1, z1 of the frame
+			Vector4 uv;          // u0, v0, u1, v1 of the frame
+		};
+
 		struct SpriteInstanceData
 		{
 			u32 size;
@@ -251,25 +407,49 @@ struct RenderWorld
 			Material **material;
 			u32 *frame;
 			Matrix4x4 *world;
-			AABB *aabb;
+			OBB *obb;
 			bool *flip_x;
 			bool *flip_y;
 			u32 *layer;
 			u32 *depth;
+			u32 *proxy; // Proxy in _tree
 		};
 
 		Allocator *_allocator;
 		RenderWorld *_render_world;
-		HashMap<UnitId, u32> _map;
+		UnitMap _map;
 		SpriteInstanceData _data;
+		AabbTree _tree;
+		Array<u32> _visible;
+		Array<u64> _sort_keys;
+		Array<u64> _sort_keys_temp;
+		Array<u32> _sort_items_temp;
+		Array<DrawBatch> _batches;
+		bgfx::VertexLayout _layout;
+		bgfx::VertexBufferHandle _quad_vb;
+		bgfx::IndexBufferHandle _quad_ib;
 
 		///
 		SpriteManager(Allocator &a, RenderWorld *rw)
 			: _allocator(&a)
 			, _render_world(rw)
 			, _map(a)
+			, _tree(a)
+			, _visible(a)
+			, _sort_keys(a)
+			, _sort_keys_temp(a)
+			, _sort_items_temp(a)
+			, _batches(a)
 		{
 			memset(&_data, 0, sizeof(_data));
+
+			_layout.begin();
+			_layout.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float);
+			_layout.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, false);
+			_layout.end();
+
+			_quad_vb = BGFX_INVALID_HANDLE;
+			_quad_ib = BGFX_INVALID_HANDLE;
 		}
 
 		///
@@ -299,7 +479,22 @@ struct RenderWorld
 		///
 		void swap(u32 inst_a, u32 inst_b);
 
-		///
+		/// Fills _visible with the visible instances that intersect the frustum @a f.
+		void cull(const Frustum &f);
+
+		/// Returns the world-space box enclosing the instance @a i.
+		AABB world_aabb(u32 i);
+
+		/// Moves the proxy of the instance @a i to enclose its current bounds.
+		void update_proxy(u32 i);
+
+		/// Fills @a quad with the instance data of the instance @a i.
+		void quad(SpriteQuad &quad, u32 i) const;
+
+		/// Fills @a vertices with the 4 world-space vertices of the instance @a i.
+		void vertices(SpriteVertex *vertices, u32 i) const;
+
+		/// Draws the instances in _visible in @a view. See MeshManager::draw().
 		void draw(u8 view
 			, ResourceManager *rm
 			, ShaderManager *sm
@@ -313,6 +508,210 @@ struct RenderWorld
 		}
 	};
 
+	/// List of tilemaps to be rendered. Tilemaps are split in chunks, each
+	/// with its own vertex buffer and proxy in _tree, so that chunks are
+	/// culled and drawn independently.
+	struct TilemapManager
+	{
+		struct TileVertex
+		{
+			Vector3 position; // Tilemap-space
+			Vector2 uv;
+		};
+
+		struct Chunk
+		{
+			u32 instance;  ///< Tilemap owning the chunk.
+			u32 num_tiles; ///< Number of non-empty tiles.
+			u32 proxy;     ///< Proxy in _tree.
+			bgfx::DynamicVertexBufferHandle vbh;
+		};
+
+		struct TilemapInstanceData
+		{
+			u32 size;
+			u32 capacity;
+			void *buffer;
+
+			UnitId *unit;
+			const TilemapResource **resource;
+			Material **material;
+			Matrix4x4 *world;
+			u16 **tiles;      // Copy of the resource tiles, see set_tile()
+			u32 *first_chunk; // First chunk in _chunks
+			u32 *layer;
+			u32 *depth;
+			bool *visible;
+		};
+
+		Allocator *_allocator;
+		RenderWorld *_render_world;
+		UnitMap _map;
+		TilemapInstanceData _data;
+		Array<Chunk> _chunks;
+		AabbTree _tree;
+		Array<u32> _visible; // Visible chunks
+		bgfx::VertexLayout _layout;
+		bgfx::IndexBufferHandle _index_buffer;
+
+		///
+		TilemapManager(Allocator &a, RenderWorld *rw)
+			: _allocator(&a)
+			, _render_world(rw)
+			, _map(a)
+			, _chunks(a)
+			, _tree(a)
+			, _visible(a)
+		{
+			memset(&_data, 0, sizeof(_data));
+
+			_layout.begin();
+			_layout.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float);
+			_layout.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, false);
+			_layout.end();
+
+			_index_buffer = BGFX_INVALID_HANDLE;
+		}
+
+		///
+		TilemapInstance create(UnitId unit, const TilemapResource *tmr, const TilemapRendererDesc &trd, const Matrix4x4 &tr);
+
+		///
+		void destroy(TilemapInstance tilemap);
+
+		///
+		bool has(UnitId unit);
+
+		///
+		TilemapInstance tilemap(UnitId unit);
+
+		///
+		void allocate(u32 num);
+
+		///
+		void grow();
+
+		///
+		void destroy();
+
+		/// Returns the tile at column @a x and row @a y of @a layer of the
+		/// instance @a i.
+		u32 tile(u32 i, u32 layer, u32 x, u32 y);
+
+		/// Sets the tile at column @a x and row @a y of @a layer of the
+		/// instance @a i. Only the vertices of that tile are uploaded.
+		void set_tile(u32 i, u32 layer, u32 x, u32 y, u32 tile);
+
+		/// Fills _visible with the visible chunks that intersect the frustum @a f.
+		void cull(const Frustum &f);
+
+		/// Returns the world-space box enclosing the chunk @a c.
+		AABB world_aabb(u32 c);
+
+		/// Moves the proxies of the chunks of the instance @a i to enclose
+		/// their current bounds.
+		void update_proxies(u32 i);
+
+		/// Draws the chunks in _visible in @a view.
+		void draw(u8 view
+			, ResourceManager *rm
+			, ShaderManager *sm
+			, DrawOverride draw_override = NULL
+			);
+
+		///
+		TilemapInstance make_instance(u32 i)
+		{
+			TilemapInstance inst = { i }; return inst;
+		}
+	};
+
+	/// List of particle systems to be rendered. Each instance owns a
+	/// ParticleEmitter and is drawn as instanced billboards with a single
+	/// draw call.
+	struct ParticleManager
+	{
+		struct ParticleSystemInstanceData
+		{
+			u32 size;
+			u32 capacity;
+			void *buffer;
+
+			UnitId *unit;
+			const ParticleSystemResource **resource;
+			Material **material;
+			Matrix4x4 *world;
+			ParticleEmitter **emitter;
+			bool *visible;
+		};
+
+		Allocator *_allocator;
+		RenderWorld *_render_world;
+		UnitMap _map;
+		ParticleSystemInstanceData _data;
+		Array<u32> _visible; // Visible instances
+		bgfx::VertexLayout _layout;
+		bgfx::VertexBufferHandle _quad_vb;
+		bgfx::IndexBufferHandle _quad_ib;
+
+		///
+		ParticleManager(Allocator &a, RenderWorld *rw)
+			: _allocator(&a)
+			, _render_world(rw)
+			, _map(a)
+			, _visible(a)
+		{
+			memset(&_data, 0, sizeof(_data));
+
+			_layout.begin();
+			_layout.add(bgfx::Attrib::Position,  3, bgfx::AttribType::Float);
+			_layout.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Float, false);
+			_layout.end();
+
+			_quad_vb = BGFX_INVALID_HANDLE;
+			_quad_ib = BGFX_INVALID_HANDLE;
+		}
+
+		///
+		ParticleSystemInstance create(UnitId unit, const ParticleSystemResource *psr, const ParticleSystemDesc &psd, const Matrix4x4 &tr);
+
+		///
+		void destroy(ParticleSystemInstance ps);
+
+		///
+		bool has(UnitId unit);
+
+		///
+		ParticleSystemInstance particle_system(UnitId unit);
+
+		///
+		void allocate(u32 num);
+
+		///
+		void grow();
+
+		///
+		void destroy();
+
+		/// Simulates all emitters by @a dt seconds, in parallel, and records
+		/// their counters in the profiler.
+		void update(f32 dt);
+
+		/// Fills _visible with the visible instances whose particles
+		/// intersect the frustum @a f.
+		void cull(const Frustum &f);
+
+		/// Draws the instances in _visible in @a view, sorted back to front
+		/// by their distance from the camera @a view_tm.
+		void draw(u8 view, const Matrix4x4 &view_tm, ResourceManager *rm, ShaderManager *sm);
+
+		///
+		ParticleSystemInstance make_instance(u32 i)
+		{
+			ParticleSystemInstance inst = { i }; return inst;
+		}
+	};
+
 	struct LightManager
 	{
 		struct LightInstanceData
@@ -327,17 +726,22 @@ struct RenderWorld
 			f32 *intensity;
 			f32 *spot_angle;
 			Color4 *color;
-			u32 *type; // LightType::Enum
+			u32 *type;  // LightType::Enum
+			u32 *proxy; // Proxy in _tree or UINT32_MAX for directional lights
 		};
 
 		Allocator *_allocator;
-		HashMap<UnitId, u32> _map;
+		UnitMap _map;
 		LightInstanceData _data;
+		AabbTree _tree;
+		Array<u32> _directional; // Directional lights, see RenderWorld::render().
 
 		///
 		explicit LightManager(Allocator &a)
 			: _allocator(&a)
 			, _map(a)
+			, _tree(a)
+			, _directional(a)
 		{
 			memset(&_data, 0, sizeof(_data));
 		}
@@ -354,6 +758,13 @@ struct RenderWorld
 		///
 		LightInstance light(UnitId unit);
 
+		/// Returns the world-space box enclosing the range of the instance @a i.
+		AABB world_aabb(u32 i);
+
+		/// Moves the proxy of the instance @a i to enclose its current range,
+		/// creating or destroying it if the type of the light changed.
+		void update_proxy(u32 i);
+
 		///
 		void debug_draw(u32 start_index, u32 num, DebugLine &dl);
 
@@ -379,15 +790,17 @@ struct RenderWorld
 	MaterialManager *_material_manager;
 	UnitManager *_unit_manager;
 
-	bgfx::UniformHandle _u_light_position;
-	bgfx::UniformHandle _u_light_direction;
-	bgfx::UniformHandle _u_light_color;
-	bgfx::UniformHandle _u_light_range;
-	bgfx::UniformHandle _u_light_intensity;
+	bgfx::UniformHandle _u_lights;
+	bgfx::UniformHandle _u_light_count;
+	Array<Vector4> _light_data; // 4 Vector4 per light, see RenderWorld::render().
 
 	bool _debug_drawing;
+	bool _occlusion_culling;
+	OcclusionBuffer _occlusion_buffer;
 	MeshManager _mesh_manager;
 	SpriteManager _sprite_manager;
+	TilemapManager _tilemap_manager;
+	ParticleManager _particle_manager;
 	LightManager _light_manager;
 
 	UnitDestroyCallback _unit_destroy_callback;
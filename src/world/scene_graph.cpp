@@ -4,15 +4,16 @@
  */
 
 #include "core/containers/array.inl"
-#include "core/containers/hash_map.inl"
 #include "core/math/constants.h"
 #include "core/math/matrix3x3.inl"
 #include "core/math/matrix4x4.inl"
 #include "core/math/quaternion.inl"
 #include "core/math/vector3.inl"
 #include "core/memory/allocator.h"
+#include "core/memory/memory.inl"
 #include "world/scene_graph.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 #include <stdint.h> // UINT_MAX
 #include <string.h> // memcpy
 
@@ -41,6 +42,9 @@ SceneGraph::SceneGraph(Allocator &a, UnitManager &um)
 	, _allocator(&a)
 	, _unit_manager(&um)
 	, _map(a)
+	, _first_dirty(UINT32_MAX)
+	, _unsorted(false)
+	, _changed(a)
 {
 	_unit_destroy_callback.destroy = unit_destroyed_callback_bridge;
 	_unit_destroy_callback.user_data = this;
@@ -63,31 +67,40 @@ TransformInstance SceneGraph::make_instance(u32 i)
 	TransformInstance inst = { i }; return inst;
 }
 
-void SceneGraph::allocate(u32 num)
+/// Allocates storage for @a num nodes from @a a and points the arrays of
+/// @a data into it.
+static void scene_graph_allocate_data(SceneGraph::InstanceData &data, Allocator &a, u32 num)
 {
-	CE_ASSERT(num > _data.size, "num > _data.size");
-
 	const u32 bytes = 0
 		+ num*sizeof(UnitId) + alignof(UnitId)
 		+ num*sizeof(Matrix4x4) + alignof(Matrix4x4)
-		+ num*sizeof(Pose) + alignof(Pose)
+		+ num*sizeof(SceneGraph::Pose) + alignof(SceneGraph::Pose)
 		+ num*sizeof(TransformInstance) * 4 + alignof(TransformInstance)
+		+ num*sizeof(u32) + alignof(u32)
 		+ num*sizeof(bool) + alignof(bool)
 		;
 
+	data.capacity = num;
+	data.buffer = a.allocate(bytes);
+
+	data.unit          = (UnitId *           )memory::align_top(data.buffer,              alignof(UnitId));
+	data.world         = (Matrix4x4 *        )memory::align_top(data.unit + num,          alignof(Matrix4x4));
+	data.local         = (SceneGraph::Pose * )memory::align_top(data.world + num,         alignof(SceneGraph::Pose));
+	data.parent        = (TransformInstance *)memory::align_top(data.local + num,         alignof(TransformInstance));
+	data.first_child   = (TransformInstance *)memory::align_top(data.parent + num,        alignof(TransformInstance));
+	data.next_sibling  = (TransformInstance *)memory::align_top(data.first_child + num,   alignof(TransformInstance));
+	data.prev_sibling  = (TransformInstance *)memory::align_top(data.next_sibling + num,  alignof(TransformInstance));
+	data.changed_index = (u32 *              )memory::align_top(data.prev_sibling + num,  alignof(u32));
+	data.dirty         = (bool *             )memory::align_top(data.changed_index + num, alignof(bool));
+}
+
+void SceneGraph::allocate(u32 num)
+{
+	CE_ASSERT(num > _data.size, "num > _data.size");
+
 	InstanceData new_data;
 	new_data.size = _data.size;
-	new_data.capacity = num;
-	new_data.buffer = _allocator->allocate(bytes);
-
-	new_data.unit         = (UnitId *           )memory::align_top(new_data.buffer,             alignof(UnitId));
-	new_data.world        = (Matrix4x4 *        )memory::align_top(new_data.unit + num,         alignof(Matrix4x4));
-	new_data.local        = (Pose *             )memory::align_top(new_data.world + num,        alignof(Pose));
-	new_data.parent       = (TransformInstance *)memory::align_top(new_data.local + num,        alignof(TransformInstance));
-	new_data.first_child  = (TransformInstance *)memory::align_top(new_data.parent + num,       alignof(TransformInstance));
-	new_data.next_sibling = (TransformInstance *)memory::align_top(new_data.first_child + num,  alignof(TransformInstance));
-	new_data.prev_sibling = (TransformInstance *)memory::align_top(new_data.next_sibling + num, alignof(TransformInstance));
-	new_data.changed      = (bool *             )memory::align_top(new_data.prev_sibling + num, alignof(bool));
+	scene_graph_allocate_data(new_data, *_allocator, num);
 
 	memcpy(new_data.unit, _data.unit, _data.size * sizeof(UnitId));
 	memcpy(new_data.world, _data.world, _data.size * sizeof(Matrix4x4));
@@ -96,7 +109,8 @@ void SceneGraph::allocate(u32 num)
 	memcpy(new_data.first_child, _data.first_child, _data.size * sizeof(TransformInstance));
 	memcpy(new_data.next_sibling, _data.next_sibling, _data.size * sizeof(TransformInstance));
 	memcpy(new_data.prev_sibling, _data.prev_sibling, _data.size * sizeof(TransformInstance));
-	memcpy(new_data.changed, _data.changed, _data.size * sizeof(bool));
+	memcpy(new_data.changed_index, _data.changed_index, _data.size * sizeof(u32));
+	memcpy(new_data.dirty, _data.dirty, _data.size * sizeof(bool));
 
 	_allocator->deallocate(_data.buffer);
 	_data = new_data;
@@ -122,7 +136,7 @@ TransformInstance SceneGraph::create(UnitId unit, const Vector3 &pos, const Quat
 
 TransformInstance SceneGraph::create(UnitId unit, const Matrix4x4 &pose)
 {
-	CE_ASSERT(!hash_map::has(_map, unit), "Unit already has a transform component");
+	CE_ASSERT(!unit_map::has(_map, unit), "Unit already has a transform component");
 
 	if (_data.capacity == 0 || _data.capacity - 1 == _data.size)
 		grow();
@@ -136,18 +150,19 @@ TransformInstance SceneGraph::create(UnitId unit, const Matrix4x4 &pose)
 	_data.first_child[last].i  = UINT32_MAX;
 	_data.next_sibling[last].i = UINT32_MAX;
 	_data.prev_sibling[last].i = UINT32_MAX;
-	_data.changed[last]        = false;
+	_data.changed_index[last]  = UINT32_MAX;
+	_data.dirty[last]          = false;
 
 	++_data.size;
 
-	hash_map::set(_map, unit, last);
+	unit_map::set(_map, unit, last);
 
 	return make_instance(last);
 }
 
 /// Moves the node data from index @a src to index @a dst, while preserving
 /// internal links between nodes.
-static void scene_graph_move_data(const SceneGraph &sg, u32 dst, u32 src)
+static void scene_graph_move_data(SceneGraph &sg, u32 dst, u32 src)
 {
 	// Any node can be referenced by its children.
 	TransformInstance cur = sg._data.first_child[src];
@@ -169,18 +184,23 @@ static void scene_graph_move_data(const SceneGraph &sg, u32 dst, u32 src)
 			sg._data.next_sibling[sg._data.prev_sibling[src].i].i = dst;
 	}
 
-	sg._data.unit[dst]         = sg._data.unit[src];
-	sg._data.world[dst]        = sg._data.world[src];
-	sg._data.local[dst]        = sg._data.local[src];
-	sg._data.parent[dst]       = sg._data.parent[src];
-	sg._data.first_child[dst]  = sg._data.first_child[src];
-	sg._data.next_sibling[dst] = sg._data.next_sibling[src];
-	sg._data.prev_sibling[dst] = sg._data.prev_sibling[src];
-	sg._data.changed[dst]      = sg._data.changed[src];
+	// The node can also be referenced by the list of changed nodes.
+	if (sg._data.changed_index[src] != UINT32_MAX)
+		sg._changed[sg._data.changed_index[src]] = dst;
+
+	sg._data.unit[dst]          = sg._data.unit[src];
+	sg._data.world[dst]         = sg._data.world[src];
+	sg._data.local[dst]         = sg._data.local[src];
+	sg._data.parent[dst]        = sg._data.parent[src];
+	sg._data.first_child[dst]   = sg._data.first_child[src];
+	sg._data.next_sibling[dst]  = sg._data.next_sibling[src];
+	sg._data.prev_sibling[dst]  = sg._data.prev_sibling[src];
+	sg._data.changed_index[dst] = sg._data.changed_index[src];
+	sg._data.dirty[dst]         = sg._data.dirty[src];
 }
 
 /// Swaps the transforms @a aa and @a bb.
-static void scene_graph_swap(const SceneGraph &sg, TransformInstance aa, TransformInstance bb)
+static void scene_graph_swap(SceneGraph &sg, TransformInstance aa, TransformInstance bb)
 {
 	// Index of the temporary storage slot. Memory access past size-1 is allowed
 	// because we allocate one extra slot in SceneGraph::grow().
@@ -195,6 +215,9 @@ void SceneGraph::destroy(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
 
+	transform = sorted(transform);
+	update();
+
 	// Unlink all children.
 	TransformInstance cur = _data.first_child[transform.i];
 	while (is_valid(cur)) {
@@ -204,27 +227,52 @@ void SceneGraph::destroy(TransformInstance transform)
 	}
 	unlink(transform);
 
+	// Remove the node from the list of changed nodes.
+	const u32 ci = _data.changed_index[transform.i];
+	if (ci != UINT32_MAX) {
+		const u32 back = _changed[array::size(_changed) - 1];
+		_changed[ci] = back;
+		_data.changed_index[back] = ci;
+		array::pop_back(_changed);
+		_data.changed_index[transform.i] = UINT32_MAX;
+	}
+
 	const u32 last = _data.size - 1;
 	const UnitId u = _data.unit[transform.i];
 	const UnitId last_u = _data.unit[last];
 
 	if (last != transform.i) {
 		scene_graph_swap(*this, transform, make_instance(last));
-		hash_map::set(_map, last_u, transform.i);
+		unit_map::set(_map, last_u, transform.i);
 	}
-	hash_map::remove(_map, u);
+	unit_map::remove(_map, u);
 
 	--_data.size;
+
+	if (last != transform.i) {
+		// The last node has no children but it may now come before its
+		// parent. Swap it with its ancestors until the order is restored.
+		TransformInstance cur = transform;
+		TransformInstance parent = _data.parent[cur.i];
+		while (is_valid(parent) && parent.i > cur.i) {
+			const UnitId cur_u = _data.unit[cur.i];
+			const UnitId parent_u = _data.unit[parent.i];
+			scene_graph_swap(*this, cur, parent);
+			unit_map::set(_map, cur_u, parent.i);
+			unit_map::set(_map, parent_u, cur.i);
+			parent = _data.parent[cur.i];
+		}
+	}
 }
 
 TransformInstance SceneGraph::instance(UnitId unit)
 {
-	return make_instance(hash_map::get(_map, unit, UINT32_MAX));
+	return make_instance(unit_map::get(_map, unit, UINT32_MAX));
 }
 
 bool SceneGraph::has(UnitId unit)
 {
-	return hash_map::has(_map, unit);
+	return unit_map::has(_map, unit);
 }
 
 void SceneGraph::set_local_position(TransformInstance transform, const Vector3 &pos)
@@ -284,34 +332,44 @@ Matrix4x4 SceneGraph::local_pose(TransformInstance transform)
 Vector3 SceneGraph::world_position(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	transform = sorted(transform);
+	update();
 	return translation(_data.world[transform.i]);
 }
 
 Quaternion SceneGraph::world_rotation(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	transform = sorted(transform);
+	update();
 	return rotation(_data.world[transform.i]);
 }
 
 Matrix4x4 SceneGraph::world_pose(TransformInstance transform)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	transform = sorted(transform);
+	update();
 	return _data.world[transform.i];
 }
 
 void SceneGraph::set_world_pose(TransformInstance transform, const Matrix4x4 &pose)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	transform = sorted(transform);
+	update();
 	_data.world[transform.i] = pose;
-	_data.changed[transform.i] = true;
+	set_changed(transform.i);
 }
 
 void SceneGraph::set_world_pose_and_rescale(TransformInstance transform, const Matrix4x4 &pose)
 {
 	CE_ASSERT(transform.i < _data.size, "Index out of bounds");
+	transform = sorted(transform);
+	update();
 	_data.world[transform.i] = pose;
 	set_scale(_data.world[transform.i], _data.local[transform.i].scale);
-	_data.changed[transform.i] = true;
+	set_changed(transform.i);
 }
 
 u32 SceneGraph::num_nodes() const
@@ -329,7 +387,13 @@ void SceneGraph::link(TransformInstance parent
 	CE_ASSERT(child.i < _data.size, "Index out of bounds");
 	CE_ASSERT(parent.i < _data.size, "Index out of bounds");
 
-	unlink(child);
+	if (is_valid(_data.parent[child.i])) {
+		// Unlinking may sort the nodes.
+		const UnitId parent_unit = _data.unit[parent.i];
+		child = sorted(child);
+		parent = instance(parent_unit);
+		unlink(child);
+	}
 
 	// Append transform to the list of parent's children
 	if (!is_valid(_data.first_child[parent.i])) {
@@ -345,7 +409,6 @@ void SceneGraph::link(TransformInstance parent
 
 		_data.next_sibling[prev.i] = child;
 
-		_data.first_child[child.i].i = UINT32_MAX;
 		_data.next_sibling[child.i].i = UINT32_MAX;
 		_data.prev_sibling[child.i] = prev;
 	}
@@ -355,7 +418,12 @@ void SceneGraph::link(TransformInstance parent
 	_data.local[child.i].scale    = child_local_scale;
 	_data.parent[child.i] = parent;
 
-	transform(_data.world[parent.i], child);
+	set_local(child);
+
+	// Sorting is deferred to the next update() so that linking many nodes
+	// costs a single sort.
+	if (child.i < parent.i)
+		_unsorted = true;
 }
 
 void SceneGraph::unlink(TransformInstance child)
@@ -365,6 +433,9 @@ void SceneGraph::unlink(TransformInstance child)
 	if (!is_valid(_data.parent[child.i]))
 		return;
 
+	child = sorted(child);
+	update();
+
 	if (_data.first_child[_data.parent[child.i].i].i == child.i)
 		_data.first_child[_data.parent[child.i].i] = _data.next_sibling[child.i];
 	else
@@ -381,42 +452,142 @@ void SceneGraph::unlink(TransformInstance child)
 	_data.prev_sibling[child.i].i = UINT32_MAX;
 }
 
-void SceneGraph::clear_changed()
+void SceneGraph::update()
 {
-	for (u32 i = 0; i < _data.size; ++i) {
-		_data.changed[i] = false;
+	if (_unsorted)
+		sort();
+
+	if (_first_dirty == UINT32_MAX)
+		return;
+
+	// Parents come before their children so, by the time a node is visited,
+	// its parent world pose is up to date and its dirty flag tells whether
+	// the node must be recomputed too.
+	for (u32 i = _first_dirty; i < _data.size; ++i) {
+		const TransformInstance parent = _data.parent[i];
+
+		if (is_valid(parent) && _data.dirty[parent.i])
+			_data.dirty[i] = true;
+		else if (!_data.dirty[i])
+			continue;
+
+		const Matrix4x4 local = local_pose(make_instance(i));
+		_data.world[i] = is_valid(parent) ? local * _data.world[parent.i] : local;
+		set_changed(i);
 	}
+
+	memset(&_data.dirty[_first_dirty], 0, (_data.size - _first_dirty) * sizeof(bool));
+	_first_dirty = UINT32_MAX;
+}
+
+void SceneGraph::clear_changed()
+{
+	for (u32 i = 0; i < array::size(_changed); ++i)
+		_data.changed_index[_changed[i]] = UINT32_MAX;
+
+	array::clear(_changed);
 }
 
 void SceneGraph::get_changed(Array<UnitId> &units, Array<Matrix4x4> &world_poses)
 {
-	for (u32 i = 0; i < _data.size; ++i) {
-		if (_data.changed[i]) {
-			array::push_back(units, _data.unit[i]);
-			array::push_back(world_poses, _data.world[i]);
-		}
+	update();
+
+	const u32 num = array::size(_changed);
+	array::reserve(units, array::size(units) + num);
+	array::reserve(world_poses, array::size(world_poses) + num);
+
+	for (u32 i = 0; i < num; ++i) {
+		array::push_back(units, _data.unit[_changed[i]]);
+		array::push_back(world_poses, _data.world[_changed[i]]);
 	}
 }
 
-void SceneGraph::set_local(TransformInstance transform)
+void SceneGraph::set_changed(u32 i)
 {
-	TransformInstance parent = _data.parent[transform.i];
-	Matrix4x4 parent_tm = is_valid(parent) ? _data.world[parent.i] : MATRIX4X4_IDENTITY;
-	SceneGraph::transform(parent_tm, transform);
+	if (_data.changed_index[i] != UINT32_MAX)
+		return;
+
+	_data.changed_index[i] = array::push_back(_changed, i);
+}
 
-	_data.changed[transform.i] = true;
+void SceneGraph::set_local(TransformInstance transform)
+{
+	_data.dirty[transform.i] = true;
+	_first_dirty = min(_first_dirty, transform.i);
 }
 
-void SceneGraph::transform(const Matrix4x4 &parent, TransformInstance transform)
+void SceneGraph::sort()
 {
-	_data.world[transform.i] = local_pose(transform) * parent;
-	_data.changed[transform.i] = true;
+	const u32 num = _data.size;
+
+	// Breadth-first visit starting from the roots: order[] maps new indices
+	// to old indices and remap[] does the opposite.
+	u32 *order = (u32 *)_allocator->allocate(sizeof(u32) * num * 2);
+	u32 *remap = order + num;
+
+	u32 tail = 0;
+	for (u32 i = 0; i < num; ++i) {
+		if (!is_valid(_data.parent[i]))
+			order[tail++] = i;
+	}
+	for (u32 head = 0; head < tail; ++head) {
+		TransformInstance child = _data.first_child[order[head]];
+		while (is_valid(child)) {
+			order[tail++] = child.i;
+			child = _data.next_sibling[child.i];
+		}
+	}
+	CE_ASSERT(tail == num, "Cycle in scene graph");
+
+	for (u32 i = 0; i < num; ++i)
+		remap[order[i]] = i;
 
-	TransformInstance child = _data.first_child[transform.i];
-	while (is_valid(child)) {
-		SceneGraph::transform(_data.world[transform.i], child);
-		child = _data.next_sibling[child.i];
+	InstanceData new_data;
+	new_data.size = num;
+	scene_graph_allocate_data(new_data, *_allocator, _data.capacity);
+
+	const TransformInstance *links_src[] = { _data.parent, _data.first_child, _data.next_sibling, _data.prev_sibling };
+	TransformInstance *links_dst[] = { new_data.parent, new_data.first_child, new_data.next_sibling, new_data.prev_sibling };
+
+	u32 first_dirty = UINT32_MAX;
+	for (u32 i = 0; i < num; ++i) {
+		const u32 src = order[i];
+
+		new_data.unit[i]    = _data.unit[src];
+		new_data.world[i]   = _data.world[src];
+		new_data.local[i]   = _data.local[src];
+		new_data.changed_index[i] = _data.changed_index[src];
+		new_data.dirty[i]   = _data.dirty[src];
+
+		for (u32 ll = 0; ll < countof(links_src); ++ll) {
+			const TransformInstance link = links_src[ll][src];
+			links_dst[ll][i].i = is_valid(link) ? remap[link.i] : UINT32_MAX;
+		}
+
+		if (new_data.changed_index[i] != UINT32_MAX)
+			_changed[new_data.changed_index[i]] = i;
+
+		if (new_data.dirty[i] && first_dirty == UINT32_MAX)
+			first_dirty = i;
+
+		unit_map::set(_map, new_data.unit[i], i);
 	}
+
+	_allocator->deallocate(order);
+	_allocator->deallocate(_data.buffer);
+	_data = new_data;
+	_first_dirty = first_dirty;
+	_unsorted = false;
+}
+
+TransformInstance SceneGraph::sorted(TransformInstance transform)
+{
+	if (!_unsorted)
+		return transform;
+
+	const UnitId unit = _data.unit[transform.i];
+	sort();
+	return instance(unit);
 }
 
 void SceneGraph::grow()
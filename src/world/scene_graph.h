@@ -11,6 +11,7 @@
 #include "core/memory/types.h"
 #include "core/types.h"
 #include "world/types.h"
+#include "world/unit_map.h"
 
 namespace crown
 {
@@ -41,7 +42,8 @@ struct SceneGraph
 			, first_child(NULL)
 			, next_sibling(NULL)
 			, prev_sibling(NULL)
-			, changed(NULL)
+			, changed_index(NULL)
+			, dirty(NULL)
 		{
 		}
 
@@ -56,15 +58,19 @@ struct SceneGraph
 		TransformInstance *first_child;
 		TransformInstance *next_sibling;
 		TransformInstance *prev_sibling;
-		bool *changed;
+		u32 *changed_index; ///< Index into SceneGraph::_changed or UINT32_MAX.
+		bool *dirty;
 	};
 
 	u32 _marker;
 	Allocator *_allocator;
 	UnitManager *_unit_manager;
 	InstanceData _data;
-	HashMap<UnitId, u32> _map;
+	UnitMap _map;
 	UnitDestroyCallback _unit_destroy_callback;
+	u32 _first_dirty;
+	bool _unsorted;    ///< Whether some node comes before its parent.
+	Array<u32> _changed;
 
 	///
 	SceneGraph(Allocator &a, UnitManager &um);
@@ -133,6 +139,9 @@ struct SceneGraph
 	/// parent. Set child_local_* to modify the child position after it has been
 	/// linked to the parent, otherwise che child will be positioned at the
 	/// location of its parent.
+	/// @note If @a child is stored before @a parent, the nodes are reordered
+	/// by the next update() so that parents always come before their
+	/// children. This invalidates any TransformInstance obtained before it.
 	void link(TransformInstance parent
 		, TransformInstance child
 		, const Vector3 &child_local_position = VECTOR3_ZERO
@@ -144,10 +153,24 @@ struct SceneGraph
 	/// pose of the @a child is set to its previous world pose.
 	void unlink(TransformInstance child);
 
+	/// Recomputes the world poses of the nodes whose local poses changed and of
+	/// all their descendants. Nodes are kept sorted so that parents always come
+	/// before their children, so this is a single linear sweep starting from
+	/// the first changed node. Reading world poses calls this automatically.
+	void update();
+
+	/// Forgets all the nodes whose world poses changed.
 	void clear_changed();
+
+	/// Returns the @a units whose world poses changed since the last call to
+	/// clear_changed() together with their @a world_poses. The cost is
+	/// proportional to the number of changed nodes.
 	void get_changed(Array<UnitId> &units, Array<Matrix4x4> &world_poses);
+
+	void set_changed(u32 i);
 	void set_local(TransformInstance transform);
-	void transform(const Matrix4x4 &parent, TransformInstance transform);
+	void sort();
+	TransformInstance sorted(TransformInstance transform);
 	void grow();
 	void allocate(u32 num);
 	TransformInstance make_instance(u32 i);
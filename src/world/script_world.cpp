@@ -10,6 +10,7 @@
 #include "resource/resource_manager.h"
 #include "world/script_world.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 
 namespace crown
 {
@@ -23,7 +24,7 @@ namespace script_world_internal
 
 	static void unit_destroyed_callback(ScriptWorld &sw, UnitId unit, ScriptInstance i)
 	{
-		if (hash_map::has(sw._map, unit))
+		if (unit_map::has(sw._map, unit))
 			script_world::destroy(sw, unit, i);
 	}
 
@@ -37,7 +38,7 @@ namespace script_world
 {
 	ScriptInstance create(ScriptWorld &sw, UnitId unit, const ScriptDesc &desc)
 	{
-		CE_ASSERT(!hash_map::has(sw._map, unit), "Unit already has a script component");
+		CE_ASSERT(!unit_map::has(sw._map, unit), "Unit already has a script component");
 
 		u32 script_i = hash_map::get(sw._cache
 			, desc.script_resource
@@ -69,7 +70,7 @@ namespace script_world
 
 		u32 instance_i = array::size(sw._data);
 		array::push_back(sw._data, data);
-		hash_map::set(sw._map, unit, instance_i);
+		unit_map::set(sw._map, unit, instance_i);
 
 		/*if (!sw._disable_callbacks) {
 			LuaStack stack(sw._lua_environment->L);
@@ -93,9 +94,9 @@ namespace script_world
 
 	void destroy(ScriptWorld &sw, UnitId unit, ScriptInstance /*i*/)
 	{
-		CE_ASSERT(hash_map::has(sw._map, unit), "Unit does not have script component");
+		CE_ASSERT(unit_map::has(sw._map, unit), "Unit does not have script component");
 
-		const u32 unit_i    = hash_map::get(sw._map, unit, UINT32_MAX);
+		const u32 unit_i    = unit_map::get(sw._map, unit, UINT32_MAX);
 		const u32 last_i    = array::size(sw._data) - 1;
 		const UnitId last_u = sw._data[last_i].unit;
 		const u32 script_i  = sw._data[unit_i].script_i;
@@ -118,13 +119,13 @@ namespace script_world
 		}*/
 
 		sw._data[unit_i] = sw._data[last_i];
-		hash_map::set(sw._map, last_u, unit_i);
+		unit_map::set(sw._map, last_u, unit_i);
 		array::pop_back(sw._data);
 	}
 
 	ScriptInstance instance(ScriptWorld &sw, UnitId unit)
 	{
-		return script_world_internal::make_instance(hash_map::get(sw._map, unit, UINT32_MAX));
+		return script_world_internal::make_instance(unit_map::get(sw._map, unit, UINT32_MAX));
 	}
 
 	void update(ScriptWorld &sw, f32 dt)
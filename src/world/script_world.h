@@ -7,6 +7,7 @@
 #include "python/py_evn.h"
 #include "resource/types.h"
 #include "world/types.h"
+#include "world/unit_map.h"
 
 namespace crown
 {
@@ -29,7 +30,7 @@ struct ScriptWorld
 	u32 _marker;
 	Array<ScriptData> _script;
 	Array<InstanceData> _data;
-	HashMap<UnitId, u32> _map;
+	UnitMap _map;
 	HashMap<StringId64, u32> _cache;
 
 	UnitManager *_unit_manager;
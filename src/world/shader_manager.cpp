@@ -140,7 +140,37 @@ u32 ShaderManager::sampler_state(StringId32 shader_id, StringId32 sampler_name)
 	return UINT32_MAX;
 }
 
-void ShaderManager::submit(StringId32 shader_id, u8 view_id, s32 depth, u64 state)
+bool ShaderManager::has(StringId32 shader_id)
+{
+	return hash_map::has(_shader_map, shader_id);
+}
+
+u64 ShaderManager::state(StringId32 shader_id)
+{
+	CE_ASSERT(hash_map::has(_shader_map, shader_id), "Shader not found");
+	ShaderData sd;
+	sd.state = BGFX_STATE_DEFAULT;
+	sd.program = BGFX_INVALID_HANDLE;
+	return hash_map::get(_shader_map, shader_id, sd).state;
+}
+
+bgfx::ProgramHandle ShaderManager::program(StringId32 shader_id)
+{
+	CE_ASSERT(hash_map::has(_shader_map, shader_id), "Shader not found");
+	ShaderData sd;
+	sd.state = BGFX_STATE_DEFAULT;
+	sd.program = BGFX_INVALID_HANDLE;
+	return hash_map::get(_shader_map, shader_id, sd).program;
+}
+
+void ShaderManager::submit(StringId32 shader_id, u8 view_id, s32 depth, u64 state, u8 flags)
+{
+	bgfx::Encoder *encoder = bgfx::begin();
+	submit(encoder, shader_id, view_id, depth, state, flags);
+	bgfx::end(encoder);
+}
+
+void ShaderManager::submit(bgfx::Encoder *encoder, StringId32 shader_id, u8 view_id, s32 depth, u64 state, u8 flags)
 {
 	CE_ASSERT(hash_map::has(_shader_map, shader_id), "Shader not found");
 	ShaderData sd;
@@ -148,8 +178,8 @@ void ShaderManager::submit(StringId32 shader_id, u8 view_id, s32 depth, u64 stat
 	sd.program = BGFX_INVALID_HANDLE;
 	sd = hash_map::get(_shader_map, shader_id, sd);
 
-	bgfx::setState(state != UINT64_MAX ? state : sd.state);
-	bgfx::submit(view_id, sd.program, depth);
+	encoder->setState(state != UINT64_MAX ? state : sd.state);
+	encoder->submit(view_id, sd.program, depth, flags);
 }
 
 } // namespace crown
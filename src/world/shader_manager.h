@@ -51,8 +51,21 @@ struct ShaderManager
 	///
 	u32 sampler_state(StringId32 shader_id, StringId32 sampler_name);
 
-	///
-	void submit(StringId32 shader_id, u8 view_id, s32 depth = 0, u64 state = UINT64_MAX);
+	/// Returns whether the shader @a shader_id exists.
+	bool has(StringId32 shader_id);
+
+	/// Returns the render state of the shader @a shader_id.
+	u64 state(StringId32 shader_id);
+
+	/// Returns the program of the shader @a shader_id.
+	bgfx::ProgramHandle program(StringId32 shader_id);
+
+	/// Submits a draw call with the shader @a shader_id. See bgfx::submit()
+	/// for the meaning of @a flags.
+	void submit(StringId32 shader_id, u8 view_id, s32 depth = 0, u64 state = UINT64_MAX, u8 flags = BGFX_DISCARD_ALL);
+
+	/// Submits a draw call with the shader @a shader_id through @a encoder.
+	void submit(bgfx::Encoder *encoder, StringId32 shader_id, u8 view_id, s32 depth = 0, u64 state = UINT64_MAX, u8 flags = BGFX_DISCARD_ALL);
 };
 
 } // namespace crown
@@ -20,6 +20,7 @@ struct Gui;
 struct Level;
 struct Material;
 struct MaterialManager;
+struct ParticleEmitter;
 struct PhysicsWorld;
 struct RenderWorld;
 struct SceneGraph;
@@ -270,6 +271,8 @@ INSTANCE_ID(TransformInstance)
 INSTANCE_ID(CameraInstance)
 INSTANCE_ID(MeshInstance)
 INSTANCE_ID(SpriteInstance)
+INSTANCE_ID(TilemapInstance)
+INSTANCE_ID(ParticleSystemInstance)
 INSTANCE_ID(LightInstance)
 INSTANCE_ID(ColliderInstance)
 INSTANCE_ID(ActorInstance)
@@ -288,7 +291,8 @@ struct MeshRendererDesc
 	StringId64 material_resource; ///< Name of .material resource.
 	StringId32 geometry_name;     ///< Name of geometry inside .mesh resource.
 	bool visible;                 ///< Whether mesh is visible.
-	char _pad0[3];
+	bool occluder;                ///< Whether mesh hides other meshes when occlusion culling is enabled.
+	char _pad0[2];
 };
 
 /// Sprite renderer description.
@@ -305,6 +309,32 @@ struct SpriteRendererDesc
 	char _pad1[4];
 };
 
+/// Tilemap renderer description.
+///
+/// @ingroup World
+struct TilemapRendererDesc
+{
+	StringId64 tilemap_resource;  ///< Name of .tilemap resource.
+	StringId64 material_resource; ///< Name of .material resource.
+	u32 layer;                    ///< Sort layer
+	u32 depth;                    ///< Depth in layer
+	bool visible;                 ///< Whether tilemap is visible.
+	char _pad0[3];
+	char _pad1[4];
+};
+
+/// Particle system description.
+///
+/// @ingroup World
+struct ParticleSystemDesc
+{
+	StringId64 particle_system_resource; ///< Name of .particle_system resource.
+	StringId64 material_resource;        ///< Name of .material resource.
+	bool visible;                        ///< Whether particles are visible.
+	char _pad0[3];
+	char _pad1[4];
+};
+
 /// Animation state machine description.
 ///
 /// @ingroup World
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/containers/types.h"
+#include "world/types.h"
+
+namespace crown
+{
+/// Maps units to u32 values, usually the index of their component instance.
+/// Values are stored in an array indexed by UnitId::index(), so lookups are
+/// a single array load. Each slot also stores the UnitId it was set for,
+/// which makes lookups with a UnitId from an older generation miss.
+///
+/// @ingroup World
+struct UnitMap
+{
+	struct Entry
+	{
+		UnitId unit;
+		u32 value;
+	};
+
+	Array<Entry> _data;
+
+	///
+	explicit UnitMap(Allocator &a);
+};
+
+} // namespace crown
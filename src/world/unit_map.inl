@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2012-2024 Daniele Bartolini et al.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include "core/containers/array.inl"
+#include "world/unit_map.h"
+
+namespace crown
+{
+/// Functions to manipulate UnitMap.
+///
+/// @ingroup World
+namespace unit_map
+{
+	/// Returns whether the @a unit is in the map @a m.
+	inline bool has(const UnitMap &m, UnitId unit)
+	{
+		const u32 idx = unit.index();
+		return idx < array::size(m._data) && m._data[idx].unit == unit;
+	}
+
+	/// Returns the value of the @a unit or @a deffault if the unit is not in the map @a m.
+	inline u32 get(const UnitMap &m, UnitId unit, u32 deffault)
+	{
+		return has(m, unit) ? m._data[unit.index()].value : deffault;
+	}
+
+	/// Sets the @a value of the @a unit in the map @a m.
+	inline void set(UnitMap &m, UnitId unit, u32 value)
+	{
+		const u32 idx = unit.index();
+		const u32 size = array::size(m._data);
+
+		if (idx >= size) {
+			array::reserve(m._data, idx + 1);
+			array::resize(m._data, idx + 1);
+
+			for (u32 ii = size; ii < idx + 1; ++ii)
+				m._data[ii].unit = UNIT_INVALID;
+		}
+
+		m._data[idx].unit = unit;
+		m._data[idx].value = value;
+	}
+
+	/// Removes the @a unit from the map @a m.
+	inline void remove(UnitMap &m, UnitId unit)
+	{
+		if (has(m, unit))
+			m._data[unit.index()].unit = UNIT_INVALID;
+	}
+
+} // namespace unit_map
+
+inline UnitMap::UnitMap(Allocator &a)
+	: _data(a)
+{
+}
+
+} // namespace crown
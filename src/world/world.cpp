@@ -3,7 +3,6 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include "core/containers/hash_map.inl"
 #include "core/error/error.h"
 #include "core/list.inl"
 #include "core/math/matrix4x4.inl"
@@ -24,6 +23,7 @@
 #include "world/script_world.h"
 #include "world/sound_world.h"
 #include "world/unit_manager.h"
+#include "world/unit_map.inl"
 #include "world/world.h"
 #include <bgfx/bgfx.h>
 #include <bx/math.h>
@@ -48,7 +48,7 @@ World::World(Allocator &a, ResourceManager &rm, ShaderManager &sm, MaterialManag
 	, _camera(a)
 	, _camera_map(a)
 	, _events(a)
-	, _gui_buffer(sm)
+	, _gui_buffer(a, rm, sm, mm)
 {
 	_lines = create_debug_line(true);
 	_scene_graph   = CE_NEW(*_allocator, SceneGraph)(*_allocator, um);
@@ -250,6 +250,8 @@ void World::update_scene(f32 dt)
 		, array::begin(changed_world)
 		);
 
+	_render_world->update_particles(dt);
+
 	_sound_world->update();
 
 	_gui_buffer.reset();
@@ -265,9 +267,10 @@ void World::update(f32 dt)
 	update_scene(dt);
 }
 
-void World::render(const Matrix4x4 &view)
+void World::render(const Matrix4x4 &view, const Matrix4x4 &proj)
 {
-	_render_world->render(view);
+	_render_world->render(view, proj);
+	_gui_buffer.submit();
 
 	_physics_world->debug_draw();
 	_render_world->debug_draw(*_lines);
@@ -278,7 +281,7 @@ void World::render(const Matrix4x4 &view)
 
 CameraInstance World::camera_create(UnitId unit, const CameraDesc &cd, const Matrix4x4 & /*tr*/)
 {
-	CE_ASSERT(!hash_map::has(_camera_map, unit), "Unit already has a camera component");
+	CE_ASSERT(!unit_map::has(_camera_map, unit), "Unit already has a camera component");
 
 	Camera camera;
 	camera.unit            = unit;
@@ -290,7 +293,7 @@ CameraInstance World::camera_create(UnitId unit, const CameraDesc &cd, const Mat
 	const u32 last = array::size(_camera);
 	array::push_back(_camera, camera);
 
-	hash_map::set(_camera_map, unit, last);
+	unit_map::set(_camera_map, unit, last);
 	return camera_make_instance(last);
 }
 
@@ -302,13 +305,13 @@ void World::camera_destroy(CameraInstance camera)
 
 	_camera[camera.i] = _camera[last];
 
-	hash_map::set(_camera_map, last_u, camera.i);
-	hash_map::remove(_camera_map, u);
+	unit_map::set(_camera_map, last_u, camera.i);
+	unit_map::remove(_camera_map, u);
 }
 
 CameraInstance World::camera_instance(UnitId unit)
 {
-	return camera_make_instance(hash_map::get(_camera_map, unit, UINT32_MAX));
+	return camera_make_instance(unit_map::get(_camera_map, unit, UINT32_MAX));
 }
 
 void World::camera_set_projection_type(CameraInstance camera, ProjectionType::Enum type)
@@ -513,7 +516,7 @@ void World::set_sound_volume(SoundInstanceId id, f32 vol)
 
 DebugLine *World::create_debug_line(bool depth_test)
 {
-	return CE_NEW(*_allocator, DebugLine)(*_shader_manager, depth_test);
+	return CE_NEW(*_allocator, DebugLine)(*_allocator, *_shader_manager, depth_test);
 }
 
 void World::destroy_debug_line(DebugLine &line)
@@ -523,10 +526,7 @@ void World::destroy_debug_line(DebugLine &line)
 
 Gui *World::create_screen_gui()
 {
-	Gui *gui = CE_NEW(*_allocator, Gui)(_gui_buffer, *_resource_manager
-		, *_shader_manager
-		, *_material_manager
-		);
+	Gui *gui = CE_NEW(*_allocator, Gui)(_gui_buffer);
 
 	list::add(gui->_node, _guis);
 	return gui;
@@ -655,6 +655,20 @@ void spawn_units(World &w, const UnitResource *ur, const Vector3 &pos, const Qua
 				Matrix4x4 tm = scene_graph->world_pose(ti);
 				render_world->sprite_create(unit_lookup[unit_index[i]], *srd, tm);
 			}
+		} else if (component->type == STRING_ID_32("tilemap_renderer", UINT32_C(0xa0882575))) {
+			const TilemapRendererDesc *trd = (const TilemapRendererDesc *)data;
+			for (u32 i = 0, n = component->num_instances; i < n; ++i, ++trd) {
+				TransformInstance ti = scene_graph->instance(unit_lookup[unit_index[i]]);
+				Matrix4x4 tm = scene_graph->world_pose(ti);
+				render_world->tilemap_create(unit_lookup[unit_index[i]], *trd, tm);
+			}
+		} else if (component->type == STRING_ID_32("particle_system", UINT32_C(0xcc53e046))) {
+			const ParticleSystemDesc *psd = (const ParticleSystemDesc *)data;
+			for (u32 i = 0, n = component->num_instances; i < n; ++i, ++psd) {
+				TransformInstance ti = scene_graph->instance(unit_lookup[unit_index[i]]);
+				Matrix4x4 tm = scene_graph->world_pose(ti);
+				render_world->particle_system_create(unit_lookup[unit_index[i]], *psd, tm);
+			}
 		} else if (component->type == STRING_ID_32("light", UINT32_C(0xbb9f08c2))) {
 			const LightDesc *ld = (const LightDesc *)data;
 			for (u32 i = 0, n = component->num_instances; i < n; ++i, ++ld) {
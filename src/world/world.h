@@ -14,6 +14,7 @@
 #include "world/event_stream.h"
 #include "world/gui.h"
 #include "world/types.h"
+#include "world/unit_map.h"
 
 namespace crown
 {
@@ -61,7 +62,7 @@ struct World
 
 	Array<UnitId> _units;
 	Array<Camera> _camera;
-	HashMap<UnitId, u32> _camera_map;
+	UnitMap _camera_map;
 
 	EventStream _events;
 	GuiBuffer _gui_buffer;
@@ -165,8 +166,8 @@ struct World
 	/// Updates all units and sub-systems with the given @a dt delta time.
 	void update(f32 dt);
 
-	/// Renders the world using @a view.
-	void render(const Matrix4x4 &view);
+	/// Renders the world using @a view and @a proj.
+	void render(const Matrix4x4 &view, const Matrix4x4 &proj);
 
 	SoundInstanceId play_sound(const SoundResource &sr, bool loop = false, f32 volume = 1.0f, const Vector3 &position = VECTOR3_ZERO, f32 range = 50.0f);
 